@@ -1023,14 +1023,18 @@ void export_Roadmap() {
     {
         GET(Tempus::ResultElement, Tempus::Roadmap, roadmap)
         GET(Tempus::ResultElement, Tempus::Isochrone, isochrone)
+        GET(Tempus::ResultElement, Tempus::TravelTimeProfile, travel_time_profile)
 
         bp::class_<Tempus::ResultElement>("ResultElement")
             .def(bp::init<const Tempus::Isochrone&>())
             .def(bp::init<const Tempus::Roadmap&>())
+            .def(bp::init<const Tempus::TravelTimeProfile&>())
             .def("is_roadmap", &Tempus::ResultElement::is_roadmap)
             .def("is_isochrone", &Tempus::ResultElement::is_isochrone)
+            .def("is_travel_time_profile", &Tempus::ResultElement::is_travel_time_profile)
             .def("roadmap", roadmap_get)
             .def("isochrone", isochrone_get)
+            .def("travel_time_profile", travel_time_profile_get)
         ;
     }
 
@@ -1048,6 +1052,15 @@ void export_Roadmap() {
             .add_property("cost", cost_get, cost_set)
         ;
     }
+
+    {
+        GET_SET(Tempus::TravelTimeProfileValue, double, departure_time)
+        GET_SET(Tempus::TravelTimeProfileValue, double, travel_time)
+        bp::class_<Tempus::TravelTimeProfileValue>("TravelTimeProfileValue", bp::init<double, double>())
+            .add_property("departure_time", departure_time_get, departure_time_set)
+            .add_property("travel_time", travel_time_get, travel_time_set)
+        ;
+    }
 }
 
 void export_Cost() {
@@ -1074,6 +1087,36 @@ void export_Cost() {
     bp::to_python_converter<Tempus::Costs, map_to_python<Tempus::CostId, double>>();
 }
 
+#include <tempus/ch_distance_table.hh>
+
+bp::list ch_distance_table_wrapper(const Tempus::CHRoutingData& rd, const std::vector<Tempus::db_id_t>& origins, const std::vector<Tempus::db_id_t>& destinations) {
+    // one list per origin, None when a destination cannot be reached
+    Tempus::CHDistanceTable table( Tempus::ch_distance_table_from_ids( rd, origins, destinations ) );
+    bp::list rows;
+    for ( size_t i = 0; i < table.n_origins(); i++ ) {
+        bp::list row;
+        for ( size_t j = 0; j < table.n_destinations(); j++ ) {
+            if ( table.cost( i, j ) == Tempus::CHDistanceTable::infinity() ) {
+                row.append( bp::object() );
+            }
+            else {
+                row.append( table.cost( i, j ) );
+            }
+        }
+        rows.append( row );
+    }
+    return rows;
+}
+
+void export_CH() {
+    bp::class_<Tempus::CHRoutingData, bp::bases<Tempus::RoutingData>, boost::noncopyable>("CHRoutingData", bp::no_init)
+        .def("vertex_from_id", &Tempus::CHRoutingData::vertex_from_id, bp::return_value_policy<return_optional>())
+        .def("vertex_id", &Tempus::CHRoutingData::vertex_id)
+    ;
+
+    bp::def("ch_distance_table", &ch_distance_table_wrapper);
+}
+
 boost::optional<Tempus::Road::Edge> edge_wrapper(Tempus::Road::Vertex v1, Tempus::Road::Vertex v2, const Tempus::Road::Graph& road_graph) {
     Tempus::Road::Edge e;
     bool found = false;
@@ -1099,6 +1142,7 @@ BOOST_PYTHON_MODULE(pytempus)
     VECTOR_SEQ_CONV(Tempus::db_id_t)
     VECTOR_SEQ_CONV(Tempus::CostId)
     VECTOR_SEQ_CONV(Tempus::IsochroneValue)
+    VECTOR_SEQ_CONV(Tempus::TravelTimeProfileValue)
     VECTOR_SEQ_CONV(Tempus::POI)
     LIST_SEQ_CONV(Tempus::ResultElement)
 
@@ -1121,4 +1165,5 @@ BOOST_PYTHON_MODULE(pytempus)
     export_POI();
     export_Point();
     export_Cost();
+    export_CH();
 }
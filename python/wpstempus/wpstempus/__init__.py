@@ -1,6 +1,6 @@
 from history_file import HistoryFile, ZipHistoryFile
 from tempus_request import Cost,CostName,CostUnit,Point,DateTime,Constraint,RequestStep,EndMovement,RoadStep,PublicTransportStep,ConnectionType
 from tempus_request import RoadTransportStep,TransferStep
-from tempus_request import Roadmap,Isochrone,OptionType,OptionValue
+from tempus_request import Roadmap,Isochrone,TravelTimeProfile,OptionType,OptionValue
 from tempus_request import Variant,PluginOption,Plugin,TransportMode,TransportNetwork,RoadVertex,PoiVertex,PtVertex,ValuedEdge,TempusRequest
 import wps_client
@@ -197,6 +197,11 @@ class Isochrone:
     def __init__(self, points = []):
         self.points = points
 
+class TravelTimeProfile:
+    def __init__(self, points = []):
+        # (departure_time, travel_time) breakpoints, in minutes
+        self.points = points
+
 
 class OptionType:
     Bool = 0,
@@ -416,6 +421,8 @@ def parse_results(results):
             r.append(parse_roadmap(result))
         elif result.tag == 'isochrone':
             r.append(parse_isochrone(result))
+        elif result.tag == 'travel_time_profile':
+            r.append(parse_travel_time_profile(result))
     return r
 
 def parse_isochrone(result):
@@ -427,6 +434,13 @@ def parse_isochrone(result):
                        float(child.attrib['cost'])))
     return Isochrone(points)
 
+def parse_travel_time_profile(result):
+    points = []
+    for child in result:
+        points.append((float(child.attrib['departure_time']),
+                       float(child.attrib['travel_time'])))
+    return TravelTimeProfile(points)
+
 def parse_roadmap(result):
     steps = []
     gcosts = {}
@@ -657,6 +671,22 @@ class TempusRequest:
         r = "<select>\n" + r + "</select>\n"
         return r
 
+    def distance_table(self, plugin_name='ch_plugin', origins=None, destinations=None):
+        """Costs from each origin to each destination, as a list of rows.
+        None is used for destinations that cannot be reached"""
+        origins = origins or []
+        destinations = destinations or []
+        args = {
+            'plugin': ['plugin', {'name': plugin_name}],
+            'origins': ['origins'] + [p.to_pson() for p in origins],
+            'destinations': ['destinations'] + [p.to_pson() for p in destinations]
+        }
+        outputs = self.wps.execute('distance_table', args)
+        rows = []
+        for row in outputs['table']:
+            rows.append([float(c.attrib['cost']) if 'cost' in c.attrib else None for c in row])
+        return rows
+
     def server_state(self):
         """Retrieve current server state and return a XML string"""
         plugins = self.plugin_list()
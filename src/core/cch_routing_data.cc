@@ -0,0 +1,225 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cch_routing_data.hh"
+#include "db.hh"
+
+#include <cmath>
+#include <fstream>
+#include <boost/format.hpp>
+
+namespace Tempus
+{
+
+namespace
+{
+
+std::vector<std::pair<uint32_t, uint32_t>> section_pairs( const std::vector<CCHSection>& sections )
+{
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    pairs.reserve( sections.size() );
+    for ( const CCHSection& s : sections ) {
+        pairs.push_back( std::make_pair( s.from, s.to ) );
+    }
+    return pairs;
+}
+
+}
+
+CCHRoutingData::CCHRoutingData( std::vector<db_id_t>&& a_node_id, std::vector<CCHSection>&& a_sections, const CCHSpeeds& a_speeds ) :
+    RoutingData( "cch_graph" ),
+    node_id_( std::move( a_node_id ) ),
+    sections_( std::move( a_sections ) ),
+    topology_( node_id_.size(), section_pairs( sections_ ) ),
+    speeds_( a_speeds )
+{
+    for ( db_id_t mode : { TransportModeWalking, TransportModePrivateBicycle, TransportModePrivateCar } ) {
+        metrics_[mode] = customize( mode, speeds_ );
+    }
+}
+
+const CHRoutingData& CCHRoutingData::metric( db_id_t transport_mode ) const
+{
+    auto it = metrics_.find( transport_mode );
+    if ( it == metrics_.end() ) {
+        throw std::invalid_argument( (boost::format("No customized CH for transport mode %1%") % transport_mode).str() );
+    }
+    return *it->second;
+}
+
+std::unique_ptr<CHRoutingData> CCHRoutingData::customize( db_id_t transport_mode, const CCHSpeeds& speeds ) const
+{
+    uint16_t traffic_rule = 0;
+    switch ( transport_mode ) {
+    case TransportModeWalking:
+        traffic_rule = TrafficRulePedestrian;
+        break;
+    case TransportModePrivateBicycle:
+        traffic_rule = TrafficRuleBicycle;
+        break;
+    case TransportModePrivateCar:
+        traffic_rule = TrafficRuleCar;
+        break;
+    default:
+        throw std::invalid_argument( (boost::format("Can't customize a CH for transport mode %1%") % transport_mode).str() );
+    }
+
+    std::vector<CCHMetricEdge> metric;
+    metric.reserve( sections_.size() );
+    for ( const CCHSection& s : sections_ ) {
+        if ( (s.traffic_rules & traffic_rule) == 0 ) {
+            continue;
+        }
+        float speed = traffic_rule == TrafficRulePedestrian ? speeds.walking_speed
+            : traffic_rule == TrafficRuleBicycle ? speeds.cycling_speed
+            : s.car_speed_limit;
+        if ( speed <= 0.0 ) {
+            continue;
+        }
+        // hundredths of seconds
+        double duration = s.length / ( speed / 3.6 ) * 100.0;
+        CCHMetricEdge e;
+        e.from = s.from;
+        e.to = s.to;
+        e.cost = uint32_t( std::max( std::round( duration ), 1.0 ) );
+        e.db_id = s.db_id;
+        metric.push_back( e );
+    }
+
+    std::unique_ptr<CHQuery> ch_query( customize_ch( topology_, metric ) );
+    std::vector<db_id_t> node_id( node_id_ );
+    return std::unique_ptr<CHRoutingData>( new CHRoutingData( std::move( ch_query ), std::move( node_id ) ) );
+}
+
+///
+/// Speeds of the initial customization ("ch/walking_speed" and "ch/cycling_speed" options)
+static CCHSpeeds cch_speeds( const VariantMap& options )
+{
+    CCHSpeeds speeds;
+    auto it = options.find( "ch/walking_speed" );
+    if ( it != options.end() ) {
+        speeds.walking_speed = float( it->second.as<double>() );
+    }
+    it = options.find( "ch/cycling_speed" );
+    if ( it != options.end() ) {
+        speeds.cycling_speed = float( it->second.as<double>() );
+    }
+    return speeds;
+}
+
+std::unique_ptr<RoutingData> CCHRoutingDataBuilder::pg_import( const std::string& pg_options, ProgressionCallback&, const VariantMap& options ) const
+{
+    std::string schema = "ch";
+    if ( options.find( "ch/schema" ) != options.end() ) {
+        schema = options.find( "ch/schema" )->second.str();
+    }
+
+    Db::Connection conn( pg_options );
+
+    // contraction order
+    std::vector<db_id_t> node_id;
+    std::map<db_id_t, uint32_t> node_order;
+    {
+        Db::ResultIterator res_it = conn.exec_it( (boost::format("select node_id from %1%.ordered_nodes order by sort_order asc") % schema).str() );
+        Db::ResultIterator it_end;
+        for ( ; res_it != it_end; res_it++ ) {
+            Db::RowValue res_i = *res_it;
+            db_id_t id = res_i[0];
+            node_order[id] = uint32_t( node_id.size() );
+            node_id.push_back( id );
+        }
+    }
+
+    // road sections, in both directions
+    std::vector<CCHSection> sections;
+    {
+        Db::ResultIterator res_it = conn.exec_it( "select id, node_from, node_to, length, car_speed_limit, traffic_rules_ft, traffic_rules_tf from tempus.road_section" );
+        Db::ResultIterator it_end;
+        for ( ; res_it != it_end; res_it++ ) {
+            Db::RowValue res_i = *res_it;
+            auto from_it = node_order.find( res_i[1].as<db_id_t>() );
+            auto to_it = node_order.find( res_i[2].as<db_id_t>() );
+            if ( from_it == node_order.end() || to_it == node_order.end() ) {
+                throw std::runtime_error( (boost::format("Road section %1% has a node that is not ordered in %2%.ordered_nodes") % res_i[0].as<db_id_t>() % schema).str() );
+            }
+            CCHSection s;
+            s.db_id = res_i[0];
+            s.length = res_i[3];
+            s.car_speed_limit = res_i[4].is_null() ? 50.0f : res_i[4].as<float>();
+
+            s.from = from_it->second;
+            s.to = to_it->second;
+            s.traffic_rules = res_i[5].as<int>();
+            sections.push_back( s );
+
+            std::swap( s.from, s.to );
+            s.traffic_rules = res_i[6].as<int>();
+            sections.push_back( s );
+        }
+    }
+
+    std::unique_ptr<CCHRoutingData> rd( new CCHRoutingData( std::move( node_id ), std::move( sections ), cch_speeds( options ) ) );
+
+    RoutingData::TransportModes all_modes = load_transport_modes( conn );
+    RoutingData::TransportModes modes;
+    for ( db_id_t mode : { TransportModeWalking, TransportModePrivateBicycle, TransportModePrivateCar } ) {
+        if ( all_modes.find( mode ) != all_modes.end() ) {
+            modes[mode] = all_modes[mode];
+        }
+    }
+    rd->set_transport_modes( modes );
+
+    return std::unique_ptr<RoutingData>( rd.release() );
+}
+
+std::unique_ptr<RoutingData> CCHRoutingDataBuilder::file_import( const std::string& filename, ProgressionCallback& /*progression*/, const VariantMap& options ) const
+{
+    std::ifstream ifs( filename );
+    if ( ifs.fail() ) {
+        throw std::runtime_error( "Problem opening input file " + filename );
+    }
+
+    read_header( ifs );
+
+    std::vector<db_id_t> node_id;
+    unserialize( ifs, node_id, binary_serialization_t() );
+    std::vector<CCHSection> sections;
+    unserialize( ifs, sections, binary_serialization_t() );
+    RoutingData::TransportModes modes;
+    unserialize( ifs, modes, binary_serialization_t() );
+
+    std::unique_ptr<CCHRoutingData> rd( new CCHRoutingData( std::move( node_id ), std::move( sections ), cch_speeds( options ) ) );
+    rd->set_transport_modes( modes );
+    return std::unique_ptr<RoutingData>( rd.release() );
+}
+
+void CCHRoutingDataBuilder::file_export( const RoutingData* rd, const std::string& filename, ProgressionCallback& /*progression*/, const VariantMap& /*options*/ ) const
+{
+    std::ofstream ofs( filename );
+
+    write_header( ofs );
+
+    const CCHRoutingData* crd = static_cast<const CCHRoutingData*>( rd );
+
+    // only the input of the customization is stored, it is fast enough to redo it
+    serialize( ofs, crd->node_id(), binary_serialization_t() );
+    serialize( ofs, crd->sections(), binary_serialization_t() );
+    serialize( ofs, crd->transport_modes(), binary_serialization_t() );
+}
+
+REGISTER_BUILDER( CCHRoutingDataBuilder )
+
+} // namespace Tempus
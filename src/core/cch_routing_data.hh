@@ -0,0 +1,142 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_CCH_ROUTING_DATA_HH
+#define TEMPUS_CCH_ROUTING_DATA_HH
+
+#include <vector>
+#include <map>
+#include <memory>
+
+#include "ch_customization.hh"
+#include "routing_data.hh"
+#include "routing_data_builder.hh"
+#include "serializers.hh"
+
+namespace Tempus
+{
+
+///
+/// Speeds used to compute travel times of pedestrians and cyclists, in km/h.
+/// Cars drive at the speed limit of each road section
+struct CCHSpeeds
+{
+    CCHSpeeds() : walking_speed( 3.6f ), cycling_speed( 12.0f ) {}
+    float walking_speed;
+    float cycling_speed;
+};
+
+///
+/// Road section, as needed to compute the weights of a metric
+struct CCHSection
+{
+    /// contraction order of the source
+    uint32_t from;
+    /// contraction order of the target
+    uint32_t to;
+    /// length in meters
+    float length;
+    /// speed limit for cars, in km/h
+    float car_speed_limit;
+    /// allowed traffic rules, from source to target
+    uint16_t traffic_rules;
+    db_id_t db_id;
+
+    void serialize( std::ostream& ostr, binary_serialization_t t ) const
+    {
+        Tempus::serialize( ostr, from, t );
+        Tempus::serialize( ostr, to, t );
+        Tempus::serialize( ostr, reinterpret_cast<const char*>( &length ), sizeof(float), t );
+        Tempus::serialize( ostr, reinterpret_cast<const char*>( &car_speed_limit ), sizeof(float), t );
+        Tempus::serialize( ostr, traffic_rules, t );
+        Tempus::serialize( ostr, db_id, t );
+    }
+    void unserialize( std::istream& istr, binary_serialization_t t )
+    {
+        Tempus::unserialize( istr, from, t );
+        Tempus::unserialize( istr, to, t );
+        Tempus::unserialize( istr, reinterpret_cast<char*>( &length ), sizeof(float), t );
+        Tempus::unserialize( istr, reinterpret_cast<char*>( &car_speed_limit ), sizeof(float), t );
+        Tempus::unserialize( istr, traffic_rules, t );
+        Tempus::unserialize( istr, db_id, t );
+    }
+};
+
+///
+/// Routing data of a customizable CH.
+///
+/// The topology of the CH only depends on the contraction order. One CH is customized
+/// out of it for each of the walking, bicycle and car private modes, with durations
+/// in hundredths of seconds as weights.
+class CCHRoutingData : public RoutingData
+{
+public:
+    ///
+    /// \param node_id Road node id of each vertex, in contraction order
+    /// \param sections Road sections, between contraction orders
+    /// \param speeds Speeds of the initial customization
+    CCHRoutingData( std::vector<db_id_t>&& node_id, std::vector<CCHSection>&& sections, const CCHSpeeds& speeds = CCHSpeeds() );
+
+    const CCHTopology& topology() const { return topology_; }
+
+    const std::vector<db_id_t>& node_id() const { return node_id_; }
+
+    const std::vector<CCHSection>& sections() const { return sections_; }
+
+    ///
+    /// Speeds used for the customized CH returned by metric()
+    const CCHSpeeds& speeds() const { return speeds_; }
+
+    ///
+    /// CH customized for a transport mode (walking, private bicycle or private car)
+    /// Throws std::invalid_argument for another mode
+    const CHRoutingData& metric( db_id_t transport_mode ) const;
+
+    ///
+    /// Customize a new CH for a transport mode, with other speeds.
+    /// Throws std::invalid_argument if the mode is not walking, private bicycle or private car
+    std::unique_ptr<CHRoutingData> customize( db_id_t transport_mode, const CCHSpeeds& speeds ) const;
+
+private:
+    std::vector<db_id_t> node_id_;
+    std::vector<CCHSection> sections_;
+    CCHTopology topology_;
+    CCHSpeeds speeds_;
+
+    // transport mode -> customized CH
+    std::map<db_id_t, std::unique_ptr<CHRoutingData>> metrics_;
+};
+
+///
+/// Builder of a customizable CH.
+///
+/// The contraction order is read from the ordered_nodes table of the "ch/schema" schema
+/// (see ch_preprocess --nested-dissection) and road sections from tempus.road_section.
+/// Speeds of pedestrians and cyclists are given by the "ch/walking_speed" and "ch/cycling_speed" options (km/h)
+class CCHRoutingDataBuilder : public RoutingDataBuilder
+{
+public:
+    CCHRoutingDataBuilder() : RoutingDataBuilder( "cch_graph" ) {}
+
+    virtual std::unique_ptr<RoutingData> pg_import( const std::string& pg_options, ProgressionCallback&, const VariantMap& options = VariantMap() ) const override;
+
+    virtual std::unique_ptr<RoutingData> file_import( const std::string& filename, ProgressionCallback& progression, const VariantMap& options = VariantMap() ) const override;
+    virtual void file_export( const RoutingData* rd, const std::string& filename, ProgressionCallback& progression, const VariantMap& options = VariantMap() ) const override;
+};
+
+} // namespace Tempus
+
+#endif
@@ -0,0 +1,283 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ch_customization.hh"
+
+#include <algorithm>
+#include <limits>
+#include <boost/format.hpp>
+
+namespace Tempus
+{
+
+namespace
+{
+
+///
+/// Recursive bisection of a cell of the graph
+class NestedDissection
+{
+public:
+    NestedDissection( const std::vector<Point2D>& coordinates, const std::vector<std::pair<uint32_t, uint32_t>>& edges ) :
+        coordinates_( coordinates ),
+        first_neighbour_( coordinates.size() + 1, 0 ),
+        cell_( coordinates.size(), 0 ),
+        side_( coordinates.size(), 0 ),
+        current_cell_( 0 )
+    {
+        // undirected adjacency
+        for ( const auto& e : edges ) {
+            first_neighbour_[e.first + 1]++;
+            first_neighbour_[e.second + 1]++;
+        }
+        for ( size_t v = 0; v < coordinates.size(); v++ ) {
+            first_neighbour_[v + 1] += first_neighbour_[v];
+        }
+        neighbours_.resize( first_neighbour_.back() );
+        std::vector<uint32_t> next( first_neighbour_.begin(), first_neighbour_.end() - 1 );
+        for ( const auto& e : edges ) {
+            neighbours_[next[e.first]++] = e.second;
+            neighbours_[next[e.second]++] = e.first;
+        }
+    }
+
+    ///
+    /// Append the vertices of a cell to order, in contraction order
+    void dissect( std::vector<uint32_t>& cell, std::vector<uint32_t>& order )
+    {
+        if ( cell.size() <= 2 ) {
+            order.insert( order.end(), cell.begin(), cell.end() );
+            return;
+        }
+
+        // split along the widest dimension
+        float min_x = std::numeric_limits<float>::max(), max_x = -min_x;
+        float min_y = min_x, max_y = max_x;
+        for ( uint32_t v : cell ) {
+            min_x = std::min( min_x, coordinates_[v].x() );
+            max_x = std::max( max_x, coordinates_[v].x() );
+            min_y = std::min( min_y, coordinates_[v].y() );
+            max_y = std::max( max_y, coordinates_[v].y() );
+        }
+        const bool along_x = max_x - min_x >= max_y - min_y;
+        auto median = cell.begin() + cell.size() / 2;
+        std::nth_element( cell.begin(), median, cell.end(), [this, along_x]( uint32_t a, uint32_t b ) {
+                return along_x ? coordinates_[a].x() < coordinates_[b].x() : coordinates_[a].y() < coordinates_[b].y();
+            });
+
+        current_cell_++;
+        for ( auto it = cell.begin(); it != cell.end(); it++ ) {
+            cell_[*it] = current_cell_;
+            side_[*it] = it < median ? 0 : 1;
+        }
+
+        // boundary vertices of each side
+        std::vector<uint32_t> boundary[2];
+        for ( uint32_t v : cell ) {
+            for ( uint32_t i = first_neighbour_[v]; i < first_neighbour_[v + 1]; i++ ) {
+                uint32_t w = neighbours_[i];
+                if ( cell_[w] == current_cell_ && side_[w] != side_[v] ) {
+                    boundary[side_[v]].push_back( v );
+                    break;
+                }
+            }
+        }
+        const int separator_side = boundary[0].size() <= boundary[1].size() ? 0 : 1;
+        std::vector<uint32_t>& separator = boundary[separator_side];
+        for ( uint32_t v : separator ) {
+            side_[v] = 2;
+        }
+
+        std::vector<uint32_t> halves[2];
+        for ( uint32_t v : cell ) {
+            if ( side_[v] < 2 ) {
+                halves[side_[v]].push_back( v );
+            }
+        }
+        cell.clear();
+        cell.shrink_to_fit();
+
+        // the separator is contracted after both halves
+        dissect( halves[0], order );
+        dissect( halves[1], order );
+        order.insert( order.end(), separator.begin(), separator.end() );
+    }
+
+private:
+    const std::vector<Point2D>& coordinates_;
+    std::vector<uint32_t> first_neighbour_;
+    std::vector<uint32_t> neighbours_;
+    // cell and side of a vertex during the last split
+    std::vector<uint32_t> cell_;
+    std::vector<uint8_t> side_;
+    uint32_t current_cell_;
+};
+
+const uint32_t NO_MIDDLE_NODE = std::numeric_limits<uint32_t>::max();
+const uint32_t INFINITE_WEIGHT = std::numeric_limits<uint32_t>::max();
+/// maximum cost that fits in CHEdgeProperty
+const uint64_t MAX_CH_COST = ( uint64_t(1) << 31 ) - 1;
+
+}
+
+std::vector<uint32_t> nested_dissection_order( const std::vector<Point2D>& coordinates, const std::vector<std::pair<uint32_t, uint32_t>>& edges )
+{
+    NestedDissection nd( coordinates, edges );
+    std::vector<uint32_t> cell( coordinates.size() );
+    for ( uint32_t v = 0; v < cell.size(); v++ ) {
+        cell[v] = v;
+    }
+    std::vector<uint32_t> order;
+    order.reserve( coordinates.size() );
+    nd.dissect( cell, order );
+    return order;
+}
+
+CCHTopology::CCHTopology( size_t n_vertices, const std::vector<std::pair<uint32_t, uint32_t>>& edges )
+{
+    std::vector<std::vector<uint32_t>> upper( n_vertices );
+    for ( const auto& e : edges ) {
+        if ( e.first != e.second ) {
+            upper[std::min( e.first, e.second )].push_back( std::max( e.first, e.second ) );
+        }
+    }
+
+    // contracting v links all its upper neighbours together. It is enough to link them
+    // to the lowest one, since it will in turn link them when contracted
+    first_arc_.resize( n_vertices + 1 );
+    for ( uint32_t v = 0; v < n_vertices; v++ ) {
+        std::vector<uint32_t>& up = upper[v];
+        std::sort( up.begin(), up.end() );
+        up.erase( std::unique( up.begin(), up.end() ), up.end() );
+        if ( up.size() > 1 ) {
+            std::vector<uint32_t>& lowest = upper[up[0]];
+            lowest.insert( lowest.end(), up.begin() + 1, up.end() );
+        }
+        first_arc_[v] = uint32_t( head_.size() );
+        head_.insert( head_.end(), up.begin(), up.end() );
+        std::vector<uint32_t>().swap( up );
+    }
+    first_arc_[n_vertices] = uint32_t( head_.size() );
+}
+
+uint32_t CCHTopology::find_arc( uint32_t u, uint32_t v ) const
+{
+    if ( u > v ) {
+        std::swap( u, v );
+    }
+    auto b = head_.begin() + first_arc_[u];
+    auto e = head_.begin() + first_arc_[u + 1];
+    auto it = std::lower_bound( b, e, v );
+    if ( it == e || *it != v ) {
+        return uint32_t( head_.size() );
+    }
+    return uint32_t( it - head_.begin() );
+}
+
+std::unique_ptr<CHQuery> customize_ch( const CCHTopology& topology, const std::vector<CCHMetricEdge>& metric )
+{
+    const uint32_t n = uint32_t( topology.num_vertices() );
+    const uint32_t m = uint32_t( topology.num_arcs() );
+
+    // weights of an arc {u,v} with u < v, for both directions
+    std::vector<uint32_t> up_weight( m, INFINITE_WEIGHT ), down_weight( m, INFINITE_WEIGHT );
+    std::vector<uint32_t> up_middle( m, NO_MIDDLE_NODE ), down_middle( m, NO_MIDDLE_NODE );
+    std::vector<db_id_t> up_id( m, 0 ), down_id( m, 0 );
+
+    for ( const CCHMetricEdge& e : metric ) {
+        if ( e.from == e.to ) {
+            continue;
+        }
+        uint32_t arc = topology.find_arc( e.from, e.to );
+        if ( arc == m ) {
+            throw std::invalid_argument( (boost::format("Edge (%1%,%2%) is not part of the CH topology") % e.from % e.to).str() );
+        }
+        uint32_t cost = uint32_t( std::min( uint64_t( e.cost ), MAX_CH_COST ) );
+        if ( e.from < e.to && cost < up_weight[arc] ) {
+            up_weight[arc] = cost;
+            up_id[arc] = e.db_id;
+        }
+        else if ( e.from > e.to && cost < down_weight[arc] ) {
+            down_weight[arc] = cost;
+            down_id[arc] = e.db_id;
+        }
+    }
+
+    // for each vertex v, in ascending order, relax the arcs between its upper neighbours
+    // through v. Weights of the arcs of v are final, since their lower triangles only
+    // involve lower vertices
+    for ( uint32_t v = 0; v < n; v++ ) {
+        for ( uint32_t i = topology.first_arc( v ); i < topology.first_arc( v + 1 ); i++ ) {
+            const uint32_t a = topology.head( i );
+            // the upper neighbours of a include those of v above a, both are sorted
+            uint32_t ab = topology.first_arc( a );
+            for ( uint32_t j = i + 1; j < topology.first_arc( v + 1 ); j++ ) {
+                const uint32_t b = topology.head( j );
+                while ( topology.head( ab ) < b ) {
+                    ab++;
+                }
+                BOOST_ASSERT( ab < topology.first_arc( a + 1 ) && topology.head( ab ) == b );
+                // a -> v -> b
+                if ( down_weight[i] != INFINITE_WEIGHT && up_weight[j] != INFINITE_WEIGHT ) {
+                    uint64_t c = uint64_t( down_weight[i] ) + up_weight[j];
+                    if ( c < up_weight[ab] && c <= MAX_CH_COST ) {
+                        up_weight[ab] = uint32_t( c );
+                        up_middle[ab] = v;
+                    }
+                }
+                // b -> v -> a
+                if ( down_weight[j] != INFINITE_WEIGHT && up_weight[i] != INFINITE_WEIGHT ) {
+                    uint64_t c = uint64_t( down_weight[j] ) + up_weight[i];
+                    if ( c < down_weight[ab] && c <= MAX_CH_COST ) {
+                        down_weight[ab] = uint32_t( c );
+                        down_middle[ab] = v;
+                    }
+                }
+            }
+        }
+    }
+
+    // CH query graph: upward edges of each vertex, then its downward edges
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    std::vector<CHEdgeProperty> properties;
+    std::vector<uint32_t> up_degrees( n, 0 );
+    auto add_edge = [&]( uint32_t v, uint32_t arc, uint32_t weight, uint32_t middle, db_id_t id ) {
+        CHEdgeProperty p;
+        p.b.cost = weight;
+        p.b.is_shortcut = middle != NO_MIDDLE_NODE ? 1 : 0;
+        p.middle_node = middle != NO_MIDDLE_NODE ? middle : 0;
+        p.db_id = middle != NO_MIDDLE_NODE ? 0 : id;
+        pairs.push_back( std::make_pair( v, topology.head( arc ) ) );
+        properties.push_back( p );
+    };
+    for ( uint32_t v = 0; v < n; v++ ) {
+        for ( uint32_t i = topology.first_arc( v ); i < topology.first_arc( v + 1 ); i++ ) {
+            if ( up_weight[i] != INFINITE_WEIGHT ) {
+                add_edge( v, i, up_weight[i], up_middle[i], up_id[i] );
+                up_degrees[v]++;
+            }
+        }
+        for ( uint32_t i = topology.first_arc( v ); i < topology.first_arc( v + 1 ); i++ ) {
+            if ( down_weight[i] != INFINITE_WEIGHT ) {
+                add_edge( v, i, down_weight[i], down_middle[i], down_id[i] );
+            }
+        }
+    }
+
+    return std::unique_ptr<CHQuery>( new CHQuery( pairs.begin(), pairs.end(), n, up_degrees.begin(), properties.begin() ) );
+}
+
+} // namespace Tempus
@@ -0,0 +1,106 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_CH_CUSTOMIZATION_HH
+#define TEMPUS_CH_CUSTOMIZATION_HH
+
+#include <vector>
+#include <memory>
+#include <utility>
+
+#include "point.hh"
+#include "ch_routing_data.hh"
+
+/**
+ * Metric independent contraction hierarchies (customizable CH).
+ *
+ * The contraction order only depends on the topology of the graph and so do the shortcuts:
+ * contracting a vertex links all its higher neighbours together, without any witness search.
+ * Weights of a metric are then given to this topology by a customization phase that goes
+ * through the lower triangles of each shortcut, which is much faster than a contraction.
+ */
+
+namespace Tempus
+{
+
+///
+/// Metric independent contraction order, by nested dissection.
+///
+/// The graph is recursively split in two halves along the widest dimension of the
+/// coordinates of its vertices. The smallest set of boundary vertices separates both halves,
+/// and is contracted after them.
+/// \param coordinates Coordinates of the vertices
+/// \param edges Edges of the graph, their direction does not matter
+/// \returns the vertices, in contraction order
+std::vector<uint32_t> nested_dissection_order( const std::vector<Point2D>& coordinates, const std::vector<std::pair<uint32_t, uint32_t>>& edges );
+
+///
+/// Shortcuts of a metric independent contraction.
+///
+/// Vertices are given by their contraction order. Each undirected arc links a vertex to
+/// a higher neighbour.
+class CCHTopology
+{
+public:
+    CCHTopology() : first_arc_( 1, 0 ) {}
+
+    ///
+    /// Contract a graph
+    /// \param n_vertices Number of vertices
+    /// \param edges Edges of the graph, between contraction orders, their direction does not matter
+    CCHTopology( size_t n_vertices, const std::vector<std::pair<uint32_t, uint32_t>>& edges );
+
+    size_t num_vertices() const { return first_arc_.size() - 1; }
+    size_t num_arcs() const { return head_.size(); }
+
+    ///
+    /// Arcs to the higher neighbours of v are [first_arc(v), first_arc(v+1)), sorted by head
+    uint32_t first_arc( uint32_t v ) const { return first_arc_[v]; }
+    uint32_t head( uint32_t arc ) const { return head_[arc]; }
+
+    ///
+    /// Index of the arc between u and v (in any order), or num_arcs() if there is none
+    uint32_t find_arc( uint32_t u, uint32_t v ) const;
+
+private:
+    std::vector<uint32_t> first_arc_;
+    std::vector<uint32_t> head_;
+};
+
+///
+/// Edge of the original graph, with its weight in a given metric
+struct CCHMetricEdge
+{
+    /// contraction order of the source
+    uint32_t from;
+    /// contraction order of the target
+    uint32_t to;
+    /// weight, in the unit of CHEdgeProperty costs
+    uint32_t cost;
+    /// id of the road section
+    db_id_t db_id;
+};
+
+///
+/// Customization of a metric independent contraction.
+///
+/// The returned CH query graph only contains edges with a finite weight.
+/// Throws std::invalid_argument if an edge of the metric is not part of the topology
+std::unique_ptr<CHQuery> customize_ch( const CCHTopology& topology, const std::vector<CCHMetricEdge>& metric );
+
+} // namespace Tempus
+
+#endif
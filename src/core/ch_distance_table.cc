@@ -0,0 +1,267 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ch_distance_table.hh"
+#include "ch_query_workspace.hh"
+
+#include <boost/format.hpp>
+
+namespace Tempus
+{
+
+CHDistanceTable::CHDistanceTable( size_t n_origins, size_t n_destinations ) :
+    n_origins_( n_origins ),
+    n_destinations_( n_destinations ),
+    costs_( n_origins * n_destinations, infinity() )
+{
+}
+
+namespace
+{
+
+inline float ch_edge_cost( const CHQuery::edge_descriptor& e )
+{
+    return float(e.property().b.cost / 100.0);
+}
+
+///
+/// Upward search from start, visit( v, cost ) is called on each settled vertex.
+///
+/// The forward search follows upward edges (out_edges). The backward search follows
+/// downward edges (in_edges) in reverse.
+/// Vertices that can be reached with a lower cost through a higher ranked vertex are
+/// "stalled": they are not settled and their edges are not relaxed.
+template <bool Forward, typename Visitor>
+void ch_upward_search( const CHQuery& graph, CHVertex start, CHQueryWorkspace<float>& ws, Visitor visit )
+{
+    ws.reset( num_vertices( graph ) );
+    TimestampedLabels<float>& labels = ws.labels[0];
+    ReusableMinQueue<float>& queue = ws.queue[0];
+
+    labels.set( start, 0.0, start );
+    queue.push( 0.0, start );
+
+    while ( !queue.empty() ) {
+        float min_pi;
+        CHVertex min_v;
+        std::tie( min_pi, min_v ) = queue.top();
+        queue.pop();
+        if ( min_pi > labels.potential( min_v ) ) {
+            // outdated queue entry
+            continue;
+        }
+
+        // stall on demand: look at edges coming from higher ranked vertices
+        bool stalled = false;
+        if ( Forward ) {
+            for ( auto iei = in_edges( min_v, graph ).first; iei != in_edges( min_v, graph ).second; iei++ ) {
+                float pi = labels.potential( source( *iei, graph ) );
+                if ( pi != TimestampedLabels<float>::infinity() && pi + ch_edge_cost( *iei ) < min_pi ) {
+                    stalled = true;
+                    break;
+                }
+            }
+        }
+        else {
+            for ( auto oei = out_edges( min_v, graph ).first; oei != out_edges( min_v, graph ).second; oei++ ) {
+                float pi = labels.potential( target( *oei, graph ) );
+                if ( pi != TimestampedLabels<float>::infinity() && pi + ch_edge_cost( *oei ) < min_pi ) {
+                    stalled = true;
+                    break;
+                }
+            }
+        }
+        if ( stalled ) {
+            continue;
+        }
+
+        visit( min_v, min_pi );
+
+        if ( Forward ) {
+            for ( auto oei = out_edges( min_v, graph ).first; oei != out_edges( min_v, graph ).second; oei++ ) {
+                CHVertex vv = target( *oei, graph );
+                float new_pi = min_pi + ch_edge_cost( *oei );
+                if ( new_pi < labels.potential( vv ) ) {
+                    labels.set( vv, new_pi, min_v );
+                    queue.push( new_pi, vv );
+                }
+            }
+        }
+        else {
+            for ( auto iei = in_edges( min_v, graph ).first; iei != in_edges( min_v, graph ).second; iei++ ) {
+                CHVertex vv = source( *iei, graph );
+                float new_pi = min_pi + ch_edge_cost( *iei );
+                if ( new_pi < labels.potential( vv ) ) {
+                    labels.set( vv, new_pi, min_v );
+                    queue.push( new_pi, vv );
+                }
+            }
+        }
+    }
+}
+
+struct BucketEntry
+{
+    BucketEntry() : destination( 0 ), cost( 0.0 ) {}
+    BucketEntry( uint32_t d, float c ) : destination( d ), cost( c ) {}
+    uint32_t destination;
+    float cost;
+};
+
+}
+
+CHDistanceTable ch_distance_table( const CHRoutingData& rd, const std::vector<CHVertex>& origins, const std::vector<CHVertex>& destinations )
+{
+    const CHQuery& graph = rd.ch_query();
+    const size_t n = num_vertices( graph );
+
+    CHDistanceTable table( origins.size(), destinations.size() );
+
+    // backward searches, collect (vertex, bucket entry) pairs
+    std::vector<std::pair<CHVertex, BucketEntry>> entries;
+    {
+        CHQueryWorkspace<float> ws;
+        for ( uint32_t j = 0; j < destinations.size(); j++ ) {
+            ch_upward_search<false>( graph, destinations[j], ws, [&entries, j]( CHVertex v, float cost ) {
+                    entries.push_back( std::make_pair( v, BucketEntry( j, cost ) ) );
+                });
+        }
+    }
+
+    // store buckets contiguously, indexed by vertex
+    std::vector<uint32_t> bucket_index( n + 1, 0 );
+    std::vector<BucketEntry> buckets( entries.size() );
+    for ( const auto& p : entries ) {
+        bucket_index[p.first + 1]++;
+    }
+    for ( size_t v = 0; v < n; v++ ) {
+        bucket_index[v + 1] += bucket_index[v];
+    }
+    {
+        std::vector<uint32_t> next( bucket_index.begin(), bucket_index.end() - 1 );
+        for ( const auto& p : entries ) {
+            buckets[next[p.first]++] = p.second;
+        }
+    }
+    entries.clear();
+    entries.shrink_to_fit();
+
+    // forward searches, one row of the table each
+    #pragma omp parallel
+    {
+        CHQueryWorkspace<float> ws;
+        #pragma omp for schedule(dynamic)
+        for ( int i = 0; i < int(origins.size()); i++ ) {
+            ch_upward_search<true>( graph, origins[i], ws, [&]( CHVertex v, float cost ) {
+                    for ( uint32_t k = bucket_index[v]; k < bucket_index[v + 1]; k++ ) {
+                        const BucketEntry& b = buckets[k];
+                        float& c = table.cost( i, b.destination );
+                        if ( cost + b.cost < c ) {
+                            c = cost + b.cost;
+                        }
+                    }
+                });
+        }
+    }
+
+    return table;
+}
+
+CHDistanceTable ch_distance_table_from_ids( const CHRoutingData& rd, const std::vector<db_id_t>& origins, const std::vector<db_id_t>& destinations )
+{
+    auto to_vertices = [&rd]( const std::vector<db_id_t>& ids ) {
+        std::vector<CHVertex> vertices;
+        vertices.reserve( ids.size() );
+        for ( db_id_t id : ids ) {
+            boost::optional<CHVertex> v = rd.vertex_from_id( id );
+            if ( !v ) {
+                throw std::invalid_argument( (boost::format("Can't find vertex of ID %1%") % id).str() );
+            }
+            vertices.push_back( *v );
+        }
+        return vertices;
+    };
+    return ch_distance_table( rd, to_vertices( origins ), to_vertices( destinations ) );
+}
+
+namespace
+{
+
+///
+/// PHAST for up to L origins at once.
+/// Costs of the L origins are interleaved (costs[v * L + k]) so that the downward sweep
+/// handles every origin with the same, vectorizable, inner loop
+template <size_t L>
+void ch_phast( const CHQuery& graph, const CHVertex* origins, size_t n_origins, std::vector<float>& costs )
+{
+    const size_t n = num_vertices( graph );
+    costs.assign( n * L, CHDistanceTable::infinity() );
+
+    // upward searches
+    CHQueryWorkspace<float> ws;
+    for ( size_t k = 0; k < n_origins; k++ ) {
+        ch_upward_search<true>( graph, origins[k], ws, [&costs, k]( CHVertex v, float cost ) {
+                costs[v * L + k] = cost;
+            });
+    }
+
+    // downward sweep, in descending CH order
+    // in_edges of v are downward edges from higher ranked vertices, already final
+    for ( size_t v = n; v-- > 0; ) {
+        float* cv = &costs[v * L];
+        for ( auto iei = in_edges( CHVertex(v), graph ).first; iei != in_edges( CHVertex(v), graph ).second; iei++ ) {
+            const float* cu = &costs[source( *iei, graph ) * L];
+            const float w = ch_edge_cost( *iei );
+            for ( size_t k = 0; k < L; k++ ) {
+                cv[k] = std::min( cv[k], cu[k] + w );
+            }
+        }
+    }
+}
+
+}
+
+std::vector<float> ch_one_to_all( const CHRoutingData& rd, CHVertex origin )
+{
+    std::vector<float> costs;
+    ch_phast<1>( rd.ch_query(), &origin, 1, costs );
+    return costs;
+}
+
+std::vector<std::vector<float>> ch_many_to_all( const CHRoutingData& rd, const std::vector<CHVertex>& origins )
+{
+    const CHQuery& graph = rd.ch_query();
+    const size_t n = num_vertices( graph );
+    const size_t L = CH_ONE_TO_ALL_LANES;
+
+    std::vector<std::vector<float>> ret( origins.size() );
+    std::vector<float> costs;
+    for ( size_t first = 0; first < origins.size(); first += L ) {
+        const size_t n_lanes = std::min( L, origins.size() - first );
+        ch_phast<CH_ONE_TO_ALL_LANES>( graph, &origins[first], n_lanes, costs );
+        // de-interleave
+        for ( size_t k = 0; k < n_lanes; k++ ) {
+            std::vector<float>& c = ret[first + k];
+            c.resize( n );
+            for ( size_t v = 0; v < n; v++ ) {
+                c[v] = costs[v * L + k];
+            }
+        }
+    }
+    return ret;
+}
+
+} // namespace Tempus
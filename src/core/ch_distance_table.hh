@@ -0,0 +1,91 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_CH_DISTANCE_TABLE_HH
+#define TEMPUS_CH_DISTANCE_TABLE_HH
+
+#include <vector>
+#include <limits>
+
+#include "ch_routing_data.hh"
+
+namespace Tempus
+{
+
+///
+/// Dense matrix of shortest path costs between origins (rows) and destinations (columns)
+class CHDistanceTable
+{
+public:
+    CHDistanceTable( size_t n_origins, size_t n_destinations );
+
+    size_t n_origins() const { return n_origins_; }
+    size_t n_destinations() const { return n_destinations_; }
+
+    ///
+    /// Cost from the i-th origin to the j-th destination.
+    /// Equals infinity() if the destination cannot be reached
+    float cost( size_t i, size_t j ) const { return costs_[i * n_destinations_ + j]; }
+    float& cost( size_t i, size_t j ) { return costs_[i * n_destinations_ + j]; }
+
+    ///
+    /// Row-major storage of the matrix
+    const std::vector<float>& costs() const { return costs_; }
+
+    static float infinity() { return std::numeric_limits<float>::max(); }
+
+private:
+    size_t n_origins_;
+    size_t n_destinations_;
+    std::vector<float> costs_;
+};
+
+///
+/// Many-to-many shortest path costs on a CH query graph.
+///
+/// Costs are expressed in the same unit as the ch_plugin results.
+/// An upward backward search is run from each destination and its settled vertices
+/// are stored in buckets. An upward forward search is then run from each origin and
+/// scans the buckets of the vertices it settles.
+CHDistanceTable ch_distance_table( const CHRoutingData& rd, const std::vector<CHVertex>& origins, const std::vector<CHVertex>& destinations );
+
+///
+/// Same as ch_distance_table, with origins and destinations given by their road node ids
+/// Throws std::invalid_argument if a node cannot be found in the CH graph
+CHDistanceTable ch_distance_table_from_ids( const CHRoutingData& rd, const std::vector<db_id_t>& origins, const std::vector<db_id_t>& destinations );
+
+///
+/// Costs from one origin to every vertex of a CH query graph (PHAST).
+///
+/// An upward search from the origin is followed by one linear sweep over vertices
+/// in descending CH order that relaxes downward edges.
+/// The returned vector is indexed by CH vertex. Unreachable vertices have a cost of CHDistanceTable::infinity()
+std::vector<float> ch_one_to_all( const CHRoutingData& rd, CHVertex origin );
+
+///
+/// Same as ch_one_to_all, for several origins.
+///
+/// Origins are processed by groups of CH_ONE_TO_ALL_LANES sharing the same downward sweep.
+/// Returns one cost vector per origin
+std::vector<std::vector<float>> ch_many_to_all( const CHRoutingData& rd, const std::vector<CHVertex>& origins );
+
+///
+/// Number of origins processed together by ch_many_to_all
+const size_t CH_ONE_TO_ALL_LANES = 8;
+
+} // namespace Tempus
+
+#endif
@@ -98,7 +98,7 @@ public:
 
             edge_index_[v].first_downward_edge = edges_.size();
             if ( vp != vp_end && vp->first == v ) {
-                for ( ; v == vp->first; vp++, ep++ ) {
+                for ( ; vp != vp_end && v == vp->first; vp++, ep++ ) {
                     BOOST_ASSERT( vp->first == v ); // check the downward degreee is ok
                     EdgeData data;
                     data.target = vp->second;
@@ -159,10 +159,11 @@ public:
     class OutEdgeIterator
     {
     public:
-        OutEdgeIterator( VertexIndex source, const EdgeData* data ) : source_(source), data_(data), v_( source, data->target, &data->property, true ) {}
-        EdgeDescriptor operator*() { return v_; }
-        EdgeDescriptor* operator->() { return &v_; }
-        void operator++() { data_++; v_ = EdgeDescriptor(source_, data_->target, &data_->property, true); }
+        // the descriptor is only built when dereferenced, since the end iterator points past the last edge
+        OutEdgeIterator( VertexIndex source, const EdgeData* data ) : source_(source), data_(data) {}
+        EdgeDescriptor operator*() const { return EdgeDescriptor( source_, data_->target, &data_->property, true ); }
+        EdgeDescriptor* operator->() { v_ = **this; return &v_; }
+        void operator++() { data_++; }
         void operator++(int) { this->operator++(); }
         bool operator==( const OutEdgeIterator& other ) const { return other.source_ == source_ && other.data_ == data_; }
         bool operator!=( const OutEdgeIterator& other ) const { return !(*this == other); }
@@ -175,10 +176,10 @@ public:
     class InEdgeIterator
     {
     public:
-        InEdgeIterator( VertexIndex source, const EdgeData* data ) : source_(source), data_(data), v_( data->target, source_, &data_->property, false ) {}
-        EdgeDescriptor operator*() { return v_; }
-        EdgeDescriptor* operator->() { return &v_; }
-        void operator++() { data_++; v_ = EdgeDescriptor(data_->target, source_, &data_->property, false ); }
+        InEdgeIterator( VertexIndex source, const EdgeData* data ) : source_(source), data_(data) {}
+        EdgeDescriptor operator*() const { return EdgeDescriptor( data_->target, source_, &data_->property, false ); }
+        EdgeDescriptor* operator->() { v_ = **this; return &v_; }
+        void operator++() { data_++; }
         void operator++(int) { this->operator++(); }
         bool operator==( const InEdgeIterator& other ) const { return other.source_ == source_ && other.data_ == data_; }
         bool operator!=( const InEdgeIterator& other ) const { return !(*this == other); }
@@ -190,8 +191,8 @@ public:
 
     std::pair<OutEdgeIterator, OutEdgeIterator> out_edges( VertexIndex v ) const
     {
-        return std::make_pair( OutEdgeIterator( v, &edges_[edge_index_[v].first_upward_edge] ),
-                               OutEdgeIterator( v, &edges_[edge_index_[v].first_downward_edge] ) );
+        return std::make_pair( OutEdgeIterator( v, edges_.data() + edge_index_[v].first_upward_edge ),
+                               OutEdgeIterator( v, edges_.data() + edge_index_[v].first_downward_edge ) );
     }
 
     size_t out_degree( VertexIndex v ) const
@@ -201,8 +202,8 @@ public:
 
     std::pair<InEdgeIterator, InEdgeIterator> in_edges( VertexIndex v ) const
     {
-        return std::make_pair( InEdgeIterator( v, &edges_[edge_index_[v].first_downward_edge] ),
-                               InEdgeIterator( v, &edges_[edge_index_[v+1].first_upward_edge] ) );
+        return std::make_pair( InEdgeIterator( v, edges_.data() + edge_index_[v].first_downward_edge ),
+                               InEdgeIterator( v, edges_.data() + edge_index_[v+1].first_upward_edge ) );
     }
 
     size_t in_degree( VertexIndex v ) const
@@ -217,8 +218,7 @@ public:
     public:
         EdgeIterator( VertexIndex source, EdgeIndex edge, CHQueryGraph<EdgeProperty, VertexIndex, EdgeIndex>& graph )
             :
-            source_(source), edge_(edge), graph_(graph),
-            v_( source_, graph_.edges_[edge_].target, &graph_.edges_[edge_].property, true )
+            source_(source), edge_(edge), graph_(graph)
         {
             update_();
         }
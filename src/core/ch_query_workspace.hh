@@ -0,0 +1,176 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_CH_QUERY_WORKSPACE_HH
+#define TEMPUS_CH_QUERY_WORKSPACE_HH
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include <cstdint>
+
+namespace Tempus
+{
+
+///
+/// Per-vertex labels of a shortest path search that can be reused from one query to another.
+///
+/// Each label carries the stamp of the query that last wrote it. Starting a new query only
+/// increments the current stamp, so that labels left over by the previous query are seen as
+/// unreached without touching them. Memory is only filled again when the stamp wraps around,
+/// i.e. every 2^32 queries with the default StampType.
+template <typename CostType, typename VertexType = uint32_t, typename StampType = uint32_t>
+class TimestampedLabels
+{
+public:
+    TimestampedLabels() : current_stamp_( 0 ) {}
+
+    ///
+    /// Start a new search on a graph of n vertices
+    void reset( size_t n )
+    {
+        if ( labels_.size() != n ) {
+            labels_.assign( n, Label() );
+            current_stamp_ = 0;
+        }
+        current_stamp_++;
+        if ( current_stamp_ == 0 ) {
+            // stamp overflow, every label must be invalidated
+            std::fill( labels_.begin(), labels_.end(), Label() );
+            current_stamp_ = 1;
+        }
+    }
+
+    ///
+    /// Number of vertices
+    size_t size() const { return labels_.size(); }
+
+    ///
+    /// Whether the vertex has been reached during the current search
+    bool reached( VertexType v ) const
+    {
+        return labels_[v].stamp == current_stamp_;
+    }
+
+    ///
+    /// Potential of a vertex, infinity if it has not been reached yet
+    CostType potential( VertexType v ) const
+    {
+        const Label& l = labels_[v];
+        return l.stamp == current_stamp_ ? l.potential : infinity();
+    }
+
+    ///
+    /// Predecessor of a reached vertex
+    VertexType predecessor( VertexType v ) const
+    {
+        return labels_[v].predecessor;
+    }
+
+    ///
+    /// Set the potential and the predecessor of a vertex
+    void set( VertexType v, CostType potential, VertexType predecessor )
+    {
+        Label& l = labels_[v];
+        l.stamp = current_stamp_;
+        l.potential = potential;
+        l.predecessor = predecessor;
+    }
+
+    static CostType infinity() { return std::numeric_limits<CostType>::max(); }
+
+private:
+    struct Label
+    {
+        Label() : stamp( 0 ), potential( std::numeric_limits<CostType>::max() ), predecessor( 0 ) {}
+        StampType stamp;
+        CostType potential;
+        VertexType predecessor;
+    };
+    std::vector<Label> labels_;
+    StampType current_stamp_;
+};
+
+///
+/// Binary min-heap of (cost, vertex) entries whose storage is kept between queries.
+///
+/// There is no decrease-key operation: a vertex may be pushed several times
+/// and outdated entries have to be skipped by the caller when popped.
+template <typename CostType, typename VertexType = uint32_t>
+class ReusableMinQueue
+{
+public:
+    using Entry = std::pair<CostType, VertexType>;
+
+    void clear() { heap_.clear(); }
+    bool empty() const { return heap_.empty(); }
+    const Entry& top() const { return heap_.front(); }
+
+    void push( CostType c, VertexType v )
+    {
+        heap_.push_back( Entry( c, v ) );
+        std::push_heap( heap_.begin(), heap_.end(), std::greater<Entry>() );
+    }
+
+    void pop()
+    {
+        std::pop_heap( heap_.begin(), heap_.end(), std::greater<Entry>() );
+        heap_.pop_back();
+    }
+
+private:
+    std::vector<Entry> heap_;
+};
+
+///
+/// Workspace of a bidirectional CH query (one set of labels and one queue per direction).
+///
+/// Allocating and initializing O(n) arrays for each query dominates the cost of a CH query,
+/// since a query only settles a few hundred vertices. A workspace is then meant to be kept
+/// alive between queries, see ch_query_workspace()
+template <typename CostType, typename VertexType = uint32_t, typename StampType = uint32_t>
+struct CHQueryWorkspace
+{
+    /// labels of the forward (0) and backward (1) searches
+    TimestampedLabels<CostType, VertexType, StampType> labels[2];
+    /// queues of the forward (0) and backward (1) searches
+    ReusableMinQueue<CostType, VertexType> queue[2];
+
+    ///
+    /// Prepare the workspace for a new query on a graph of n vertices
+    void reset( size_t n )
+    {
+        for ( int dir = 0; dir < 2; dir++ ) {
+            labels[dir].reset( n );
+            queue[dir].clear();
+        }
+    }
+};
+
+///
+/// Returns the workspace of the calling thread, reset for a query on a graph of n vertices
+template <typename CostType, typename VertexType = uint32_t>
+CHQueryWorkspace<CostType, VertexType>& ch_query_workspace( size_t n )
+{
+    static thread_local CHQueryWorkspace<CostType, VertexType> workspace;
+    workspace.reset( n );
+    return workspace;
+}
+
+} // namespace Tempus
+
+#endif
@@ -23,10 +23,9 @@
 namespace Tempus
 {
 
-CHRoutingData::CHRoutingData( std::unique_ptr<CHQuery> a_ch_query, MiddleNodeMap&& a_middle_node, std::vector<db_id_t>&& a_node_id) :
+CHRoutingData::CHRoutingData( std::unique_ptr<CHQuery> a_ch_query, std::vector<db_id_t>&& a_node_id) :
     RoutingData( "ch_graph" ),
     ch_query_( std::move(a_ch_query) ),
-    middle_node_( a_middle_node ),
     node_id_( a_node_id )
 {
     // update the reverse id map
@@ -49,10 +48,83 @@ db_id_t CHRoutingData::vertex_id( CHVertex v ) const
     return node_id_[v];
 }
 
+void CHRoutingData::unpack_edge( const CHEdge& e, std::vector<CHEdge>& edges ) const
+{
+    // edges still to unpack, the last one comes first in the path
+    std::vector<CHEdge> stack;
+    stack.push_back( e );
+    while ( !stack.empty() ) {
+        CHEdge top = stack.back();
+        stack.pop_back();
+        if ( !top.property().b.is_shortcut ) {
+            edges.push_back( top );
+            continue;
+        }
+        auto it = unpacked_index_.find( &top.property() );
+        if ( it != unpacked_index_.end() ) {
+            edges.insert( edges.end(), unpacked_edges_.begin() + it->second.first, unpacked_edges_.begin() + it->second.second );
+            continue;
+        }
+
+        // a shortcut u -> v is made of u -> middle and middle -> v
+        CHVertex middle = top.property().middle_node;
+        CHEdge e1, e2;
+        bool found1 = false, found2 = false;
+        std::tie( e1, found1 ) = edge( top.source(), middle, *ch_query_ );
+        std::tie( e2, found2 ) = edge( middle, top.target(), *ch_query_ );
+        if ( !found1 || !found2 ) {
+            throw std::runtime_error( (boost::format("Can't unpack shortcut (%1%,%2%)") % vertex_id( top.source() ) % vertex_id( top.target() )).str() );
+        }
+        stack.push_back( e2 );
+        stack.push_back( e1 );
+    }
+}
+
+void CHRoutingData::precompute_unpacked_shortcuts( size_t n_top_vertices )
+{
+    unpacked_index_.clear();
+    unpacked_edges_.clear();
+
+    const CHQuery& graph = *ch_query_;
+    const size_t n = num_vertices( graph );
+    const CHVertex first = CHVertex( n - std::min( n, n_top_vertices ) );
+
+    // unpack without using precomputed sequences, since unpacked_edges_ may be reallocated
+    std::unordered_map<const CHEdgeProperty*, std::pair<uint32_t, uint32_t>> index;
+    auto add_shortcut = [&]( const CHEdge& e ) {
+        if ( !e.property().b.is_shortcut ) {
+            return;
+        }
+        uint32_t begin = unpacked_edges_.size();
+        unpack_edge( e, unpacked_edges_ );
+        index[&e.property()] = std::make_pair( begin, uint32_t( unpacked_edges_.size() ) );
+    };
+    for ( CHVertex v = first; v < n; v++ ) {
+        // both ends of the edges are in the top vertices
+        for ( auto oei = out_edges( v, graph ).first; oei != out_edges( v, graph ).second; oei++ ) {
+            add_shortcut( *oei );
+        }
+        for ( auto iei = in_edges( v, graph ).first; iei != in_edges( v, graph ).second; iei++ ) {
+            add_shortcut( *iei );
+        }
+    }
+    unpacked_index_.swap( index );
+}
+
+///
+/// Number of top ranked vertices whose shortcuts are unpacked in advance ("ch/unpacked_top_vertices" option)
+static size_t unpacked_top_vertices( const VariantMap& options )
+{
+    auto it = options.find( "ch/unpacked_top_vertices" );
+    if ( it != options.end() ) {
+        return it->second.as<int64_t>();
+    }
+    return 0;
+}
+
 std::unique_ptr<RoutingData> CHRoutingDataBuilder::pg_import( const std::string& pg_options, ProgressionCallback&, const VariantMap& options ) const
 {
     std::unique_ptr<CHQuery> ch_query;
-    MiddleNodeMap middle_node;
     std::vector<db_id_t> node_id;
 
     std::string schema = "ch";
@@ -153,16 +225,11 @@ std::unique_ptr<RoutingData> CHRoutingDataBuilder::pg_import( const std::string&
             p.b.cost = res_i[2];
             p.db_id = eid;
             p.b.is_shortcut = 0;
+            p.middle_node = 0;
             if ( !res_i[3].is_null() ) {
-                uint32_t middle = res_i[3].as<uint32_t>();
                 // we have a middle node, it is a shortcut
                 p.b.is_shortcut = 1;
-                if ( dir == 0 ) {
-                    middle_node[std::make_pair(id1, id2)] = middle;
-                }
-                else {
-                    middle_node[std::make_pair(id2, id1)] = middle;
-                }
+                p.middle_node = res_i[3].as<uint32_t>();
             }
             properties.emplace_back( p );
             targets.emplace_back( std::make_pair(id1, id2) );
@@ -217,7 +284,8 @@ std::unique_ptr<RoutingData> CHRoutingDataBuilder::pg_import( const std::string&
         }
     }
 
-    std::unique_ptr<RoutingData> rd( new CHRoutingData( std::move(ch_query), std::move(middle_node), std::move(node_id) ) );
+    std::unique_ptr<CHRoutingData> rd( new CHRoutingData( std::move(ch_query), std::move(node_id) ) );
+    rd->precompute_unpacked_shortcuts( unpacked_top_vertices( options ) );
 
     // import transport modes
     RoutingData::TransportModes all_modes = load_transport_modes( conn );
@@ -229,29 +297,29 @@ std::unique_ptr<RoutingData> CHRoutingDataBuilder::pg_import( const std::string&
     return rd;
 }
 
-std::unique_ptr<RoutingData> CHRoutingDataBuilder::file_import( const std::string& filename, ProgressionCallback& /*progression**/, const VariantMap& /*options*/ ) const
+std::unique_ptr<RoutingData> CHRoutingDataBuilder::file_import( const std::string& filename, ProgressionCallback& /*progression**/, const VariantMap& options ) const
 {
     std::ifstream ifs( filename );
     if ( ifs.fail() ) {
         throw std::runtime_error( "Problem opening input file " + filename );
     }
 
-    read_header( ifs );
+    if ( read_header( ifs ) < 2 ) {
+        // middle nodes used to be stored in a separate map
+        throw std::runtime_error( "The CH graph in " + filename + " has been dumped by an older version, please dump it again" );
+    }
 
     std::cout << "read graph" << std::endl;
     std::unique_ptr<CHQuery> query( new CHQuery() );
     query->unserialize( ifs, binary_serialization_t() );
 
-    std::cout << "read middle node" << std::endl;
-    MiddleNodeMap middle_node;
-    unserialize( ifs, middle_node, binary_serialization_t() );
-
     std::cout << "read node id" << std::endl;
     std::vector<db_id_t> node_id;
     unserialize( ifs, node_id, binary_serialization_t() );
 
-    std::unique_ptr<RoutingData> rd( new CHRoutingData( std::move( query ), std::move( middle_node ), std::move( node_id ) ) );
-    return rd;
+    std::unique_ptr<CHRoutingData> rd( new CHRoutingData( std::move( query ), std::move( node_id ) ) );
+    rd->precompute_unpacked_shortcuts( unpacked_top_vertices( options ) );
+    return std::unique_ptr<RoutingData>( rd.release() );
 }
 
 void CHRoutingDataBuilder::file_export( const RoutingData* rd, const std::string& filename, ProgressionCallback& /*progression*/, const VariantMap& /*options*/ ) const
@@ -265,8 +333,6 @@ void CHRoutingDataBuilder::file_export( const RoutingData* rd, const std::string
     // serialize the graph
     mrd->ch_query_->serialize( ofs, binary_serialization_t() );
 
-    // middle node
-    serialize( ofs, mrd->middle_node_, binary_serialization_t() );
     serialize( ofs, mrd->node_id_, binary_serialization_t() );
 }
 
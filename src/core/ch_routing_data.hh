@@ -18,6 +18,7 @@
 #define TEMPUS_CH_ROUTING_DATA_HH
 
 #include <vector>
+#include <unordered_map>
 
 #include "ch_query_graph.hh"
 #include "routing_data.hh"
@@ -36,16 +37,21 @@ struct CHEdgeProperty
         } b;
         uint32_t data;
     };
+    /// the node "in the middle" of a shortcut, i.e. the node whose contraction
+    /// created it. Only meaningful if b.is_shortcut is set
+    uint32_t middle_node;
     db_id_t db_id;
 
     void serialize( std::ostream& ostr, binary_serialization_t t ) const
     {
         Tempus::serialize( ostr, data, t );
+        Tempus::serialize( ostr, middle_node, t );
         Tempus::serialize( ostr, db_id, t );
     }
     void unserialize( std::istream& istr, binary_serialization_t t )
     {
         Tempus::unserialize( istr, data, t );
+        Tempus::unserialize( istr, middle_node, t );
         Tempus::unserialize( istr, db_id, t );
     }
 };
@@ -61,17 +67,12 @@ using CHQuery = CHQueryGraph<CHEdgeProperty>;
 using CHVertex = uint32_t;
 using CHEdge = CHQueryGraph<CHEdgeProperty>::edge_descriptor;
 
-///
-/// storage of the "middle" node, i.e. the node involved
-/// in a shortcut
-using MiddleNodeMap = std::map<std::pair<CHVertex, CHVertex>, CHVertex>;
-
 ///
 /// Routing data out of a CH query graph
 class CHRoutingData : public RoutingData
 {
 public:
-    CHRoutingData( std::unique_ptr<CHQuery> ch_query, MiddleNodeMap&& middle_node, std::vector<db_id_t>&& node_id);
+    CHRoutingData( std::unique_ptr<CHQuery> ch_query, std::vector<db_id_t>&& node_id );
 
     boost::optional<CHVertex> vertex_from_id( db_id_t id ) const;
 
@@ -79,21 +80,29 @@ public:
 
     const CHQuery& ch_query() const { return *ch_query_; }
 
-    const MiddleNodeMap& middle_node() const { return middle_node_; }
+    ///
+    /// Append to edges the original (non shortcut) edges represented by an edge, in path order
+    void unpack_edge( const CHEdge& e, std::vector<CHEdge>& edges ) const;
+
+    ///
+    /// Precompute the unpacked sequences of the shortcuts between the n highest ranked vertices.
+    /// These are the shortcuts that represent the longest paths.
+    void precompute_unpacked_shortcuts( size_t n_top_vertices );
 
 private:
     // the CH graph
     std::unique_ptr<CHQuery> ch_query_;
 
-    // middle node of a shortcut
-    MiddleNodeMap middle_node_;
-
     // node index -> node id
     std::vector<db_id_t> node_id_;
 
     // node id -> index
     std::map<db_id_t, size_t> rnode_id_;
 
+    // precomputed unpacked shortcuts: shortcut -> [begin, end) in unpacked_edges_
+    std::unordered_map<const CHEdgeProperty*, std::pair<uint32_t, uint32_t>> unpacked_index_;
+    std::vector<CHEdge> unpacked_edges_;
+
     friend class CHRoutingDataBuilder;
 };
 
@@ -107,7 +116,7 @@ public:
     virtual std::unique_ptr<RoutingData> file_import( const std::string& filename, ProgressionCallback& progression, const VariantMap& options = VariantMap() ) const override;
     virtual void file_export( const RoutingData* rd, const std::string& filename, ProgressionCallback& progression, const VariantMap& options = VariantMap() ) const override;
 
-    uint32_t version() const override { return 1; }
+    uint32_t version() const override { return 2; }
 };
 
 } // namespace Tempus
@@ -0,0 +1,281 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "csa.hh"
+
+#include <algorithm>
+#include <numeric>
+#include <boost/assert.hpp>
+
+namespace Tempus
+{
+
+namespace
+{
+const uint32_t NONE = uint32_t(-1);
+}
+
+PTConnectionTable::PTConnectionTable( const PTTimetable& timetable )
+{
+    std::vector<PTConnection> connections;
+    std::vector<PTRouteStop> route_stops;
+    uint32_t route_trip = 0;
+    for ( uint32_t r = 0; r < timetable.num_routes(); r++ ) {
+        const uint32_t n_stops = timetable.route_num_stops( r );
+        for ( uint32_t i = 0; i < timetable.route_num_trips( r ); i++, route_trip++ ) {
+            const PTStopTime* times = timetable.stop_times( r, i );
+            for ( uint32_t p = 0; p + 1 < n_stops; p++ ) {
+                connections.push_back( PTConnection{ timetable.route_stop( r, p ), timetable.route_stop( r, p + 1 ),
+                                                     times[p].departure_time, times[p + 1].arrival_time,
+                                                     timetable.route_trip( r, i ), route_trip } );
+                route_stops.push_back( PTRouteStop{ r, p } );
+            }
+        }
+    }
+    n_route_trips_ = route_trip;
+
+    // sort by departure. Connections of a trip that depart at the same time keep their order
+    std::vector<uint32_t> order( connections.size() );
+    std::iota( order.begin(), order.end(), 0 );
+    std::sort( order.begin(), order.end(), [&]( uint32_t a, uint32_t b ) {
+            const PTConnection& ca = connections[a];
+            const PTConnection& cb = connections[b];
+            return std::make_tuple( ca.departure_time, ca.arrival_time, route_stops[a].position ) <
+                std::make_tuple( cb.departure_time, cb.arrival_time, route_stops[b].position );
+        });
+    connections_.reserve( connections.size() );
+    route_stops_.reserve( connections.size() );
+    for ( uint32_t i : order ) {
+        connections_.push_back( connections[i] );
+        route_stops_.push_back( route_stops[i] );
+    }
+}
+
+size_t PTConnectionTable::first_connection( float departure_time ) const
+{
+    auto it = std::lower_bound( connections_.begin(), connections_.end(), departure_time, []( const PTConnection& c, float t ) {
+            return c.departure_time < t;
+        });
+    return size_t( it - connections_.begin() );
+}
+
+ConnectionScan::ConnectionScan( const PTTimetable& timetable, const PTConnectionTable& connections ) :
+    timetable_( timetable ),
+    connections_( connections ),
+    ride_arrival_( timetable.num_stops(), PTTimetable::infinity() ),
+    walk_arrival_( timetable.num_stops(), PTTimetable::infinity() ),
+    ready_time_( timetable.num_stops(), PTTimetable::infinity() ),
+    in_connection_( timetable.num_stops(), NONE ),
+    walk_departure_( timetable.num_stops(), PTTimetable::infinity() ),
+    walk_from_( timetable.num_stops(), NONE ),
+    egress_duration_( timetable.num_stops(), PTTimetable::infinity() ),
+    trip_boarding_( connections.num_route_trips(), NONE ),
+    arrivals_( timetable.num_stops(), PTTimetable::infinity() ),
+    n_scanned_connections_( 0 )
+{
+}
+
+void ConnectionScan::clear()
+{
+    for ( uint32_t s : touched_stops_ ) {
+        ride_arrival_[s] = PTTimetable::infinity();
+        walk_arrival_[s] = PTTimetable::infinity();
+        ready_time_[s] = PTTimetable::infinity();
+        in_connection_[s] = NONE;
+        walk_departure_[s] = PTTimetable::infinity();
+        walk_from_[s] = NONE;
+    }
+    touched_stops_.clear();
+    for ( uint32_t t : touched_trips_ ) {
+        trip_boarding_[t] = NONE;
+    }
+    touched_trips_.clear();
+}
+
+void ConnectionScan::set_walk_arrival( uint32_t s, float arrival, float departure, uint32_t from )
+{
+    if ( ready_time_[s] == PTTimetable::infinity() ) {
+        touched_stops_.push_back( s );
+    }
+    walk_arrival_[s] = arrival;
+    walk_departure_[s] = departure;
+    walk_from_[s] = from;
+    ready_time_[s] = std::min( ready_time_[s], arrival );
+}
+
+void ConnectionScan::scan( const std::vector<bool>& active_trips,
+                           const std::vector<PTAccess>& access,
+                           const std::vector<PTAccess>& egress,
+                           float departure_time,
+                           float walking_speed,
+                           float min_transfer_time,
+                           float max_arrival_time )
+{
+    clear();
+    n_scanned_connections_ = 0;
+
+    float target = max_arrival_time;
+    for ( const PTAccess& e : egress ) {
+        egress_duration_[e.stop] = std::min( egress_duration_[e.stop], e.duration );
+    }
+    for ( const PTAccess& a : access ) {
+        const float arrival = departure_time + a.duration;
+        if ( arrival < walk_arrival_[a.stop] ) {
+            set_walk_arrival( a.stop, arrival, departure_time, PTJourneyLeg::NO_STOP );
+            target = std::min( target, arrival + egress_duration_[a.stop] );
+        }
+    }
+
+    for ( size_t i = connections_.first_connection( departure_time ); i < connections_.num_connections(); i++ ) {
+        const PTConnection& c = connections_.connection( i );
+        if ( c.departure_time >= target ) {
+            break;
+        }
+        n_scanned_connections_++;
+        if ( !active_trips[c.trip] ) {
+            continue;
+        }
+        uint32_t& boarding = trip_boarding_[c.route_trip];
+        if ( boarding == NONE ) {
+            if ( ready_time_[c.from_stop] > c.departure_time ) {
+                continue;
+            }
+            boarding = uint32_t(i);
+            touched_trips_.push_back( c.route_trip );
+        }
+        if ( c.arrival_time >= ride_arrival_[c.to_stop] ) {
+            continue;
+        }
+
+        const uint32_t s = c.to_stop;
+        if ( ready_time_[s] == PTTimetable::infinity() ) {
+            touched_stops_.push_back( s );
+        }
+        ride_arrival_[s] = c.arrival_time;
+        in_connection_[s] = uint32_t(i);
+        ready_time_[s] = std::min( ready_time_[s], c.arrival_time + min_transfer_time );
+        target = std::min( target, c.arrival_time + egress_duration_[s] );
+
+        const PTFootpath* it, *it_end;
+        for ( std::tie( it, it_end ) = timetable_.footpaths( s ); it != it_end; it++ ) {
+            const float arrival = c.arrival_time + it->distance / walking_speed;
+            // a trip arrival only allows to board after the minimum transfer time
+            if ( arrival < ready_time_[it->stop] ) {
+                set_walk_arrival( it->stop, arrival, c.arrival_time, s );
+                target = std::min( target, arrival + egress_duration_[it->stop] );
+            }
+        }
+    }
+
+    for ( const PTAccess& e : egress ) {
+        egress_duration_[e.stop] = PTTimetable::infinity();
+    }
+}
+
+bool ConnectionScan::query( const std::vector<bool>& active_trips,
+                            const std::vector<PTAccess>& access,
+                            const std::vector<PTAccess>& egress,
+                            float departure_time,
+                            float walking_speed,
+                            float min_transfer_time,
+                            PTJourney& journey )
+{
+    scan( active_trips, access, egress, departure_time, walking_speed, min_transfer_time, PTTimetable::infinity() );
+
+    const PTAccess* best_egress = nullptr;
+    float best_arrival = PTTimetable::infinity();
+    for ( const PTAccess& e : egress ) {
+        const float arrival = std::min( ride_arrival_[e.stop], walk_arrival_[e.stop] ) + e.duration;
+        if ( arrival < best_arrival ) {
+            best_arrival = arrival;
+            best_egress = &e;
+        }
+    }
+    if ( !best_egress ) {
+        return false;
+    }
+
+    std::vector<PTJourneyLeg> legs;
+    uint32_t s = best_egress->stop;
+    PTJourneyLeg egress_leg = PTJourneyLeg();
+    egress_leg.type = PTJourneyLeg::LegWalk;
+    egress_leg.from_stop = s;
+    egress_leg.to_stop = PTJourneyLeg::NO_STOP;
+    egress_leg.departure_time = best_arrival - best_egress->duration;
+    egress_leg.arrival_time = best_arrival;
+    legs.push_back( egress_leg );
+
+    uint32_t n_trips = 0;
+    bool by_walk = walk_arrival_[s] < ride_arrival_[s];
+    for ( bool done = false; !done; ) {
+        PTJourneyLeg leg = PTJourneyLeg();
+        leg.to_stop = s;
+        if ( by_walk ) {
+            leg.type = PTJourneyLeg::LegWalk;
+            leg.from_stop = walk_from_[s];
+            leg.departure_time = walk_departure_[s];
+            leg.arrival_time = walk_arrival_[s];
+            done = walk_from_[s] == PTJourneyLeg::NO_STOP;
+            s = walk_from_[s];
+            by_walk = false;
+        }
+        else {
+            const uint32_t alight = in_connection_[s];
+            BOOST_ASSERT( alight != NONE );
+            const uint32_t board = trip_boarding_[connections_.connection( alight ).route_trip];
+            const PTConnection& c = connections_.connection( board );
+            leg.type = PTJourneyLeg::LegRide;
+            leg.from_stop = c.from_stop;
+            leg.trip = c.trip;
+            leg.route = connections_.route_stop( board ).route;
+            leg.board_position = connections_.route_stop( board ).position;
+            leg.alight_position = connections_.route_stop( alight ).position + 1;
+            leg.departure_time = c.departure_time;
+            leg.arrival_time = connections_.connection( alight ).arrival_time;
+            n_trips++;
+            s = c.from_stop;
+            // label the trip was boarded with
+            by_walk = walk_arrival_[s] <= c.departure_time;
+        }
+        legs.push_back( leg );
+    }
+
+    std::reverse( legs.begin(), legs.end() );
+    journey.departure_time = legs.front().departure_time;
+    journey.arrival_time = legs.back().arrival_time;
+    journey.n_trips = n_trips;
+    journey.legs.swap( legs );
+    return true;
+}
+
+const std::vector<float>& ConnectionScan::earliest_arrivals( const std::vector<bool>& active_trips,
+                                                             const std::vector<PTAccess>& access,
+                                                             float departure_time,
+                                                             float walking_speed,
+                                                             float min_transfer_time,
+                                                             float max_arrival_time )
+{
+    scan( active_trips, access, std::vector<PTAccess>(), departure_time, walking_speed, min_transfer_time, max_arrival_time );
+    for ( uint32_t s = 0; s < arrivals_.size(); s++ ) {
+        arrivals_[s] = std::min( ride_arrival_[s], walk_arrival_[s] );
+        if ( arrivals_[s] > max_arrival_time ) {
+            arrivals_[s] = PTTimetable::infinity();
+        }
+    }
+    return arrivals_;
+}
+
+} // namespace Tempus
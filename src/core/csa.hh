@@ -0,0 +1,163 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_CSA_HH
+#define TEMPUS_CSA_HH
+
+#include <vector>
+
+#include "pt_timetable.hh"
+
+/**
+ * Connection Scan Algorithm (Dibbelt, Pajor, Strasser & Wagner, 2013).
+ *
+ * Every elementary connection of every trip, from a stop to the next one, is stored in a
+ * single array sorted by departure time. An earliest arrival query scans it linearly from
+ * the first connection departing after the departure time, which only touches flat arrays.
+ */
+
+namespace Tempus
+{
+
+///
+/// Elementary connection of a trip, between two consecutive stops
+struct PTConnection
+{
+    uint32_t from_stop;
+    uint32_t to_stop;
+    /// times in minutes since midnight
+    float departure_time;
+    float arrival_time;
+    /// trip index in the timetable
+    uint32_t trip;
+    /// index of the trip among the trips of all the routes
+    uint32_t route_trip;
+};
+
+///
+/// Connections of all the trips of a timetable, sorted by departure time
+class PTConnectionTable
+{
+public:
+    PTConnectionTable( const PTTimetable& timetable );
+
+    size_t num_connections() const { return connections_.size(); }
+    const PTConnection& connection( size_t i ) const { return connections_[i]; }
+    ///
+    /// Route and position of the departure stop of a connection
+    const PTRouteStop& route_stop( size_t i ) const { return route_stops_[i]; }
+
+    ///
+    /// Number of trips of all the routes
+    size_t num_route_trips() const { return n_route_trips_; }
+
+    ///
+    /// First connection that departs at or after a time
+    size_t first_connection( float departure_time ) const;
+
+private:
+    std::vector<PTConnection> connections_;
+    std::vector<PTRouteStop> route_stops_;
+    size_t n_route_trips_;
+};
+
+///
+/// Connection scan earliest arrival queries on a timetable.
+///
+/// Labels are kept from one query to another, only the entries a query touched are reset.
+class ConnectionScan
+{
+public:
+    ConnectionScan( const PTTimetable& timetable, const PTConnectionTable& connections );
+
+    ///
+    /// Earliest arrival journey
+    /// \param active_trips Whether each trip runs on the day of the query
+    /// \param access Stops reachable from the origin
+    /// \param egress Stops the destination is reachable from
+    /// \param departure_time Departure time from the origin, in minutes since midnight
+    /// \param walking_speed Walking speed on footpaths, in meters per minute
+    /// \param min_transfer_time Time needed to board a trip after leaving another one at the same stop (minutes)
+    /// \param journey The journey, if the destination is reached
+    /// \returns Whether the destination is reached
+    bool query( const std::vector<bool>& active_trips,
+                const std::vector<PTAccess>& access,
+                const std::vector<PTAccess>& egress,
+                float departure_time,
+                float walking_speed,
+                float min_transfer_time,
+                PTJourney& journey );
+
+    ///
+    /// Earliest arrival times at every stop, for isochrones and travel time matrices
+    /// \param max_arrival_time Connections arriving after this time are not scanned
+    /// \returns Arrival time at each stop, infinity if not reached
+    const std::vector<float>& earliest_arrivals( const std::vector<bool>& active_trips,
+                                                 const std::vector<PTAccess>& access,
+                                                 float departure_time,
+                                                 float walking_speed,
+                                                 float min_transfer_time,
+                                                 float max_arrival_time = PTTimetable::infinity() );
+
+    ///
+    /// Number of connections scanned by the last query
+    size_t num_scanned_connections() const { return n_scanned_connections_; }
+
+private:
+    ///
+    /// Scan connections until the departure time is after the target arrival time
+    void scan( const std::vector<bool>& active_trips,
+               const std::vector<PTAccess>& access,
+               const std::vector<PTAccess>& egress,
+               float departure_time,
+               float walking_speed,
+               float min_transfer_time,
+               float max_arrival_time );
+
+    void set_walk_arrival( uint32_t s, float arrival, float departure, uint32_t from );
+
+    void clear();
+
+    const PTTimetable& timetable_;
+    const PTConnectionTable& connections_;
+
+    // earliest arrival at each stop by a trip, and by walking
+    std::vector<float> ride_arrival_;
+    std::vector<float> walk_arrival_;
+    // earliest time a trip can be boarded at each stop
+    std::vector<float> ready_time_;
+    // last connection of a ride arrival
+    std::vector<uint32_t> in_connection_;
+    // departure time and origin of a walk arrival, NO_STOP for an access
+    std::vector<float> walk_departure_;
+    std::vector<uint32_t> walk_from_;
+    std::vector<uint32_t> touched_stops_;
+
+    // walking duration to the destination from each stop
+    std::vector<float> egress_duration_;
+
+    // first connection boarded of each trip of each route, or -1
+    std::vector<uint32_t> trip_boarding_;
+    std::vector<uint32_t> touched_trips_;
+
+    std::vector<float> arrivals_;
+
+    size_t n_scanned_connections_;
+};
+
+} // namespace Tempus
+
+#endif
@@ -0,0 +1,350 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mcraptor.hh"
+
+#include <algorithm>
+
+namespace Tempus
+{
+
+namespace
+{
+const uint32_t NONE = uint32_t(-1);
+const uint16_t NO_ZONE = uint16_t(-1);
+}
+
+McRaptor::McRaptor( const PTTimetable& timetable ) :
+    timetable_( timetable ),
+    n_stops_( uint32_t( timetable.num_stops() ) ),
+    n_rounds_( 0 ),
+    min_transfer_time_( 0.0 ),
+    best_ride_( timetable.num_stops() ),
+    best_( timetable.num_stops() ),
+    marked_( timetable.num_stops(), 0 ),
+    route_marked_position_( timetable.num_routes(), NONE )
+{
+}
+
+bool McRaptor::dominated( const std::vector<uint32_t>& bag, const Label& l ) const
+{
+    for ( uint32_t i : bag ) {
+        if ( dominates( labels_[i], l ) ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool McRaptor::dominated_by_targets( const Label& l ) const
+{
+    // arrival times and zones can only grow until the destination
+    for ( const Target& t : targets_ ) {
+        if ( t.arrival_time <= l.arrival_time && t.zones <= l.zones ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void McRaptor::merge( std::vector<uint32_t>& bag, uint32_t l )
+{
+    const Label& label = labels_[l];
+    bag.erase( std::remove_if( bag.begin(), bag.end(), [&]( uint32_t i ) {
+                return dominates( label, labels_[i] );
+            }), bag.end() );
+    bag.push_back( l );
+}
+
+void McRaptor::add_label( uint32_t round, const Label& l, bool ride )
+{
+    if ( dominated_by_targets( l ) || dominated( ride ? best_ride_[l.stop] : best_[l.stop], l ) ) {
+        return;
+    }
+    const uint32_t idx = uint32_t( labels_.size() );
+    labels_.push_back( l );
+
+    std::vector<uint32_t>& b = bag( round, l.stop );
+    if ( b.empty() ) {
+        touched_bags_.push_back( size_t(round) * n_stops_ + l.stop );
+    }
+    merge( b, idx );
+    if ( best_[l.stop].empty() && best_ride_[l.stop].empty() ) {
+        touched_stops_.push_back( l.stop );
+    }
+    if ( ride ) {
+        merge( best_ride_[l.stop], idx );
+    }
+    merge( best_[l.stop], idx );
+    if ( !marked_[l.stop] ) {
+        marked_[l.stop] = 1;
+        marked_stops_.push_back( l.stop );
+    }
+}
+
+void McRaptor::clear()
+{
+    labels_.clear();
+    for ( size_t i : touched_bags_ ) {
+        bags_[i].clear();
+    }
+    touched_bags_.clear();
+    for ( uint32_t s : touched_stops_ ) {
+        best_ride_[s].clear();
+        best_[s].clear();
+    }
+    touched_stops_.clear();
+    for ( uint32_t s : marked_stops_ ) {
+        marked_[s] = 0;
+    }
+    marked_stops_.clear();
+    targets_.clear();
+}
+
+std::vector<PTJourney> McRaptor::query( const std::vector<bool>& active_trips,
+                                        const std::vector<PTAccess>& access,
+                                        const std::vector<PTAccess>& egress,
+                                        float departure_time,
+                                        uint32_t max_transfers,
+                                        float walking_speed,
+                                        float min_transfer_time )
+{
+    clear();
+    min_transfer_time_ = min_transfer_time;
+    const uint32_t n_rounds = max_transfers + 2;
+    if ( n_rounds > n_rounds_ ) {
+        bags_.resize( size_t(n_rounds) * n_stops_ );
+        n_rounds_ = n_rounds;
+    }
+
+    // round 0: walking access to stops
+    for ( const PTAccess& a : access ) {
+        Label l = Label();
+        l.arrival_time = departure_time + a.duration;
+        l.departure_time = departure_time;
+        l.zones = 0;
+        l.last_zone = NO_ZONE;
+        l.type = LabelAccess;
+        l.stop = a.stop;
+        l.from_stop = PTJourneyLeg::NO_STOP;
+        l.parent = NONE;
+        add_label( 0, l, false );
+    }
+
+    std::vector<uint32_t> ride_labels;
+    for ( uint32_t k = 0; k + 1 < n_rounds; k++ ) {
+        // routes served by the stops marked in the previous round
+        for ( uint32_t s : marked_stops_ ) {
+            marked_[s] = 0;
+            const PTRouteStop* it, *it_end;
+            for ( std::tie( it, it_end ) = timetable_.stop_routes( s ); it != it_end; it++ ) {
+                uint32_t& position = route_marked_position_[it->route];
+                if ( position == NONE ) {
+                    marked_routes_.push_back( it->route );
+                    position = it->position;
+                }
+                else {
+                    position = std::min( position, it->position );
+                }
+            }
+        }
+        marked_stops_.clear();
+        if ( marked_routes_.empty() ) {
+            break;
+        }
+
+        const uint32_t round = k + 1;
+        for ( uint32_t r : marked_routes_ ) {
+            const uint32_t first_position = route_marked_position_[r];
+            route_marked_position_[r] = NONE;
+            const uint32_t n_route_stops = timetable_.route_num_stops( r );
+            const uint32_t n_route_trips = timetable_.route_num_trips( r );
+
+            route_bag_.clear();
+            for ( uint32_t i = first_position; i < n_route_stops; i++ ) {
+                const uint32_t s = timetable_.route_stop( r, i );
+                const uint16_t zone = timetable_.stop( s ).zone_id;
+
+                // alight
+                for ( RouteLabel& rl : route_bag_ ) {
+                    if ( rl.last_zone != zone ) {
+                        rl.zones++;
+                        rl.last_zone = zone;
+                    }
+                    const PTStopTime* times = timetable_.stop_times( r, rl.route_trip );
+                    Label l;
+                    l.arrival_time = times[i].arrival_time;
+                    l.departure_time = times[rl.board_position].departure_time;
+                    l.zones = rl.zones;
+                    l.last_zone = zone;
+                    l.type = LabelRide;
+                    l.stop = s;
+                    l.from_stop = timetable_.route_stop( r, rl.board_position );
+                    l.parent = rl.parent;
+                    l.route = r;
+                    l.route_trip = rl.route_trip;
+                    l.board_position = rl.board_position;
+                    l.alight_position = i;
+                    add_label( round, l, true );
+                }
+
+                // board with the labels of the previous round
+                if ( i + 1 == n_route_stops ) {
+                    break;
+                }
+                for ( uint32_t li : bag( k, s ) ) {
+                    const Label& l = labels_[li];
+                    const float ready = ready_time( l );
+                    uint32_t t = 0, hi = n_route_trips;
+                    while ( t < hi ) {
+                        uint32_t mid = ( t + hi ) / 2;
+                        if ( timetable_.stop_times( r, mid )[i].departure_time < ready ) {
+                            t = mid + 1;
+                        }
+                        else {
+                            hi = mid;
+                        }
+                    }
+                    while ( t < n_route_trips && !active_trips[timetable_.route_trip( r, t )] ) {
+                        t++;
+                    }
+                    if ( t == n_route_trips ) {
+                        continue;
+                    }
+                    RouteLabel rl;
+                    rl.route_trip = t;
+                    rl.zones = uint16_t( l.zones + ( l.last_zone != zone ? 1 : 0 ) );
+                    rl.last_zone = zone;
+                    rl.parent = li;
+                    rl.board_position = i;
+                    // an earlier trip with fewer zones dominates
+                    bool is_dominated = false;
+                    for ( const RouteLabel& o : route_bag_ ) {
+                        if ( o.route_trip <= rl.route_trip && o.zones <= rl.zones ) {
+                            is_dominated = true;
+                            break;
+                        }
+                    }
+                    if ( is_dominated ) {
+                        continue;
+                    }
+                    route_bag_.erase( std::remove_if( route_bag_.begin(), route_bag_.end(), [&rl]( const RouteLabel& o ) {
+                                return rl.route_trip <= o.route_trip && rl.zones <= o.zones;
+                            }), route_bag_.end() );
+                    route_bag_.push_back( rl );
+                }
+            }
+        }
+        marked_routes_.clear();
+
+        // footpaths from the stops reached by a trip in this round
+        ride_labels.clear();
+        for ( uint32_t s : marked_stops_ ) {
+            for ( uint32_t li : bag( round, s ) ) {
+                if ( labels_[li].type == LabelRide ) {
+                    ride_labels.push_back( li );
+                }
+            }
+        }
+        for ( uint32_t li : ride_labels ) {
+            const uint32_t s = labels_[li].stop;
+            const PTFootpath* it, *it_end;
+            for ( std::tie( it, it_end ) = timetable_.footpaths( s ); it != it_end; it++ ) {
+                Label l = labels_[li];
+                l.departure_time = l.arrival_time;
+                l.arrival_time += it->distance / walking_speed;
+                l.type = LabelWalk;
+                l.stop = it->stop;
+                l.from_stop = s;
+                l.parent = li;
+                add_label( round, l, false );
+            }
+        }
+
+        // destination
+        for ( const PTAccess& e : egress ) {
+            for ( uint32_t li : bag( round, e.stop ) ) {
+                const Label& l = labels_[li];
+                Target t{ l.arrival_time + e.duration, l.zones, round, li, e.duration };
+                bool is_dominated = false;
+                for ( const Target& o : targets_ ) {
+                    if ( o.arrival_time <= t.arrival_time && o.zones <= t.zones ) {
+                        is_dominated = true;
+                        break;
+                    }
+                }
+                if ( is_dominated ) {
+                    continue;
+                }
+                // targets of previous rounds have fewer trips
+                targets_.erase( std::remove_if( targets_.begin(), targets_.end(), [&t]( const Target& o ) {
+                            return o.round == t.round && t.arrival_time <= o.arrival_time && t.zones <= o.zones;
+                        }), targets_.end() );
+                targets_.push_back( t );
+            }
+        }
+    }
+
+    std::vector<PTJourney> journeys;
+    for ( const Target& t : targets_ ) {
+        journeys.push_back( journey( t ) );
+    }
+    std::sort( journeys.begin(), journeys.end(), []( const PTJourney& a, const PTJourney& b ) {
+            return std::make_pair( a.n_trips, a.arrival_time ) < std::make_pair( b.n_trips, b.arrival_time );
+        });
+    return journeys;
+}
+
+PTJourney McRaptor::journey( const Target& target ) const
+{
+    std::vector<PTJourneyLeg> legs;
+    PTJourneyLeg egress_leg = PTJourneyLeg();
+    egress_leg.type = PTJourneyLeg::LegWalk;
+    egress_leg.from_stop = labels_[target.label].stop;
+    egress_leg.to_stop = PTJourneyLeg::NO_STOP;
+    egress_leg.departure_time = target.arrival_time - target.egress_duration;
+    egress_leg.arrival_time = target.arrival_time;
+    legs.push_back( egress_leg );
+
+    uint32_t n_trips = 0;
+    for ( uint32_t li = target.label; li != NONE; li = labels_[li].parent ) {
+        const Label& l = labels_[li];
+        PTJourneyLeg leg = PTJourneyLeg();
+        leg.type = l.type == LabelRide ? PTJourneyLeg::LegRide : PTJourneyLeg::LegWalk;
+        leg.from_stop = l.from_stop;
+        leg.to_stop = l.stop;
+        leg.departure_time = l.departure_time;
+        leg.arrival_time = l.arrival_time;
+        if ( l.type == LabelRide ) {
+            leg.route = l.route;
+            leg.trip = timetable_.route_trip( l.route, l.route_trip );
+            leg.board_position = l.board_position;
+            leg.alight_position = l.alight_position;
+            n_trips++;
+        }
+        legs.push_back( leg );
+    }
+
+    std::reverse( legs.begin(), legs.end() );
+    PTJourney j;
+    j.departure_time = legs.front().departure_time;
+    j.arrival_time = legs.back().arrival_time;
+    j.n_trips = n_trips;
+    j.legs.swap( legs );
+    return j;
+}
+
+} // namespace Tempus
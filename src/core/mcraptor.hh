@@ -0,0 +1,173 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_MCRAPTOR_HH
+#define TEMPUS_MCRAPTOR_HH
+
+#include <vector>
+
+#include "pt_timetable.hh"
+
+/**
+ * Multi-criteria RAPTOR (McRAPTOR, Delling, Pajor & Werneck, 2012).
+ *
+ * Instead of a single arrival time, each stop holds in each round a bag of labels that do
+ * not dominate each other. Rounds still bound the number of trips, labels compare arrival
+ * times and numbers of fare zones (see pt_journey_fare_zones()).
+ */
+
+namespace Tempus
+{
+
+///
+/// Multi-criteria RAPTOR queries on a timetable.
+///
+/// Labels of a query are stored in a single pool, bags only hold indices in this pool.
+/// Bags are kept from one query to another, only the bags a query touched are cleared.
+class McRaptor
+{
+public:
+    McRaptor( const PTTimetable& timetable );
+
+    ///
+    /// Pareto-optimal journeys over (arrival time, number of trips, number of fare zones)
+    /// \param active_trips Whether each trip runs on the day of the query
+    /// \param access Stops reachable from the origin
+    /// \param egress Stops the destination is reachable from
+    /// \param departure_time Departure time from the origin, in minutes since midnight
+    /// \param max_transfers Maximum number of transfers between trips
+    /// \param walking_speed Walking speed on footpaths, in meters per minute
+    /// \param min_transfer_time Time needed to board a trip after leaving another one at the same stop (minutes)
+    /// \returns Journeys sorted by number of trips, then by arrival time
+    std::vector<PTJourney> query( const std::vector<bool>& active_trips,
+                                  const std::vector<PTAccess>& access,
+                                  const std::vector<PTAccess>& egress,
+                                  float departure_time,
+                                  uint32_t max_transfers,
+                                  float walking_speed,
+                                  float min_transfer_time );
+
+    ///
+    /// Number of labels created by the last query
+    size_t num_labels() const { return labels_.size(); }
+
+private:
+    enum LabelType
+    {
+        LabelAccess,
+        LabelRide,
+        LabelWalk
+    };
+
+    struct Label
+    {
+        float arrival_time;
+        /// departure time of the last leg
+        float departure_time;
+        uint16_t zones;
+        /// zone of the last stop visited by a trip, NO_ZONE before the first one
+        uint16_t last_zone;
+        LabelType type;
+        uint32_t stop;
+        /// boarding stop of a ride, or origin of a walk
+        uint32_t from_stop;
+        /// label the trip was boarded with, or the walk started from
+        uint32_t parent;
+        uint32_t route;
+        /// trip index in the route
+        uint32_t route_trip;
+        uint32_t board_position;
+        uint32_t alight_position;
+    };
+
+    ///
+    /// Trip of a route, boarded with a label
+    struct RouteLabel
+    {
+        uint32_t route_trip;
+        uint16_t zones;
+        uint16_t last_zone;
+        uint32_t parent;
+        uint32_t board_position;
+    };
+
+    struct Target
+    {
+        float arrival_time;
+        uint16_t zones;
+        uint32_t round;
+        uint32_t label;
+        float egress_duration;
+    };
+
+    std::vector<uint32_t>& bag( uint32_t round, uint32_t s ) { return bags_[size_t(round) * n_stops_ + s]; }
+
+    ///
+    /// Earliest time a trip can be boarded with a label
+    float ready_time( const Label& l ) const
+    {
+        return l.arrival_time + ( l.type == LabelRide ? min_transfer_time_ : 0.0f );
+    }
+    ///
+    /// A label dominates another one if it arrives and allows to board no later, with no more zones
+    /// once the zone of the next trip is known
+    bool dominates( const Label& a, const Label& b ) const
+    {
+        return a.arrival_time <= b.arrival_time && ready_time( a ) <= ready_time( b ) &&
+            a.zones + ( a.last_zone != b.last_zone ? 1 : 0 ) <= b.zones;
+    }
+    bool dominated( const std::vector<uint32_t>& bag, const Label& l ) const;
+    bool dominated_by_targets( const Label& l ) const;
+
+    ///
+    /// Add a label to a bag, removing the labels it dominates
+    void merge( std::vector<uint32_t>& bag, uint32_t l );
+
+    ///
+    /// Add a new label to the bags of its stop, if it is not dominated
+    void add_label( uint32_t round, const Label& l, bool ride );
+
+    PTJourney journey( const Target& target ) const;
+
+    void clear();
+
+    const PTTimetable& timetable_;
+    const uint32_t n_stops_;
+    uint32_t n_rounds_;
+    float min_transfer_time_;
+
+    std::vector<Label> labels_;
+    // bags of each round, round-major
+    std::vector<std::vector<uint32_t>> bags_;
+    std::vector<size_t> touched_bags_;
+    // best labels at each stop over all rounds, reached by a trip and by any means.
+    // Footpaths are not transitive, see Raptor
+    std::vector<std::vector<uint32_t>> best_ride_;
+    std::vector<std::vector<uint32_t>> best_;
+    std::vector<uint32_t> touched_stops_;
+
+    std::vector<Target> targets_;
+
+    std::vector<uint8_t> marked_;
+    std::vector<uint32_t> marked_stops_;
+    std::vector<uint32_t> route_marked_position_;
+    std::vector<uint32_t> marked_routes_;
+    std::vector<RouteLabel> route_bag_;
+};
+
+} // namespace Tempus
+
+#endif
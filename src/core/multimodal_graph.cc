@@ -17,6 +17,8 @@
 
 #include <string>
 #include <functional>
+#include <algorithm>
+#include <limits>
 
 #include <boost/format.hpp>
 #include <boost/variant/get.hpp>
@@ -30,168 +32,85 @@ namespace Tempus {
 namespace Multimodal {
 
 
-Vertex::Vertex() : graph_(0), type_(Null)
+const PublicTransport::Graph* Vertex::pt_graph( const Graph& graph ) const
 {
+    return &graph.public_transport( pt_graph_idx() );
 }
 
-Vertex::Vertex( const Graph& a_graph, Road::Vertex vertex, road_t ) : graph_(&a_graph), type_(Road)
+const POI* Vertex::poi( const Graph& graph ) const
 {
-    data_.vertex = vertex;
+    return &graph.poi( poi_idx() );
 }
 
-Vertex::Vertex( const Graph& a_graph, PublicTransportGraphIndex idx, PublicTransport::Vertex vertex, pt_t ) : graph_(&a_graph), type_(PublicTransport)
+Point3D Vertex::coordinates( const Graph& graph ) const
 {
-    data_.pt.index = idx;
-    data_.pt.vertex = vertex;
-}
-
-Vertex::Vertex( const Graph& a_graph, POIIndex idx, poi_t ) : graph_(&a_graph), type_(Poi)
-{
-    data_.poi = idx;
-}
-
-const Multimodal::Graph* Vertex::graph() const
-{
-    return graph_;
-}
-
-const Road::Graph* Vertex::road_graph() const
-{
-    return &graph_->road();
-}
-
-Road::Vertex Vertex::road_vertex() const
-{
-    if ( is_null() || type() != Road ) {
-        return Road::Vertex();
+    switch ( type() )
+    {
+    case Null:
+        return Point3D();
+    case Road:
+        return graph.road()[road_vertex()].coordinates();
+    case PublicTransport:
+        return (*pt_graph( graph ))[pt_vertex()].coordinates();
+    case Poi:
+        return poi( graph )->coordinates();
     }
-    return data_.vertex;
-}
-
-PublicTransportGraphIndex Vertex::pt_graph_idx() const
-{
-    return data_.pt.index;
-}
-
-const PublicTransport::Graph* Vertex::pt_graph() const
-{
-    return &graph_->public_transport(data_.pt.index);
-}
-
-PublicTransport::Vertex Vertex::pt_vertex() const
-{
-    return data_.pt.vertex;
+    return Point3D();
 }
 
-Road::Node get_road_node( const Multimodal::Vertex& v )
+const Road::Node& get_road_node( const Multimodal::Vertex& v, const Graph& graph )
 {
-    return v.graph()->road()[v.road_vertex()];
+    return graph.road()[v.road_vertex()];
 }
 
-PublicTransport::Stop get_pt_stop( const Multimodal::Vertex& v )
+const PublicTransport::Stop& get_pt_stop( const Multimodal::Vertex& v, const Graph& graph )
 {
-    return (*v.pt_graph())[v.pt_vertex()];
+    return (*v.pt_graph( graph ))[v.pt_vertex()];
 }
 
-MMVertex get_mm_vertex( const Multimodal::Vertex& v )
+MMVertex get_mm_vertex( const Multimodal::Vertex& v, const Graph& graph )
 {
     switch ( v.type() ) {
     case Multimodal::Vertex::Road:
-        return MMVertex( MMVertex::Road, (*v.road_graph())[v.road_vertex()].db_id() );
+        return MMVertex( MMVertex::Road, graph.road()[v.road_vertex()].db_id() );
     case Multimodal::Vertex::PublicTransport:
-        return MMVertex( (*v.pt_graph())[v.pt_vertex()].db_id(), v.graph()->public_transport_rindex( v.pt_graph_idx() ) );
+        return MMVertex( (*v.pt_graph( graph ))[v.pt_vertex()].db_id(), graph.public_transport_rindex( v.pt_graph_idx() ) );
     case Multimodal::Vertex::Poi:
-        return MMVertex( MMVertex::Poi, v.poi()->db_id() );
+        return MMVertex( MMVertex::Poi, v.poi( graph )->db_id() );
     default:
         break;
     }
     return MMVertex(MMVertex::Road, 0);
 }
 
-POIIndex Vertex::poi_idx() const
-{
-    return data_.poi;
-}
-
-const POI* Vertex::poi() const
-{
-    return &graph_->poi(data_.poi);
-}
-
-Point3D Vertex::coordinates() const
+// Road edge of a connection from a road vertex to a stop or a POI:
+// the road edge the object is on or its opposite, whichever ends on the road vertex
+template <class Object>
+Road::Edge road_edge_to_object( const Road::Graph& road, Road::Vertex s, const Object& o )
 {
-    switch (type_)
-    {
-    case Null:
-        return Point3D();
-    case Road:
-        return graph_->road()[data_.vertex].coordinates();
-    case PublicTransport:
-        return (*pt_graph())[data_.pt.vertex].coordinates();
-    case Poi:
-        return poi()->coordinates();
+    if ( o.opposite_road_edge() && s == target( o.road_edge(), road ) ) {
+        return *o.opposite_road_edge();
     }
-    return Point3D();
+    return o.road_edge();
 }
 
-size_t Vertex::hash() const
+// Road edge of a connection from a stop or a POI to a road vertex
+template <class Object>
+Road::Edge road_edge_from_object( const Road::Graph& road, const Object& o, Road::Vertex t )
 {
-    uint64_t v = (static_cast<uint64_t>(type_) << 62);
-    switch ( type_ )
-    {
-    case Road:
-        v |= data_.vertex;
-        break;
-    case PublicTransport:
-        v |= (static_cast<uint64_t>(data_.pt.index) << 32) | data_.pt.vertex;
-        break;
-    case Poi:
-        v |= data_.poi;
-        break;
-    case Null:
-    default:
-        break;
+    if ( o.opposite_road_edge() && t == source( o.road_edge(), road ) ) {
+        return *o.opposite_road_edge();
     }
-    return std::hash<uint64_t>()( v );
+    return o.road_edge();
 }
 
-Edge::ConnectionType Edge::connection_type() const
-{
-    if ( source_.type() == Vertex::Road ) {
-        if ( target_.type() == Vertex::Road ) {
-            return Road2Road;
-        }
-        else if ( target_.type() == Vertex::PublicTransport ) {
-            return Road2Transport;
-        }
-        else {
-            return Road2Poi;
-        }
-    }
-    else if ( source_.type() == Vertex::PublicTransport ) {
-        if ( target_.type() == Vertex::Road ) {
-            return Transport2Road;
-        }
-        else if ( target_.type() == Vertex::PublicTransport ) {
-            return Transport2Transport;
-        }
-    }
-    else {
-        if ( target_.type() == Vertex::Road ) {
-            return Poi2Road;
-        }
-    }
-
-    return UnknownConnection;
-}
-
-unsigned Edge::traffic_rules() const
+unsigned Edge::traffic_rules( const Multimodal::Graph& graph ) const
 {
     if ( connection_type() == Multimodal::Edge::Transport2Transport ) {
         return TrafficRulePublicTransport;
     }
 
-    return source_.graph()->road()[road_edge()].traffic_rules();
+    return graph.road()[road_edge()].traffic_rules();
 }
 
 bool Edge::operator==( const Multimodal::Edge& e ) const
@@ -206,21 +125,11 @@ bool Edge::operator!=( const Multimodal::Edge& e ) const
 
 bool Edge::operator<( const Multimodal::Edge& e ) const
 {
-#if 0
-    // not faster ...
-    int c = source_.cmp( e.source_ );
-    if ( c == 0 ) {
-        int d = target_.cmp( e.target_ );
-        return d == 0 ? road_edge_ < e.road_edge_ : d < 0;
-    }
-    return c < 0;
-#else
     return source_ == e.source_ ?
         ( target_ == e.target_ ?
           road_edge_ < e.road_edge_
           : target_ < e.target_ )
                        : source_ < e.source_;
-#endif
 }
 
 VertexIterator::VertexIterator( const Multimodal::Graph& graph )
@@ -253,14 +162,14 @@ Vertex VertexIterator::dereference() const
     BOOST_ASSERT( graph_ != 0 );
 
     if ( road_it_ != road_it_end_ ) {
-        vertex = Vertex( *graph_, *road_it_, Vertex::road_t() );
+        vertex = Vertex( *road_it_, Vertex::road_t() );
     }
     else {
         if ( pt_it_ != pt_it_end_ ) {
-            vertex = Vertex( *graph_, pt_graph_it_, *pt_it_ );
+            vertex = Vertex( pt_graph_it_, *pt_it_ );
         }
         else {
-            vertex = Vertex( *graph_, poi_it_, Vertex::poi_t() );
+            vertex = Vertex( poi_it_, Vertex::poi_t() );
         }
     }
 
@@ -323,152 +232,37 @@ bool VertexIterator::equal( const VertexIterator& v ) const
     return poi_it_ == v.poi_it_;
 }
 
-// Road2Road
-Edge::Edge( const Multimodal::Graph& graph, const Road::Vertex& s, const Road::Vertex& t, road2road_t ) :
-    source_( graph, s, Vertex::road_t() ), target_( graph, t, Vertex::road_t() )
-{
-    bool found = false;
-    tie( road_edge_, found ) = edge( s, t, graph.road() );
-    BOOST_ASSERT( found );
-}
-
-// Road2Transport
-Edge::Edge( const Multimodal::Graph& graph, const Road::Vertex& s,
-            PublicTransportGraphIndex pt_idx, const PublicTransport::Vertex& t ) :
-    source_( graph, s, Vertex::road_t() ), target_( graph, pt_idx, t )
-{
-    using boost::target;
-    const PublicTransport::Graph& pt_graph = graph.public_transport(pt_idx);
-    const PublicTransport::Stop& stop = pt_graph[t];
-    if ( stop.opposite_road_edge() && (s == target( stop.road_edge(), graph.road() )) ) {
-        road_edge_ = *stop.opposite_road_edge();
-    }
-    else {
-        road_edge_ = stop.road_edge();
-    }
-}
-
-// Road2Poi
-Edge::Edge( const Multimodal::Graph& graph, const Road::Vertex& s,
-            POIIndex idx, road2poi_t ) :
-    source_( graph, s, Vertex::road_t() ), target_( graph, idx, Vertex::poi_t() )
+Edge::Edge( const Multimodal::Graph& graph, const Vertex& s, const Vertex& t ) : source_( s ), target_( t )
 {
-    using boost::target;
-    const POI& poi = graph.poi(idx);
-    if ( poi.opposite_road_edge() && s == target( poi.road_edge(), graph.road() ) ) {
-        road_edge_ = *poi.opposite_road_edge();
-    }
-    else {
-        road_edge_ = poi.road_edge();
-    }
-}
-
-// Transport2Road
-Edge::Edge( const Multimodal::Graph& graph, PublicTransportGraphIndex pt_idx, const PublicTransport::Vertex& s,
-            const Road::Vertex& t ) :
-    source_( graph, pt_idx, s), target_( graph, t, Vertex::road_t() )
-{
-    using boost::source;
-    const PublicTransport::Graph& pt_graph = graph.public_transport(pt_idx);
-    const PublicTransport::Stop& stop = pt_graph[s];
-    if ( stop.opposite_road_edge() && t == source( stop.road_edge(), graph.road() ) ) {
-        road_edge_ = *stop.opposite_road_edge();
-    }
-    else {
-        road_edge_ = stop.road_edge();
-    }
-}
-
-// Transport2Transport
-Edge::Edge( const Multimodal::Graph& graph, PublicTransportGraphIndex pt_idx, const PublicTransport::Vertex& s, const PublicTransport::Vertex& t ) :
-    source_( graph, pt_idx, s ), target_( graph, pt_idx, t )
-{
-    const PublicTransport::Graph& pt_graph = graph.public_transport(pt_idx);
-    BOOST_ASSERT( edge( s, t, pt_graph ).second );
-    // arbitrary direction
-    road_edge_ = pt_graph[s].road_edge();
-}
-
-// Poi2Road
-Edge::Edge( const Multimodal::Graph& graph, POIIndex s,
-            const Road::Vertex& t, poi2road_t ) :
-    source_( graph, s, Vertex::poi_t() ), target_( graph, t, Vertex::road_t() )
-{
-    using boost::source;
-    const POI& poi = graph.poi(s);
-    if ( poi.opposite_road_edge() && t == source( poi.road_edge(), graph.road() ) ) {
-        road_edge_ = *poi.opposite_road_edge();
-    }
-    else {
-        road_edge_ = poi.road_edge();
-    }
-}
+    BOOST_ASSERT( connection_type() != UnknownConnection );
 
-Edge::Edge( const Multimodal::Graph& graph, const Vertex& s, const Vertex& t )
-{
-    using boost::target;
-    using boost::source;
-    using boost::edge;
-    BOOST_ASSERT( (s.type() == Vertex::Road && t.type() == Vertex::Road) ||
-                  (s.type() == Vertex::Road && t.type() == Vertex::PublicTransport) ||
-                  (s.type() == Vertex::PublicTransport && t.type() == Vertex::Road) ||
-                  (s.type() == Vertex::PublicTransport && t.type() == Vertex::PublicTransport) ||
-                  (s.type() == Vertex::Road && t.type() == Vertex::Poi) ||
-                  (s.type() == Vertex::Poi && t.type() == Vertex::Road) );
-
-    source_ = s;
-    target_ = t;
-    if ( s.type() == Vertex::Road ) {
-        if ( t.type() == Vertex::Road ) {
-            bool found = false;
-            tie(road_edge_,found) = edge( s.road_vertex(), t.road_vertex(), graph.road() );
-            BOOST_ASSERT( found );
-        }
-        else if (t.type() == Vertex::PublicTransport ) {
-            const PublicTransport::Stop& stop = get_pt_stop( t );
-            if ( stop.opposite_road_edge() && s.road_vertex() == target( stop.road_edge(), graph.road() ) ) {
-                road_edge_ = *stop.opposite_road_edge();
-            }
-            else {
-                road_edge_ = stop.road_edge();
-            }
-        }
-        else if (t.type() == Vertex::Poi ) {
-            const POI* poi = t.poi();
-            if ( poi->opposite_road_edge() && s.road_vertex() == target( poi->road_edge(), graph.road() ) ) {
-                road_edge_ = *poi->opposite_road_edge();
-            }
-            else {
-                road_edge_ = poi->road_edge();
-            }
-        }
-    }
-    else if ( s.type() == Vertex::PublicTransport ) {
-        if ( t.type() == Vertex::Road ) {
-            const PublicTransport::Stop& stop = get_pt_stop( s );
-            if ( stop.opposite_road_edge() && t.road_vertex() == source( stop.road_edge(), graph.road() ) ) {
-                road_edge_ = *stop.opposite_road_edge();
-            }
-            else {
-                road_edge_ = stop.road_edge();
-            }
-        }
-        else if (t.type() == Vertex::PublicTransport ) {
-            BOOST_ASSERT( edge( s.pt_vertex(), t.pt_vertex(), *s.pt_graph() ).second );
-            // arbitrary direction
-            road_edge_ = (*s.pt_graph())[s.pt_vertex()].road_edge();
-        }
+    const Road::Graph& road = graph.road();
+    switch ( connection_type() ) {
+    case Road2Road: {
+        bool found = false;
+        tie( road_edge_, found ) = edge( s.road_vertex(), t.road_vertex(), road );
+        BOOST_ASSERT( found );
+        break;
     }
-    else if ( s.type() == Vertex::Poi ) {
-        const POI& poi = *s.poi();
-        if ( t.type() == Vertex::Road ) {
-            if ( poi.opposite_road_edge() && t.road_vertex() == source( poi.road_edge(), graph.road() ) ) {
-                road_edge_ = *poi.opposite_road_edge();
-            }
-            else {
-                road_edge_ = poi.road_edge();
-            }
-        }
+    case Road2Transport:
+        road_edge_ = road_edge_to_object( road, s.road_vertex(), get_pt_stop( t, graph ) );
+        break;
+    case Road2Poi:
+        road_edge_ = road_edge_to_object( road, s.road_vertex(), *t.poi( graph ) );
+        break;
+    case Transport2Road:
+        road_edge_ = road_edge_from_object( road, get_pt_stop( s, graph ), t.road_vertex() );
+        break;
+    case Transport2Transport:
+        BOOST_ASSERT( edge( s.pt_vertex(), t.pt_vertex(), *s.pt_graph( graph ) ).second );
+        // arbitrary direction
+        road_edge_ = get_pt_stop( s, graph ).road_edge();
+        break;
+    case Poi2Road:
+        road_edge_ = road_edge_from_object( road, *s.poi( graph ), t.road_vertex() );
+        break;
+    case UnknownConnection:
+        break;
     }
 }
 
@@ -539,349 +333,6 @@ bool EdgeIterator::equal( const EdgeIterator& v ) const
     return v.vi_ == v.vi_end_;
 }
 
-OutEdgeIterator::OutEdgeIterator( const Multimodal::Graph& graph, Multimodal::Vertex source )
-{
-    graph_ = &graph;
-    source_ = source;
-
-    if ( source.type() == Vertex::Road ) {
-        boost::tie( road_it_, road_it_end_ ) = boost::out_edges( source.road_vertex(), graph_->road() );
-    }
-    else if ( source.type() == Vertex::PublicTransport ) {
-        boost::tie( pt_it_, pt_it_end_ ) = boost::out_edges( source.pt_vertex(), *source.pt_graph() );
-    }
-
-    stop2road_connection_ = 0;
-    road2stop_connection_ = 0;
-    road2poi_connection_ = 0;
-    poi2road_connection_ = 0;
-}
-
-void OutEdgeIterator::to_end()
-{
-    pt_it_ = pt_it_end_;
-    road_it_ = road_it_end_;
-    stop2road_connection_ = 2;
-    road2stop_connection_ = -1;
-    road2poi_connection_ = -1;
-    poi2road_connection_ = 2;
-}
-
-Multimodal::Edge OutEdgeIterator::dereference() const
-{
-    Multimodal::Edge edge;
-    BOOST_ASSERT( graph_ != 0 );
-
-    if ( source_.type() == Vertex::Road ) {
-        BOOST_ASSERT( road_it_ != road_it_end_ );
-        Road::Vertex r_target = boost::target( *road_it_, graph_->road() );
-
-        if ( road2stop_connection_ >= 0 && ( size_t )road2stop_connection_ < graph_->edge_stops( *road_it_ ).size() ) {
-            size_t idx = road2stop_connection_;
-            Multimodal::Graph::StopIndex stop = graph_->edge_stops( *road_it_ )[ idx ];
-            edge = Multimodal::Edge( *graph_, source_.road_vertex(), stop.graph(), stop.vertex() );
-        }
-        else if ( road2poi_connection_ >= 0 && ( size_t )road2poi_connection_ < graph_->edge_pois( *road_it_ ).size() ) {
-            size_t idx = road2poi_connection_;
-            POIIndex poi = graph_->edge_pois( *road_it_ )[ idx ];
-            edge = Multimodal::Edge( *graph_, source_.road_vertex(), poi, Multimodal::Edge::road2poi_t() );
-        }
-        else {
-            edge = Multimodal::Edge( *graph_, source_.road_vertex(), r_target, Multimodal::Edge::road2road_t() );
-        }
-    }
-    else if ( source_.type() == Vertex::PublicTransport ) {
-        PublicTransportGraphIndex pt_graph = source_.pt_graph_idx();
-        PublicTransport::Vertex r_source = source_.pt_vertex();
-        const PublicTransport::Stop& stop = get_pt_stop(source_);
-
-        if ( stop2road_connection_ == 0 ) {
-            edge = Multimodal::Edge( *graph_, pt_graph, r_source, target( stop.road_edge(), graph_->road() ) );
-        }
-        // if there is an opposite road edge attached
-        else if ( stop2road_connection_ == 1 && stop.opposite_road_edge() ) {
-            edge = Multimodal::Edge( *graph_, pt_graph, r_source, target( *stop.opposite_road_edge(), graph_->road() ) );
-        }
-        else {
-            PublicTransport::Vertex r_target = boost::target( *pt_it_, graph_->public_transport(pt_graph) );
-            edge = Multimodal::Edge( *graph_, pt_graph, r_source, r_target );
-        }
-    }
-    else if ( source_.type() == Vertex::Poi ) {
-        const POI& poi = *source_.poi();
-        if ( poi2road_connection_ == 0 ) {
-            edge = Multimodal::Edge( *graph_, source_.poi_idx(), boost::target( poi.road_edge(), graph_->road() ), Multimodal::Edge::poi2road_t() );
-        }
-        // if there is an opposite road edge attached
-        else if ( poi2road_connection_ == 1 &&
-                  poi.opposite_road_edge() ) {
-            edge = Multimodal::Edge( *graph_, source_.poi_idx(), boost::target( *poi.opposite_road_edge(), graph_->road() ), Multimodal::Edge::poi2road_t() );
-        }
-    }
-
-    return edge;
-}
-
-void OutEdgeIterator::increment()
-{
-    BOOST_ASSERT( graph_ != 0 );
-
-    if ( source_.type() == Vertex::Road ) {
-        if ( road2stop_connection_ >= 0 && ( size_t )road2stop_connection_ < graph_->edge_stops( *road_it_ ).size() ) {
-            road2stop_connection_++;
-        }
-        else if ( road2poi_connection_ >= 0 && ( size_t )road2poi_connection_ < graph_->edge_pois( *road_it_ ).size() ) {
-            road2poi_connection_++;
-        }
-        else {
-            road2stop_connection_ = 0;
-            road2poi_connection_ = 0;
-            road_it_++;
-        }
-    }
-    else if ( source_.type() == Vertex::PublicTransport ) {
-        const PublicTransport::Stop& stop = get_pt_stop(source_);
-
-        if ( stop2road_connection_ == 0 ) {
-            // if there is an opposite edge
-            if ( stop.opposite_road_edge() ) {
-                stop2road_connection_ ++;
-            }
-            // else, step to 2
-            else {
-                stop2road_connection_ = 2;
-            }
-        }
-        else if ( stop2road_connection_ == 1 ) {
-            stop2road_connection_ ++;
-        }
-        else {
-            bool is_at_pt_end = ( pt_it_ == pt_it_end_ );
-
-            if ( !is_at_pt_end ) {
-                pt_it_++;
-            }
-        }
-    }
-    else if ( source_.type() == Vertex::Poi ) {
-        if ( poi2road_connection_ == 0 ) {
-            // if there is an opposite edge
-            if ( source_.poi()->opposite_road_edge() ) {
-                poi2road_connection_ ++;
-            }
-            else {
-                poi2road_connection_ = 2;
-            }
-        }
-        else if ( poi2road_connection_ == 1 ) {
-            poi2road_connection_ ++;
-        }
-    }
-}
-
-bool OutEdgeIterator::equal( const OutEdgeIterator& v ) const
-{
-    // not the same road graph
-    if ( graph_ != v.graph_ ) {
-        return false;
-    }
-
-    if ( source_ != v.source_ ) {
-        return false;
-    }
-
-    if ( source_.type() == Vertex::Road ) {
-        if ( road_it_ == road_it_end_ ) {
-            return v.road_it_ == v.road_it_end_;
-        }
-
-        return road_it_ == v.road_it_ && road2stop_connection_ == v.road2stop_connection_ && road2poi_connection_ == v.road2poi_connection_;
-    }
-
-    if ( source_.type() == Vertex::PublicTransport ) {
-        if ( stop2road_connection_ != v.stop2road_connection_ ) {
-            return false;
-        }
-
-        return pt_it_ == v.pt_it_;
-    }
-
-    // else
-    return poi2road_connection_ == v.poi2road_connection_;
-}
-
-
-InEdgeIterator::InEdgeIterator( const Multimodal::Graph& graph, Multimodal::Vertex source )
-{
-    graph_ = &graph;
-    source_ = source;
-
-    if ( source.type() == Vertex::Road ) {
-        boost::tie( road_it_, road_it_end_ ) = boost::in_edges( source.road_vertex(), graph_->road() );
-    }
-    else if ( source.type() == Vertex::PublicTransport ) {
-        boost::tie( pt_it_, pt_it_end_ ) = boost::in_edges( source.pt_vertex(), *source.pt_graph() );
-    }
-
-    stop_from_road_connection_ = 0;
-    road_from_stop_connection_ = 0;
-    road_from_poi_connection_ = 0;
-    poi_from_road_connection_ = 0;
-}
-
-void InEdgeIterator::to_end()
-{
-    pt_it_ = pt_it_end_;
-    road_it_ = road_it_end_;
-    stop_from_road_connection_ = 2;
-    road_from_stop_connection_ = -1;
-    road_from_poi_connection_ = -1;
-    poi_from_road_connection_ = 2;
-}
-
-Multimodal::Edge InEdgeIterator::dereference() const
-{
-    Multimodal::Edge edge;
-    BOOST_ASSERT( graph_ != 0 );
-
-    if ( source_.type() == Vertex::Road ) {
-        BOOST_ASSERT( road_it_ != road_it_end_ );
-
-        if ( road_from_stop_connection_ >= 0 && ( size_t )road_from_stop_connection_ < graph_->edge_stops( *road_it_ ).size() ) {
-            size_t idx = road_from_stop_connection_;
-            Multimodal::Graph::StopIndex stop = graph_->edge_stops( *road_it_ )[ idx ];
-            edge = Multimodal::Edge( *graph_, stop.graph(), stop.vertex(), source_.road_vertex() );
-        }
-        else if ( road_from_poi_connection_ >= 0 && ( size_t )road_from_poi_connection_ < graph_->edge_pois( *road_it_ ).size() ) {
-            size_t idx = road_from_poi_connection_;
-            POIIndex poi_idx = graph_->edge_pois( *road_it_ )[ idx ];
-            edge = Multimodal::Edge( *graph_, poi_idx, source_.road_vertex(), Multimodal::Edge::poi2road_t() );
-        }
-        else {
-            Road::Vertex r_source = source( *road_it_, graph_->road() );
-            edge = Multimodal::Edge( *graph_, r_source, source_.road_vertex(), Multimodal::Edge::road2road_t() );
-        }
-    }
-    else if ( source_.type() == Vertex::PublicTransport ) {
-        PublicTransport::Vertex r_source = source_.pt_vertex();
-        const PublicTransport::Stop& stop = get_pt_stop(source_);
-
-        if ( stop_from_road_connection_ == 0 ) {
-            edge = Multimodal::Edge( *graph_, source( stop.road_edge(), graph_->road() ), source_.pt_graph_idx(), r_source );
-        }
-        // if there is an opposite road edge attached
-        else if ( stop_from_road_connection_ == 1 && stop.opposite_road_edge() ) {
-            edge = Multimodal::Edge( *graph_, source( *stop.opposite_road_edge(), graph_->road() ), source_.pt_graph_idx(), r_source );
-        }
-        else {
-            PublicTransport::Vertex r_target = source( *pt_it_, *source_.pt_graph() );
-            edge = Multimodal::Edge( *graph_, source_.pt_graph_idx(), r_target, r_source );
-        }
-    }
-    else if ( source_.type() == Vertex::Poi ) {
-        if ( poi_from_road_connection_ == 0 ) {
-            edge = Multimodal::Edge( *graph_, source( source_.poi()->road_edge(), graph_->road() ), source_.poi_idx(), Multimodal::Edge::road2poi_t() );
-        }
-        // if there is an opposite road edge attached
-        else if ( poi_from_road_connection_ == 1 &&
-                  source_.poi()->opposite_road_edge() ) {
-            edge = Multimodal::Edge( *graph_, source( *source_.poi()->opposite_road_edge(), graph_->road() ), source_.poi_idx(), Multimodal::Edge::road2poi_t() );
-        }
-    }
-
-    return edge;
-}
-
-void InEdgeIterator::increment()
-{
-    BOOST_ASSERT( graph_ != 0 );
-
-    if ( source_.type() == Vertex::Road ) {
-        if ( road_from_stop_connection_ >= 0 && ( size_t )road_from_stop_connection_ < graph_->edge_stops( *road_it_ ).size() ) {
-            road_from_stop_connection_++;
-        }
-        else if ( road_from_poi_connection_ >= 0 && ( size_t )road_from_poi_connection_ < graph_->edge_pois( *road_it_ ).size() ) {
-            road_from_poi_connection_++;
-        }
-        else {
-            road_from_stop_connection_ = 0;
-            road_from_poi_connection_ = 0;
-            road_it_++;
-        }
-    }
-    else if ( source_.type() == Vertex::PublicTransport ) {
-        const PublicTransport::Graph* pt_graph = source_.pt_graph();
-        PublicTransport::Vertex r_source = source_.pt_vertex();
-        const PublicTransport::Stop *stop = &(*pt_graph)[r_source];
-
-        if ( stop_from_road_connection_ == 0 ) {
-            // if there is an opposite edge
-            if ( stop->opposite_road_edge() ) {
-                stop_from_road_connection_ ++;
-            }
-            // else, step to 2
-            else {
-                stop_from_road_connection_ = 2;
-            }
-        }
-        else if ( stop_from_road_connection_ == 1 ) {
-            stop_from_road_connection_ ++;
-        }
-        else {
-            bool is_at_pt_end = ( pt_it_ == pt_it_end_ );
-
-            if ( !is_at_pt_end ) {
-                pt_it_++;
-            }
-        }
-    }
-    else if ( source_.type() == Vertex::Poi ) {
-        if ( poi_from_road_connection_ == 0 ) {
-            // if there is an opposite edge
-            if ( source_.poi()->opposite_road_edge() ) {
-                poi_from_road_connection_ ++;
-            }
-            else {
-                poi_from_road_connection_ = 2;
-            }
-        }
-        else if ( poi_from_road_connection_ == 1 ) {
-            poi_from_road_connection_ ++;
-        }
-    }
-}
-
-bool InEdgeIterator::equal( const InEdgeIterator& v ) const
-{
-    // not the same road graph
-    if ( graph_ != v.graph_ ) {
-        return false;
-    }
-
-    if ( source_ != v.source_ ) {
-        return false;
-    }
-
-    if ( source_.type() == Vertex::Road ) {
-        if ( road_it_ == road_it_end_ ) {
-            return v.road_it_ == v.road_it_end_;
-        }
-
-        return road_it_ == v.road_it_ && road_from_stop_connection_ == v.road_from_stop_connection_ && road_from_poi_connection_ == v.road_from_poi_connection_;
-    }
-
-    if ( source_.type() == Vertex::PublicTransport ) {
-        if ( stop_from_road_connection_ != v.stop_from_road_connection_ ) {
-            return false;
-        }
-
-        return pt_it_ == v.pt_it_;
-    }
-
-    // else
-    return poi_from_road_connection_ == v.poi_from_road_connection_;
-}
-
 VertexIndexProperty get( boost::vertex_index_t, const Multimodal::Graph& graph )
 {
     return VertexIndexProperty( graph );
@@ -892,19 +343,31 @@ size_t get( const VertexIndexProperty& p, const Multimodal::Vertex& v )
     return p.get_index( v );
 }
 
-size_t VertexIndexProperty::get_index( const Vertex& v ) const
+VertexIndexProperty::VertexIndexProperty( const Graph& graph ) : graph_( graph )
 {
-    // Maps a vertex to an integer in (0, num_vertices-1).
-    //
     // If the vertex is a road vertex, maps it to its vertex_index in the road graph
     // If it is a public transport vertex, maps it to its vertex_index in the pt graph
     // and adds the number of vertices of the road graph and all the preceding public transport
     // graphs.
     // If it is a poi, maps it to its vertex index + the sum of num_vertices for all previous graphs.
-    //
-    // The complexity is then not constant (linear in terms of number of public transports graphs and pois).
-
+    size_t n = num_vertices( graph_.road() );
+    std::vector<std::pair<PublicTransportGraphIndex, size_t>> offsets;
+    for ( auto it : graph_.public_transports() ) {
+        offsets.push_back( std::make_pair( graph_.public_transport_index( it.first ).get(), n ) );
+        n += num_vertices( *it.second );
+    }
+    poi_offset_ = n;
+    for ( const auto& p : offsets ) {
+        if ( p.first >= pt_offsets_.size() ) {
+            pt_offsets_.resize( p.first + 1, poi_offset_ );
+        }
+        pt_offsets_[p.first] = p.second;
+    }
+}
 
+size_t VertexIndexProperty::get_index( const Vertex& v ) const
+{
+    // Maps a vertex to an integer in (0, num_vertices-1), in constant time
     switch (v.type()) {
     case Vertex::Null:
         return 0;
@@ -913,29 +376,16 @@ size_t VertexIndexProperty::get_index( const Vertex& v ) const
     }
 
     case Vertex::PublicTransport: {
-        size_t n = num_vertices( graph_.road() );
-
-        for ( auto it : graph_.public_transports() ) {
-            if ( it.second != v.pt_graph() ) {
-                n += num_vertices( *it.second );
-            }
-            else {
-                n += boost::get( boost::get( boost::vertex_index, *v.pt_graph() ), v.pt_vertex() );
-                break;
-            }
+        const PublicTransportGraphIndex idx = v.pt_graph_idx();
+        if ( idx >= pt_offsets_.size() || pt_offsets_[idx] == poi_offset_ ) {
+            // not a selected public transport graph
+            return poi_offset_;
         }
-        return n;
+        return pt_offsets_[idx] + boost::get( boost::get( boost::vertex_index, *v.pt_graph( graph_ ) ), v.pt_vertex() );
     }
 
     case Vertex::Poi: {
-        size_t n = num_vertices( graph_.road() );
-
-        for ( auto it : graph_.public_transports() ) {
-            n += num_vertices( *it.second );
-        }
-
-        n += v.poi_idx();
-        return n;
+        return poi_offset_ + v.poi_idx();
     }
     }
 
@@ -988,72 +438,30 @@ pair<EdgeIterator, EdgeIterator> edges( const Graph& graph )
 
 pair<OutEdgeIterator, OutEdgeIterator> out_edges( const Vertex& v, const Graph& graph )
 {
-    OutEdgeIterator v_begin( graph, v ), v_end( graph, v );
-    v_end.to_end();
-    return std::make_pair( v_begin, v_end );
+    const Graph::AdjacentEdge *begin, *end;
+    boost::tie( begin, end ) = graph.out_adjacency( graph.adjacency_index( v ) );
+    return std::make_pair( OutEdgeIterator( v, begin ), OutEdgeIterator( v, end ) );
 }
 
 pair<InEdgeIterator, InEdgeIterator> in_edges( const Vertex& v, const Graph& graph )
 {
-    InEdgeIterator v_begin( graph, v ), v_end( graph, v );
-    v_end.to_end();
-    return std::make_pair( v_begin, v_end );
+    const Graph::AdjacentEdge *begin, *end;
+    boost::tie( begin, end ) = graph.in_adjacency( graph.adjacency_index( v ) );
+    return std::make_pair( InEdgeIterator( v, begin ), InEdgeIterator( v, end ) );
 }
 
 size_t out_degree( const Vertex& v, const Graph& graph )
 {
-    if ( v.type() == Vertex::Road ) {
-        size_t sum = 0;
-        Road::OutEdgeIterator ei, ei_end;
-
-        //
-        // For each out edge of the vertex, we have access to
-        // N stops (given by stops.size())
-        // M POis (given by pois.size())
-        // the out edge (+1)
-        for ( boost::tie( ei, ei_end ) = out_edges( v.road_vertex(), graph.road() ); ei != ei_end; ei++ ) {
-            sum += graph.edge_stops( *ei ).size() + graph.edge_pois( *ei ).size() + 1;
-        }
-
-        return sum;
-    }
-    else if ( v.type() == Vertex::PublicTransport ) {
-        //
-        // For a PublicTransport::Vertex, we have access to 1 or 2 additional node (the road node)
-        return out_degree( v.pt_vertex(), *v.pt_graph() ) +
-            ( (*v.pt_graph())[v.pt_vertex()].opposite_road_edge() ? 2 : 1);
-    }
-
-    // else (Poi), 1 road node is reachable
-    return v.poi()->opposite_road_edge() ? 2 : 1;
+    const Graph::AdjacentEdge *begin, *end;
+    boost::tie( begin, end ) = graph.out_adjacency( graph.adjacency_index( v ) );
+    return end - begin;
 }
 
 size_t in_degree( const Vertex& v, const Graph& graph )
 {
-    if ( v.type() == Vertex::Road ) {
-        size_t sum = 0;
-        Road::InEdgeIterator ei, ei_end;
-
-        //
-        // For each in edge of the vertex, we have access to
-        // N stops (given by stops.size())
-        // M POis (given by pois.size())
-        // the out edge (+1)
-        for ( boost::tie( ei, ei_end ) = in_edges( v.road_vertex(), graph.road() ); ei != ei_end; ei++ ) {
-            sum += graph.edge_stops( *ei ).size() + graph.edge_pois( *ei ).size() + 1;
-        }
-
-        return sum;
-    }
-    else if ( v.type() == Vertex::PublicTransport ) {
-        //
-        // For a PublicTransport::Vertex, we have access to 1 or 2 additional node (the road node)
-        return in_degree( v.pt_vertex(), *v.pt_graph() ) +
-            ( (*v.pt_graph())[v.pt_vertex()].opposite_road_edge() ? 2 : 1);
-    }
-
-    // else (Poi), 1 road node is reachable
-    return v.poi()->opposite_road_edge() ? 2 : 1;
+    const Graph::AdjacentEdge *begin, *end;
+    boost::tie( begin, end ) = graph.in_adjacency( graph.adjacency_index( v ) );
+    return end - begin;
 }
 
 size_t degree( const Vertex& v, const Graph& graph )
@@ -1078,7 +486,7 @@ std::pair< Edge, bool> edge( const Vertex& u, const Vertex& v, const Graph& grap
     return std::make_pair( e, found );
 }
 
-std::pair<PublicTransport::Edge, bool> public_transport_edge( const Multimodal::Edge& e )
+std::pair<PublicTransport::Edge, bool> public_transport_edge( const Multimodal::Edge& e, const Multimodal::Graph& graph )
 {
     if ( e.connection_type() != Multimodal::Edge::Transport2Transport ) {
         return std::make_pair( PublicTransport::Edge(), false );
@@ -1086,7 +494,7 @@ std::pair<PublicTransport::Edge, bool> public_transport_edge( const Multimodal::
 
     PublicTransport::Edge ret_edge;
     bool found;
-    boost::tie( ret_edge, found ) = edge( e.source().pt_vertex(), e.target().pt_vertex(), *( e.source().pt_graph() ) );
+    boost::tie( ret_edge, found ) = edge( e.source().pt_vertex(), e.target().pt_vertex(), *( e.source().pt_graph( graph ) ) );
     return std::make_pair( ret_edge, found );
 }
 
@@ -1109,6 +517,7 @@ Road::Graph& Graph::road() {
 void Graph::set_road( std::unique_ptr<Road::Graph> r )
 {
     road_ = std::move(r);
+    clear_adjacency();
 
     road_vertex_map_.clear();
     road_edge_map_.clear();
@@ -1154,6 +563,7 @@ void Graph::set_public_transports( std::map<db_id_t, std::unique_ptr<PublicTrans
     public_transport_graph_idx_map_.clear();
     public_transport_graph_ridx_map_.clear();
     public_transport_graphs_.clear();
+    clear_adjacency();
     // move
 
     size_t n_graphs = nmap.size();
@@ -1187,6 +597,7 @@ void Graph::set_pois( std::vector<POI>&& v )
 {
     pois_ = v;
     poi_index_map_.clear();
+    clear_adjacency();
     POIIndex idx = 0;
     for ( auto p : pois_ ) {
         poi_index_map_[p.db_id()] = idx;
@@ -1196,6 +607,7 @@ void Graph::set_pois( std::vector<POI>&& v )
 
 void Graph::add_poi_ref( const Road::Edge& e, POIIndex idx )
 {
+    clear_adjacency();
     auto it = road_edge_pois_.find(e);
     if ( it == road_edge_pois_.end() ) {
         std::vector<POIIndex> v(1);
@@ -1237,6 +649,7 @@ const Graph::EdgePois& Graph::edge_pois( const Road::Edge& e ) const
 
 void Graph::add_stop_ref( const Road::Edge& e, const PublicTransportGraphIndex& idx, const PublicTransport::Vertex& vertex )
 {
+    clear_adjacency();
     auto it = road_edge_stops_.find(e);
     if ( it == road_edge_stops_.end() ) {
         EdgeStops v;
@@ -1257,6 +670,163 @@ const Graph::EdgeStops& Graph::edge_stops( const Road::Edge& e ) const
     return it->second;
 }
 
+void Graph::clear_adjacency()
+{
+    pt_adjacency_offsets_.clear();
+    out_offsets_.clear();
+    in_offsets_.clear();
+    out_adjacency_.clear();
+    in_adjacency_.clear();
+}
+
+void Graph::build_adjacency()
+{
+    clear_adjacency();
+    if ( !road_ ) {
+        return;
+    }
+    const Road::Graph& rg = *road_;
+
+    size_t n = num_vertices( rg );
+    for ( const auto& g : public_transport_graphs_ ) {
+        pt_adjacency_offsets_.push_back( n );
+        n += num_vertices( *g );
+    }
+    pt_adjacency_offsets_.push_back( n );
+    n += pois_.size();
+    if ( n >= std::numeric_limits<uint32_t>::max() ) {
+        throw std::runtime_error( "Too many vertices in the multimodal graph" );
+    }
+
+    out_offsets_.reserve( n + 1 );
+    in_offsets_.reserve( n + 1 );
+    out_offsets_.push_back( 0 );
+    in_offsets_.push_back( 0 );
+
+    auto add_out = [this]( const Vertex& v, const Road::Edge& e ) {
+        AdjacentEdge a = { v, e };
+        out_adjacency_.push_back( a );
+    };
+    auto add_in = [this]( const Vertex& v, const Road::Edge& e ) {
+        AdjacentEdge a = { v, e };
+        in_adjacency_.push_back( a );
+    };
+    auto road_vertex = []( Road::Vertex v ) {
+        return Vertex( v, Vertex::road_t() );
+    };
+
+    // Road vertices
+    // For each out edge, stops and POIs on the road edge are reachable, then the target road vertex
+    Road::VertexIterator vi, vi_end;
+    for ( boost::tie( vi, vi_end ) = vertices( rg ); vi != vi_end; vi++ ) {
+        Road::OutEdgeIterator oei, oei_end;
+        for ( boost::tie( oei, oei_end ) = out_edges( *vi, rg ); oei != oei_end; oei++ ) {
+            for ( const StopIndex& stop : edge_stops( *oei ) ) {
+                const PublicTransport::Stop& s = (*public_transport_graphs_[stop.graph()])[stop.vertex()];
+                add_out( Vertex( stop.graph(), stop.vertex() ), road_edge_to_object( rg, *vi, s ) );
+            }
+            for ( POIIndex poi : edge_pois( *oei ) ) {
+                add_out( Vertex( poi, Vertex::poi_t() ), road_edge_to_object( rg, *vi, pois_[poi] ) );
+            }
+            add_out( road_vertex( target( *oei, rg ) ), *oei );
+        }
+        out_offsets_.push_back( out_adjacency_.size() );
+
+        Road::InEdgeIterator iei, iei_end;
+        for ( boost::tie( iei, iei_end ) = in_edges( *vi, rg ); iei != iei_end; iei++ ) {
+            for ( const StopIndex& stop : edge_stops( *iei ) ) {
+                const PublicTransport::Stop& s = (*public_transport_graphs_[stop.graph()])[stop.vertex()];
+                add_in( Vertex( stop.graph(), stop.vertex() ), road_edge_from_object( rg, s, *vi ) );
+            }
+            for ( POIIndex poi : edge_pois( *iei ) ) {
+                add_in( Vertex( poi, Vertex::poi_t() ), road_edge_from_object( rg, pois_[poi], *vi ) );
+            }
+            add_in( road_vertex( source( *iei, rg ) ), *iei );
+        }
+        in_offsets_.push_back( in_adjacency_.size() );
+    }
+
+    // Public transport vertices
+    // A stop is connected to the ends of its road edge, then to other stops
+    for ( size_t k = 0; k < public_transport_graphs_.size(); k++ ) {
+        const PublicTransport::Graph& pg = *public_transport_graphs_[k];
+        const PublicTransportGraphIndex idx = PublicTransportGraphIndex( k );
+        PublicTransport::VertexIterator pvi, pvi_end;
+        for ( boost::tie( pvi, pvi_end ) = vertices( pg ); pvi != pvi_end; pvi++ ) {
+            const PublicTransport::Stop& stop = pg[*pvi];
+
+            Road::Vertex t = target( stop.road_edge(), rg );
+            add_out( road_vertex( t ), road_edge_from_object( rg, stop, t ) );
+            if ( stop.opposite_road_edge() ) {
+                t = target( *stop.opposite_road_edge(), rg );
+                add_out( road_vertex( t ), road_edge_from_object( rg, stop, t ) );
+            }
+            PublicTransport::OutEdgeIterator oei, oei_end;
+            for ( boost::tie( oei, oei_end ) = out_edges( *pvi, pg ); oei != oei_end; oei++ ) {
+                // arbitrary direction
+                add_out( Vertex( idx, target( *oei, pg ) ), stop.road_edge() );
+            }
+            out_offsets_.push_back( out_adjacency_.size() );
+
+            Road::Vertex s = source( stop.road_edge(), rg );
+            add_in( road_vertex( s ), road_edge_to_object( rg, s, stop ) );
+            if ( stop.opposite_road_edge() ) {
+                s = source( *stop.opposite_road_edge(), rg );
+                add_in( road_vertex( s ), road_edge_to_object( rg, s, stop ) );
+            }
+            PublicTransport::InEdgeIterator iei, iei_end;
+            for ( boost::tie( iei, iei_end ) = in_edges( *pvi, pg ); iei != iei_end; iei++ ) {
+                const PublicTransport::Vertex ps = source( *iei, pg );
+                add_in( Vertex( idx, ps ), pg[ps].road_edge() );
+            }
+            in_offsets_.push_back( in_adjacency_.size() );
+        }
+    }
+
+    // POIs
+    // A POI is connected to the ends of its road edge
+    for ( const POI& poi : pois_ ) {
+        Road::Vertex t = target( poi.road_edge(), rg );
+        add_out( road_vertex( t ), road_edge_from_object( rg, poi, t ) );
+        if ( poi.opposite_road_edge() ) {
+            t = target( *poi.opposite_road_edge(), rg );
+            add_out( road_vertex( t ), road_edge_from_object( rg, poi, t ) );
+        }
+        out_offsets_.push_back( out_adjacency_.size() );
+
+        Road::Vertex s = source( poi.road_edge(), rg );
+        add_in( road_vertex( s ), road_edge_to_object( rg, s, poi ) );
+        if ( poi.opposite_road_edge() ) {
+            s = source( *poi.opposite_road_edge(), rg );
+            add_in( road_vertex( s ), road_edge_to_object( rg, s, poi ) );
+        }
+        in_offsets_.push_back( in_adjacency_.size() );
+    }
+
+    if ( out_adjacency_.size() >= std::numeric_limits<uint32_t>::max() ||
+         in_adjacency_.size() >= std::numeric_limits<uint32_t>::max() ) {
+        throw std::runtime_error( "Too many edges in the multimodal graph" );
+    }
+    out_adjacency_.shrink_to_fit();
+    in_adjacency_.shrink_to_fit();
+}
+
+uint32_t Graph::adjacency_index( const Vertex& v ) const
+{
+    BOOST_ASSERT( !pt_adjacency_offsets_.empty() );
+    switch ( v.type() ) {
+    case Vertex::Road:
+        return uint32_t( v.road_vertex() );
+    case Vertex::PublicTransport:
+        return uint32_t( pt_adjacency_offsets_[v.pt_graph_idx()] + v.pt_vertex() );
+    case Vertex::Poi:
+        return pt_adjacency_offsets_.back() + v.poi_idx();
+    case Vertex::Null:
+        break;
+    }
+    return 0;
+}
+
 boost::optional<Road::Vertex> Graph::road_vertex_from_id( db_id_t id ) const
 {
     auto it = road_vertex_map_.find( id );
@@ -1277,14 +847,15 @@ boost::optional<Road::Edge> Graph::road_edge_from_id( db_id_t id ) const
 
 ostream& operator<<( ostream& out, const Multimodal::Vertex& v )
 {
+    // vertices do not know their graph, indices are printed instead of database ids
     if ( v.type() == Multimodal::Vertex::Road ) {
-        out << "R" << v.graph()->road()[v.road_vertex()].db_id();
+        out << "R#" << v.road_vertex();
     }
     else if ( v.type() == Multimodal::Vertex::PublicTransport ) {
-        out << "PT" << ( *v.pt_graph() )[v.pt_vertex()].db_id();
+        out << "PT#" << v.pt_graph_idx() << ":" << v.pt_vertex();
     }
     else if ( v.type() == Multimodal::Vertex::Poi ) {
-        out << "POI" << v.poi()->db_id();
+        out << "POI#" << v.poi_idx();
     }
 
     return out;
@@ -1327,55 +898,13 @@ std::ostream& operator<<( std::ostream& ostr, const Multimodal::VertexIterator&
 
 std::ostream& operator<<( std::ostream& ostr, const Multimodal::OutEdgeIterator& it )
 {
-    ostr << "out_edge_iterator{ source(" << it.source_ << "), graph(" << it.graph_;
-    ostr << "), road_it(";
-
-    if ( it.road_it_ == it.road_it_end_ ) {
-        ostr << "-END-";
-    }
-    else {
-        ostr << *it.road_it_;
-    }
-
-    ostr << "), pt_it(";
-
-    if ( it.pt_it_ == it.pt_it_end_ ) {
-        ostr << "-END-";
-    }
-    else {
-        ostr << *it.pt_it_;
-    }
-
-    ostr << "), stop2road(" << it.stop2road_connection_ << "), road2stop(" << it.road2stop_connection_;
-    ostr << "), poi2road(" << it.poi2road_connection_ << "), road2poi(" << it.road2poi_connection_;
-    ostr << ")}" ;
+    ostr << "out_edge_iterator{ source(" << it.source_ << "), edge(" << it.it_ << ")}";
     return ostr;
 }
 
 std::ostream& operator<<( std::ostream& ostr, const Multimodal::InEdgeIterator& it )
 {
-    ostr << "in_edge_iterator{ source(" << it.source_ << "), graph(" << it.graph_;
-    ostr << "), road_it(";
-
-    if ( it.road_it_ == it.road_it_end_ ) {
-        ostr << "-END-";
-    }
-    else {
-        ostr << *it.road_it_;
-    }
-
-    ostr << "), pt_it(";
-
-    if ( it.pt_it_ == it.pt_it_end_ ) {
-        ostr << "-END-";
-    }
-    else {
-        ostr << *it.pt_it_;
-    }
-
-    ostr << "), stop_from_road(" << it.stop_from_road_connection_ << "), road_from_stop(" << it.road_from_stop_connection_;
-    ostr << "), poi_from_road(" << it.poi_from_road_connection_ << "), road_from_poi(" << it.road_from_poi_connection_;
-    ostr << ")}" ;
+    ostr << "in_edge_iterator{ target(" << it.target_ << "), edge(" << it.it_ << ")}";
     return ostr;
 }
 
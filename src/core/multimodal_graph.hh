@@ -65,89 +65,42 @@ namespace Multimodal {
 
 struct Graph;
 
-class VertexIndexProperty;
 ///
-/// A Multimodal::Vertex is either a Road::Vertex or PublicTransport::Vertex on a particular public transport network
+/// A Multimodal::Vertex is either a Road::Vertex, a PublicTransport::Vertex on a particular public transport network or a POI
+///
+/// It is packed in a 64-bit integer: the vertex type in the two upper bits, the public transport graph index
+/// in the bits 32 to 47 and the road vertex, public transport vertex or POI index in the lower 32 bits.
+/// Comparison and hashing work on this integer. Road vertices come first, then public transport vertices ordered
+/// by graph, then POIs.
+/// The graph is not stored in the vertex, methods that need it take it as parameter.
 struct Vertex {
 public:
     ///
     /// Comparison operator
-    inline bool operator==( const Vertex& v ) const {
-        switch ( type_ ) {
-        case Road:
-            return v.data_.vertex == data_.vertex;
-        case PublicTransport:
-            return v.data_.pt.index == data_.pt.index && v.data_.pt.vertex == data_.pt.vertex;
-        case Poi:
-            return v.data_.poi == data_.poi;
-        case Null:
-            return v.is_null();
-    }
-    return false;
-    }
+    bool operator==( const Vertex& v ) const { return bits_ == v.bits_; }
 
-    bool operator!=( const Vertex& v ) const { return !operator==( v ); }
+    bool operator!=( const Vertex& v ) const { return bits_ != v.bits_; }
 
-    inline bool operator<( const Vertex& v ) const {
-        // Critical code, called in many places. Each minor optimisation is a huge gain
-        if (type() != v.type()) {
-            return type() < v.type();
-        }
-        switch (type_)
-        {
-        case Road:
-            return data_.vertex < v.data_.vertex;
-        case PublicTransport:
-            return data_.pt.index != v.data_.pt.index ? data_.pt.index < v.data_.pt.index : data_.pt.vertex < v.data_.pt.vertex;
-        case Poi:
-            return data_.poi < v.data_.poi;
-        case Null:
-            return false;
-        }
-        return false;
-    }
+    bool operator<( const Vertex& v ) const { return bits_ < v.bits_; }
 
-    inline int cmp( const Vertex& v ) const {
-        if (type() != v.type()) {
-            return type() < v.type() ? -1 : 1;
-        }
-        switch (type_)
-        {
-        case Road:
-            if ( data_.vertex != v.data_.vertex ) {
-                return data_.vertex < v.data_.vertex ? -1 : 1;
-            }
-            break;
-        case PublicTransport:
-            if ( data_.pt.index != v.data_.pt.index ) {
-                return data_.pt.index < v.data_.pt.index ? -1 : 1;
-            }
-            if ( data_.pt.vertex != v.data_.pt.vertex ) {
-                return data_.pt.vertex < v.data_.pt.vertex ? -1 : 1;
-            }
-            break;
-        case Poi:
-            if ( data_.poi != v.data_.poi ) {
-                return data_.poi < v.data_.poi ? -1 : 1;
-            }
-        default:
-            break;
-        }
-        return 0;
-    }
+    int cmp( const Vertex& v ) const { return bits_ < v.bits_ ? -1 : ( bits_ == v.bits_ ? 0 : 1 ); }
 
     struct road_t {};
     struct pt_t {};
     struct poi_t {};
 
     /// A null vertex
-    Vertex();
+    Vertex() : bits_( 0 ) {}
     /// A road vertex
-    Vertex( const Graph&, Road::Vertex vertex, road_t );
+    Vertex( Road::Vertex vertex, road_t ) : bits_( ( uint64_t( Road ) << TYPE_SHIFT ) | uint32_t( vertex ) ) {}
     /// A public transport vertex
-    Vertex( const Graph&, PublicTransportGraphIndex idx, PublicTransport::Vertex vertex, pt_t = pt_t() );
+    Vertex( PublicTransportGraphIndex idx, PublicTransport::Vertex vertex, pt_t = pt_t() ) :
+        bits_( ( uint64_t( PublicTransport ) << TYPE_SHIFT ) | ( uint64_t( idx ) << PT_GRAPH_SHIFT ) | uint32_t( vertex ) )
+    {
+        BOOST_ASSERT( vertex <= INDEX_MASK );
+    }
     /// A POI vertex
-    Vertex( const Graph&, POIIndex, poi_t );
+    Vertex( POIIndex idx, poi_t ) : bits_( ( uint64_t( Poi ) << TYPE_SHIFT ) | idx ) {}
 
     enum VertexType {
         Null = 0,
@@ -155,51 +108,37 @@ public:
         PublicTransport, /// This vertex is a public transport stop
         Poi              /// This vertex is a POI
     };
-    VertexType type() const { return type_; }
-
-    bool is_null() const { return type_ == Null; }
+    VertexType type() const { return static_cast<VertexType>( bits_ >> TYPE_SHIFT ); }
 
-    /// Access to the underlying road graph
-    /// @returns the road graph or 0 if it's not a road vertex
-    const Graph* graph() const;
-    const Road::Graph* road_graph() const;
+    bool is_null() const { return bits_ == 0; }
 
     /// @returns the road vertex on the road graph if it's a road vertex
-    Road::Vertex road_vertex() const;
+    Road::Vertex road_vertex() const { return type() == Road ? Road::Vertex( bits_ & INDEX_MASK ) : Road::Vertex(); }
 
-    /// @returns the public transport graph or 0 if it's not a pt vertex
-    PublicTransportGraphIndex pt_graph_idx() const;
-    const PublicTransport::Graph* pt_graph() const;
+    /// @returns the public transport graph index, if it's a pt vertex
+    PublicTransportGraphIndex pt_graph_idx() const { return PublicTransportGraphIndex( bits_ >> PT_GRAPH_SHIFT ); }
+    /// @returns the public transport graph, if it's a pt vertex
+    const PublicTransport::Graph* pt_graph( const Graph& graph ) const;
 
     /// @returns the pt vertex on the pt graph if it's a pt vertex
-    PublicTransport::Vertex pt_vertex() const;
+    PublicTransport::Vertex pt_vertex() const { return PublicTransport::Vertex( bits_ & INDEX_MASK ); }
 
-    /// @returns the POI, if it's a POI, or 0
-    POIIndex poi_idx() const;
-    const POI* poi() const;
+    /// @returns the POI index, if it's a POI
+    POIIndex poi_idx() const { return POIIndex( bits_ & INDEX_MASK ); }
+    /// @returns the POI, if it's a POI
+    const POI* poi( const Graph& graph ) const;
 
     /// @returns the coordinates, whatever the vertex type
-    Point3D coordinates() const;
+    Point3D coordinates( const Graph& graph ) const;
 
     /// @returns a hash value of the vertex
-    size_t hash() const;
+    size_t hash() const { return std::hash<uint64_t>()( bits_ ); }
 private:
-    const Graph* graph_;
+    static const int TYPE_SHIFT = 62;
+    static const int PT_GRAPH_SHIFT = 32;
+    static const uint64_t INDEX_MASK = 0xffffffff;
 
-    union
-    {
-        Road::Vertex vertex;
-        struct
-        {
-            PublicTransportGraphIndex index;
-            PublicTransport::Vertex vertex;
-        } pt;
-        POIIndex poi;
-    } data_;
-
-    VertexType type_;
-
-    friend class VertexIndexProperty;
+    uint64_t bits_;
 };
 } // namespace Multimodal
 } // namespace Tempus
@@ -224,16 +163,16 @@ namespace Multimodal
 /// Convenience function - get a Road::Node out of a Vertex, if defined
 /// @returns the corresponding road node
 /// warning no check is done, could crash
-Road::Node get_road_node( const Vertex& v );
+const Road::Node& get_road_node( const Vertex& v, const Graph& graph );
 
 /// Convenience function - get a PublicTransport::Stop out of a Vertex, if defined
 /// @returns the corresponding public transport stop
 /// warning no check is done, could crash
-PublicTransport::Stop get_pt_stop( const Vertex& v );
+const PublicTransport::Stop& get_pt_stop( const Vertex& v, const Graph& graph );
 
 /// Convenience function
 /// Converts a Multimodal::Vertex to a MMVertex
-MMVertex get_mm_vertex( const Vertex& v );
+MMVertex get_mm_vertex( const Vertex& v, const Graph& graph );
 
 ///
 /// A multimodal edge is defined with :
@@ -262,39 +201,34 @@ struct Edge {
         Poi2Road
     };
     ///
-    /// Get the connection type of the edge
-    ConnectionType connection_type() const;
+    /// Get the connection type of the edge, from the types of its vertices
+    ConnectionType connection_type() const
+    {
+        static const ConnectionType types[4][4] = {
+            // source Null
+            { UnknownConnection, UnknownConnection, UnknownConnection, UnknownConnection },
+            // source Road
+            { UnknownConnection, Road2Road, Road2Transport, Road2Poi },
+            // source PublicTransport
+            { UnknownConnection, Transport2Road, Transport2Transport, UnknownConnection },
+            // source Poi
+            { UnknownConnection, Poi2Road, UnknownConnection, UnknownConnection }
+        };
+        return types[source_.type()][target_.type()];
+    }
 
     ///
     /// Allowed traffic rules
-    unsigned traffic_rules() const;
+    unsigned traffic_rules( const Multimodal::Graph& graph ) const;
 
     /// empty constructor
     Edge() {}
     /// Generic constructor
-    /// Warning try to call more specialized, faster constructors
+    /// Warning the road edge is looked up, edges from out_edges() and in_edges() should be preferred
     Edge( const Multimodal::Graph& g, const Multimodal::Vertex& s, const Multimodal::Vertex& t );
-
-    /// Road2Road constructor
-    struct road2road_t {};
-    Edge( const Multimodal::Graph&, const Road::Vertex& s, const Road::Vertex& t, road2road_t );
-    /// Transport2Road constructor
-    Edge( const Multimodal::Graph&,
-          PublicTransportGraphIndex pt_graph, const PublicTransport::Vertex& s,
-          const Road::Vertex& t );
-    /// Road2Transport constructor
-    Edge( const Multimodal::Graph&,
-          const Road::Vertex& s,
-          PublicTransportGraphIndex pt_graph, const PublicTransport::Vertex& t );
-    /// Transport2Transport constructor
-    Edge( const Multimodal::Graph&,
-          PublicTransportGraphIndex pt_graph, const PublicTransport::Vertex& s, const PublicTransport::Vertex& t );
-    /// Road2Poi constructor
-    struct road2poi_t {};
-    Edge( const Graph&, const Road::Vertex& s, POIIndex t, road2poi_t );
-    /// Poi2Road constructor
-    struct poi2road_t {};
-    Edge( const Graph&, POIIndex s, const Road::Vertex& t, poi2road_t );
+    /// Constructor from a known road edge
+    Edge( const Multimodal::Vertex& s, const Multimodal::Vertex& t, const Road::Edge& road_edge ) :
+        source_( s ), target_( t ), road_edge_( road_edge ) {}
 
     bool operator==( const Multimodal::Edge& e ) const;
     bool operator!=( const Multimodal::Edge& e ) const;
@@ -304,7 +238,7 @@ struct Edge {
 ///
 /// Get the public transport edge if the given edge is a Transport2Transport
 /// else, return false
-std::pair< PublicTransport::Edge, bool > public_transport_edge( const Multimodal::Edge& e );
+std::pair< PublicTransport::Edge, bool > public_transport_edge( const Multimodal::Edge& e, const Multimodal::Graph& graph );
 
 ///
 /// A MultimodalGraph is basically a Road::Graph associated with a list of PublicTransport::Graph
@@ -469,6 +403,46 @@ public:
     typedef std::vector<StopIndex> EdgeStops;
     const EdgeStops& edge_stops( const Road::Edge& ) const;
 
+    ///
+    /// An out (resp. in) edge of the frozen adjacency
+    struct AdjacentEdge
+    {
+        /// target (resp. source) vertex
+        Vertex vertex;
+        Road::Edge road_edge;
+    };
+
+    ///
+    /// Build the frozen adjacency used by out_edges() and in_edges()
+    /// It has to be called once the graph is loaded, any change to the road graph, public transport graphs,
+    /// POIs or stop and POI references clears it.
+    void build_adjacency();
+
+    ///
+    /// Index of a vertex in the adjacency: road vertices come first, then vertices of each
+    /// public transport graph, selected or not, in graph index order, then POIs.
+    uint32_t adjacency_index( const Vertex& v ) const;
+
+    ///
+    /// Number of adjacency indices
+    size_t adjacency_size() const { return out_offsets_.empty() ? 0 : out_offsets_.size() - 1; }
+
+    ///
+    /// Out edges of a vertex, given its adjacency index
+    std::pair<const AdjacentEdge*, const AdjacentEdge*> out_adjacency( uint32_t idx ) const
+    {
+        BOOST_ASSERT( idx + 1 < out_offsets_.size() );
+        return std::make_pair( out_adjacency_.data() + out_offsets_[idx], out_adjacency_.data() + out_offsets_[idx + 1] );
+    }
+
+    ///
+    /// In edges of a vertex, given its adjacency index
+    std::pair<const AdjacentEdge*, const AdjacentEdge*> in_adjacency( uint32_t idx ) const
+    {
+        BOOST_ASSERT( idx + 1 < in_offsets_.size() );
+        return std::make_pair( in_adjacency_.data() + in_offsets_[idx], in_adjacency_.data() + in_offsets_[idx + 1] );
+    }
+
 private:
     typedef std::map<Road::Edge, EdgeStops> RoadEdgeStops;
     RoadEdgeStops road_edge_stops_;
@@ -480,6 +454,16 @@ private:
     // just to be able to return a reference to empty
     EdgePois empty_edge_pois_;
 
+    void clear_adjacency();
+
+    // first adjacency index of each public transport graph, followed by the first POI index
+    std::vector<uint32_t> pt_adjacency_offsets_;
+    // first out (resp. in) edge of each vertex, by adjacency index, followed by the number of edges
+    std::vector<uint32_t> out_offsets_;
+    std::vector<uint32_t> in_offsets_;
+    std::vector<AdjacentEdge> out_adjacency_;
+    std::vector<AdjacentEdge> in_adjacency_;
+
     friend void Tempus::serialize( std::ostream& ostr, const Graph& graph, binary_serialization_t );
     friend void Tempus::unserialize( std::istream& istr, Graph& graph, binary_serialization_t );
 };
@@ -538,13 +522,7 @@ protected:
 ///
 /// Class that implements the out edges iterator concept of a Multimodal::Graph
 ///
-/// It is a wrapper around:
-///  - a source vertex
-///  - a road edge iterator for road edges
-///  - a public transport edge iterator
-///  - various counters to deal with road <-> transport stops and road <-> poi
-///
-/// Deferencing, incrementation and comparison operators are defined by means of these underlying iterators
+/// It is a pointer on the out edges of the source vertex in the frozen adjacency of the graph
 ///
 class OutEdgeIterator :
     public boost::iterator_facade< OutEdgeIterator,
@@ -552,122 +530,51 @@ class OutEdgeIterator :
     boost::forward_traversal_tag,
 /* reference */ Multimodal::Edge> {
 public:
-    OutEdgeIterator() : source_(), graph_( 0 )
-                      , road_it_(), road_it_end_()
-                      , pt_it_(), pt_it_end_()
-                      , stop2road_connection_( 0 ), road2stop_connection_( 0 )
-                      , road2poi_connection_( 0 ), poi2road_connection_( 0 ) {}
-    OutEdgeIterator( const Multimodal::Graph& graph, Multimodal::Vertex source );
+    OutEdgeIterator() : source_(), it_( 0 ) {}
+    OutEdgeIterator( const Multimodal::Vertex& source, const Graph::AdjacentEdge* it ) :
+        source_( source ), it_( it ) {}
 
-    void to_end();
-    Multimodal::Edge dereference() const;
-    void increment();
-    bool equal( const OutEdgeIterator& v ) const;
+    Multimodal::Edge dereference() const { return Multimodal::Edge( source_, it_->vertex, it_->road_edge ); }
+    void increment() { it_++; }
+    bool equal( const OutEdgeIterator& v ) const { return it_ == v.it_; }
 protected:
     ///
     /// The source vertex
     Multimodal::Vertex source_;
 
     ///
-    /// The underlying graph
-    const Multimodal::Graph* graph_;
-
-    ///
-    /// A pair of out edge iterators for road vertices
-    Road::OutEdgeIterator road_it_, road_it_end_;
-
-    ///
-    /// A pair of out edge iterators for public transport vertices
-    PublicTransport::OutEdgeIterator pt_it_, pt_it_end_;
-
-    ///
-    /// A counter used to represent position on a Transport2Road connection.
-    /// Indeed, a transport stop is linked to a road section and thus to 2 road nodes.
-    /// 0: on the node_from of the associated road section
-    /// 1: on the node_to
-    /// 2: out of the connection
-    size_t stop2road_connection_;
-
-    ///
-    /// A counter used to represent position on a Road2Transport connection.
-    /// A road node can be linked to 0..N public transport nodes (@relates Road::Section::stops)
-    int road2stop_connection_;
-
-    ///
-    /// A counter used to represent position on a Road2Poi connection.
-    /// A road node can be linked to 0..N POI (@relates Road::Section::pois)
-    int road2poi_connection_;
-
-    ///
-    /// A counter used to represent position on a Poi2Road connection.
-    /// Indeed, a POI is linked to a road section and thus to 2 road nodes.
-    /// 0: on the node_from of the associated road section
-    /// 1: on the node_to
-    /// 2: out of the connection
-    int poi2road_connection_;
+    /// Current out edge
+    const Graph::AdjacentEdge* it_;
 
     friend std::ostream& operator<<( std::ostream& ostr, const OutEdgeIterator& it );
 };
 
+///
+/// Class that implements the in edges iterator concept of a Multimodal::Graph
+///
+/// It is a pointer on the in edges of the target vertex in the frozen adjacency of the graph
+///
 class InEdgeIterator :
     public boost::iterator_facade< InEdgeIterator,
     Multimodal::Edge,
     boost::forward_traversal_tag,
 /* reference */ Multimodal::Edge> {
 public:
-    InEdgeIterator() : source_(), graph_( 0 )
-                     , road_it_(), road_it_end_()
-                     , pt_it_(), pt_it_end_()
-                     , stop_from_road_connection_( 0 ), road_from_stop_connection_( 0 )
-                     , road_from_poi_connection_( 0 ), poi_from_road_connection_( 0 ) {}
-    InEdgeIterator( const Multimodal::Graph& graph, Multimodal::Vertex source );
+    InEdgeIterator() : target_(), it_( 0 ) {}
+    InEdgeIterator( const Multimodal::Vertex& target, const Graph::AdjacentEdge* it ) :
+        target_( target ), it_( it ) {}
 
-    void to_end();
-    Multimodal::Edge dereference() const;
-    void increment();
-    bool equal( const InEdgeIterator& v ) const;
+    Multimodal::Edge dereference() const { return Multimodal::Edge( it_->vertex, target_, it_->road_edge ); }
+    void increment() { it_++; }
+    bool equal( const InEdgeIterator& v ) const { return it_ == v.it_; }
 protected:
     ///
-    /// The source vertex
-    Multimodal::Vertex source_;
-
-    ///
-    /// The underlying graph
-    const Multimodal::Graph* graph_;
-
-    ///
-    /// A pair of out edge iterators for road vertices
-    Road::InEdgeIterator road_it_, road_it_end_;
-
-    ///
-    /// A pair of out edge iterators for public transport vertices
-    PublicTransport::InEdgeIterator pt_it_, pt_it_end_;
-
-    ///
-    /// A counter used to represent position on a Transport2Road connection.
-    /// Indeed, a transport stop is linked to a road section and thus to 2 road nodes.
-    /// 0: on the node_from of the associated road section
-    /// 1: on the node_to
-    /// 2: out of the connection
-    size_t stop_from_road_connection_;
-
-    ///
-    /// A counter used to represent position on a Road2Transport connection.
-    /// A road node can be linked to 0..N public transport nodes (@relates Road::Section::stops)
-    int road_from_stop_connection_;
-
-    ///
-    /// A counter used to represent position on a Road2Poi connection.
-    /// A road node can be linked to 0..N POI (@relates Road::Section::pois)
-    int road_from_poi_connection_;
+    /// The target vertex
+    Multimodal::Vertex target_;
 
     ///
-    /// A counter used to represent position on a Poi2Road connection.
-    /// Indeed, a POI is linked to a road section and thus to 2 road nodes.
-    /// 0: on the node_from of the associated road section
-    /// 1: on the node_to
-    /// 2: out of the connection
-    int poi_from_road_connection_;
+    /// Current in edge
+    const Graph::AdjacentEdge* it_;
 
     friend std::ostream& operator<<( std::ostream& ostr, const InEdgeIterator& it );
 };
@@ -712,7 +619,9 @@ protected:
 ///
 /// Class that implemented the property map vertex_index.
 ///
-/// The goal is to map an integer in the range (0, num_vertices-1) to a vertex
+/// The goal is to map an integer in the range (0, num_vertices-1) to a vertex.
+/// The first index of each public transport graph and of the POIs are computed on construction,
+/// so that get_index() is constant time.
 class VertexIndexProperty {
 public:
     typedef size_t                     value_type;
@@ -720,7 +629,7 @@ public:
     typedef Tempus::Multimodal::Vertex key_type;
     typedef boost::vertex_property_tag category;
 
-    VertexIndexProperty( const Graph& graph ) : graph_( graph ) {}
+    VertexIndexProperty( const Graph& graph );
     size_t get_index( const Vertex& v ) const;
 
     size_t operator[] ( const Vertex& v ) const {
@@ -728,6 +637,9 @@ public:
     }
 protected:
     const Multimodal::Graph& graph_;
+    // first index of each public transport graph, by graph index, or the first POI index if it is not selected
+    std::vector<size_t> pt_offsets_;
+    size_t poi_offset_;
 };
 
 //
@@ -738,13 +650,13 @@ protected:
 /// Number of vertices. Constant time
 size_t num_vertices( const Graph& graph );
 ///
-/// Number of edges. O(n) for n number of PT and POI edges
+/// Number of edges. Linear in the number of vertices
 size_t num_edges( const Graph& graph );
 ///
-/// Returns source vertex from an edge. Constant time (linear in number of PT networks)
+/// Returns source vertex from an edge. Constant time
 Vertex source( const Edge& e, const Graph& graph );
 ///
-/// Returns source vertex from an edge. Constant time (linear in number of PT networks)
+/// Returns target vertex from an edge. Constant time
 Vertex target( const Edge& e, const Graph& graph );
 
 ///
@@ -760,10 +672,10 @@ std::pair<OutEdgeIterator, OutEdgeIterator> out_edges( const Vertex& v, const Gr
 /// Returns a range of EdgeIterator that allows to iterate on in edges of a vertex. Constant time
 std::pair<InEdgeIterator, InEdgeIterator> in_edges( const Vertex& v, const Graph& graph );
 ///
-/// Number of out edges for a vertex.
+/// Number of out edges for a vertex. Constant time
 size_t out_degree( const Vertex& v, const Graph& graph );
 ///
-/// Number of in edges for a vertex.
+/// Number of in edges for a vertex. Constant time
 size_t in_degree( const Vertex& v, const Graph& graph );
 ///
 /// Number of out and in edges for a vertex.
@@ -381,6 +381,12 @@ std::unique_ptr<Multimodal::Graph> import_graph( Db::Connection& connection, Pro
     // network_id -> pt_node_id -> vertex
     std::map<Tempus::db_id_t, std::map<Tempus::db_id_t, PublicTransport::Vertex> > pt_nodes_map;
 
+    // network_id -> stops, sections and their ends
+    // public transport graphs are frozen, they are built once all the sections are read
+    std::map<db_id_t, std::vector<PublicTransport::Stop>> pt_stops;
+    std::map<db_id_t, std::vector<PublicTransport::Section>> pt_sections;
+    std::map<db_id_t, std::vector<std::pair<PublicTransport::Vertex, PublicTransport::Vertex>>> pt_section_ends;
+
     std::map<db_id_t, std::unique_ptr<PublicTransport::Graph>> pt_graphs;
     Multimodal::Graph::NetworkMap networks;
     {
@@ -394,7 +400,6 @@ std::unique_ptr<Multimodal::Graph> import_graph( Db::Connection& connection, Pro
             network.set_name( res[i][1] );
 
             networks[network.db_id()] = network;
-            pt_graphs[network.db_id()].reset(new PublicTransport::Graph());
         }
     }
 
@@ -415,8 +420,6 @@ std::unique_ptr<Multimodal::Graph> import_graph( Db::Connection& connection, Pro
             res_i[j++] >> network_id;
             BOOST_ASSERT( network_id > 0 );
             BOOST_ASSERT( networks.find( network_id ) != networks.end() );
-            BOOST_ASSERT( pt_graphs.find( network_id ) != pt_graphs.end() );
-            PublicTransport::Graph& pt_graph = *pt_graphs[network_id];
             PublicTransport::Stop stop;
 
             stop.set_db_id( res_i[j++] );
@@ -458,32 +461,16 @@ std::unique_ptr<Multimodal::Graph> import_graph( Db::Connection& connection, Pro
             p.set_z( res_i[j++] );
             stop.set_coordinates(p);
 
-            PublicTransport::Vertex v = boost::add_vertex( stop, pt_graph );
+            std::vector<PublicTransport::Stop>& network_stops = pt_stops[network_id];
+            PublicTransport::Vertex v = PublicTransport::Vertex( network_stops.size() );
+            stop.set_vertex( v );
+            network_stops.push_back( stop );
             pt_nodes_map[network_id][ stop.db_id() ] = v;
-            pt_graph[v].set_vertex( v );
 
             //progression( static_cast<float>( ( ( i + 0. ) / res.size() / 4.0 ) + 0.5 ) );
         }
     }
 
-    //
-    // For all public transport nodes, add a reference to the attached road section
-    size_t gidx = 0;
-    for ( auto it = pt_graphs.begin(); it != pt_graphs.end(); it++, gidx++ ) {
-        PublicTransport::Graph& g = *it->second;
-        PublicTransport::VertexIterator vi, vi_end;
-
-        for ( boost::tie( vi, vi_end ) = boost::vertices( g ); vi != vi_end; vi++ ) {
-            Road::Edge rs = g[ *vi ].road_edge();
-            graph->add_stop_ref( rs, gidx, *vi );
-            // add a ref to the opposite road edge, if any
-            if (g[*vi].opposite_road_edge()) {
-                rs = g[*vi].opposite_road_edge().get();
-                graph->add_stop_ref( rs, gidx, *vi );
-            }
-        }
-    }
-
     {
         Db::ResultIterator res_it( connection.exec_it( (boost::format("SELECT network_id, stop_from, stop_to FROM %1%.pt_section ORDER BY network_id") % schema_name).str() ) );
         Db::ResultIterator it_end;
@@ -492,8 +479,7 @@ std::unique_ptr<Multimodal::Graph> import_graph( Db::Connection& connection, Pro
             Tempus::db_id_t network_id;
             res_i[0] >> network_id;
             BOOST_ASSERT( network_id > 0 );
-            BOOST_ASSERT( pt_graphs.find( network_id ) != pt_graphs.end() );
-            PublicTransport::Graph& pt_graph = *pt_graphs[ network_id ];
+            BOOST_ASSERT( networks.find( network_id ) != networks.end() );
 
             Tempus::db_id_t stop_from_id, stop_to_id;
             res_i[1] >> stop_from_id;
@@ -513,25 +499,62 @@ std::unique_ptr<Multimodal::Graph> import_graph( Db::Connection& connection, Pro
 
             PublicTransport::Vertex stop_from = pt_nodes_map[network_id][ stop_from_id ];
             PublicTransport::Vertex stop_to = pt_nodes_map[network_id][ stop_to_id ];
-            PublicTransport::Edge e;
-            bool is_added;
-            boost::tie( e, is_added ) = boost::add_edge( stop_from, stop_to, pt_graph );
-            BOOST_ASSERT( is_added );
-            pt_graph[e].set_network_id( network_id );
+            PublicTransport::Section section;
+            section.set_network_id( network_id );
+            pt_section_ends[network_id].push_back( std::make_pair( stop_from, stop_to ) );
+            pt_sections[network_id].push_back( section );
 
             //progression( static_cast<float>( ( ( i + 0. ) / res.size() / 4.0 ) + 0.75 ) );
         }
 
+        // build the public transport graphs
+        for ( const auto& p : networks ) {
+            const db_id_t network_id = p.first;
+            const std::vector<std::pair<PublicTransport::Vertex, PublicTransport::Vertex>>& ends = pt_section_ends[network_id];
+            std::vector<PublicTransport::Stop>& stops = pt_stops[network_id];
+            std::unique_ptr<PublicTransport::Graph> g( new PublicTransport::Graph( boost::edges_are_unsorted_multi_pass,
+                                                                                   ends.begin(), ends.end(),
+                                                                                   pt_sections[network_id].begin(),
+                                                                                   PublicTransport::Vertex( stops.size() ) ) );
+            for ( size_t i = 0; i < stops.size(); i++ ) {
+                (*g)[PublicTransport::Vertex( i )] = std::move( stops[i] );
+            }
+            pt_graphs[network_id] = std::move( g );
+        }
+        pt_stops.clear();
+        pt_sections.clear();
+        pt_section_ends.clear();
+
         // assign graph index to stops
         size_t graph_idx = 0;
-        for ( auto p : pt_nodes_map ) {
-            for ( auto p2 : p.second ) {
-                (*pt_graphs[p.first])[p2.second].set_graph( graph_idx );
+        for ( auto& p : pt_graphs ) {
+            PublicTransport::Graph& g = *p.second;
+            PublicTransport::VertexIterator vi, vi_end;
+            for ( boost::tie( vi, vi_end ) = boost::vertices( g ); vi != vi_end; vi++ ) {
+                g[*vi].set_graph( graph_idx );
             }
             graph_idx++;
         }
     }
 
+    //
+    // For all public transport nodes, add a reference to the attached road section
+    size_t gidx = 0;
+    for ( auto it = pt_graphs.begin(); it != pt_graphs.end(); it++, gidx++ ) {
+        PublicTransport::Graph& g = *it->second;
+        PublicTransport::VertexIterator vi, vi_end;
+
+        for ( boost::tie( vi, vi_end ) = boost::vertices( g ); vi != vi_end; vi++ ) {
+            Road::Edge rs = g[ *vi ].road_edge();
+            graph->add_stop_ref( rs, gidx, *vi );
+            // add a ref to the opposite road edge, if any
+            if (g[*vi].opposite_road_edge()) {
+                rs = g[*vi].opposite_road_edge().get();
+                graph->add_stop_ref( rs, gidx, *vi );
+            }
+        }
+    }
+
     {
         // load PT service
         for ( auto& p: pt_graphs ) {
@@ -551,18 +574,47 @@ std::unique_ptr<Multimodal::Graph> import_graph( Db::Connection& connection, Pro
         // load PT timetable
         std::cout << "load PT time tables ..." << std::endl;
         for ( auto& p: pt_graphs ) {
+            PublicTransport::Graph& pt_graph = *p.second;
             std::string q = (boost::format("select origin_stop, destination_stop, departure_time, arrival_time, trip_id, service_id from tempus.pt_timetable "
                                            "where network_id = %1% "
                                            "order by origin_stop, destination_stop, departure_time, arrival_time") % p.first).str();
             Db::ResultIterator res_it( connection.exec_it( q ) );
             Db::ResultIterator it_end;
+
+            // trip times of each edge, by edge index
+            std::vector<std::vector<PublicTransport::Timetable::TripTime>> time_tables( num_edges( pt_graph ) );
+            // trip times of the current (origin, destination) pair
+            std::vector<PublicTransport::Timetable::TripTime> trip_times;
             int32_t old_origin = 0;
             int32_t old_destination = 0;
-            std::vector<PublicTransport::Timetable::TripTime> trip_times;
-            do {
+            auto assign_trip_times = [&]() {
+                auto pit1 = pt_nodes_map[p.first].find( old_origin );
+                auto pit2 = pt_nodes_map[p.first].find( old_destination );
+                if ( pit1 == pt_nodes_map[p.first].end() ) {
+                    CERR << "Cannot find 'from' node of ID " << old_origin << endl;
+                    return;
+                }
+                if ( pit2 == pt_nodes_map[p.first].end() ) {
+                    CERR << "Cannot find 'to' node of ID " << old_destination << endl;
+                    return;
+                }
+                PublicTransport::Edge e;
+                bool found = false;
+                boost::tie( e, found ) = edge( pit1->second, pit2->second, pt_graph );
+                if ( ! found ) {
+                    CERR << "Cannot find PT edge" << endl;
+                    return;
+                }
+                time_tables[get( boost::edge_index, pt_graph, e )] = trip_times;
+            };
+            for ( ; res_it != it_end; res_it++ ) {
                 Db::RowValue res_i = *res_it;
                 int32_t origin = res_i[0].as<int32_t>();
                 int32_t destination = res_i[1].as<int32_t>();
+                if ( !trip_times.empty() && ( ( origin != old_origin ) || ( destination != old_destination ) ) ) {
+                    assign_trip_times();
+                    trip_times.clear();
+                }
 
                 PublicTransport::Timetable::TripTime tt;
                 tt.set_departure_time( res_i[2].as<float>() );
@@ -570,38 +622,15 @@ std::unique_ptr<Multimodal::Graph> import_graph( Db::Connection& connection, Pro
                 tt.set_trip_id( res_i[4].as<int32_t>() );
                 tt.set_service_id( res_i[5].as<int32_t>() );
                 trip_times.push_back( tt );
-                
-                res_it++;
-                if ( ( res_it == it_end ) ||
-                     ( old_origin && (old_origin != origin) ) ||
-                     ( old_destination && (old_destination != destination ) ) ) {
-                    auto pit1 = pt_nodes_map[p.first].find( old_origin );
-                    auto pit2 = pt_nodes_map[p.first].find( old_destination );
-                    if ( pit1 == pt_nodes_map[p.first].end() ) {
-                        CERR << "Cannot find 'from' node of ID " << old_origin << endl;
-                        continue;
-                    }
-                    if ( pit2 == pt_nodes_map[p.first].end() ) {
-                        CERR << "Cannot find 'to' node of ID " << old_destination << endl;
-                        continue;
-                    }
-                    PublicTransport::Vertex stop_from = pit1->second;
-                    PublicTransport::Vertex stop_to = pit2->second;
-                    PublicTransport::Edge e;
-                    bool found = false;
-                    boost::tie( e, found ) = edge( stop_from, stop_to, *p.second );
-                    if ( ! found ) {
-                        CERR << "Cannot find PT edge" << endl;
-                        continue;
-                    }
 
-                    (*p.second)[e].time_table().assign_sorted_table( trip_times );
-                    trip_times.clear();
-                }
                 old_origin = origin;
                 old_destination = destination;
             }
-            while ( res_it != it_end );
+            if ( !trip_times.empty() ) {
+                assign_trip_times();
+            }
+
+            get_property( pt_graph ).assign_time_tables( time_tables );
         }
     }
 
@@ -666,6 +695,7 @@ std::unique_ptr<Multimodal::Graph> import_graph( Db::Connection& connection, Pro
     graph->set_network_map( networks );
     graph->set_public_transports( std::move(pt_graphs) );
     graph->set_pois( std::move(pois) );
+    graph->build_adjacency();
 
     progression( 1.0, /* finished = */ true );
 
@@ -783,7 +813,13 @@ std::unique_ptr<RoutingData> MultimodalGraphBuilder::file_import( const std::str
         throw std::runtime_error( "Problem opening input file " + filename );
     }
 
-    read_header( ifs );
+    if ( read_header( ifs ) < version() ) {
+        // older layouts:
+        // 1: road graphs in the forward direction only
+        // 2: public transport graphs as adjacency lists, with a timetable per edge
+        // 3: services without their calendar bitmaps
+        throw std::runtime_error( "The multimodal graph in " + filename + " has been dumped by an older version, please dump it again" );
+    }
 
     unserialize( ifs, *graph, binary_serialization_t() );
     std::unique_ptr<RoutingData> rd( graph.release() );
@@ -0,0 +1,371 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pt_timetable.hh"
+#include "ch_query_workspace.hh"
+#include "utils/timer.hh"
+
+#include <algorithm>
+
+namespace Tempus
+{
+
+namespace
+{
+
+///
+/// Compressed rows out of a list of (row, value) pairs
+template <typename T>
+void compress_rows( size_t n_rows, const std::vector<std::pair<uint32_t, T>>& entries, std::vector<uint32_t>& first, std::vector<T>& values )
+{
+    first.assign( n_rows + 1, 0 );
+    for ( const auto& e : entries ) {
+        first[e.first + 1]++;
+    }
+    for ( size_t i = 0; i < n_rows; i++ ) {
+        first[i + 1] += first[i];
+    }
+    values.resize( entries.size() );
+    std::vector<uint32_t> next( first.begin(), first.end() - 1 );
+    for ( const auto& e : entries ) {
+        values[next[e.first]++] = e.second;
+    }
+}
+
+///
+/// A trip, or a part of a trip, going through a sequence of stops
+struct TripPiece
+{
+    uint32_t trip;
+    std::vector<uint32_t> stops;
+    std::vector<PTStopTime> times;
+};
+
+///
+/// Whether trip b never overtakes trip a
+bool does_not_overtake( const TripPiece& a, const TripPiece& b )
+{
+    for ( size_t i = 0; i < a.times.size(); i++ ) {
+        if ( b.times[i].arrival_time < a.times[i].arrival_time || b.times[i].departure_time < a.times[i].departure_time ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+PTTimetable::PTTimetable( std::vector<PTStop>&& a_stops, std::vector<PTTrip>&& a_trips, std::vector<PTTripLeg>&& legs, size_t n_road_vertices ) :
+    stops_( a_stops ),
+    trips_( a_trips )
+{
+    // chain the legs of each trip
+    std::sort( legs.begin(), legs.end(), []( const PTTripLeg& a, const PTTripLeg& b ) {
+            return std::tie( a.trip, a.departure_time, a.arrival_time ) < std::tie( b.trip, b.departure_time, b.arrival_time );
+        });
+    std::vector<TripPiece> pieces;
+    for ( size_t i = 0; i < legs.size(); i++ ) {
+        const PTTripLeg& l = legs[i];
+        if ( i == 0 || l.trip != legs[i - 1].trip || l.from_stop != legs[i - 1].to_stop || l.departure_time < legs[i - 1].arrival_time ) {
+            pieces.push_back( TripPiece() );
+            pieces.back().trip = l.trip;
+            pieces.back().stops.push_back( l.from_stop );
+            pieces.back().times.push_back( PTStopTime{ l.departure_time, l.departure_time } );
+        }
+        TripPiece& p = pieces.back();
+        p.times.back().departure_time = l.departure_time;
+        p.stops.push_back( l.to_stop );
+        p.times.push_back( PTStopTime{ l.arrival_time, l.arrival_time } );
+    }
+    legs.clear();
+    legs.shrink_to_fit();
+
+    // group pieces by stop sequence, sorted by departure
+    std::map<std::vector<uint32_t>, std::vector<uint32_t>> sequences;
+    for ( uint32_t i = 0; i < pieces.size(); i++ ) {
+        sequences[pieces[i].stops].push_back( i );
+    }
+    for ( auto& p : sequences ) {
+        std::vector<uint32_t>& seq_pieces = p.second;
+        std::sort( seq_pieces.begin(), seq_pieces.end(), [&pieces]( uint32_t a, uint32_t b ) {
+                return std::make_pair( pieces[a].times[0].departure_time, pieces[a].times.back().arrival_time ) <
+                    std::make_pair( pieces[b].times[0].departure_time, pieces[b].times.back().arrival_time );
+            });
+
+        // split into routes whose trips do not overtake each other
+        std::vector<std::vector<uint32_t>> seq_routes;
+        for ( uint32_t piece : seq_pieces ) {
+            bool added = false;
+            for ( auto& r : seq_routes ) {
+                if ( does_not_overtake( pieces[r.back()], pieces[piece] ) ) {
+                    r.push_back( piece );
+                    added = true;
+                    break;
+                }
+            }
+            if ( !added ) {
+                seq_routes.push_back( std::vector<uint32_t>( 1, piece ) );
+            }
+        }
+
+        for ( const auto& r : seq_routes ) {
+            Route route;
+            route.first_stop = uint32_t( route_stops_.size() );
+            route.n_stops = uint32_t( p.first.size() );
+            route.first_trip = uint32_t( route_trips_.size() );
+            route.n_trips = uint32_t( r.size() );
+            route.first_stop_time = stop_times_.size();
+            route_stops_.insert( route_stops_.end(), p.first.begin(), p.first.end() );
+            for ( uint32_t piece : r ) {
+                route_trips_.push_back( pieces[piece].trip );
+                stop_times_.insert( stop_times_.end(), pieces[piece].times.begin(), pieces[piece].times.end() );
+            }
+            routes_.push_back( route );
+        }
+    }
+
+    // routes of each stop
+    {
+        std::vector<std::pair<uint32_t, PTRouteStop>> entries;
+        for ( uint32_t r = 0; r < routes_.size(); r++ ) {
+            for ( uint32_t i = 0; i < routes_[r].n_stops; i++ ) {
+                entries.push_back( std::make_pair( route_stop( r, i ), PTRouteStop{ r, i } ) );
+            }
+        }
+        compress_rows( stops_.size(), entries, first_stop_route_, stop_routes_ );
+    }
+
+    // stops around each road vertex
+    {
+        std::vector<std::pair<uint32_t, PTFootpath>> entries;
+        for ( uint32_t s = 0; s < stops_.size(); s++ ) {
+            entries.push_back( std::make_pair( uint32_t( stops_[s].road_source ), PTFootpath{ s, stops_[s].source_distance } ) );
+            entries.push_back( std::make_pair( uint32_t( stops_[s].road_target ), PTFootpath{ s, stops_[s].target_distance } ) );
+        }
+        compress_rows( n_road_vertices, entries, first_road_vertex_stop_, road_vertex_stops_ );
+    }
+
+    first_footpath_.assign( stops_.size() + 1, 0 );
+}
+
+void PTTimetable::set_footpaths( const std::vector<std::vector<PTFootpath>>& footpaths )
+{
+    std::vector<std::pair<uint32_t, PTFootpath>> entries;
+    for ( uint32_t s = 0; s < footpaths.size(); s++ ) {
+        for ( const PTFootpath& f : footpaths[s] ) {
+            entries.push_back( std::make_pair( s, f ) );
+        }
+    }
+    compress_rows( stops_.size(), entries, first_footpath_, footpaths_ );
+}
+
+std::vector<bool> PTTimetable::active_trips( const Multimodal::Graph& graph, const Date& day ) const
+{
+    std::map<std::pair<PublicTransportGraphIndex, db_id_t>, bool> services;
+    std::vector<bool> active( trips_.size() );
+    for ( size_t t = 0; t < trips_.size(); t++ ) {
+        auto key = std::make_pair( trips_[t].graph, trips_[t].service_id );
+        auto it = services.find( key );
+        if ( it == services.end() ) {
+            const PublicTransport::Graph& pt_graph = graph.public_transport( trips_[t].graph );
+            it = services.insert( std::make_pair( key, get_property( pt_graph ).service_map().is_available_on( trips_[t].service_id, day ) ) ).first;
+        }
+        active[t] = it->second;
+    }
+    return active;
+}
+
+void pt_walking_search( const Road::Graph& graph, const std::vector<std::pair<Road::Vertex, float>>& origins, float max_distance,
+                        const std::function<void( Road::Vertex, float )>& visit )
+{
+    static thread_local TimestampedLabels<float, Road::Vertex> labels;
+    static thread_local ReusableMinQueue<float, Road::Vertex> queue;
+    labels.reset( num_vertices( graph ) );
+    queue.clear();
+
+    for ( const auto& o : origins ) {
+        if ( o.second <= max_distance && o.second < labels.potential( o.first ) ) {
+            labels.set( o.first, o.second, o.first );
+            queue.push( o.second, o.first );
+        }
+    }
+
+    while ( !queue.empty() ) {
+        float d;
+        Road::Vertex u;
+        std::tie( d, u ) = queue.top();
+        queue.pop();
+        if ( d > labels.potential( u ) ) {
+            // outdated queue entry
+            continue;
+        }
+        visit( u, d );
+
+        auto relax = [&]( const Road::Edge& e, Road::Vertex v ) {
+            if ( ( graph[e].traffic_rules() & TrafficRulePedestrian ) == 0 ) {
+                return;
+            }
+            float dv = d + graph[e].length();
+            if ( dv <= max_distance && dv < labels.potential( v ) ) {
+                labels.set( v, dv, u );
+                queue.push( dv, v );
+            }
+        };
+        Road::OutEdgeIterator oei, oei_end;
+        for ( boost::tie( oei, oei_end ) = out_edges( u, graph ); oei != oei_end; oei++ ) {
+            relax( *oei, target( *oei, graph ) );
+        }
+        Road::InEdgeIterator iei, iei_end;
+        for ( boost::tie( iei, iei_end ) = in_edges( u, graph ); iei != iei_end; iei++ ) {
+            relax( *iei, source( *iei, graph ) );
+        }
+    }
+}
+
+namespace
+{
+
+std::vector<PTFootpath> stops_reached( const PTTimetable& timetable, const Road::Graph& graph,
+                                       const std::vector<std::pair<Road::Vertex, float>>& origins, float max_distance )
+{
+    std::vector<PTFootpath> stops;
+    pt_walking_search( graph, origins, max_distance, [&]( Road::Vertex v, float d ) {
+            const PTFootpath* it, *it_end;
+            for ( std::tie( it, it_end ) = timetable.road_vertex_stops( v ); it != it_end; it++ ) {
+                if ( d + it->distance <= max_distance ) {
+                    stops.push_back( PTFootpath{ it->stop, d + it->distance } );
+                }
+            }
+        });
+
+    // keep the shortest distance of each stop
+    std::sort( stops.begin(), stops.end(), []( const PTFootpath& a, const PTFootpath& b ) {
+            return std::tie( a.stop, a.distance ) < std::tie( b.stop, b.distance );
+        });
+    stops.erase( std::unique( stops.begin(), stops.end(), []( const PTFootpath& a, const PTFootpath& b ) {
+                return a.stop == b.stop;
+            }), stops.end() );
+    return stops;
+}
+
+}
+
+std::vector<PTFootpath> pt_stops_around( const PTTimetable& timetable, const Road::Graph& graph, Road::Vertex v, float max_distance )
+{
+    return stops_reached( timetable, graph, { std::make_pair( v, 0.0f ) }, max_distance );
+}
+
+uint32_t pt_journey_fare_zones( const PTTimetable& timetable, const PTJourney& journey )
+{
+    uint32_t zones = 0;
+    bool on_board = false;
+    uint16_t last_zone = 0;
+    for ( const PTJourneyLeg& leg : journey.legs ) {
+        if ( leg.type != PTJourneyLeg::LegRide ) {
+            continue;
+        }
+        for ( uint32_t p = leg.board_position; p <= leg.alight_position; p++ ) {
+            const uint16_t zone = timetable.stop( timetable.route_stop( leg.route, p ) ).zone_id;
+            if ( !on_board || zone != last_zone ) {
+                zones++;
+                last_zone = zone;
+                on_board = true;
+            }
+        }
+    }
+    return zones;
+}
+
+std::unique_ptr<PTTimetable> build_pt_timetable( const Multimodal::Graph& graph, const std::map<db_id_t, db_id_t>& trip_modes, float max_footpath_distance )
+{
+    Timer timer;
+    const Road::Graph& road_graph = graph.road();
+
+    std::vector<PTStop> stops;
+    std::vector<PTTrip> trips;
+    std::vector<PTTripLeg> legs;
+    for ( auto p : graph.public_transports() ) {
+        const db_id_t network_id = p.first;
+        const PublicTransport::Graph& pt_graph = *p.second;
+        const PublicTransportGraphIndex graph_idx = graph.public_transport_index( network_id ).get();
+
+        // stops of this graph, by vertex
+        const uint32_t first_stop = uint32_t( stops.size() );
+        PublicTransport::VertexIterator vit, vit_end;
+        for ( boost::tie( vit, vit_end ) = vertices( pt_graph ); vit != vit_end; vit++ ) {
+            const PublicTransport::Stop& s = pt_graph[*vit];
+            PTStop stop;
+            stop.db_id = s.db_id();
+            stop.network_id = network_id;
+            stop.graph = graph_idx;
+            stop.vertex = *vit;
+            stop.zone_id = s.zone_id();
+            const Road::Edge& re = s.road_edge();
+            stop.road_source = source( re, road_graph );
+            stop.road_target = target( re, road_graph );
+            stop.source_distance = float( s.abscissa_road_section() ) * road_graph[re].length();
+            stop.target_distance = road_graph[re].length() - stop.source_distance;
+            stops.push_back( stop );
+        }
+
+        std::map<db_id_t, uint32_t> trip_index;
+        PublicTransport::EdgeIterator eit, eit_end;
+        for ( boost::tie( eit, eit_end ) = edges( pt_graph ); eit != eit_end; eit++ ) {
+            const uint32_t from = first_stop + uint32_t( source( *eit, pt_graph ) );
+            const uint32_t to = first_stop + uint32_t( target( *eit, pt_graph ) );
+            for ( const PublicTransport::Timetable::TripTime& tt : PublicTransport::time_table( pt_graph, *eit ).table() ) {
+                auto it = trip_index.find( tt.trip_id() );
+                if ( it == trip_index.end() ) {
+                    PTTrip trip;
+                    trip.db_id = tt.trip_id();
+                    trip.service_id = tt.service_id();
+                    trip.network_id = network_id;
+                    trip.graph = graph_idx;
+                    auto mit = trip_modes.find( tt.trip_id() );
+                    trip.transport_mode = mit != trip_modes.end() ? mit->second : 0;
+                    it = trip_index.insert( std::make_pair( tt.trip_id(), uint32_t( trips.size() ) ) ).first;
+                    trips.push_back( trip );
+                }
+                legs.push_back( PTTripLeg{ it->second, from, to, tt.departure_time(), tt.arrival_time() } );
+            }
+        }
+    }
+
+    std::unique_ptr<PTTimetable> timetable( new PTTimetable( std::move( stops ), std::move( trips ), std::move( legs ), num_vertices( road_graph ) ) );
+
+    // footpaths
+    std::vector<std::vector<PTFootpath>> footpaths( timetable->num_stops() );
+    #pragma omp parallel for schedule(dynamic)
+    for ( int s = 0; s < int( timetable->num_stops() ); s++ ) {
+        const PTStop& stop = timetable->stop( s );
+        std::vector<PTFootpath> reached = stops_reached( *timetable, road_graph,
+                                                         { std::make_pair( stop.road_source, stop.source_distance ),
+                                                           std::make_pair( stop.road_target, stop.target_distance ) },
+                                                         max_footpath_distance );
+        for ( const PTFootpath& f : reached ) {
+            if ( f.stop != uint32_t( s ) ) {
+                footpaths[s].push_back( f );
+            }
+        }
+    }
+    timetable->set_footpaths( footpaths );
+
+    std::cout << "PT timetable: " << timetable->num_stops() << " stops, " << timetable->num_trips() << " trips, "
+              << timetable->num_routes() << " routes, built in " << timer.elapsed_ms() << "ms" << std::endl;
+    return timetable;
+}
+
+} // namespace Tempus
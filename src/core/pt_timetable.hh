@@ -0,0 +1,272 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_PT_TIMETABLE_HH
+#define TEMPUS_PT_TIMETABLE_HH
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <limits>
+#include <functional>
+
+#include "multimodal_graph.hh"
+
+/**
+ * Flat public transport timetable, for round-based (RAPTOR) and scan-based algorithms.
+ *
+ * Stops of all the loaded public transport graphs are numbered together. Trips that go
+ * through the same sequence of stops without overtaking each other are grouped in routes,
+ * whose stop times are stored contiguously, trip by trip. Footpaths between stops come
+ * from walking distances on the road graph.
+ */
+
+namespace Tempus
+{
+
+///
+/// Public transport stop, with its attachment to the road graph
+struct PTStop
+{
+    db_id_t db_id = 0;
+    /// network of the public transport graph of the stop
+    db_id_t network_id = 0;
+    PublicTransportGraphIndex graph = 0;
+    PublicTransport::Vertex vertex = 0;
+    uint16_t zone_id = 0;
+    /// ends of the road section of the stop, and their distance to the stop (meters)
+    Road::Vertex road_source = 0;
+    Road::Vertex road_target = 0;
+    float source_distance = 0.0;
+    float target_distance = 0.0;
+};
+
+///
+/// Public transport trip
+struct PTTrip
+{
+    db_id_t db_id = 0;
+    db_id_t service_id = 0;
+    db_id_t network_id = 0;
+    PublicTransportGraphIndex graph = 0;
+    /// transport mode, 0 if unknown
+    db_id_t transport_mode = 0;
+};
+
+///
+/// Part of a trip between two consecutive stops
+struct PTTripLeg
+{
+    uint32_t trip;
+    uint32_t from_stop;
+    uint32_t to_stop;
+    /// times in minutes since midnight
+    float departure_time;
+    float arrival_time;
+};
+
+///
+/// Walking path between two stops
+struct PTFootpath
+{
+    uint32_t stop;
+    /// length in meters
+    float distance;
+};
+
+struct PTStopTime
+{
+    float arrival_time;
+    float departure_time;
+};
+
+///
+/// Route going through a stop, at a given position
+struct PTRouteStop
+{
+    uint32_t route;
+    uint32_t position;
+};
+
+///
+/// Walking access to (or egress from) a stop
+struct PTAccess
+{
+    uint32_t stop;
+    /// walking duration, in minutes
+    float duration;
+};
+
+///
+/// Part of a public transport journey
+struct PTJourneyLeg
+{
+    static const uint32_t NO_STOP = uint32_t(-1);
+
+    enum LegType
+    {
+        LegWalk,
+        LegRide
+    };
+    LegType type;
+    /// stops, NO_STOP for the origin or the destination of the journey
+    uint32_t from_stop;
+    uint32_t to_stop;
+    /// trip, route and positions along the route of a ride
+    uint32_t trip;
+    uint32_t route;
+    uint32_t board_position;
+    uint32_t alight_position;
+    /// times in minutes since midnight
+    float departure_time;
+    float arrival_time;
+};
+
+///
+/// Public transport journey, from an origin to a destination
+struct PTJourney
+{
+    float departure_time;
+    float arrival_time;
+    /// number of trips
+    uint32_t n_trips;
+    std::vector<PTJourneyLeg> legs;
+};
+
+class PTTimetable
+{
+public:
+    static float infinity() { return std::numeric_limits<float>::infinity(); }
+
+    ///
+    /// \param stops Stops
+    /// \param trips Trips
+    /// \param legs Legs of the trips, in any order. Legs of a trip that do not follow each other split it
+    /// \param n_road_vertices Number of vertices of the road graph stops are attached to
+    PTTimetable( std::vector<PTStop>&& stops, std::vector<PTTrip>&& trips, std::vector<PTTripLeg>&& legs, size_t n_road_vertices );
+
+    size_t num_stops() const { return stops_.size(); }
+    size_t num_trips() const { return trips_.size(); }
+    size_t num_routes() const { return routes_.size(); }
+
+    const PTStop& stop( uint32_t s ) const { return stops_[s]; }
+    const PTTrip& trip( uint32_t t ) const { return trips_[t]; }
+
+    ///
+    /// Number of stops of a route
+    uint32_t route_num_stops( uint32_t r ) const { return routes_[r].n_stops; }
+    ///
+    /// Number of trips of a route. Trips are sorted by departure, at every stop
+    uint32_t route_num_trips( uint32_t r ) const { return routes_[r].n_trips; }
+    ///
+    /// Stop at a position of a route
+    uint32_t route_stop( uint32_t r, uint32_t position ) const { return route_stops_[routes_[r].first_stop + position]; }
+    ///
+    /// Trip index of the i-th trip of a route
+    uint32_t route_trip( uint32_t r, uint32_t i ) const { return route_trips_[routes_[r].first_trip + i]; }
+    ///
+    /// Stop times of the i-th trip of a route, one per stop of the route
+    const PTStopTime* stop_times( uint32_t r, uint32_t i ) const
+    {
+        return &stop_times_[routes_[r].first_stop_time + size_t(i) * routes_[r].n_stops];
+    }
+
+    ///
+    /// Routes going through a stop
+    std::pair<const PTRouteStop*, const PTRouteStop*> stop_routes( uint32_t s ) const
+    {
+        return std::make_pair( stop_routes_.data() + first_stop_route_[s], stop_routes_.data() + first_stop_route_[s + 1] );
+    }
+
+    ///
+    /// Footpaths from a stop
+    std::pair<const PTFootpath*, const PTFootpath*> footpaths( uint32_t s ) const
+    {
+        return std::make_pair( footpaths_.data() + first_footpath_[s], footpaths_.data() + first_footpath_[s + 1] );
+    }
+
+    ///
+    /// Set the footpaths from each stop
+    void set_footpaths( const std::vector<std::vector<PTFootpath>>& footpaths );
+
+    ///
+    /// Stops attached to the road sections around a road vertex, with their distance to it
+    std::pair<const PTFootpath*, const PTFootpath*> road_vertex_stops( Road::Vertex v ) const
+    {
+        return std::make_pair( road_vertex_stops_.data() + first_road_vertex_stop_[v], road_vertex_stops_.data() + first_road_vertex_stop_[v + 1] );
+    }
+
+    ///
+    /// Whether each trip runs on a given day
+    std::vector<bool> active_trips( const Multimodal::Graph& graph, const Date& day ) const;
+
+private:
+    struct Route
+    {
+        uint32_t first_stop;
+        uint32_t n_stops;
+        uint32_t first_trip;
+        uint32_t n_trips;
+        size_t first_stop_time;
+    };
+
+    std::vector<PTStop> stops_;
+    std::vector<PTTrip> trips_;
+
+    std::vector<Route> routes_;
+    std::vector<uint32_t> route_stops_;
+    std::vector<uint32_t> route_trips_;
+    std::vector<PTStopTime> stop_times_;
+
+    std::vector<uint32_t> first_stop_route_;
+    std::vector<PTRouteStop> stop_routes_;
+
+    std::vector<uint32_t> first_footpath_;
+    std::vector<PTFootpath> footpaths_;
+
+    std::vector<uint32_t> first_road_vertex_stop_;
+    std::vector<PTFootpath> road_vertex_stops_;
+};
+
+///
+/// Walking distances on the road graph, on the sections allowed to pedestrians in any direction
+/// \param graph The road graph
+/// \param origins Origin vertices and their initial distance
+/// \param max_distance Distance (meters) where the search stops
+/// \param visit Called on each settled vertex, with its distance
+void pt_walking_search( const Road::Graph& graph, const std::vector<std::pair<Road::Vertex, float>>& origins, float max_distance,
+                        const std::function<void( Road::Vertex, float )>& visit );
+
+///
+/// Stops within a walking distance of a road vertex
+/// \returns (stop, distance in meters) pairs
+std::vector<PTFootpath> pt_stops_around( const PTTimetable& timetable, const Road::Graph& graph, Road::Vertex v, float max_distance );
+
+///
+/// Number of fare zones a journey goes through on board: one at the first boarding, and
+/// one more each time a trip reaches, or is boarded in, a zone different from the last one
+uint32_t pt_journey_fare_zones( const PTTimetable& timetable, const PTJourney& journey );
+
+///
+/// Build the flat timetable of the public transport graphs of a multimodal graph
+/// \param graph The multimodal graph
+/// \param trip_modes Transport mode of each trip (trip db id -> mode), may be empty
+/// \param max_footpath_distance Maximum length of a footpath between two stops (meters)
+std::unique_ptr<PTTimetable> build_pt_timetable( const Multimodal::Graph& graph, const std::map<db_id_t, db_id_t>& trip_modes, float max_footpath_distance );
+
+} // namespace Tempus
+
+#endif
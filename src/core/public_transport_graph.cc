@@ -15,6 +15,8 @@
  *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+
 #include "public_transport_graph.hh"
 
 namespace Tempus {
@@ -25,32 +27,101 @@ void Network::add_agency( const Agency& agency )
     agencies_.push_back( agency );
 }
 
-void Timetable::assign_sorted_table( const std::vector<TripTime>& table )
+void GraphProperties::assign_time_tables( const std::vector<std::vector<Timetable::TripTime>>& tables )
 {
-    table_ = table;
+    size_t n = 0;
+    for ( const auto& table : tables ) {
+        n += table.size();
+    }
+    trip_times_.clear();
+    trip_times_.reserve( n );
+    time_table_offsets_.resize( tables.size() + 1 );
+    for ( size_t i = 0; i < tables.size(); i++ ) {
+        time_table_offsets_[i] = uint32_t( trip_times_.size() );
+        for ( const Timetable::TripTime& tt : tables[i] ) {
+            trip_times_.push_back( tt );
+            trip_times_.back().set_service_index( service_map_.service_index( tt.service_id() ) );
+        }
+    }
+    time_table_offsets_[tables.size()] = uint32_t( trip_times_.size() );
 }
 
-void Timetable::assign_sorted_table( std::vector<TripTime>&& table )
+uint32_t ServiceMap::service_index( db_id_t service_id )
 {
-    table_ = table;
+    auto it = index_.find( service_id );
+    if ( it != index_.end() ) {
+        return it->second;
+    }
+    const uint32_t idx = uint32_t( service_ids_.size() );
+    service_ids_.push_back( service_id );
+    index_[service_id] = idx;
+    days_.resize( days_.size() + n_words_, 0 );
+    return idx;
 }
 
-void ServiceMap::add( db_id_t service_id, const Date& date )
+void ServiceMap::extend_range( uint32_t day )
 {
-    auto it = map_.find( service_id );
-    if ( it == map_.end() ) {
-        auto pp = map_.emplace( std::make_pair( service_id, Service() ) );
-        it = pp.first;
+    if ( n_words_ == 0 ) {
+        first_day_ = day;
+        n_words_ = 1;
+        days_.assign( service_ids_.size(), 0 );
+        return;
     }
-    it->second.insert( date );
+    const uint32_t last_day = first_day_ + n_words_ * 64 - 1;
+    if ( day >= first_day_ && day <= last_day ) {
+        return;
+    }
+
+    // at least double the range, so that successive extensions are amortized
+    const uint32_t lo = std::min( first_day_, day );
+    const uint32_t hi = std::max( last_day, day );
+    const uint32_t new_n_words = std::max( n_words_ * 2, ( hi - lo ) / 64 + 1 );
+    uint32_t new_first_day = lo;
+    if ( day < first_day_ ) {
+        // the extra room goes before the range
+        const uint32_t room = new_n_words * 64 - ( hi - lo + 1 );
+        new_first_day = lo > room ? lo - room : 0;
+    }
+
+    std::vector<uint64_t> new_days( service_ids_.size() * new_n_words, 0 );
+    const uint32_t shift = first_day_ - new_first_day;
+    for ( size_t s = 0; s < service_ids_.size(); s++ ) {
+        for ( uint32_t d = 0; d < n_words_ * 64; d++ ) {
+            if ( ( days_[s * n_words_ + d / 64] >> ( d % 64 ) ) & 1 ) {
+                const uint32_t nd = d + shift;
+                new_days[s * new_n_words + nd / 64] |= uint64_t( 1 ) << ( nd % 64 );
+            }
+        }
+    }
+    days_.swap( new_days );
+    first_day_ = new_first_day;
+    n_words_ = new_n_words;
+}
+
+void ServiceMap::add( db_id_t service_id, const Date& date )
+{
+    const uint32_t day = date.day_number();
+    extend_range( day );
+    const uint32_t idx = service_index( service_id );
+    const uint32_t d = day - first_day_;
+    days_[idx * n_words_ + d / 64] |= uint64_t( 1 ) << ( d % 64 );
 }
 
 bool ServiceMap::is_available_on( db_id_t service_id, const Date& date ) const
 {
-    auto it = map_.find( service_id );
-    if ( it == map_.end() )
+    auto it = index_.find( service_id );
+    if ( it == index_.end() )
         return false;
-    return it->second.find( date ) != it->second.end();
+    return is_index_available_on( it->second, date );
+}
+
+ActiveServices ServiceMap::active_services( const Date& date ) const
+{
+    ActiveServices active( service_ids_.size() );
+    for ( uint32_t i = 0; i < service_ids_.size(); i++ ) {
+        active[i] = is_index_available_on( i, date );
+    }
+    return active;
 }
 
 static bool departure_cmp( const Timetable::TripTime& t1, float t )
@@ -60,15 +131,12 @@ static bool departure_cmp( const Timetable::TripTime& t1, float t )
 
 std::pair<Timetable::TripTimeIterator, Timetable::TripTimeIterator> Timetable::next_departures( float time_min ) const
 {
-    auto it = std::lower_bound( table_.begin(), table_.end(), time_min, departure_cmp );
-    if ( it == table_.end() )
-        return std::make_pair( table_.begin(), table_.begin() );
+    auto it = std::lower_bound( begin_, end_, time_min, departure_cmp );
+    if ( it == end_ )
+        return std::make_pair( begin_, begin_ );
     float t = it->departure_time();
-    while ( it->departure_time() == t )
-        it--;
-    it++;
     auto it2 = it;
-    while ( it2->departure_time() == t )
+    while ( it2 != end_ && it2->departure_time() == t )
         it2++;
     return std::make_pair( it, it2 );
 }
@@ -80,28 +148,35 @@ static bool arrival_cmp( float t, const Timetable::TripTime& t1 )
 
 std::pair<Timetable::TripTimeIterator, Timetable::TripTimeIterator> Timetable::previous_arrivals( float time_min ) const
 {
-    auto it = std::upper_bound( table_.begin(), table_.end(), time_min, arrival_cmp );
-    if ( it == table_.begin() )
-        return std::make_pair( table_.begin(), table_.begin() );
+    auto it = std::upper_bound( begin_, end_, time_min, arrival_cmp );
+    if ( it == begin_ )
+        return std::make_pair( begin_, begin_ );
     it--;
     float t = it->arrival_time();
-    while ( it->arrival_time() == t )
+    while ( it != begin_ && (it - 1)->arrival_time() == t )
         it--;
-    it++;
     auto it2 = it;
-    while ( it2->arrival_time() == t )
+    while ( it2 != end_ && it2->arrival_time() == t )
         it2++;
     return std::make_pair( it, it2 );
 }
 
 boost::optional<Timetable::TripTime> next_departure( const Graph& g, const Edge& e, const Date& day, float time )
 {
-    auto p = g[e].time_table().next_departures( time );
-    if ( p.first == p.second )
-        return boost::optional<Timetable::TripTime>();
-    const GraphProperties& props = get_property( g );
+    auto p = time_table( g, e ).next_departures( time );
+    const ServiceMap& services = get_property( g ).service_map();
+    for ( auto it = p.first; it != p.second; it++ ) {
+        if ( services.is_index_available_on( it->service_index(), day ) )
+            return *it;
+    }
+    return boost::optional<Timetable::TripTime>();
+}
+
+boost::optional<Timetable::TripTime> next_departure( const Graph& g, const Edge& e, const ActiveServices& services, float time )
+{
+    auto p = time_table( g, e ).next_departures( time );
     for ( auto it = p.first; it != p.second; it++ ) {
-        if ( props.service_map().is_available_on( it->service_id(), day ) )
+        if ( services[it->service_index()] )
             return *it;
     }
     return boost::optional<Timetable::TripTime>();
@@ -109,12 +184,20 @@ boost::optional<Timetable::TripTime> next_departure( const Graph& g, const Edge&
 
 boost::optional<Timetable::TripTime> previous_arrival( const Graph& g, const Edge& e, const Date& day, float time )
 {
-    auto p = g[e].time_table().previous_arrivals( time );
-    if ( p.first == p.second )
-        return boost::optional<Timetable::TripTime>();
-    const GraphProperties& props = get_property( g );
+    auto p = time_table( g, e ).previous_arrivals( time );
+    const ServiceMap& services = get_property( g ).service_map();
+    for ( auto it = p.first; it != p.second; it++ ) {
+        if ( services.is_index_available_on( it->service_index(), day ) )
+            return *it;
+    }
+    return boost::optional<Timetable::TripTime>();
+}
+
+boost::optional<Timetable::TripTime> previous_arrival( const Graph& g, const Edge& e, const ActiveServices& services, float time )
+{
+    auto p = time_table( g, e ).previous_arrivals( time );
     for ( auto it = p.first; it != p.second; it++ ) {
-        if ( props.service_map().is_available_on( it->service_id(), day ) )
+        if ( services[it->service_index()] )
             return *it;
     }
     return boost::optional<Timetable::TripTime>();
@@ -21,8 +21,10 @@
 #ifdef _WIN32
 #pragma warning(push, 0)
 #endif
+#include <unordered_map>
 #include <boost/optional.hpp>
-#include <boost/graph/adjacency_list.hpp>
+#include <boost/range/iterator_range.hpp>
+#include <boost/graph/compressed_sparse_row_graph.hpp>
 #ifdef _WIN32
 #pragma warning(pop)
 #endif
@@ -44,30 +46,136 @@ namespace Tempus {
 */
 namespace PublicTransport {
 
-///
-/// storage types used to make a road graph
-typedef boost::vecS VertexListType;
-typedef boost::vecS EdgeListType;
-
 struct Stop;
 struct Section;
 
+///
+/// Trip times of a public transport section.
+/// This is a view on times stored elsewhere, in the graph properties of a public transport graph
+class Timetable
+{
+public:
+    class TripTime
+    {
+    public:
+        TripTime() {}
+        TripTime( float ldeparture_time, float larrival_time, db_id_t ltrip_id, db_id_t lservice_id ) :
+            departure_time_( ldeparture_time ),
+            arrival_time_( larrival_time ),
+            trip_id_( ltrip_id ),
+            service_id_( lservice_id ),
+            service_index_( 0 )
+        {}
+        ///
+        /// departure time, in minutes since midnight
+        DECLARE_RW_PROPERTY( departure_time, float );
+        ///
+        /// arrival time, in minutes since midnight
+        DECLARE_RW_PROPERTY( arrival_time, float );
+        ///
+        /// trip id
+        DECLARE_RW_PROPERTY( trip_id, db_id_t );
+        ///
+        /// service id
+        DECLARE_RW_PROPERTY( service_id, db_id_t );
+        ///
+        /// dense index of the service in the service map of the graph
+        DECLARE_RW_PROPERTY( service_index, uint32_t );
+    };
+
+    using TripTimeIterator = const TripTime*;
+
+    Timetable() : begin_( nullptr ), end_( nullptr ) {}
+
+    ///
+    /// Timetable over a range of trip times, sorted by departure times
+    Timetable( TripTimeIterator lbegin, TripTimeIterator lend ) : begin_( lbegin ), end_( lend ) {}
+
+    ///
+    /// Timetable over the trip times of the given table, sorted by departure times
+    explicit Timetable( const std::vector<TripTime>& table ) :
+        begin_( table.data() ), end_( table.data() + table.size() ) {}
+
+    ///
+    /// All the trip times, sorted by departure times
+    boost::iterator_range<TripTimeIterator> table() const { return boost::make_iterator_range( begin_, end_ ); }
+
+    ///
+    /// Get the next departures
+    /// @returns a pair of iterators. If first == second, it is empty
+    std::pair<TripTimeIterator, TripTimeIterator> next_departures( float time_min ) const;
+
+    ///
+    /// Get the previous arrival
+    /// @returns a pair of iterators. If first == second, it is empty
+    std::pair<TripTimeIterator, TripTimeIterator> previous_arrivals( float time_min ) const;
+private:
+    // range of times, sorted by departure times
+    TripTimeIterator begin_;
+    TripTimeIterator end_;
+};
+
+///
+/// Services available on a given day, by dense service index
+typedef std::vector<bool> ActiveServices;
+
 ///
 /// Service map: service db ID -> dates of availability
+///
+/// Services are given dense indices. The calendar of each service is a bitmap of days
+/// over the validity range of all the services.
 class ServiceMap
 {
 public:
-    using Service = std::set<Date>;
+    ServiceMap() : first_day_( 0 ), n_words_( 0 ) {}
 
     ///
     /// Add a service_id, date
     void add( db_id_t service_id, const Date& date );
 
+    ///
+    /// Dense index of a service. A service with no date is added if it does not exist yet
+    uint32_t service_index( db_id_t service_id );
+
+    ///
+    /// Number of services
+    size_t size() const { return service_ids_.size(); }
+
     ///
     /// Check if a service is available on a given date
     bool is_available_on( db_id_t service_id, const Date& date ) const;
+
+    ///
+    /// Check if a service, given its dense index, is available on a given date
+    bool is_index_available_on( uint32_t service_index, const Date& date ) const
+    {
+        const int32_t d = int32_t( date.day_number() ) - int32_t( first_day_ );
+        if ( d < 0 || d >= int32_t( n_words_ * 64 ) ) {
+            return false;
+        }
+        return ( days_[service_index * n_words_ + d / 64] >> ( d % 64 ) ) & 1;
+    }
+
+    ///
+    /// Services available on a given date, to be computed once for a query
+    ActiveServices active_services( const Date& date ) const;
 private:
-    std::map<db_id_t, Service> map_;
+    // make room in the bitmaps for the given day number
+    void extend_range( uint32_t day );
+
+    // dense index -> service db id
+    std::vector<db_id_t> service_ids_;
+    // service db id -> dense index
+    std::unordered_map<db_id_t, uint32_t> index_;
+    // day number of the first day of the bitmaps
+    uint32_t first_day_;
+    // number of 64 bits words of each bitmap
+    uint32_t n_words_;
+    // bitmaps of each service, by dense index
+    std::vector<uint64_t> days_;
+
+    friend void Tempus::serialize( std::ostream& ostr, const PublicTransport::GraphProperties&, binary_serialization_t );
+    friend void Tempus::unserialize( std::istream& istr, PublicTransport::GraphProperties&, binary_serialization_t );
 };
 
 class GraphProperties
@@ -75,13 +183,41 @@ class GraphProperties
 public:
     ServiceMap& service_map() { return service_map_; }
     const ServiceMap& service_map() const { return service_map_; }
+
+    ///
+    /// Timetable of an edge, given its index
+    /// It is empty if no timetable has been assigned
+    Timetable time_table( size_t edge_index ) const
+    {
+        if ( time_table_offsets_.empty() ) {
+            return Timetable();
+        }
+        BOOST_ASSERT( edge_index + 1 < time_table_offsets_.size() );
+        return Timetable( trip_times_.data() + time_table_offsets_[edge_index],
+                          trip_times_.data() + time_table_offsets_[edge_index + 1] );
+    }
+
+    ///
+    /// Assign the timetables of all the edges, indexed by edge index.
+    /// Each table must be sorted by departure times.
+    /// Service indices of trip times are resolved with the service map
+    void assign_time_tables( const std::vector<std::vector<Timetable::TripTime>>& tables );
 private:
     ServiceMap service_map_;
+
+    // trip times of all the edges, concatenated in edge index order
+    std::vector<Timetable::TripTime> trip_times_;
+    // offset of the first trip time of each edge, followed by the total number of trip times
+    std::vector<uint32_t> time_table_offsets_;
+
+    friend void Tempus::serialize( std::ostream& ostr, const PublicTransport::GraphProperties&, binary_serialization_t );
+    friend void Tempus::unserialize( std::istream& istr, PublicTransport::GraphProperties&, binary_serialization_t );
 };
 
 ///
 /// Definition of a public transport graph
-typedef boost::adjacency_list<VertexListType, EdgeListType, boost::bidirectionalS, Stop, Section, GraphProperties> Graph;
+/// It is a frozen graph, built once from the list of its sections. Edges are stored in CSR form, in both directions.
+typedef boost::compressed_sparse_row_graph<boost::bidirectionalS, Stop, Section, GraphProperties, uint32_t, uint32_t> Graph;
 typedef Graph::vertex_descriptor Vertex;
 typedef Graph::edge_descriptor Edge;
 
@@ -132,71 +268,23 @@ public:
     friend void Tempus::unserialize( std::istream& istr, PublicTransport::Stop&, binary_serialization_t );
 };
 
-class Timetable
-{
-public:
-    class TripTime
-    {
-    public:
-        TripTime() {}
-        TripTime( float ldeparture_time, float larrival_time, db_id_t ltrip_id, db_id_t lservice_id ) :
-            departure_time_( ldeparture_time ),
-            arrival_time_( larrival_time ),
-            trip_id_( ltrip_id ),
-            service_id_( lservice_id )
-        {}
-        ///
-        /// departure time, in minutes since midnight
-        DECLARE_RW_PROPERTY( departure_time, float );
-        ///
-        /// arrival time, in minutes since midnight
-        DECLARE_RW_PROPERTY( arrival_time, float );
-        ///
-        /// trip id
-        DECLARE_RW_PROPERTY( trip_id, db_id_t );
-        ///
-        /// service id
-        DECLARE_RW_PROPERTY( service_id, db_id_t );
-    };
-
-    ///
-    /// Assign times from the given table, sorted by departure times
-    void assign_sorted_table( const std::vector<TripTime>& );
-
-    ///
-    /// Assign times from the given table, sorted by departure times
-    void assign_sorted_table( std::vector<TripTime>&& );
-
-    using TripTimeIterator = std::vector<TripTime>::const_iterator;
-    ///
-    /// Get the next departures
-    /// @returns a pair of iterators. If first == second, it is empty
-    std::pair<TripTimeIterator, TripTimeIterator> next_departures( float time_min ) const;
-
-    ///
-    /// Get the previous arrival
-    /// @returns a pair of iterators. If first == second, it is empty
-    std::pair<TripTimeIterator, TripTimeIterator> previous_arrivals( float time_min ) const;
-private:
-    // sorted vector of times
-    std::vector<TripTime> table_ = std::vector<TripTime>();
-};
-
 ///
 /// used as an Edge in a PublicTransportGraph
 struct Section {
 public:
-    Section() : network_id_(0), time_table_() {}
+    Section() : network_id_(0) {}
 
     /// must not be null
     DECLARE_RW_PROPERTY( network_id, db_id_t );
-
-    Timetable& time_table() { return time_table_; }
-    const Timetable& time_table() const { return time_table_; }
-private:
-    Timetable time_table_;
 };
 
+///
+/// Convenience function - Get the timetable of a public transport section
+inline Timetable time_table( const Graph& g, const Edge& e )
+{
+    return get_property( g ).time_table( get( boost::edge_index, g, e ) );
+}
+
 ///
 /// Convenience function - Get the departure stop of a public transport section
 inline Stop get_stop_from( const Graph& g, const Edge& e )
@@ -221,10 +309,18 @@ typedef boost::graph_traits<Graph>::in_edge_iterator InEdgeIterator;
 /// Get the next (first) departure given an edge, day and time
 boost::optional<Timetable::TripTime> next_departure( const Graph& g, const Edge& e, const Date& day, float time );
 
+///
+/// Get the next (first) departure given an edge, services available on the day and time
+boost::optional<Timetable::TripTime> next_departure( const Graph& g, const Edge& e, const ActiveServices& services, float time );
+
 ///
 /// Get the previous (first) arrival given an edge, day and time
 boost::optional<Timetable::TripTime> previous_arrival( const Graph& g, const Edge& e, const Date& day, float time );
 
+///
+/// Get the previous (first) arrival given an edge, services available on the day and time
+boost::optional<Timetable::TripTime> previous_arrival( const Graph& g, const Edge& e, const ActiveServices& services, float time );
+
 } // PublicTransport namespace
 
 void serialize( std::ostream& ostr, const PublicTransport::Graph&, binary_serialization_t );
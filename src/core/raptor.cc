@@ -0,0 +1,398 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "raptor.hh"
+
+#include <algorithm>
+#include <functional>
+#include <tuple>
+#include <boost/assert.hpp>
+
+namespace Tempus
+{
+
+namespace
+{
+const uint32_t NONE = uint32_t(-1);
+}
+
+Raptor::Raptor( const PTTimetable& timetable ) :
+    timetable_( timetable ),
+    n_stops_( uint32_t( timetable.num_stops() ) ),
+    n_rounds_( 0 ),
+    marked_( timetable.num_stops(), 0 ),
+    route_marked_position_( timetable.num_routes(), NONE ),
+    n_query_rounds_( 0 ),
+    min_transfer_time_( 0.0 ),
+    n_scanned_routes_( 0 )
+{
+}
+
+void Raptor::set_label( uint32_t round, uint32_t s, const Label& l )
+{
+    const bool ride = l.type == LabelRide;
+    Label& current = ride ? ride_label( round, s ) : walk_label( round, s );
+    if ( current.type == LabelNone ) {
+        touched_labels_.push_back( ( size_t(round) * n_stops_ + s ) * 2 + ( ride ? 0 : 1 ) );
+    }
+    current = l;
+    if ( ready_time( n_rounds_ - 1, s ) == PTTimetable::infinity() ) {
+        touched_stops_.push_back( s );
+    }
+    // the label also counts for the later rounds
+    if ( ride ) {
+        for ( uint32_t k = round; k < n_rounds_ && l.arrival_time < best_ride_arrival( k, s ); k++ ) {
+            best_ride_arrival( k, s ) = l.arrival_time;
+        }
+    }
+    const float ready = l.arrival_time + ( ride ? min_transfer_time_ : 0.0f );
+    for ( uint32_t k = round; k < n_rounds_ && ready < ready_time( k, s ); k++ ) {
+        ready_time( k, s ) = ready;
+    }
+    if ( !marked_[s] ) {
+        marked_[s] = 1;
+        marked_stops_.push_back( s );
+    }
+}
+
+uint32_t Raptor::earliest_trip( const std::vector<bool>& active_trips, uint32_t r, uint32_t position, float time, uint32_t n_trips ) const
+{
+    // trips of a route do not overtake each other, departures are sorted at every position
+    uint32_t lo = 0, hi = n_trips;
+    while ( lo < hi ) {
+        uint32_t mid = ( lo + hi ) / 2;
+        if ( timetable_.stop_times( r, mid )[position].departure_time < time ) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    while ( lo < n_trips && !active_trips[timetable_.route_trip( r, lo )] ) {
+        lo++;
+    }
+    return lo;
+}
+
+void Raptor::clear()
+{
+    for ( size_t i : touched_labels_ ) {
+        ( i % 2 ? walk_labels_ : ride_labels_ )[i / 2] = Label();
+    }
+    touched_labels_.clear();
+    for ( uint32_t s : touched_stops_ ) {
+        for ( uint32_t k = 0; k < n_rounds_; k++ ) {
+            best_ride_arrival( k, s ) = PTTimetable::infinity();
+            ready_time( k, s ) = PTTimetable::infinity();
+        }
+    }
+    touched_stops_.clear();
+    for ( uint32_t s : marked_stops_ ) {
+        marked_[s] = 0;
+    }
+    marked_stops_.clear();
+}
+
+void Raptor::start( uint32_t max_transfers, float min_transfer_time )
+{
+    clear();
+    n_scanned_routes_ = 0;
+    min_transfer_time_ = min_transfer_time;
+    n_query_rounds_ = max_transfers + 2;
+    if ( n_query_rounds_ > n_rounds_ ) {
+        ride_labels_.resize( size_t(n_query_rounds_) * n_stops_ );
+        walk_labels_.resize( size_t(n_query_rounds_) * n_stops_ );
+        best_ride_arrivals_.resize( size_t(n_query_rounds_) * n_stops_, PTTimetable::infinity() );
+        ready_times_.resize( size_t(n_query_rounds_) * n_stops_, PTTimetable::infinity() );
+        n_rounds_ = n_query_rounds_;
+    }
+    target_arrival_.assign( n_query_rounds_, PTTimetable::infinity() );
+}
+
+std::vector<PTJourney> Raptor::query( const std::vector<bool>& active_trips,
+                                      const std::vector<PTAccess>& access,
+                                      const std::vector<PTAccess>& egress,
+                                      float departure_time,
+                                      uint32_t max_transfers,
+                                      float walking_speed,
+                                      float min_transfer_time )
+{
+    start( max_transfers, min_transfer_time );
+    std::vector<PTJourney> journeys;
+    run( active_trips, access, egress, departure_time, walking_speed, journeys );
+    return journeys;
+}
+
+std::vector<PTJourney> Raptor::range_query( const std::vector<bool>& active_trips,
+                                            const std::vector<PTAccess>& access,
+                                            const std::vector<PTAccess>& egress,
+                                            float window_begin,
+                                            float window_end,
+                                            uint32_t max_transfers,
+                                            float walking_speed,
+                                            float min_transfer_time )
+{
+    // departures from the origin that reach an access stop right on time for a trip
+    std::vector<float> departures;
+    for ( const PTAccess& a : access ) {
+        const PTRouteStop* it, *it_end;
+        for ( std::tie( it, it_end ) = timetable_.stop_routes( a.stop ); it != it_end; it++ ) {
+            if ( it->position + 1 == timetable_.route_num_stops( it->route ) ) {
+                continue;
+            }
+            for ( uint32_t t = 0; t < timetable_.route_num_trips( it->route ); t++ ) {
+                const float departure = timetable_.stop_times( it->route, t )[it->position].departure_time - a.duration;
+                if ( departure >= window_begin && departure <= window_end && active_trips[timetable_.route_trip( it->route, t )] ) {
+                    departures.push_back( departure );
+                }
+            }
+        }
+    }
+    std::sort( departures.begin(), departures.end(), std::greater<float>() );
+    departures.erase( std::unique( departures.begin(), departures.end() ), departures.end() );
+
+    start( max_transfers, min_transfer_time );
+    std::vector<PTJourney> journeys;
+    for ( float departure : departures ) {
+        run( active_trips, access, egress, departure, walking_speed, journeys );
+    }
+
+    // a journey may be rebuilt from the labels of a later departure
+    std::sort( journeys.begin(), journeys.end(), []( const PTJourney& a, const PTJourney& b ) {
+            return std::make_tuple( a.departure_time, a.n_trips, a.arrival_time ) < std::make_tuple( b.departure_time, b.n_trips, b.arrival_time );
+        });
+    std::vector<PTJourney> pareto;
+    for ( size_t i = 0; i < journeys.size(); i++ ) {
+        bool dominated = false;
+        for ( size_t j = 0; j < journeys.size() && !dominated; j++ ) {
+            const PTJourney& a = journeys[j];
+            const PTJourney& b = journeys[i];
+            dominated = j != i && a.departure_time >= b.departure_time && a.arrival_time <= b.arrival_time && a.n_trips <= b.n_trips &&
+                ( j < i || a.departure_time > b.departure_time || a.arrival_time < b.arrival_time || a.n_trips < b.n_trips );
+        }
+        if ( !dominated ) {
+            pareto.push_back( journeys[i] );
+        }
+    }
+    return pareto;
+}
+
+void Raptor::run( const std::vector<bool>& active_trips,
+                  const std::vector<PTAccess>& access,
+                  const std::vector<PTAccess>& egress,
+                  float departure_time,
+                  float walking_speed,
+                  std::vector<PTJourney>& journeys )
+{
+    const uint32_t n_rounds = n_query_rounds_;
+    const float min_transfer_time = min_transfer_time_;
+
+    // round 0: walking access to stops
+    for ( const PTAccess& a : access ) {
+        const float arrival = departure_time + a.duration;
+        if ( arrival < walk_label( 0, a.stop ).arrival_time ) {
+            Label l;
+            l.arrival_time = arrival;
+            l.departure_time = departure_time;
+            l.type = LabelAccess;
+            set_label( 0, a.stop, l );
+        }
+    }
+
+    float best_target = target_arrival_[0];
+    std::vector<std::pair<uint32_t, float>> ride_improved;
+    for ( uint32_t k = 0; k + 1 < n_rounds; k++ ) {
+
+        // routes served by the stops marked in the previous round
+        for ( uint32_t s : marked_stops_ ) {
+            marked_[s] = 0;
+            const PTRouteStop* it, *it_end;
+            for ( std::tie( it, it_end ) = timetable_.stop_routes( s ); it != it_end; it++ ) {
+                uint32_t& position = route_marked_position_[it->route];
+                if ( position == NONE ) {
+                    marked_routes_.push_back( it->route );
+                    position = it->position;
+                }
+                else {
+                    position = std::min( position, it->position );
+                }
+            }
+        }
+        marked_stops_.clear();
+        if ( marked_routes_.empty() ) {
+            break;
+        }
+
+        const uint32_t round = k + 1;
+        best_target = std::min( best_target, target_arrival_[round] );
+        for ( uint32_t r : marked_routes_ ) {
+            n_scanned_routes_++;
+            const uint32_t first_position = route_marked_position_[r];
+            route_marked_position_[r] = NONE;
+            const uint32_t n_route_stops = timetable_.route_num_stops( r );
+            const uint32_t n_route_trips = timetable_.route_num_trips( r );
+
+            uint32_t trip = NONE;
+            uint32_t board_position = 0;
+            uint32_t board_stop = 0;
+            for ( uint32_t i = first_position; i < n_route_stops; i++ ) {
+                const uint32_t s = timetable_.route_stop( r, i );
+                if ( trip != NONE ) {
+                    const PTStopTime* times = timetable_.stop_times( r, trip );
+                    const float arrival = times[i].arrival_time;
+                    if ( arrival < std::min( best_ride_arrival( round, s ), best_target ) ) {
+                        Label l;
+                        l.arrival_time = arrival;
+                        l.departure_time = times[board_position].departure_time;
+                        l.type = LabelRide;
+                        l.from_stop = board_stop;
+                        l.route = r;
+                        l.route_trip = trip;
+                        l.board_position = board_position;
+                        l.alight_position = i;
+                        set_label( round, s, l );
+                    }
+                }
+                // an earlier trip may be caught here
+                if ( i + 1 < n_route_stops && ready_time( k, s ) != PTTimetable::infinity() ) {
+                    const uint32_t n_candidates = trip == NONE ? n_route_trips : trip;
+                    const uint32_t t = earliest_trip( active_trips, r, i, ready_time( k, s ), n_candidates );
+                    if ( t < n_candidates ) {
+                        trip = t;
+                        board_position = i;
+                        board_stop = s;
+                    }
+                }
+            }
+        }
+        marked_routes_.clear();
+
+        // footpaths from the stops improved by a trip
+        ride_improved.clear();
+        for ( uint32_t s : marked_stops_ ) {
+            ride_improved.push_back( std::make_pair( s, ride_label( round, s ).arrival_time ) );
+        }
+        for ( const auto& p : ride_improved ) {
+            const PTFootpath* it, *it_end;
+            for ( std::tie( it, it_end ) = timetable_.footpaths( p.first ); it != it_end; it++ ) {
+                const float arrival = p.second + it->distance / walking_speed;
+                if ( arrival < std::min( ready_time( round, it->stop ), best_target ) ) {
+                    Label l;
+                    l.arrival_time = arrival;
+                    l.departure_time = p.second;
+                    l.type = LabelWalk;
+                    l.from_stop = p.first;
+                    set_label( round, it->stop, l );
+                }
+            }
+        }
+
+        // destination
+        const PTAccess* best_egress = nullptr;
+        for ( const PTAccess& e : egress ) {
+            const float arrival = best_label( round, e.stop ).arrival_time + e.duration;
+            if ( arrival < best_target ) {
+                best_target = arrival;
+                best_egress = &e;
+            }
+        }
+        if ( best_egress ) {
+            target_arrival_[round] = best_target;
+            journeys.push_back( journey( round, best_egress->stop, best_egress->duration, min_transfer_time ) );
+        }
+    }
+
+    // the stops of the last round are not scanned
+    for ( uint32_t s : marked_stops_ ) {
+        marked_[s] = 0;
+    }
+    marked_stops_.clear();
+}
+
+PTJourney Raptor::journey( uint32_t round, uint32_t egress_stop, float egress_duration, float min_transfer_time )
+{
+    std::vector<PTJourneyLeg> legs;
+    const Label* l = &best_label( round, egress_stop );
+    PTJourneyLeg egress_leg = PTJourneyLeg();
+    egress_leg.type = PTJourneyLeg::LegWalk;
+    egress_leg.from_stop = egress_stop;
+    egress_leg.to_stop = PTJourneyLeg::NO_STOP;
+    egress_leg.departure_time = l->arrival_time;
+    egress_leg.arrival_time = egress_leg.departure_time + egress_duration;
+    legs.push_back( egress_leg );
+
+    uint32_t s = egress_stop;
+    uint32_t n_trips = 0;
+    for ( bool done = false; !done; ) {
+        PTJourneyLeg leg = PTJourneyLeg();
+        leg.to_stop = s;
+        leg.departure_time = l->departure_time;
+        leg.arrival_time = l->arrival_time;
+        switch ( l->type ) {
+        case LabelAccess:
+            leg.type = PTJourneyLeg::LegWalk;
+            leg.from_stop = PTJourneyLeg::NO_STOP;
+            done = true;
+            break;
+        case LabelWalk:
+            leg.type = PTJourneyLeg::LegWalk;
+            leg.from_stop = l->from_stop;
+            s = l->from_stop;
+            l = &ride_label( round, s );
+            break;
+        case LabelRide: {
+            leg.type = PTJourneyLeg::LegRide;
+            leg.from_stop = l->from_stop;
+            leg.route = l->route;
+            leg.trip = timetable_.route_trip( l->route, l->route_trip );
+            leg.board_position = l->board_position;
+            leg.alight_position = l->alight_position;
+            n_trips++;
+            // the trip was boarded with a label of a previous round
+            s = l->from_stop;
+            const float boarding_time = l->departure_time;
+            const Label* previous = nullptr;
+            for ( uint32_t j = round; j > 0 && !previous; j-- ) {
+                if ( walk_label( j - 1, s ).arrival_time <= boarding_time ) {
+                    previous = &walk_label( j - 1, s );
+                }
+                else if ( ride_label( j - 1, s ).arrival_time + min_transfer_time <= boarding_time ) {
+                    previous = &ride_label( j - 1, s );
+                }
+                round = j - 1;
+            }
+            BOOST_ASSERT( previous );
+            l = previous;
+            break;
+        }
+        case LabelNone:
+            BOOST_ASSERT( false );
+            done = true;
+            break;
+        }
+        legs.push_back( leg );
+    }
+
+    std::reverse( legs.begin(), legs.end() );
+    PTJourney j;
+    j.departure_time = legs.front().departure_time;
+    j.arrival_time = legs.back().arrival_time;
+    j.n_trips = n_trips;
+    j.legs.swap( legs );
+    return j;
+}
+
+} // namespace Tempus
@@ -0,0 +1,187 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_RAPTOR_HH
+#define TEMPUS_RAPTOR_HH
+
+#include <vector>
+
+#include "pt_timetable.hh"
+
+/**
+ * Round-based public transport routing (RAPTOR, Delling, Pajor & Werneck, 2012).
+ *
+ * Round k computes the earliest arrival at every stop with at most k trips, by scanning
+ * each route served by a stop improved in the previous round once, then relaxing the
+ * footpaths of the stops it improved. No priority queue is involved.
+ */
+
+namespace Tempus
+{
+
+///
+/// RAPTOR earliest arrival queries on a timetable.
+///
+/// Labels are kept from one query to another, only the entries a query touched are reset.
+class Raptor
+{
+public:
+    Raptor( const PTTimetable& timetable );
+
+    ///
+    /// Earliest arrival journeys, one per number of trips that improves the arrival time
+    /// \param active_trips Whether each trip runs on the day of the query
+    /// \param access Stops reachable from the origin
+    /// \param egress Stops the destination is reachable from
+    /// \param departure_time Departure time from the origin, in minutes since midnight
+    /// \param max_transfers Maximum number of transfers between trips
+    /// \param walking_speed Walking speed on footpaths, in meters per minute
+    /// \param min_transfer_time Time needed to board a trip after leaving another one at the same stop (minutes)
+    /// \returns Pareto-optimal journeys over (arrival time, number of trips), by increasing number of trips
+    std::vector<PTJourney> query( const std::vector<bool>& active_trips,
+                                  const std::vector<PTAccess>& access,
+                                  const std::vector<PTAccess>& egress,
+                                  float departure_time,
+                                  uint32_t max_transfers,
+                                  float walking_speed,
+                                  float min_transfer_time );
+
+    ///
+    /// Journeys over a departure window (rRAPTOR), computed in a single pass
+    ///
+    /// Departures are processed from the latest to the earliest one, labels of later departures are kept
+    /// since they remain valid for earlier ones.
+    /// \param window_begin Earliest departure from the origin, in minutes since midnight
+    /// \param window_end Latest departure from the origin, in minutes since midnight
+    /// \returns Pareto-optimal journeys over (departure time, arrival time, number of trips),
+    /// by departure time, then by number of trips
+    std::vector<PTJourney> range_query( const std::vector<bool>& active_trips,
+                                        const std::vector<PTAccess>& access,
+                                        const std::vector<PTAccess>& egress,
+                                        float window_begin,
+                                        float window_end,
+                                        uint32_t max_transfers,
+                                        float walking_speed,
+                                        float min_transfer_time );
+
+    ///
+    /// Number of routes scanned by the last query
+    size_t num_scanned_routes() const { return n_scanned_routes_; }
+
+private:
+    enum LabelType
+    {
+        LabelNone,
+        LabelAccess,
+        LabelRide,
+        LabelWalk
+    };
+
+    struct Label
+    {
+        float arrival_time = PTTimetable::infinity();
+        /// departure time of the last leg
+        float departure_time = PTTimetable::infinity();
+        LabelType type = LabelNone;
+        /// boarding stop of a ride, or origin of a walk
+        uint32_t from_stop = 0;
+        uint32_t route = 0;
+        /// trip index in the route
+        uint32_t route_trip = 0;
+        uint32_t board_position = 0;
+        uint32_t alight_position = 0;
+    };
+
+    ///
+    /// Label of a stop reached by a trip in a round
+    Label& ride_label( uint32_t round, uint32_t s ) { return ride_labels_[size_t(round) * n_stops_ + s]; }
+    ///
+    /// Label of a stop reached by walking in a round
+    Label& walk_label( uint32_t round, uint32_t s ) { return walk_labels_[size_t(round) * n_stops_ + s]; }
+    ///
+    /// Earliest of the two labels of a stop in a round
+    const Label& best_label( uint32_t round, uint32_t s )
+    {
+        const Label& ride = ride_label( round, s );
+        const Label& walk = walk_label( round, s );
+        return ride.arrival_time <= walk.arrival_time ? ride : walk;
+    }
+
+    ///
+    /// Earliest arrival at a stop by a trip, in a round or a previous one
+    float& best_ride_arrival( uint32_t round, uint32_t s ) { return best_ride_arrivals_[size_t(round) * n_stops_ + s]; }
+    ///
+    /// Earliest time a trip can be boarded at a stop, with the labels of a round and of the previous ones
+    float& ready_time( uint32_t round, uint32_t s ) { return ready_times_[size_t(round) * n_stops_ + s]; }
+
+    void set_label( uint32_t round, uint32_t s, const Label& l );
+
+    ///
+    /// Reset the query and size the labels for a number of transfers
+    void start( uint32_t max_transfers, float min_transfer_time );
+
+    ///
+    /// Run the rounds from a departure time, on top of the labels of previous departures
+    /// \param journeys Journeys that improve the arrival time at the destination are appended here
+    void run( const std::vector<bool>& active_trips,
+              const std::vector<PTAccess>& access,
+              const std::vector<PTAccess>& egress,
+              float departure_time,
+              float walking_speed,
+              std::vector<PTJourney>& journeys );
+
+    ///
+    /// Earliest active trip of a route that can be boarded at a position after a time, among the first n_trips
+    uint32_t earliest_trip( const std::vector<bool>& active_trips, uint32_t r, uint32_t position, float time, uint32_t n_trips ) const;
+
+    PTJourney journey( uint32_t round, uint32_t egress_stop, float egress_duration, float min_transfer_time );
+
+    void clear();
+
+    const PTTimetable& timetable_;
+    const uint32_t n_stops_;
+    uint32_t n_rounds_;
+
+    // labels of each round, round-major. Footpaths are not transitive, a stop reached
+    // earlier by walking does not make a later arrival by a trip useless, since more
+    // stops may be reached by walking from there
+    std::vector<Label> ride_labels_;
+    std::vector<Label> walk_labels_;
+    std::vector<size_t> touched_labels_;
+    // see best_ride_arrival() and ready_time(), round-major. A label only prunes the labels
+    // of its round and of the later ones, which take more trips. A walk arriving later than
+    // a trip but before the end of the minimum transfer time still allows to board earlier
+    std::vector<float> best_ride_arrivals_;
+    std::vector<float> ready_times_;
+    std::vector<uint32_t> touched_stops_;
+
+    std::vector<uint8_t> marked_;
+    std::vector<uint32_t> marked_stops_;
+    // earliest marked position of each route, or -1
+    std::vector<uint32_t> route_marked_position_;
+    std::vector<uint32_t> marked_routes_;
+
+    // best arrival time at the destination with the trips of each round, over all departures
+    std::vector<float> target_arrival_;
+    uint32_t n_query_rounds_;
+    float min_transfer_time_;
+
+    size_t n_scanned_routes_;
+};
+
+} // namespace Tempus
+
+#endif
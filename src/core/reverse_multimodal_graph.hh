@@ -282,6 +282,12 @@ std::pair< Edge, bool > edge( const Vertex& u, const Vertex& v, const ReverseGra
 /// Overloading of get()
 VertexIndexProperty get( boost::vertex_index_t, const Multimodal::ReverseGraph& graph );
 
+///
+/// The multimodal graph a (possibly reversed) graph is based on.
+/// Vertices do not store their graph, this gives access to stops and POIs in generic code
+inline const Graph& underlying_graph( const Graph& graph ) { return graph; }
+inline const Graph& underlying_graph( const ReverseGraph& graph ) { return graph.graph(); }
+
 } // multimodal
 
 template <class G>
@@ -0,0 +1,462 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "road_landmarks.hh"
+#include "multimodal_graph.hh"
+#include "utils/timer.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <random>
+#include <boost/format.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace Tempus
+{
+
+float landmark_metric_weight( const Road::Graph& graph, const Road::Edge& e, LandmarkMetric metric )
+{
+    const Road::Section& s = graph[e];
+    if ( metric == LandmarkMetricCarTravelTime ) {
+        if ( ( s.traffic_rules() & TrafficRuleCar ) == 0 || s.car_speed_limit() <= 0.0 ) {
+            return RoadLandmarks::infinity();
+        }
+        // same formula as the travel time of cars in astar_road_plugin
+        return s.length() / (s.car_speed_limit() * 1000.0) * 60.0;
+    }
+    if ( ( s.traffic_rules() & ( TrafficRulePedestrian | TrafficRuleBicycle ) ) == 0 ) {
+        return RoadLandmarks::infinity();
+    }
+    return s.length();
+}
+
+namespace
+{
+
+///
+/// Dijkstra from (Forward) or to (!Forward) an origin vertex
+/// \param weights Weight of each edge, by edge index
+/// \param dist Distances, resized to the number of vertices
+/// \param pred If not null, predecessors in the shortest path tree
+/// \param settled If not null, vertices in settlement order
+template <bool Forward>
+void landmark_dijkstra( const Road::Graph& graph, const std::vector<float>& weights, Road::Vertex origin,
+                        std::vector<float>& dist, std::vector<Road::Vertex>* pred = nullptr, std::vector<Road::Vertex>* settled = nullptr )
+{
+    dist.assign( num_vertices( graph ), RoadLandmarks::infinity() );
+    if ( pred ) {
+        pred->resize( num_vertices( graph ) );
+        for ( size_t v = 0; v < pred->size(); v++ ) {
+            (*pred)[v] = Road::Vertex( v );
+        }
+    }
+    if ( settled ) {
+        settled->clear();
+    }
+
+    typedef std::pair<float, Road::Vertex> QueueEntry;
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> queue;
+    dist[origin] = 0.0;
+    queue.push( std::make_pair( 0.0f, origin ) );
+    while ( !queue.empty() ) {
+        float d = queue.top().first;
+        Road::Vertex u = queue.top().second;
+        queue.pop();
+        if ( d > dist[u] ) {
+            // outdated queue entry
+            continue;
+        }
+        if ( settled ) {
+            settled->push_back( u );
+        }
+        auto relax = [&]( const Road::Edge& e, Road::Vertex v ) {
+            float w = weights[get( boost::edge_index, graph, e )];
+            if ( w == RoadLandmarks::infinity() ) {
+                return;
+            }
+            if ( d + w < dist[v] ) {
+                dist[v] = d + w;
+                if ( pred ) {
+                    (*pred)[v] = u;
+                }
+                queue.push( std::make_pair( d + w, v ) );
+            }
+        };
+        if ( Forward ) {
+            Road::OutEdgeIterator ei, ei_end;
+            for ( boost::tie( ei, ei_end ) = out_edges( u, graph ); ei != ei_end; ei++ ) {
+                relax( *ei, target( *ei, graph ) );
+            }
+        }
+        else {
+            Road::InEdgeIterator ei, ei_end;
+            for ( boost::tie( ei, ei_end ) = in_edges( u, graph ); ei != ei_end; ei++ ) {
+                relax( *ei, source( *ei, graph ) );
+            }
+        }
+    }
+}
+
+///
+/// a - b, where an infinite b means "unreachable": the term is then ignored,
+/// unless a is infinite too
+inline float landmark_bound( float a, float b )
+{
+    if ( b == RoadLandmarks::infinity() ) {
+        return a == RoadLandmarks::infinity() ? 0.0f : -RoadLandmarks::infinity();
+    }
+    return a - b;
+}
+
+// layout of a dump, after the header
+struct LandmarksFileHeader
+{
+    uint64_t n_vertices;
+    uint64_t n_landmarks;
+    uint64_t n_metrics;
+};
+
+}
+
+struct RoadLandmarks::MappedFile
+{
+    boost::interprocess::file_mapping mapping;
+    boost::interprocess::mapped_region region;
+};
+
+RoadLandmarks::RoadLandmarks( const Road::Graph& graph, size_t n_landmarks, LandmarkSelection selection, unsigned seed ) :
+    RoutingData( "road_landmarks" ),
+    n_vertices_( boost::num_vertices( graph ) ),
+    n_landmarks_( n_landmarks ),
+    landmarks_( LandmarkMetricCount * n_landmarks, 0 ),
+    owned_tables_( LandmarkMetricCount * 2 * n_vertices_ * n_landmarks, infinity() )
+{
+    tables_ = owned_tables_.data();
+    for ( int metric = 0; metric < LandmarkMetricCount; metric++ ) {
+        Timer t;
+        select_landmarks( graph, LandmarkMetric( metric ), selection, seed );
+        std::cout << n_landmarks_ << " landmarks computed for metric " << metric << " in " << t.elapsed_ms() << "ms" << std::endl;
+    }
+}
+
+RoadLandmarks::RoadLandmarks( const std::string& filename, size_t offset ) :
+    RoutingData( "road_landmarks" )
+{
+    using namespace boost::interprocess;
+    mapped_file_.reset( new MappedFile );
+    mapped_file_->mapping = file_mapping( filename.c_str(), read_only );
+    mapped_file_->region = mapped_region( mapped_file_->mapping, read_only );
+
+    const char* data = static_cast<const char*>( mapped_file_->region.get_address() );
+    const size_t size = mapped_file_->region.get_size();
+    if ( offset + sizeof(LandmarksFileHeader) > size ) {
+        throw std::runtime_error( "Truncated landmarks file " + filename );
+    }
+    LandmarksFileHeader header;
+    memcpy( &header, data + offset, sizeof(header) );
+    if ( header.n_metrics != LandmarkMetricCount ) {
+        throw std::runtime_error( (boost::format("Wrong number of landmark metrics in %1%") % filename).str() );
+    }
+    n_vertices_ = header.n_vertices;
+    n_landmarks_ = header.n_landmarks;
+
+    size_t landmarks_offset = offset + sizeof(header);
+    size_t tables_offset = landmarks_offset + ( LandmarkMetricCount * n_landmarks_ * sizeof(uint32_t) + 7 ) / 8 * 8;
+    if ( tables_offset + LandmarkMetricCount * 2 * n_vertices_ * n_landmarks_ * sizeof(float) > size ) {
+        throw std::runtime_error( "Truncated landmarks file " + filename );
+    }
+    const uint32_t* landmarks = reinterpret_cast<const uint32_t*>( data + landmarks_offset );
+    landmarks_.assign( landmarks, landmarks + LandmarkMetricCount * n_landmarks_ );
+    tables_ = reinterpret_cast<const float*>( data + tables_offset );
+}
+
+RoadLandmarks::~RoadLandmarks()
+{
+}
+
+void RoadLandmarks::write( std::ostream& ostr ) const
+{
+    LandmarksFileHeader header;
+    header.n_vertices = n_vertices_;
+    header.n_landmarks = n_landmarks_;
+    header.n_metrics = LandmarkMetricCount;
+    ostr.write( reinterpret_cast<const char*>( &header ), sizeof(header) );
+    ostr.write( reinterpret_cast<const char*>( landmarks_.data() ), landmarks_.size() * sizeof(uint32_t) );
+    // align the tables on 8 bytes
+    const char padding[8] = {0};
+    ostr.write( padding, ( 8 - ( landmarks_.size() * sizeof(uint32_t) ) % 8 ) % 8 );
+    ostr.write( reinterpret_cast<const char*>( tables_ ), LandmarkMetricCount * 2 * n_vertices_ * n_landmarks_ * sizeof(float) );
+}
+
+void RoadLandmarks::select_landmarks( const Road::Graph& graph, LandmarkMetric metric, LandmarkSelection selection, unsigned seed )
+{
+    const size_t n = n_vertices_;
+    const size_t K = n_landmarks_;
+    float* from = owned_tables_.data() + ( metric * 2 ) * n * K;
+    float* to = owned_tables_.data() + ( metric * 2 + 1 ) * n * K;
+
+    std::vector<float> weights( num_edges( graph ) );
+    Road::EdgeIterator ei, ei_end;
+    for ( boost::tie( ei, ei_end ) = edges( graph ); ei != ei_end; ei++ ) {
+        weights[get( boost::edge_index, graph, *ei )] = landmark_metric_weight( graph, *ei, metric );
+    }
+
+    // vertices of the network of this metric
+    std::vector<Road::Vertex> candidates;
+    for ( Road::Vertex v = 0; v < n; v++ ) {
+        Road::OutEdgeIterator oei, oei_end;
+        for ( boost::tie( oei, oei_end ) = out_edges( v, graph ); oei != oei_end; oei++ ) {
+            if ( weights[get( boost::edge_index, graph, *oei )] != infinity() ) {
+                candidates.push_back( v );
+                break;
+            }
+        }
+    }
+    if ( candidates.empty() || K == 0 ) {
+        return;
+    }
+    std::mt19937 rng( seed + metric );
+
+    std::vector<float> dist;
+    auto farthest = [&]( const std::function<float(Road::Vertex)>& score ) {
+        Road::Vertex best = candidates[0];
+        float best_score = -1.0;
+        for ( Road::Vertex v : candidates ) {
+            float s = score( v );
+            if ( s != infinity() && s > best_score ) {
+                best_score = s;
+                best = v;
+            }
+        }
+        return best;
+    };
+    // minimum round trip distance to the k first landmarks
+    auto round_trip = [&]( size_t k, Road::Vertex v ) {
+        float m = infinity();
+        for ( size_t j = 0; j < k; j++ ) {
+            m = std::min( m, from[v * K + j] + to[v * K + j] );
+        }
+        return m;
+    };
+    // lower bound of the distance from u to v given by the k first landmarks
+    auto lower_bound = [&]( size_t k, Road::Vertex u, Road::Vertex v ) {
+        float b = 0.0;
+        for ( size_t j = 0; j < k; j++ ) {
+            b = std::max( b, landmark_bound( from[v * K + j], from[u * K + j] ) );
+            b = std::max( b, landmark_bound( to[u * K + j], to[v * K + j] ) );
+        }
+        return b;
+    };
+
+    std::vector<bool> is_landmark( n, false );
+    for ( size_t k = 0; k < K; k++ ) {
+        Road::Vertex landmark;
+        if ( k == 0 ) {
+            // the farthest vertex from a random one
+            landmark_dijkstra<true>( graph, weights, candidates[rng() % candidates.size()], dist );
+            landmark = farthest( [&dist]( Road::Vertex v ) { return dist[v]; } );
+        }
+        else if ( selection == LandmarkSelectionFarthest ) {
+            landmark = farthest( [&]( Road::Vertex v ) { return round_trip( k, v ); } );
+        }
+        else {
+            // shortest path tree from a random root
+            const Road::Vertex root = candidates[rng() % candidates.size()];
+            std::vector<Road::Vertex> pred, settled;
+            landmark_dijkstra<true>( graph, weights, root, dist, &pred, &settled );
+
+            // size of a subtree: sum of the differences between the distance from the root
+            // and its lower bound, null if the subtree contains a landmark
+            std::vector<float> size( n, 0.0 );
+            std::vector<bool> has_landmark( n, false );
+            for ( auto it = settled.rbegin(); it != settled.rend(); it++ ) {
+                const Road::Vertex v = *it;
+                size[v] += dist[v] - lower_bound( k, root, v );
+                has_landmark[v] = has_landmark[v] || is_landmark[v];
+                if ( has_landmark[v] ) {
+                    size[v] = 0.0;
+                }
+                if ( v != root ) {
+                    if ( has_landmark[v] ) {
+                        has_landmark[pred[v]] = true;
+                    }
+                    else {
+                        size[pred[v]] += size[v];
+                    }
+                }
+            }
+
+            // children of each vertex in the tree
+            std::vector<uint32_t> first_child( n + 1, 0 );
+            for ( Road::Vertex v : settled ) {
+                if ( v != root ) {
+                    first_child[pred[v] + 1]++;
+                }
+            }
+            for ( size_t v = 0; v < n; v++ ) {
+                first_child[v + 1] += first_child[v];
+            }
+            std::vector<Road::Vertex> children( first_child[n] );
+            {
+                std::vector<uint32_t> next( first_child.begin(), first_child.end() - 1 );
+                for ( Road::Vertex v : settled ) {
+                    if ( v != root ) {
+                        children[next[pred[v]]++] = v;
+                    }
+                }
+            }
+
+            // go down the largest subtrees, to a leaf
+            landmark = root;
+            if ( size[root] > 0.0 ) {
+                while ( first_child[landmark] < first_child[landmark + 1] ) {
+                    Road::Vertex next = landmark;
+                    for ( uint32_t i = first_child[landmark]; i < first_child[landmark + 1]; i++ ) {
+                        if ( next == landmark || size[children[i]] > size[next] ) {
+                            next = children[i];
+                        }
+                    }
+                    landmark = next;
+                }
+            }
+            if ( is_landmark[landmark] || size[root] <= 0.0 ) {
+                // every subtree is covered
+                landmark = farthest( [&]( Road::Vertex v ) { return round_trip( k, v ); } );
+            }
+        }
+
+        is_landmark[landmark] = true;
+        landmarks_[metric * K + k] = uint32_t( landmark );
+
+        std::vector<float> from_landmark, to_landmark;
+        #pragma omp parallel sections
+        {
+            #pragma omp section
+            landmark_dijkstra<true>( graph, weights, landmark, from_landmark );
+            #pragma omp section
+            landmark_dijkstra<false>( graph, weights, landmark, to_landmark );
+        }
+        for ( size_t v = 0; v < n; v++ ) {
+            from[v * K + k] = from_landmark[v];
+            to[v * K + k] = to_landmark[v];
+        }
+    }
+}
+
+ALTHeuristic::ALTHeuristic( const RoadLandmarks& landmarks, LandmarkMetric metric, Road::Vertex origin, Road::Vertex destination, float scale, size_t n_active ) :
+    landmarks_( landmarks ),
+    metric_( metric ),
+    scale_( scale )
+{
+    const size_t K = landmarks.num_landmarks();
+    const float* from_o = landmarks.from_landmarks( metric, origin );
+    const float* to_o = landmarks.to_landmarks( metric, origin );
+    const float* from_d = landmarks.from_landmarks( metric, destination );
+    const float* to_d = landmarks.to_landmarks( metric, destination );
+
+    // landmarks with the best lower bounds between the origin and the destination
+    std::vector<std::pair<float, uint32_t>> bounds;
+    for ( uint32_t k = 0; k < K; k++ ) {
+        float b = std::max( landmark_bound( from_d[k], from_o[k] ), landmark_bound( to_o[k], to_d[k] ) );
+        if ( b > 0.0 ) {
+            bounds.push_back( std::make_pair( b, k ) );
+        }
+    }
+    std::sort( bounds.begin(), bounds.end(), std::greater<std::pair<float, uint32_t>>() );
+    for ( size_t i = 0; i < std::min( n_active, bounds.size() ); i++ ) {
+        const uint32_t k = bounds[i].second;
+        active_.push_back( k );
+        from_landmark_to_destination_.push_back( from_d[k] );
+        from_destination_to_landmark_.push_back( to_d[k] );
+    }
+}
+
+float ALTHeuristic::operator()( const Road::Vertex& v ) const
+{
+    const float* from_v = landmarks_.from_landmarks( metric_, v );
+    const float* to_v = landmarks_.to_landmarks( metric_, v );
+    float h = 0.0;
+    for ( size_t i = 0; i < active_.size(); i++ ) {
+        const uint32_t k = active_[i];
+        // d(v,t) >= d(L,t) - d(L,v) and d(v,t) >= d(v,L) - d(t,L)
+        h = std::max( h, landmark_bound( from_landmark_to_destination_[i], from_v[k] ) );
+        h = std::max( h, landmark_bound( to_v[k], from_destination_to_landmark_[i] ) );
+    }
+    return h * scale_;
+}
+
+LandmarkSelection landmark_selection_from_string( const std::string& name )
+{
+    if ( name == "avoid" ) {
+        return LandmarkSelectionAvoid;
+    }
+    if ( name == "farthest" ) {
+        return LandmarkSelectionFarthest;
+    }
+    throw std::invalid_argument( "Unknown landmark selection " + name );
+}
+
+std::unique_ptr<RoutingData> RoadLandmarksBuilder::pg_import( const std::string& /*pg_options*/, ProgressionCallback& progression, const VariantMap& options ) const
+{
+    size_t n_landmarks = 16;
+    LandmarkSelection selection = LandmarkSelectionAvoid;
+    auto it = options.find( "landmarks/count" );
+    if ( it != options.end() ) {
+        n_landmarks = size_t( it->second.as<int64_t>() );
+    }
+    it = options.find( "landmarks/selection" );
+    if ( it != options.end() ) {
+        selection = landmark_selection_from_string( it->second.str() );
+    }
+
+    const Multimodal::Graph* graph = dynamic_cast<const Multimodal::Graph*>( load_routing_data( "multimodal_graph", progression, options ) );
+    if ( graph == nullptr ) {
+        throw std::runtime_error( "Problem loading the multimodal graph" );
+    }
+    return std::unique_ptr<RoutingData>( new RoadLandmarks( graph->road(), n_landmarks, selection ) );
+}
+
+std::unique_ptr<RoutingData> RoadLandmarksBuilder::file_import( const std::string& filename, ProgressionCallback& /*progression*/, const VariantMap& /*options*/ ) const
+{
+    size_t offset;
+    {
+        std::ifstream ifs( filename, std::ios::binary );
+        if ( ifs.fail() ) {
+            throw std::runtime_error( "Problem opening input file " + filename );
+        }
+        read_header( ifs );
+        offset = size_t( ifs.tellg() );
+    }
+    return std::unique_ptr<RoutingData>( new RoadLandmarks( filename, offset ) );
+}
+
+void RoadLandmarksBuilder::file_export( const RoutingData* rd, const std::string& filename, ProgressionCallback& /*progression*/, const VariantMap& /*options*/ ) const
+{
+    std::ofstream ofs( filename, std::ios::binary );
+
+    // the header is 264 bytes long, tables stay aligned
+    write_header( ofs );
+
+    static_cast<const RoadLandmarks*>( rd )->write( ofs );
+}
+
+REGISTER_BUILDER( RoadLandmarksBuilder )
+
+} // namespace Tempus
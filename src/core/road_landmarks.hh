@@ -0,0 +1,186 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_ROAD_LANDMARKS_HH
+#define TEMPUS_ROAD_LANDMARKS_HH
+
+#include <vector>
+#include <memory>
+#include <limits>
+
+#include "road_graph.hh"
+#include "routing_data.hh"
+#include "routing_data_builder.hh"
+
+/**
+ * Landmarks for A*, Landmarks and Triangle inequality (ALT).
+ *
+ * Distances from and to a small set of landmarks give, by the triangle inequality, a lower
+ * bound of the distance between any two vertices. It is a much tighter A* heuristic than an
+ * euclidian distance divided by a maximum speed.
+ */
+
+namespace Tempus
+{
+
+///
+/// Metrics landmark distances are computed for
+enum LandmarkMetric
+{
+    /// Travel time of cars at the speed limit of road sections, in minutes
+    LandmarkMetricCarTravelTime = 0,
+    /// Length in meters of the sections allowed to pedestrians or to bicycles.
+    /// Divided by a speed, it gives a lower bound of the walking or cycling travel time
+    LandmarkMetricWalkingCyclingLength,
+
+    LandmarkMetricCount
+};
+
+///
+/// Landmark selection strategy
+enum LandmarkSelection
+{
+    /// Each new landmark is the vertex the farthest from the previous ones
+    LandmarkSelectionFarthest,
+    /// Each new landmark is a leaf of the subtree of a shortest path tree where the
+    /// current landmarks give the worst lower bounds (Goldberg & Werneck's "avoid")
+    LandmarkSelectionAvoid
+};
+
+///
+/// Weight of a road section in a landmark metric, infinity if the section can't be used
+float landmark_metric_weight( const Road::Graph& graph, const Road::Edge& e, LandmarkMetric metric );
+
+///
+/// Distances between landmarks and every road vertex, for each metric.
+///
+/// Distances of a vertex to (or from) all the landmarks are stored next to each other, so
+/// that a heuristic evaluation reads a single cache line. All the tables are stored in one
+/// contiguous array, which is directly memory-mapped when loaded from a dump file.
+class RoadLandmarks : public RoutingData
+{
+public:
+    static float infinity() { return std::numeric_limits<float>::infinity(); }
+
+    ///
+    /// Select landmarks and compute their distances on a road graph
+    /// \param graph The road graph
+    /// \param n_landmarks Number of landmarks for each metric
+    /// \param selection Landmark selection strategy
+    /// \param seed Seed of the random choices of the selection
+    RoadLandmarks( const Road::Graph& graph, size_t n_landmarks, LandmarkSelection selection, unsigned seed = 0 );
+
+    ///
+    /// Memory-map landmarks written by write() in a file
+    /// \param filename The file
+    /// \param offset Position of the landmarks in the file
+    RoadLandmarks( const std::string& filename, size_t offset );
+
+    ~RoadLandmarks();
+
+    size_t num_vertices() const { return n_vertices_; }
+    size_t num_landmarks() const { return n_landmarks_; }
+
+    ///
+    /// The k-th landmark of a metric
+    Road::Vertex landmark( LandmarkMetric metric, size_t k ) const { return landmarks_[metric * n_landmarks_ + k]; }
+
+    ///
+    /// Distances from each landmark to v
+    const float* from_landmarks( LandmarkMetric metric, Road::Vertex v ) const { return table( metric, 0 ) + v * n_landmarks_; }
+
+    ///
+    /// Distances from v to each landmark
+    const float* to_landmarks( LandmarkMetric metric, Road::Vertex v ) const { return table( metric, 1 ) + v * n_landmarks_; }
+
+    ///
+    /// Write landmarks in the layout expected by the memory-mapping constructor.
+    /// The stream must be positioned at an offset aligned on 8 bytes
+    void write( std::ostream& ostr ) const;
+
+private:
+    const float* table( LandmarkMetric metric, int direction ) const
+    {
+        return tables_ + ( metric * 2 + direction ) * n_vertices_ * n_landmarks_;
+    }
+
+    void select_landmarks( const Road::Graph& graph, LandmarkMetric metric, LandmarkSelection selection, unsigned seed );
+
+    size_t n_vertices_;
+    size_t n_landmarks_;
+    std::vector<uint32_t> landmarks_;
+
+    // tables, either owned or mapped
+    std::vector<float> owned_tables_;
+    struct MappedFile;
+    std::unique_ptr<MappedFile> mapped_file_;
+    const float* tables_;
+};
+
+///
+/// ALT heuristic: lower bound of the distance from a vertex to a destination.
+///
+/// Only the landmarks that give the best bound between the origin and the destination are used.
+class ALTHeuristic
+{
+public:
+    ///
+    /// \param landmarks Landmark distances
+    /// \param metric Metric to use
+    /// \param origin Origin of the query, used to select the active landmarks
+    /// \param destination Destination of the query
+    /// \param scale Factor applied to landmark distances (inverse of a speed for lengths)
+    /// \param n_active Maximum number of active landmarks
+    ALTHeuristic( const RoadLandmarks& landmarks, LandmarkMetric metric, Road::Vertex origin, Road::Vertex destination, float scale = 1.0, size_t n_active = 8 );
+
+    float operator()( const Road::Vertex& v ) const;
+
+    const std::vector<uint32_t>& active_landmarks() const { return active_; }
+
+private:
+    const RoadLandmarks& landmarks_;
+    const LandmarkMetric metric_;
+    const float scale_;
+    std::vector<uint32_t> active_;
+    // distances between the destination and the active landmarks
+    std::vector<float> from_landmark_to_destination_;
+    std::vector<float> from_destination_to_landmark_;
+};
+
+///
+/// Builder of road landmarks.
+///
+/// Landmarks are computed on the road graph of the multimodal graph loaded with the same options.
+/// Options: "landmarks/count" (16), "landmarks/selection" ("avoid" or "farthest")
+class RoadLandmarksBuilder : public RoutingDataBuilder
+{
+public:
+    RoadLandmarksBuilder() : RoutingDataBuilder( "road_landmarks" ) {}
+
+    virtual std::unique_ptr<RoutingData> pg_import( const std::string& pg_options, ProgressionCallback& progression, const VariantMap& options = VariantMap() ) const override;
+
+    virtual std::unique_ptr<RoutingData> file_import( const std::string& filename, ProgressionCallback& progression, const VariantMap& options = VariantMap() ) const override;
+    virtual void file_export( const RoutingData* rd, const std::string& filename, ProgressionCallback& progression, const VariantMap& options = VariantMap() ) const override;
+};
+
+///
+/// Parse a landmark selection strategy name ("avoid" or "farthest").
+/// Throws std::invalid_argument for another name
+LandmarkSelection landmark_selection_from_string( const std::string& name );
+
+} // namespace Tempus
+
+#endif
@@ -218,23 +218,42 @@ public:
 /// An isochrone is a collection of vertex id associated to a cost
 using Isochrone = std::vector<IsochroneValue>;
 
+class TravelTimeProfileValue
+{
+public:
+    TravelTimeProfileValue( double ldeparture_time, double ltravel_time ) : departure_time_( ldeparture_time ), travel_time_( ltravel_time ) {}
+    /// departure time, in minutes since midnight
+    DECLARE_RW_PROPERTY( departure_time, double );
+    /// travel time, in minutes
+    DECLARE_RW_PROPERTY( travel_time, double );
+};
+
+///
+/// A travel time profile is the travel time of a path as a function of the departure time.
+/// The function is linear between its breakpoints and constant before the first and after the last one
+using TravelTimeProfile = std::vector<TravelTimeProfileValue>;
+
 ///
-/// A ResultElement is either an Isochrone or a Roadmap
+/// A ResultElement is either an Isochrone, a Roadmap or a TravelTimeProfile
 class ResultElement
 {
 public:
     ResultElement() {}
     ResultElement( const Isochrone& iso ) : element_( iso ) {}
     ResultElement( const Roadmap& rm ) : element_( rm ) {}
+    ResultElement( const TravelTimeProfile& profile ) : element_( profile ) {}
 
     bool is_roadmap() const { return element_.which() == 1; }
     bool is_isochrone() const { return element_.which() == 0; }
+    bool is_travel_time_profile() const { return element_.which() == 2; }
     Isochrone& isochrone() { return boost::get<Isochrone>(element_); }
     Roadmap& roadmap() { return boost::get<Roadmap>(element_); }
+    TravelTimeProfile& travel_time_profile() { return boost::get<TravelTimeProfile>(element_); }
     const Isochrone& isochrone() const { return boost::get<Isochrone>(element_); }
     const Roadmap& roadmap() const { return boost::get<Roadmap>(element_); }
+    const TravelTimeProfile& travel_time_profile() const { return boost::get<TravelTimeProfile>(element_); }
 private:
-    using Element = boost::variant<Isochrone, Roadmap>;
+    using Element = boost::variant<Isochrone, Roadmap, TravelTimeProfile>;
     Element element_;
 };
 
@@ -162,46 +162,53 @@ void unserialize( std::istream& istr, Point3D& pt, binary_serialization_t )
     pt.set_z( f[2] );
 }
 
-void serialize( std::ostream& ostr, const Road::Graph& graph, binary_serialization_t )
+///
+/// Write a vector of POD in one block
+template <typename T>
+static void serialize_pod_vector( std::ostream& ostr, const std::vector<T>& v )
 {
-    uint32_t cs = graph.m_forward.m_column.size();
-    ostr.write( (const char*)&cs, sizeof(cs) );
-    ostr.write( (const char*) &graph.m_forward.m_column[0], sizeof(decltype(graph.m_forward.m_column)::value_type) * cs );
+    uint32_t s = v.size();
+    ostr.write( (const char*)&s, sizeof(s) );
+    if ( s ) {
+        ostr.write( (const char*) &v[0], sizeof(T) * s );
+    }
+}
 
-    uint32_t rs = graph.m_forward.m_rowstart.size();
-    ostr.write( (const char*)&rs, sizeof(rs) );
-    ostr.write( (const char*) &graph.m_forward.m_rowstart[0], sizeof(decltype(graph.m_forward.m_rowstart)::value_type) * rs );
+template <typename T>
+static void unserialize_pod_vector( std::istream& istr, std::vector<T>& v )
+{
+    uint32_t s;
+    istr.read( (char*)&s, sizeof(s) );
+    v.resize( s );
+    if ( s ) {
+        istr.read( (char*) &v[0], sizeof(T) * s );
+    }
+}
 
-    uint32_t vs = graph.m_vertex_properties.size();
-    ostr.write( (const char*)&vs, sizeof(vs) );
-    ostr.write( (const char*) &graph.m_vertex_properties[0], sizeof(decltype(graph.m_vertex_properties)::value_type) * vs );
+void serialize( std::ostream& ostr, const Road::Graph& graph, binary_serialization_t )
+{
+    // edges, in both directions
+    serialize_pod_vector( ostr, graph.m_forward.m_rowstart );
+    serialize_pod_vector( ostr, graph.m_forward.m_column );
+    serialize_pod_vector( ostr, graph.m_forward.m_edge_properties );
+    serialize_pod_vector( ostr, graph.m_backward.m_rowstart );
+    serialize_pod_vector( ostr, graph.m_backward.m_column );
+    serialize_pod_vector( ostr, graph.m_backward.m_edge_properties );
 
-    uint32_t ps = graph.m_forward.m_edge_properties.size();
-    ostr.write( (const char*)&ps, sizeof(ps) );
-    ostr.write( (const char*) &graph.m_forward.m_edge_properties[0], sizeof(decltype(graph.m_forward.m_edge_properties)::value_type) * ps );
+    serialize_pod_vector( ostr, graph.m_vertex_properties );
 }
 
 void unserialize( std::istream& istr, Road::Graph& graph, binary_serialization_t )
 {
-    uint32_t cs;
-    istr.read( (char*)&cs, sizeof(cs) );
-    graph.m_forward.m_column.resize(cs);
-    istr.read( (char*) &graph.m_forward.m_column[0], sizeof(decltype(graph.m_forward.m_column)::value_type) * cs );
+    // edges, in both directions
+    unserialize_pod_vector( istr, graph.m_forward.m_rowstart );
+    unserialize_pod_vector( istr, graph.m_forward.m_column );
+    unserialize_pod_vector( istr, graph.m_forward.m_edge_properties );
+    unserialize_pod_vector( istr, graph.m_backward.m_rowstart );
+    unserialize_pod_vector( istr, graph.m_backward.m_column );
+    unserialize_pod_vector( istr, graph.m_backward.m_edge_properties );
 
-    uint32_t rs;
-    istr.read( (char*)&rs, sizeof(rs) );
-    graph.m_forward.m_rowstart.resize(rs);
-    istr.read( (char*) &graph.m_forward.m_rowstart[0], sizeof(decltype(graph.m_forward.m_rowstart)::value_type) * rs );
-
-    uint32_t vs;
-    istr.read( (char*)&vs, sizeof(vs) );
-    graph.m_vertex_properties.resize(vs);
-    istr.read( (char*) &graph.m_vertex_properties[0], sizeof(decltype(graph.m_vertex_properties)::value_type) * vs );
-
-    uint32_t ps;
-    istr.read( (char*)&ps, sizeof(ps) );
-    graph.m_forward.m_edge_properties.resize(ps);
-    istr.read( (char*) &graph.m_forward.m_edge_properties[0], sizeof(decltype(graph.m_forward.m_edge_properties)::value_type) * ps );
+    unserialize_pod_vector( istr, graph.m_vertex_properties );
 }
 
 void serialize( std::ostream& ostr, const PublicTransport::Stop& stop, binary_serialization_t t )
@@ -237,20 +244,44 @@ void unserialize( std::istream& istr, PublicTransport::Stop& stop, binary_serial
     unserialize( istr, stop.coordinates_, t );
 }
 
-void serialize( std::ostream& ostr, const PublicTransport::Section& section, binary_serialization_t t )
+void serialize( std::ostream& ostr, const PublicTransport::GraphProperties& props, binary_serialization_t t )
 {
-    serialize( ostr, section.network_id(), t );
+    const PublicTransport::ServiceMap& services = props.service_map_;
+    serialize_pod_vector( ostr, services.service_ids_ );
+    serialize( ostr, services.first_day_, t );
+    serialize( ostr, services.n_words_, t );
+    serialize_pod_vector( ostr, services.days_ );
+
+    serialize_pod_vector( ostr, props.trip_times_ );
+    serialize_pod_vector( ostr, props.time_table_offsets_ );
 }
 
-void unserialize( std::istream& istr, PublicTransport::Section& section, binary_serialization_t t )
+void unserialize( std::istream& istr, PublicTransport::GraphProperties& props, binary_serialization_t t )
 {
-    db_id_t db_id;
-    unserialize( istr, db_id, t );
-    section.set_network_id(db_id);
+    PublicTransport::ServiceMap& services = props.service_map_;
+    unserialize_pod_vector( istr, services.service_ids_ );
+    unserialize( istr, services.first_day_, t );
+    unserialize( istr, services.n_words_, t );
+    unserialize_pod_vector( istr, services.days_ );
+    services.index_.clear();
+    for ( uint32_t i = 0; i < services.service_ids_.size(); i++ ) {
+        services.index_[services.service_ids_[i]] = i;
+    }
+
+    unserialize_pod_vector( istr, props.trip_times_ );
+    unserialize_pod_vector( istr, props.time_table_offsets_ );
 }
 
 void serialize( std::ostream& ostr, const PublicTransport::Graph& graph, binary_serialization_t t )
 {
+    // edges, in both directions
+    serialize_pod_vector( ostr, graph.m_forward.m_rowstart );
+    serialize_pod_vector( ostr, graph.m_forward.m_column );
+    serialize_pod_vector( ostr, graph.m_forward.m_edge_properties );
+    serialize_pod_vector( ostr, graph.m_backward.m_rowstart );
+    serialize_pod_vector( ostr, graph.m_backward.m_column );
+    serialize_pod_vector( ostr, graph.m_backward.m_edge_properties );
+
     // vertices
     size_t n_vertices = num_vertices( graph );
     serialize( ostr, n_vertices, t );
@@ -259,43 +290,28 @@ void serialize( std::ostream& ostr, const PublicTransport::Graph& graph, binary_
         serialize( ostr, graph[*it], t );
     }
 
-    // edges
-    size_t n_edges = num_edges( graph );
-    serialize( ostr, n_edges, t );
-    PublicTransport::EdgeIterator eit, eit_end;
-    for ( boost::tie(eit, eit_end) = edges( graph ); eit != eit_end; eit++ ) {
-        PublicTransport::Vertex v1, v2;
-        v1 = source( *eit, graph );
-        v2 = target( *eit, graph );
-        serialize( ostr, v1, t );
-        serialize( ostr, v2, t );
-        serialize( ostr, graph[*eit], t );
-    }
+    serialize( ostr, get_property( graph ), t );
 }
 
 void unserialize( std::istream& istr, PublicTransport::Graph& graph, binary_serialization_t t )
 {
+    // edges, in both directions
+    unserialize_pod_vector( istr, graph.m_forward.m_rowstart );
+    unserialize_pod_vector( istr, graph.m_forward.m_column );
+    unserialize_pod_vector( istr, graph.m_forward.m_edge_properties );
+    unserialize_pod_vector( istr, graph.m_backward.m_rowstart );
+    unserialize_pod_vector( istr, graph.m_backward.m_column );
+    unserialize_pod_vector( istr, graph.m_backward.m_edge_properties );
+
     // vertices
     size_t n_vertices;
     unserialize( istr, n_vertices, t );
+    graph.m_vertex_properties.resize( n_vertices );
     for ( size_t i = 0; i < n_vertices; i++ ) {
-        PublicTransport::Vertex v = add_vertex( graph );
-        unserialize( istr, graph[v], t );
+        unserialize( istr, graph[PublicTransport::Vertex( i )], t );
     }
 
-    // edges
-    size_t n_edges;
-    unserialize( istr, n_edges, t );
-    for ( size_t i = 0; i < n_edges; i++ ) {
-        PublicTransport::Vertex v1, v2;
-        unserialize( istr, v1, t );
-        unserialize( istr, v2, t );
-        PublicTransport::Edge e;
-        bool is_added = false;
-        boost::tie( e, is_added ) = add_edge( v1, v2, graph );
-        BOOST_ASSERT( is_added );
-        unserialize( istr, graph[e], t );
-    }
+    unserialize( istr, get_property( graph ), t );
 }
 
 void serialize( std::ostream& ostr, const Multimodal::Graph::StopIndex& s, binary_serialization_t t )
@@ -459,6 +475,8 @@ void unserialize( std::istream& istr, Multimodal::Graph& graph, binary_serializa
     unserialize( istr, graph.road_edge_pois_, t );
     // edge stops
     unserialize( istr, graph.road_edge_stops_, t );
+
+    graph.build_adjacency();
 }
 
 }
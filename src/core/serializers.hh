@@ -42,6 +42,7 @@ namespace PublicTransport
 {
 struct Stop;
 struct Section;
+class GraphProperties;
 }
 namespace Multimodal
 {
@@ -52,6 +53,8 @@ struct binary_serialization_t {};
 
 void serialize( std::ostream& ostr, const PublicTransport::Stop& stop, binary_serialization_t t );
 void unserialize( std::istream& istr, PublicTransport::Stop& stop, binary_serialization_t t );
+void serialize( std::ostream& ostr, const PublicTransport::GraphProperties& props, binary_serialization_t t );
+void unserialize( std::istream& istr, PublicTransport::GraphProperties& props, binary_serialization_t t );
 void serialize( std::ostream& ostr, const TransportMode& tm, binary_serialization_t t );
 void unserialize( std::istream& istr, TransportMode& tm, binary_serialization_t t );
 void serialize( std::ostream& ostr, const Multimodal::Graph& g, binary_serialization_t t );
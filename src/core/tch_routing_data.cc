@@ -0,0 +1,502 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tch_routing_data.hh"
+#include "ch_query_workspace.hh"
+#include "utils/timer.hh"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <tuple>
+#include <unordered_map>
+#include <boost/format.hpp>
+
+namespace Tempus
+{
+
+const uint32_t TCHRoutingData::NONE;
+
+namespace
+{
+
+// maximum number of vertices settled by a witness search
+const size_t WITNESS_SETTLED_LIMIT = 500;
+
+///
+/// Edge of the graph being contracted
+struct ContractionEdge
+{
+    uint32_t from;
+    uint32_t to;
+    TravelTimeFunction travel_time;
+    // (middle vertex or NONE, function of the road section, road section id)
+    std::vector<std::tuple<uint32_t, uint32_t, db_id_t>> candidates;
+};
+
+uint64_t edge_key( uint32_t u, uint32_t v )
+{
+    return ( uint64_t( u ) << 32 ) | v;
+}
+
+///
+/// Per-thread workspace of a query: upward arrival times, lower bounds to the destination
+/// and downward arrival times
+struct TCHQueryWorkspace
+{
+    TimestampedLabels<double> up;
+    TimestampedLabels<double> bound;
+    TimestampedLabels<double> down;
+    ReusableMinQueue<double> queue;
+    std::vector<uint32_t> meeting;
+
+    void reset( size_t n )
+    {
+        up.reset( n );
+        bound.reset( n );
+        down.reset( n );
+        queue.clear();
+        meeting.clear();
+    }
+};
+
+}
+
+TCHRoutingData::TCHRoutingData( std::vector<db_id_t>&& a_node_id, const std::vector<TCHSection>& sections ) :
+    RoutingData( "tch_graph" ),
+    node_id_( a_node_id )
+{
+    Timer timer;
+    const uint32_t n = uint32_t( node_id_.size() );
+    const uint32_t none = NONE;
+
+    std::vector<ContractionEdge> edges;
+    std::unordered_map<uint64_t, uint32_t> edge_index;
+    std::vector<std::vector<uint32_t>> out( n ), in( n );
+
+    // parallel road sections are merged in one edge, each of them is a candidate
+    for ( const TCHSection& s : sections ) {
+        if ( s.from == s.to ) {
+            continue;
+        }
+        const uint32_t f = uint32_t( functions_.size() );
+        functions_.push_back( s.travel_time );
+        auto it = edge_index.find( edge_key( s.from, s.to ) );
+        if ( it == edge_index.end() ) {
+            edge_index[edge_key( s.from, s.to )] = uint32_t( edges.size() );
+            out[s.from].push_back( uint32_t( edges.size() ) );
+            in[s.to].push_back( uint32_t( edges.size() ) );
+            edges.push_back( ContractionEdge{ s.from, s.to, s.travel_time, { std::make_tuple( none, f, s.db_id ) } } );
+        }
+        else {
+            ContractionEdge& e = edges[it->second];
+            e.travel_time = e.travel_time.merge( s.travel_time );
+            e.candidates.push_back( std::make_tuple( none, f, s.db_id ) );
+        }
+    }
+
+    // witness search: upper bounds of the travel times from a vertex, in the remaining graph
+    TimestampedLabels<double> witness;
+    ReusableMinQueue<double> queue;
+
+    for ( uint32_t v = 0; v < n; v++ ) {
+        std::vector<uint32_t> in_edges, out_edges;
+        for ( uint32_t e : in[v] ) {
+            if ( edges[e].from > v ) {
+                in_edges.push_back( e );
+            }
+        }
+        for ( uint32_t e : out[v] ) {
+            if ( edges[e].to > v ) {
+                out_edges.push_back( e );
+            }
+        }
+        if ( out_edges.empty() ) {
+            continue;
+        }
+
+        for ( uint32_t e1 : in_edges ) {
+            const uint32_t u = edges[e1].from;
+            // copied, since edges may be added
+            const TravelTimeFunction f1 = edges[e1].travel_time;
+
+            double max_bound = 0.0;
+            for ( uint32_t e2 : out_edges ) {
+                max_bound = std::max( max_bound, f1.min() + edges[e2].travel_time.min() );
+            }
+
+            witness.reset( n );
+            queue.clear();
+            witness.set( u, 0.0, u );
+            queue.push( 0.0, u );
+            size_t settled = 0;
+            while ( !queue.empty() && settled < WITNESS_SETTLED_LIMIT ) {
+                double d;
+                uint32_t x;
+                std::tie( d, x ) = queue.top();
+                queue.pop();
+                if ( d > witness.potential( x ) ) {
+                    continue;
+                }
+                if ( d > max_bound ) {
+                    break;
+                }
+                settled++;
+                for ( uint32_t e : out[x] ) {
+                    const uint32_t y = edges[e].to;
+                    if ( y <= v ) {
+                        continue;
+                    }
+                    const double dy = d + edges[e].travel_time.max();
+                    if ( dy < witness.potential( y ) ) {
+                        witness.set( y, dy, x );
+                        queue.push( dy, y );
+                    }
+                }
+            }
+
+            for ( uint32_t e2 : out_edges ) {
+                const uint32_t w = edges[e2].to;
+                if ( w == u ) {
+                    continue;
+                }
+                // a path avoiding v is never slower
+                if ( witness.potential( w ) <= f1.min() + edges[e2].travel_time.min() ) {
+                    continue;
+                }
+                TravelTimeFunction h = f1.link( edges[e2].travel_time );
+                auto it = edge_index.find( edge_key( u, w ) );
+                if ( it == edge_index.end() ) {
+                    edge_index[edge_key( u, w )] = uint32_t( edges.size() );
+                    out[u].push_back( uint32_t( edges.size() ) );
+                    in[w].push_back( uint32_t( edges.size() ) );
+                    edges.push_back( ContractionEdge{ u, w, std::move( h ), { std::make_tuple( v, none, db_id_t( 0 ) ) } } );
+                }
+                else {
+                    ContractionEdge& e = edges[it->second];
+                    bool improves;
+                    TravelTimeFunction merged = e.travel_time.merge( h, &improves );
+                    if ( improves ) {
+                        e.travel_time = std::move( merged );
+                        e.candidates.push_back( std::make_tuple( v, none, db_id_t( 0 ) ) );
+                    }
+                }
+            }
+        }
+    }
+
+    // every edge is part of the hierarchy, laid out by source and target
+    std::vector<uint32_t> order( edges.size() );
+    for ( uint32_t i = 0; i < order.size(); i++ ) {
+        order[i] = i;
+    }
+    std::sort( order.begin(), order.end(), [&edges]( uint32_t a, uint32_t b ) {
+            return edge_key( edges[a].from, edges[a].to ) < edge_key( edges[b].from, edges[b].to );
+        } );
+    first_edge_.assign( n + 1, 0 );
+    edges_.reserve( edges.size() );
+    first_candidate_.reserve( edges.size() + 1 );
+    for ( uint32_t i : order ) {
+        ContractionEdge& ce = edges[i];
+        first_edge_[ce.from + 1]++;
+        first_candidate_.push_back( uint32_t( candidates_.size() ) );
+        for ( const auto& c : ce.candidates ) {
+            candidates_.push_back( Candidate{ std::get<0>( c ), std::get<1>( c ), std::get<2>( c ) } );
+        }
+        edges_.push_back( Edge{ ce.from, ce.to, uint32_t( functions_.size() ) } );
+        functions_.push_back( std::move( ce.travel_time ) );
+    }
+    first_candidate_.push_back( uint32_t( candidates_.size() ) );
+    for ( uint32_t v = 0; v < n; v++ ) {
+        first_edge_[v + 1] += first_edge_[v];
+    }
+
+    build_index();
+
+    std::cout << "Time-dependent CH contracted in " << timer.elapsed_ms() << "ms: " << sections.size() << " sections, "
+              << edges_.size() << " edges" << std::endl;
+}
+
+void TCHRoutingData::build_index()
+{
+    const uint32_t n = uint32_t( node_id_.size() );
+    rnode_id_.clear();
+    for ( uint32_t v = 0; v < n; v++ ) {
+        rnode_id_[node_id_[v]] = v;
+    }
+
+    first_down_in_.assign( n + 1, 0 );
+    for ( const Edge& e : edges_ ) {
+        if ( e.from > e.to ) {
+            first_down_in_[e.to + 1]++;
+        }
+    }
+    for ( uint32_t v = 0; v < n; v++ ) {
+        first_down_in_[v + 1] += first_down_in_[v];
+    }
+    down_in_.resize( first_down_in_[n] );
+    std::vector<uint32_t> next( first_down_in_.begin(), first_down_in_.end() - 1 );
+    for ( uint32_t i = 0; i < edges_.size(); i++ ) {
+        if ( edges_[i].from > edges_[i].to ) {
+            down_in_[next[edges_[i].to]++] = i;
+        }
+    }
+}
+
+boost::optional<uint32_t> TCHRoutingData::vertex_from_id( db_id_t id ) const
+{
+    auto it = rnode_id_.find( id );
+    if ( it != rnode_id_.end() ) {
+        return it->second;
+    }
+    return boost::optional<uint32_t>();
+}
+
+uint32_t TCHRoutingData::find_edge( uint32_t u, uint32_t v ) const
+{
+    auto begin = edges_.begin() + first_edge_[u];
+    auto end = edges_.begin() + first_edge_[u + 1];
+    auto it = std::lower_bound( begin, end, v, []( const Edge& e, uint32_t t ) { return e.to < t; } );
+    if ( it == end || it->to != v ) {
+        return NONE;
+    }
+    return uint32_t( it - edges_.begin() );
+}
+
+double TCHRoutingData::query( uint32_t origin, uint32_t destination, double departure_time, std::vector<PathStep>* path ) const
+{
+    if ( origin == destination ) {
+        return 0.0;
+    }
+
+    static thread_local TCHQueryWorkspace ws;
+    const size_t n = num_vertices();
+    ws.reset( n );
+
+    // lower bounds of the travel times to the destination, on the edges coming down to it.
+    // Reached vertices are the only ones the downward phase has to go through
+    ws.bound.set( destination, 0.0, destination );
+    ws.queue.push( 0.0, destination );
+    while ( !ws.queue.empty() ) {
+        double d;
+        uint32_t w;
+        std::tie( d, w ) = ws.queue.top();
+        ws.queue.pop();
+        if ( d > ws.bound.potential( w ) ) {
+            continue;
+        }
+        for ( uint32_t i = first_down_in_[w]; i < first_down_in_[w + 1]; i++ ) {
+            const Edge& e = edges_[down_in_[i]];
+            const double du = d + functions_[e.function].min();
+            if ( du < ws.bound.potential( e.from ) ) {
+                ws.bound.set( e.from, du, w );
+                ws.queue.push( du, e.from );
+            }
+        }
+    }
+
+    // upward phase: arrival times on the upward edges from the origin
+    ws.up.set( origin, departure_time, origin );
+    ws.queue.push( departure_time, origin );
+    while ( !ws.queue.empty() ) {
+        double a;
+        uint32_t u;
+        std::tie( a, u ) = ws.queue.top();
+        ws.queue.pop();
+        if ( a > ws.up.potential( u ) ) {
+            continue;
+        }
+        if ( ws.bound.reached( u ) ) {
+            ws.meeting.push_back( u );
+        }
+        for ( uint32_t i = first_edge_[u + 1]; i > first_edge_[u]; i-- ) {
+            const Edge& e = edges_[i - 1];
+            if ( e.to < u ) {
+                break;
+            }
+            const double aw = a + functions_[e.function]( a );
+            if ( aw < ws.up.potential( e.to ) ) {
+                ws.up.set( e.to, aw, u );
+                ws.queue.push( aw, e.to );
+            }
+        }
+    }
+
+    // downward phase, from the vertices reached by both searches, guided by the lower bounds
+    for ( uint32_t u : ws.meeting ) {
+        const double a = ws.up.potential( u );
+        ws.down.set( u, a, u );
+        ws.queue.push( a + ws.bound.potential( u ), u );
+    }
+    while ( !ws.queue.empty() ) {
+        double k;
+        uint32_t u;
+        std::tie( k, u ) = ws.queue.top();
+        ws.queue.pop();
+        const double a = ws.down.potential( u );
+        if ( k > a + ws.bound.potential( u ) ) {
+            continue;
+        }
+        if ( u == destination ) {
+            break;
+        }
+        for ( uint32_t i = first_edge_[u]; i < first_edge_[u + 1]; i++ ) {
+            const Edge& e = edges_[i];
+            if ( e.to > u ) {
+                break;
+            }
+            if ( !ws.bound.reached( e.to ) ) {
+                continue;
+            }
+            const double aw = a + functions_[e.function]( a );
+            if ( aw < ws.down.potential( e.to ) ) {
+                ws.down.set( e.to, aw, u );
+                ws.queue.push( aw + ws.bound.potential( e.to ), e.to );
+            }
+        }
+    }
+
+    if ( !ws.down.reached( destination ) ) {
+        return infinity();
+    }
+
+    if ( path ) {
+        // vertices of the path, back to the vertex where the downward phase started, then back to the origin
+        std::vector<uint32_t> vertices;
+        uint32_t v = destination;
+        while ( ws.down.predecessor( v ) != v ) {
+            vertices.push_back( v );
+            v = ws.down.predecessor( v );
+        }
+        while ( v != origin ) {
+            vertices.push_back( v );
+            v = ws.up.predecessor( v );
+        }
+        vertices.push_back( origin );
+        std::reverse( vertices.begin(), vertices.end() );
+
+        path->clear();
+        double t = departure_time;
+        for ( size_t i = 0; i + 1 < vertices.size(); i++ ) {
+            const uint32_t e = find_edge( vertices[i], vertices[i + 1] );
+            BOOST_ASSERT( e != NONE );
+            const size_t first = path->size();
+            unpack_edge( e, t, *path );
+            for ( size_t j = first; j < path->size(); j++ ) {
+                t += (*path)[j].travel_time;
+            }
+        }
+    }
+
+    return ws.down.potential( destination ) - departure_time;
+}
+
+void TCHRoutingData::unpack_edge( uint32_t e, double departure_time, std::vector<PathStep>& path ) const
+{
+    const Edge& edge = edges_[e];
+    // the candidate that is the fastest at this departure time
+    double best = infinity();
+    const Candidate* best_c = nullptr;
+    uint32_t best_e1 = NONE, best_e2 = NONE;
+    for ( uint32_t i = first_candidate_[e]; i < first_candidate_[e + 1]; i++ ) {
+        const Candidate& c = candidates_[i];
+        if ( c.middle == NONE ) {
+            const double tt = functions_[c.function]( departure_time );
+            if ( tt < best ) {
+                best = tt;
+                best_c = &c;
+            }
+        }
+        else {
+            const uint32_t e1 = find_edge( edge.from, c.middle );
+            const uint32_t e2 = find_edge( c.middle, edge.to );
+            BOOST_ASSERT( e1 != NONE && e2 != NONE );
+            const double tt1 = functions_[edges_[e1].function]( departure_time );
+            const double tt = tt1 + functions_[edges_[e2].function]( departure_time + tt1 );
+            if ( tt < best ) {
+                best = tt;
+                best_c = &c;
+                best_e1 = e1;
+                best_e2 = e2;
+            }
+        }
+    }
+    BOOST_ASSERT( best_c != nullptr );
+
+    if ( best_c->middle == NONE ) {
+        path.push_back( PathStep{ best_c->db_id, departure_time, best } );
+        return;
+    }
+    const size_t first = path.size();
+    unpack_edge( best_e1, departure_time, path );
+    double t = departure_time;
+    for ( size_t j = first; j < path.size(); j++ ) {
+        t += path[j].travel_time;
+    }
+    unpack_edge( best_e2, t, path );
+}
+
+void TCHRoutingData::serialize( std::ostream& ostr, binary_serialization_t t ) const
+{
+    Tempus::serialize( ostr, node_id_, t );
+    Tempus::serialize( ostr, first_edge_, t );
+    Tempus::serialize( ostr, edges_, t );
+    Tempus::serialize( ostr, first_candidate_, t );
+    Tempus::serialize( ostr, candidates_, t );
+    Tempus::serialize( ostr, functions_, t );
+    Tempus::serialize( ostr, transport_modes(), t );
+}
+
+void TCHRoutingData::unserialize( std::istream& istr, binary_serialization_t t )
+{
+    Tempus::unserialize( istr, node_id_, t );
+    Tempus::unserialize( istr, first_edge_, t );
+    Tempus::unserialize( istr, edges_, t );
+    Tempus::unserialize( istr, first_candidate_, t );
+    Tempus::unserialize( istr, candidates_, t );
+    Tempus::unserialize( istr, functions_, t );
+    RoutingData::TransportModes modes;
+    Tempus::unserialize( istr, modes, t );
+    set_transport_modes( modes );
+    build_index();
+}
+
+std::unique_ptr<RoutingData> TCHRoutingDataBuilder::file_import( const std::string& filename, ProgressionCallback& /*progression*/, const VariantMap& /*options*/ ) const
+{
+    std::ifstream ifs( filename, std::ios::binary );
+    if ( ifs.fail() ) {
+        throw std::runtime_error( "Problem opening input file " + filename );
+    }
+
+    read_header( ifs );
+
+    std::unique_ptr<TCHRoutingData> rd( new TCHRoutingData() );
+    rd->unserialize( ifs, binary_serialization_t() );
+    return std::unique_ptr<RoutingData>( rd.release() );
+}
+
+void TCHRoutingDataBuilder::file_export( const RoutingData* rd, const std::string& filename, ProgressionCallback& /*progression*/, const VariantMap& /*options*/ ) const
+{
+    std::ofstream ofs( filename, std::ios::binary );
+
+    write_header( ofs );
+
+    static_cast<const TCHRoutingData*>( rd )->serialize( ofs, binary_serialization_t() );
+}
+
+REGISTER_BUILDER( TCHRoutingDataBuilder )
+
+} // namespace Tempus
@@ -0,0 +1,213 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_TCH_ROUTING_DATA_HH
+#define TEMPUS_TCH_ROUTING_DATA_HH
+
+#include <vector>
+#include <map>
+#include <limits>
+
+#include "travel_time_function.hh"
+#include "routing_data.hh"
+#include "routing_data_builder.hh"
+#include "serializers.hh"
+
+/**
+ * Time-dependent contraction hierarchies (TCH).
+ *
+ * Vertices are contracted in a given order, as for a CH, but weights are travel time functions
+ * of the departure time. The shortcut added when contracting v between u and w is the link of
+ * the functions of (u,v) and (v,w), merged with the function of (u,w) if it already exists.
+ * A shortcut is not added if a path avoiding v is faster in the worst case than the shortcut in
+ * the best case. Since link and merge are exact, an up-down path of the hierarchy is as fast as
+ * a shortest path of the original graph, at any departure time.
+ *
+ * A shortcut may represent different paths depending on the departure time. It then keeps the
+ * list of the middle vertices it has been built with, the right one is found again when unpacked.
+ */
+
+namespace Tempus
+{
+
+///
+/// Road section of a time-dependent CH, between contraction orders
+struct TCHSection
+{
+    /// contraction order of the source
+    uint32_t from;
+    /// contraction order of the target
+    uint32_t to;
+    db_id_t db_id;
+    /// travel time, in minutes
+    TravelTimeFunction travel_time;
+
+    void serialize( std::ostream& ostr, binary_serialization_t t ) const
+    {
+        Tempus::serialize( ostr, from, t );
+        Tempus::serialize( ostr, to, t );
+        Tempus::serialize( ostr, db_id, t );
+        travel_time.serialize( ostr, t );
+    }
+    void unserialize( std::istream& istr, binary_serialization_t t )
+    {
+        Tempus::unserialize( istr, from, t );
+        Tempus::unserialize( istr, to, t );
+        Tempus::unserialize( istr, db_id, t );
+        travel_time.unserialize( istr, t );
+    }
+};
+
+///
+/// Routing data of a time-dependent CH
+class TCHRoutingData : public RoutingData
+{
+public:
+    ///
+    /// Empty hierarchy, to be unserialized
+    TCHRoutingData() : RoutingData( "tch_graph" ) {}
+
+    ///
+    /// Contract a graph
+    /// \param node_id Road node id of each vertex, in contraction order
+    /// \param sections Road sections, between contraction orders
+    TCHRoutingData( std::vector<db_id_t>&& node_id, const std::vector<TCHSection>& sections );
+
+    size_t num_vertices() const { return node_id_.size(); }
+
+    ///
+    /// Number of edges, original sections and shortcuts
+    size_t num_edges() const { return edges_.size(); }
+
+    boost::optional<uint32_t> vertex_from_id( db_id_t id ) const;
+
+    db_id_t vertex_id( uint32_t v ) const { return node_id_[v]; }
+
+    ///
+    /// Road section of an earliest arrival path
+    struct PathStep
+    {
+        db_id_t section_id;
+        /// departure time from the beginning of the section, in minutes
+        double departure_time;
+        /// travel time on the section, in minutes
+        double travel_time;
+    };
+
+    static double infinity() { return std::numeric_limits<double>::infinity(); }
+
+    ///
+    /// Earliest arrival query
+    /// \param origin Contraction order of the origin
+    /// \param destination Contraction order of the destination
+    /// \param departure_time Departure time from the origin, in minutes
+    /// \param path If not null, filled with the road sections of the path
+    /// \returns the travel time, in minutes, or infinity() if there is no path
+    double query( uint32_t origin, uint32_t destination, double departure_time, std::vector<PathStep>* path = nullptr ) const;
+
+    void serialize( std::ostream& ostr, binary_serialization_t t ) const;
+    void unserialize( std::istream& istr, binary_serialization_t t );
+
+private:
+    static const uint32_t NONE = uint32_t(-1);
+
+    struct Edge
+    {
+        uint32_t from;
+        uint32_t to;
+        /// index of the travel time function
+        uint32_t function;
+
+        void serialize( std::ostream& ostr, binary_serialization_t t ) const
+        {
+            Tempus::serialize( ostr, from, t );
+            Tempus::serialize( ostr, to, t );
+            Tempus::serialize( ostr, function, t );
+        }
+        void unserialize( std::istream& istr, binary_serialization_t t )
+        {
+            Tempus::unserialize( istr, from, t );
+            Tempus::unserialize( istr, to, t );
+            Tempus::unserialize( istr, function, t );
+        }
+    };
+
+    ///
+    /// One of the paths an edge stands for: a road section or two edges through a middle vertex
+    struct Candidate
+    {
+        /// middle vertex of a shortcut, NONE for a road section
+        uint32_t middle;
+        /// travel time function of the road section
+        uint32_t function;
+        db_id_t db_id;
+
+        void serialize( std::ostream& ostr, binary_serialization_t t ) const
+        {
+            Tempus::serialize( ostr, middle, t );
+            Tempus::serialize( ostr, function, t );
+            Tempus::serialize( ostr, db_id, t );
+        }
+        void unserialize( std::istream& istr, binary_serialization_t t )
+        {
+            Tempus::unserialize( istr, middle, t );
+            Tempus::unserialize( istr, function, t );
+            Tempus::unserialize( istr, db_id, t );
+        }
+    };
+
+    ///
+    /// Edge from u to v, NONE if there is none
+    uint32_t find_edge( uint32_t u, uint32_t v ) const;
+
+    ///
+    /// Append the road sections of an edge to a path
+    void unpack_edge( uint32_t e, double departure_time, std::vector<PathStep>& path ) const;
+
+    void build_index();
+
+    std::vector<db_id_t> node_id_;
+    std::map<db_id_t, uint32_t> rnode_id_;
+
+    // edges of each vertex are [first_edge_[v], first_edge_[v+1]), sorted by target
+    std::vector<uint32_t> first_edge_;
+    std::vector<Edge> edges_;
+    // candidates of each edge are [first_candidate_[e], first_candidate_[e+1])
+    std::vector<uint32_t> first_candidate_;
+    std::vector<Candidate> candidates_;
+    std::vector<TravelTimeFunction> functions_;
+
+    // edges coming down to each vertex, from a higher one, [first_down_in_[v], first_down_in_[v+1])
+    std::vector<uint32_t> first_down_in_;
+    std::vector<uint32_t> down_in_;
+};
+
+///
+/// Builder of a time-dependent CH.
+///
+/// The hierarchy is only read from dump files, written by ch_preprocess --time-dependent
+class TCHRoutingDataBuilder : public RoutingDataBuilder
+{
+public:
+    TCHRoutingDataBuilder() : RoutingDataBuilder( "tch_graph" ) {}
+
+    virtual std::unique_ptr<RoutingData> file_import( const std::string& filename, ProgressionCallback& progression, const VariantMap& options = VariantMap() ) const override;
+    virtual void file_export( const RoutingData* rd, const std::string& filename, ProgressionCallback& progression, const VariantMap& options = VariantMap() ) const override;
+};
+
+} // namespace Tempus
+
+#endif
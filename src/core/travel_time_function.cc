@@ -0,0 +1,209 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "travel_time_function.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <boost/assert.hpp>
+
+namespace Tempus
+{
+
+namespace
+{
+
+// tolerance on times, in minutes, under which two values are considered equal
+const double EPSILON = 1e-9;
+
+}
+
+TravelTimeFunction::TravelTimeFunction( double travel_time ) :
+    points_( 1, Point{ 0.0, travel_time } ),
+    min_( travel_time ),
+    max_( travel_time )
+{
+}
+
+TravelTimeFunction::TravelTimeFunction( std::vector<Point>&& points ) :
+    points_( std::move( points ) )
+{
+    simplify();
+}
+
+void TravelTimeFunction::simplify()
+{
+    std::vector<Point> out;
+    out.reserve( points_.size() );
+    for ( const Point& p : points_ ) {
+        if ( !out.empty() && p.time <= out.back().time + EPSILON ) {
+            continue;
+        }
+        // drop the last breakpoint if it lies on the segment to p
+        while ( out.size() >= 2 ) {
+            const Point& a = out[out.size() - 2];
+            const Point& b = out.back();
+            const double v = a.travel_time + ( p.travel_time - a.travel_time ) * ( b.time - a.time ) / ( p.time - a.time );
+            if ( std::abs( v - b.travel_time ) > EPSILON ) {
+                break;
+            }
+            out.pop_back();
+        }
+        out.push_back( p );
+    }
+    // a constant function only needs one breakpoint
+    if ( out.size() == 2 && std::abs( out[0].travel_time - out[1].travel_time ) <= EPSILON ) {
+        out.pop_back();
+    }
+    points_.swap( out );
+
+    min_ = max_ = points_.empty() ? 0.0 : points_[0].travel_time;
+    for ( const Point& p : points_ ) {
+        min_ = std::min( min_, p.travel_time );
+        max_ = std::max( max_, p.travel_time );
+    }
+}
+
+double TravelTimeFunction::operator()( double time ) const
+{
+    BOOST_ASSERT( !points_.empty() );
+    if ( time <= points_.front().time ) {
+        return points_.front().travel_time;
+    }
+    if ( time >= points_.back().time ) {
+        return points_.back().travel_time;
+    }
+    auto it = std::upper_bound( points_.begin(), points_.end(), time, []( double t, const Point& p ) { return t < p.time; } );
+    const Point& b = *it;
+    const Point& a = *(it - 1);
+    return a.travel_time + ( b.travel_time - a.travel_time ) * ( time - a.time ) / ( b.time - a.time );
+}
+
+TravelTimeFunction TravelTimeFunction::link( const TravelTimeFunction& g ) const
+{
+    BOOST_ASSERT( !empty() && !g.empty() );
+    const std::vector<Point>& fp = points_;
+    const std::vector<Point>& gp = g.points_;
+    const size_t nf = fp.size();
+    const size_t ng = gp.size();
+
+    // breakpoints of the result are the breakpoints of f and the departure times
+    // that reach a breakpoint of g. Both are sorted since the arrival time is increasing
+    std::vector<Point> out;
+    out.reserve( nf + ng );
+    size_t i = 0, j = 0;
+    while ( i < nf || j < ng ) {
+        double t, ft;
+        if ( i < nf && ( j == ng || fp[i].time + fp[i].travel_time <= gp[j].time ) ) {
+            t = fp[i].time;
+            ft = fp[i].travel_time;
+            i++;
+        }
+        else {
+            // arrival at a breakpoint of g, f is constant outside of its breakpoints
+            const double a = gp[j].time;
+            if ( i == 0 || i == nf ) {
+                ft = fp[i == 0 ? 0 : nf - 1].travel_time;
+                t = a - ft;
+            }
+            else {
+                // the arrival time is in [a0, a1), on the segment of f between i-1 and i
+                const double a0 = fp[i-1].time + fp[i-1].travel_time;
+                const double a1 = fp[i].time + fp[i].travel_time;
+                t = fp[i-1].time + ( a - a0 ) * ( fp[i].time - fp[i-1].time ) / ( a1 - a0 );
+                ft = a - t;
+            }
+            j++;
+        }
+        out.push_back( Point{ t, ft + g( t + ft ) } );
+    }
+    return TravelTimeFunction( std::move( out ) );
+}
+
+TravelTimeFunction TravelTimeFunction::merge( const TravelTimeFunction& g, bool* g_improves ) const
+{
+    BOOST_ASSERT( !empty() && !g.empty() );
+    if ( g_improves ) {
+        *g_improves = false;
+    }
+    if ( g.min_ >= max_ ) {
+        return *this;
+    }
+    if ( min_ >= g.max_ ) {
+        if ( g_improves ) {
+            *g_improves = true;
+        }
+        return g;
+    }
+
+    const std::vector<Point>& fp = points_;
+    const std::vector<Point>& gp = g.points_;
+    std::vector<Point> out;
+    out.reserve( fp.size() + gp.size() );
+    bool improves = false;
+    size_t i = 0, j = 0;
+    double prev_t = 0.0, prev_d = 0.0;
+    // both functions are linear between two consecutive breakpoints of either of them
+    while ( i < fp.size() || j < gp.size() ) {
+        double t;
+        if ( j == gp.size() || ( i < fp.size() && fp[i].time <= gp[j].time ) ) {
+            t = fp[i].time;
+            if ( j < gp.size() && gp[j].time == t ) {
+                j++;
+            }
+            i++;
+        }
+        else {
+            t = gp[j].time;
+            j++;
+        }
+        const double fv = (*this)( t );
+        const double gv = g( t );
+        const double d = gv - fv;
+        if ( !out.empty() && ( ( prev_d < -EPSILON && d > EPSILON ) || ( prev_d > EPSILON && d < -EPSILON ) ) ) {
+            // the functions cross between the previous breakpoint and this one
+            const double tc = prev_t + ( t - prev_t ) * prev_d / ( prev_d - d );
+            out.push_back( Point{ tc, (*this)( tc ) } );
+        }
+        if ( d < -EPSILON ) {
+            improves = true;
+        }
+        out.push_back( Point{ t, std::min( fv, gv ) } );
+        prev_t = t;
+        prev_d = d;
+    }
+    if ( g_improves ) {
+        *g_improves = improves;
+    }
+    return TravelTimeFunction( std::move( out ) );
+}
+
+void TravelTimeFunction::serialize( std::ostream& ostr, binary_serialization_t t ) const
+{
+    Tempus::serialize( ostr, points_.size(), t );
+    Tempus::serialize( ostr, reinterpret_cast<const char*>( points_.data() ), points_.size() * sizeof(Point), t );
+}
+
+void TravelTimeFunction::unserialize( std::istream& istr, binary_serialization_t t )
+{
+    size_t n;
+    Tempus::unserialize( istr, n, t );
+    points_.resize( n );
+    Tempus::unserialize( istr, reinterpret_cast<char*>( points_.data() ), n * sizeof(Point), t );
+    simplify();
+}
+
+} // namespace Tempus
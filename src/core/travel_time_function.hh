@@ -0,0 +1,101 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_TRAVEL_TIME_FUNCTION_HH
+#define TEMPUS_TRAVEL_TIME_FUNCTION_HH
+
+#include <vector>
+#include <iosfwd>
+
+#include "serializers.hh"
+
+namespace Tempus
+{
+
+///
+/// Travel time, as a piecewise linear function of the departure time.
+///
+/// The function is given by its breakpoints, sorted by departure time, and is linearly
+/// interpolated between them. It is constant before its first and after its last breakpoint.
+/// Times are in minutes.
+///
+/// Functions are supposed to be FIFO: leaving later never means arriving earlier, i.e. no
+/// slope is lower than -1. Linking and merging FIFO functions is then exact.
+class TravelTimeFunction
+{
+public:
+    struct Point
+    {
+        /// departure time
+        double time;
+        /// travel time, when leaving at time
+        double travel_time;
+    };
+
+    ///
+    /// Empty function, it can't be evaluated
+    TravelTimeFunction() : min_( 0.0 ), max_( 0.0 ) {}
+
+    ///
+    /// Constant function
+    explicit TravelTimeFunction( double travel_time );
+
+    ///
+    /// Function given by its breakpoints, sorted by time.
+    /// Breakpoints at the same time and collinear breakpoints are removed
+    explicit TravelTimeFunction( std::vector<Point>&& points );
+
+    bool empty() const { return points_.empty(); }
+
+    const std::vector<Point>& points() const { return points_; }
+
+    ///
+    /// Travel time when leaving at the given time
+    double operator()( double time ) const;
+
+    ///
+    /// Lower bound of the travel time
+    double min() const { return min_; }
+
+    ///
+    /// Upper bound of the travel time
+    double max() const { return max_; }
+
+    ///
+    /// Travel time of this function followed by another one:
+    /// h(t) = f(t) + g(t + f(t))
+    TravelTimeFunction link( const TravelTimeFunction& g ) const;
+
+    ///
+    /// Minimum of this function and another one
+    /// @param g_improves set to whether g is lower than this function somewhere, if not null
+    TravelTimeFunction merge( const TravelTimeFunction& g, bool* g_improves = nullptr ) const;
+
+    void serialize( std::ostream& ostr, binary_serialization_t t ) const;
+    void unserialize( std::istream& istr, binary_serialization_t t );
+
+private:
+    // remove duplicate and collinear breakpoints, compute bounds
+    void simplify();
+
+    std::vector<Point> points_;
+    double min_;
+    double max_;
+};
+
+} // namespace Tempus
+
+#endif
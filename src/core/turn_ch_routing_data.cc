@@ -0,0 +1,234 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "turn_ch_routing_data.hh"
+#include "ch_query_workspace.hh"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+namespace Tempus
+{
+
+namespace
+{
+
+std::vector<db_id_t> section_ids( const std::vector<TurnCHNode>& nodes )
+{
+    std::vector<db_id_t> ids;
+    ids.reserve( nodes.size() );
+    for ( const TurnCHNode& n : nodes ) {
+        ids.push_back( n.section_id );
+    }
+    return ids;
+}
+
+}
+
+TurnCHRoutingData::TurnCHRoutingData( std::unique_ptr<CHQuery> ch_query, std::vector<TurnCHNode>&& nodes ) :
+    RoutingData( "turn_ch_graph" ),
+    nodes_( std::move( nodes ) )
+{
+    // node ids of the CH are section ids, vertex_from_id() is not meaningful
+    ch_.reset( new CHRoutingData( std::move( ch_query ), section_ids( nodes_ ) ) );
+    build_index();
+}
+
+void TurnCHRoutingData::build_index()
+{
+    departures_.clear();
+    arrivals_.clear();
+    for ( CHVertex v = 0; v < nodes_.size(); v++ ) {
+        if ( nodes_[v].start ) {
+            departures_.push_back( std::make_pair( nodes_[v].from_node, v ) );
+        }
+        arrivals_.push_back( std::make_pair( nodes_[v].to_node, v ) );
+    }
+    std::sort( departures_.begin(), departures_.end() );
+    std::sort( arrivals_.begin(), arrivals_.end() );
+}
+
+double TurnCHRoutingData::query( db_id_t origin, db_id_t destination, std::vector<PathStep>* path ) const
+{
+    typedef uint32_t Cost;
+    const Cost unreached = std::numeric_limits<Cost>::max();
+
+    if ( path ) {
+        path->clear();
+    }
+    if ( origin == destination ) {
+        return 0.0;
+    }
+
+    const CHQuery& graph = ch_->ch_query();
+    CHQueryWorkspace<Cost>& ws = ch_query_workspace<Cost>( nodes_.size() );
+    auto& labels = ws.labels;
+    auto& vertex_queue = ws.queue;
+
+    // the forward search starts on every section leaving the origin, once it is travelled,
+    // the backward search on every section arriving at the destination
+    auto dep = std::equal_range( departures_.begin(), departures_.end(), std::make_pair( origin, CHVertex( 0 ) ),
+                                 []( const std::pair<db_id_t, CHVertex>& a, const std::pair<db_id_t, CHVertex>& b ) { return a.first < b.first; } );
+    for ( auto it = dep.first; it != dep.second; it++ ) {
+        const Cost c = nodes_[it->second].cost;
+        if ( c < labels[0].potential( it->second ) ) {
+            labels[0].set( it->second, c, it->second );
+            vertex_queue[0].push( c, it->second );
+        }
+    }
+    auto arr = std::equal_range( arrivals_.begin(), arrivals_.end(), std::make_pair( destination, CHVertex( 0 ) ),
+                                 []( const std::pair<db_id_t, CHVertex>& a, const std::pair<db_id_t, CHVertex>& b ) { return a.first < b.first; } );
+    for ( auto it = arr.first; it != arr.second; it++ ) {
+        labels[1].set( it->second, 0, it->second );
+        vertex_queue[1].push( 0, it->second );
+    }
+
+    auto min_pi = [&vertex_queue, unreached]( int dir ) {
+        return vertex_queue[dir].empty() ? unreached : vertex_queue[dir].top().first;
+    };
+
+    CHVertex top_node = 0;
+    Cost total_cost = unreached;
+    int dir = 1;
+    while ( !vertex_queue[0].empty() || !vertex_queue[1].empty() ) {
+        if ( std::min( min_pi( 0 ), min_pi( 1 ) ) >= total_cost ) {
+            break;
+        }
+        // interleave directions
+        dir = 1 - dir;
+        if ( vertex_queue[dir].empty() ) {
+            dir = 1 - dir;
+        }
+
+        Cost pi;
+        CHVertex v;
+        std::tie( pi, v ) = vertex_queue[dir].top();
+        vertex_queue[dir].pop();
+        if ( pi > labels[dir].potential( v ) ) {
+            continue;
+        }
+
+        const Cost pi2 = labels[1 - dir].potential( v );
+        if ( pi2 != unreached && pi + pi2 < total_cost ) {
+            top_node = v;
+            total_cost = pi + pi2;
+        }
+
+        if ( dir == 0 ) {
+            for ( auto oei = out_edges( v, graph ).first; oei != out_edges( v, graph ).second; oei++ ) {
+                const CHVertex w = target( *oei, graph );
+                const Cost c = pi + oei->property().b.cost;
+                if ( c < labels[0].potential( w ) ) {
+                    labels[0].set( w, c, v );
+                    vertex_queue[0].push( c, w );
+                }
+            }
+        }
+        else {
+            for ( auto iei = in_edges( v, graph ).first; iei != in_edges( v, graph ).second; iei++ ) {
+                const CHVertex w = source( *iei, graph );
+                const Cost c = pi + iei->property().b.cost;
+                if ( c < labels[1].potential( w ) ) {
+                    labels[1].set( w, c, v );
+                    vertex_queue[1].push( c, w );
+                }
+            }
+        }
+    }
+
+    if ( total_cost == unreached ) {
+        return infinity();
+    }
+
+    if ( path ) {
+        // vertices from the first section to the last one
+        std::vector<CHVertex> vertices;
+        for ( CHVertex x = top_node; ; x = labels[0].predecessor( x ) ) {
+            vertices.push_back( x );
+            if ( labels[0].predecessor( x ) == x ) {
+                break;
+            }
+        }
+        std::reverse( vertices.begin(), vertices.end() );
+        for ( CHVertex x = top_node; labels[1].predecessor( x ) != x; ) {
+            x = labels[1].predecessor( x );
+            vertices.push_back( x );
+        }
+
+        path->push_back( PathStep{ nodes_[vertices.front()].section_id, nodes_[vertices.front()].cost / 6000.0 } );
+        std::vector<CHEdge> turns;
+        for ( size_t i = 0; i + 1 < vertices.size(); i++ ) {
+            CHEdge e;
+            bool found = false;
+            std::tie( e, found ) = edge( vertices[i], vertices[i + 1], graph );
+            BOOST_ASSERT( found );
+            ch_->unpack_edge( e, turns );
+        }
+        for ( const CHEdge& e : turns ) {
+            path->push_back( PathStep{ e.property().db_id, e.property().b.cost / 6000.0 } );
+        }
+    }
+
+    // hundredths of seconds -> minutes
+    return total_cost / 6000.0;
+}
+
+void TurnCHRoutingData::serialize( std::ostream& ostr, binary_serialization_t t ) const
+{
+    ch_->ch_query().serialize( ostr, t );
+    Tempus::serialize( ostr, nodes_, t );
+    Tempus::serialize( ostr, transport_modes(), t );
+}
+
+void TurnCHRoutingData::unserialize( std::istream& istr, binary_serialization_t t )
+{
+    std::unique_ptr<CHQuery> ch_query( new CHQuery() );
+    ch_query->unserialize( istr, t );
+    Tempus::unserialize( istr, nodes_, t );
+    RoutingData::TransportModes modes;
+    Tempus::unserialize( istr, modes, t );
+    set_transport_modes( modes );
+    ch_.reset( new CHRoutingData( std::move( ch_query ), section_ids( nodes_ ) ) );
+    build_index();
+}
+
+std::unique_ptr<RoutingData> TurnCHRoutingDataBuilder::file_import( const std::string& filename, ProgressionCallback& /*progression*/, const VariantMap& /*options*/ ) const
+{
+    std::ifstream ifs( filename, std::ios::binary );
+    if ( ifs.fail() ) {
+        throw std::runtime_error( "Problem opening input file " + filename );
+    }
+
+    read_header( ifs );
+
+    std::unique_ptr<TurnCHRoutingData> rd( new TurnCHRoutingData() );
+    rd->unserialize( ifs, binary_serialization_t() );
+    return std::unique_ptr<RoutingData>( rd.release() );
+}
+
+void TurnCHRoutingDataBuilder::file_export( const RoutingData* rd, const std::string& filename, ProgressionCallback& /*progression*/, const VariantMap& /*options*/ ) const
+{
+    std::ofstream ofs( filename, std::ios::binary );
+
+    write_header( ofs );
+
+    static_cast<const TurnCHRoutingData*>( rd )->serialize( ofs, binary_serialization_t() );
+}
+
+REGISTER_BUILDER( TurnCHRoutingDataBuilder )
+
+} // namespace Tempus
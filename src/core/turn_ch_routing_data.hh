@@ -0,0 +1,141 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_TURN_CH_ROUTING_DATA_HH
+#define TEMPUS_TURN_CH_ROUTING_DATA_HH
+
+#include <vector>
+#include <memory>
+#include <limits>
+
+#include "ch_routing_data.hh"
+#include "routing_data.hh"
+#include "routing_data_builder.hh"
+#include "serializers.hh"
+
+/**
+ * Turn-aware CH: a CH of the edge-based graph of cars (see TurnGraph).
+ *
+ * Vertices of the CH are nodes of the turn graph, i.e. road sections. An edge from a section to
+ * another one costs the travel time of the second section plus the penalty of the turn, so that
+ * turn restrictions are honoured by a plain CH query. A path is a set of sections leaving the
+ * origin node to a set of sections arriving at the destination node.
+ */
+
+namespace Tempus
+{
+
+///
+/// Vertex of a turn-aware CH
+struct TurnCHNode
+{
+    /// road section
+    db_id_t section_id;
+    /// road node the section leaves
+    db_id_t from_node;
+    /// road node the section arrives at
+    db_id_t to_node;
+    /// travel time of the section, in hundredths of seconds
+    uint32_t cost;
+    /// whether a path can start on this section, i.e. no restriction is in progress
+    uint8_t start;
+
+    void serialize( std::ostream& ostr, binary_serialization_t t ) const
+    {
+        Tempus::serialize( ostr, section_id, t );
+        Tempus::serialize( ostr, from_node, t );
+        Tempus::serialize( ostr, to_node, t );
+        Tempus::serialize( ostr, cost, t );
+        Tempus::serialize( ostr, start, t );
+    }
+    void unserialize( std::istream& istr, binary_serialization_t t )
+    {
+        Tempus::unserialize( istr, section_id, t );
+        Tempus::unserialize( istr, from_node, t );
+        Tempus::unserialize( istr, to_node, t );
+        Tempus::unserialize( istr, cost, t );
+        Tempus::unserialize( istr, start, t );
+    }
+};
+
+///
+/// Routing data of a turn-aware CH
+class TurnCHRoutingData : public RoutingData
+{
+public:
+    ///
+    /// Empty hierarchy, to be unserialized
+    TurnCHRoutingData() : RoutingData( "turn_ch_graph" ) {}
+
+    ///
+    /// \param ch_query The CH of the turn graph. Original edges are turns, their db_id is the section they go to
+    /// \param nodes Road section of each vertex, in contraction order
+    TurnCHRoutingData( std::unique_ptr<CHQuery> ch_query, std::vector<TurnCHNode>&& nodes );
+
+    size_t num_vertices() const { return nodes_.size(); }
+
+    const TurnCHNode& node( CHVertex v ) const { return nodes_[v]; }
+
+    ///
+    /// Road section of a fastest path
+    struct PathStep
+    {
+        db_id_t section_id;
+        /// travel time on the section, with the penalty of the turn onto it, in minutes
+        double travel_time;
+    };
+
+    static double infinity() { return std::numeric_limits<double>::infinity(); }
+
+    ///
+    /// Fastest path between two road nodes
+    /// \param origin Road node id of the origin
+    /// \param destination Road node id of the destination
+    /// \param path If not null, filled with the road sections of the path
+    /// \returns the travel time, in minutes, or infinity() if there is no path
+    double query( db_id_t origin, db_id_t destination, std::vector<PathStep>* path = nullptr ) const;
+
+    void serialize( std::ostream& ostr, binary_serialization_t t ) const;
+    void unserialize( std::istream& istr, binary_serialization_t t );
+
+private:
+    void build_index();
+
+    std::unique_ptr<CHRoutingData> ch_;
+    std::vector<TurnCHNode> nodes_;
+
+    // (road node id, vertex) sorted by road node id, for the vertices a path can start on
+    std::vector<std::pair<db_id_t, CHVertex>> departures_;
+    // (road node id, vertex) sorted by road node id, for every vertex
+    std::vector<std::pair<db_id_t, CHVertex>> arrivals_;
+};
+
+///
+/// Builder of a turn-aware CH.
+///
+/// The hierarchy is only read from dump files, written by ch_preprocess --turn-restrictions
+class TurnCHRoutingDataBuilder : public RoutingDataBuilder
+{
+public:
+    TurnCHRoutingDataBuilder() : RoutingDataBuilder( "turn_ch_graph" ) {}
+
+    virtual std::unique_ptr<RoutingData> file_import( const std::string& filename, ProgressionCallback& progression, const VariantMap& options = VariantMap() ) const override;
+    virtual void file_export( const RoutingData* rd, const std::string& filename, ProgressionCallback& progression, const VariantMap& options = VariantMap() ) const override;
+};
+
+} // namespace Tempus
+
+#endif
@@ -57,17 +57,17 @@ Point2D coordinates( const POI* poi, Db::Connection& db )
     return p;
 }
 
-Point2D coordinates( const Multimodal::Vertex& v, Db::Connection& db, const Multimodal::Graph& )
+Point2D coordinates( const Multimodal::Vertex& v, Db::Connection& db, const Multimodal::Graph& graph )
 {
     if ( v.type() == Multimodal::Vertex::Road ) {
-        return coordinates( v.road_vertex(), db, v.graph()->road() );
+        return coordinates( v.road_vertex(), db, graph.road() );
     }
     else if ( v.type() == Multimodal::Vertex::PublicTransport ) {
-    return coordinates( v.pt_vertex(), db, *v.pt_graph() );
+    return coordinates( v.pt_vertex(), db, *v.pt_graph( graph ) );
     }
 
     // else
-return coordinates( v.poi(), db );
+return coordinates( v.poi( graph ), db );
 }
 
 void get_edge_info_from_db( const MMEdge& e, Db::Connection& db, std::string& wkb, std::string& initial_name, std::string& final_name )
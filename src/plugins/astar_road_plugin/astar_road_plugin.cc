@@ -18,7 +18,17 @@
    Sample plugin that processes very simple user request on a road graph.
    * Only distance minimization is considered
 
-   The plugin finds a route between an origin and a destination via Dijkstra.
+   The plugin finds a route between an origin and a destination via A*.
+
+   The heuristic is either an euclidian distance divided by a maximum speed, or, with the
+   "AStar/heuristic" option set to "alt", lower bounds given by landmarks. Landmarks are
+   computed when the plugin is loaded with the "AStar/landmarks" option ("landmarks/count"
+   and "landmarks/selection" options), or memory-mapped from a road_landmarks dump given
+   by the "AStar/landmarks_file" option.
+
+   With the "AStar/turn_restrictions" option, the plugin is loaded with the turn restrictions of
+   the database and car routes are searched on the edge-based graph (TurnGraph), so that they
+   honour forbidden turns and turn penalties.
  */
 
 #include "utils/struct_vector_member_property_map.hh"
@@ -38,6 +48,10 @@
 #include "plugin_factory.hh"
 #include "utils/timer.hh"
 #include "utils/function_property_accessor.hh"
+#include "road_landmarks.hh"
+#include "mm_lib/turn_graph.hh"
+#include "ch_query_workspace.hh"
+#include "multimodal_graph_builder.hh"
 
 using namespace std;
 
@@ -81,6 +95,8 @@ public:
         OptionDescriptionList odl;
         declare_option( odl, "prepare_result", "Prepare result", Variant::from_bool(true) );
         declare_option( odl, "AStar/speed_heuristic", "Max speed (km/h) to use in A* heuristic", Variant::from_float( 90.0 ) );
+        declare_option( odl, "AStar/heuristic", "A* heuristic: euclidian or alt (landmarks, needs AStar/landmarks)", Variant::from_string( "euclidian" ) );
+        declare_option( odl, "AStar/active_landmarks", "Maximum number of landmarks used by the ALT heuristic", Variant::from_int( 8 ) );
         declare_option( odl, "Time/walking_speed", "Average walking speed (km/h)", Variant::from_float( 3.6 ));
         declare_option( odl, "Time/cycling_speed", "Average cycling speed (km/h)", Variant::from_int( 12.0 ));
         return odl;
@@ -100,10 +116,59 @@ public:
         if ( graph_ == nullptr ) {
             throw std::runtime_error( "Problem loading the multimodal graph" );
         }
+
+        // landmarks of the ALT heuristic
+        auto it = options.find( "AStar/landmarks" );
+        if ( it != options.end() && it->second.as<bool>() ) {
+            auto fit = options.find( "AStar/landmarks_file" );
+            if ( fit != options.end() ) {
+                // memory-mapped dump of road_landmarks
+                VariantMap landmark_options;
+                landmark_options["from_file"] = fit->second;
+                landmarks_ = dynamic_cast<const RoadLandmarks*>( load_routing_data( "road_landmarks", progression, landmark_options ) );
+                if ( landmarks_ == nullptr ) {
+                    throw std::runtime_error( "Problem loading the road landmarks" );
+                }
+            }
+            else {
+                size_t n_landmarks = 16;
+                LandmarkSelection selection = LandmarkSelectionAvoid;
+                auto oit = options.find( "landmarks/count" );
+                if ( oit != options.end() ) {
+                    n_landmarks = size_t( oit->second.as<int64_t>() );
+                }
+                oit = options.find( "landmarks/selection" );
+                if ( oit != options.end() ) {
+                    selection = landmark_selection_from_string( oit->second.str() );
+                }
+                own_landmarks_.reset( new RoadLandmarks( graph_->road(), n_landmarks, selection ) );
+                landmarks_ = own_landmarks_.get();
+            }
+            if ( landmarks_->num_vertices() != num_vertices( graph_->road() ) ) {
+                throw std::runtime_error( "The road landmarks have not been computed on this road graph" );
+            }
+        }
+
+        // edge-based graph of cars
+        it = options.find( "AStar/turn_restrictions" );
+        if ( it != options.end() && it->second.as<bool>() ) {
+            Db::Connection connection( db_options() );
+            Road::Restrictions restrictions = import_turn_restrictions( connection, graph_->road(), schema_name() );
+            turn_graph_.reset( new TurnGraph( graph_->road(), restrictions, TrafficRuleCar ) );
+            std::cout << "Turn graph of " << turn_graph_->num_nodes() << " nodes and " << turn_graph_->num_turns() << " turns" << std::endl;
+        }
     }
 
     const RoutingData* routing_data() const { return graph_; }
 
+    ///
+    /// Landmarks of the ALT heuristic, null if the plugin has been loaded without AStar/landmarks
+    const RoadLandmarks* landmarks() const { return landmarks_; }
+
+    ///
+    /// Edge-based graph of cars, null if the plugin has been loaded without AStar/turn_restrictions
+    const TurnGraph* turn_graph() const { return turn_graph_.get(); }
+
     virtual std::unique_ptr<PluginRequest> request( const VariantMap& options = VariantMap() ) const;
 
     struct VertexRoutingData
@@ -135,6 +200,11 @@ public:
 private:
     const Multimodal::Graph* graph_;
 
+    const RoadLandmarks* landmarks_ = nullptr;
+    std::unique_ptr<RoadLandmarks> own_landmarks_;
+
+    std::unique_ptr<TurnGraph> turn_graph_;
+
     mutable ThreadRoutingData thread_routing_data_;
 };
 
@@ -184,6 +254,153 @@ private:
 
     struct path_found_exception {};
 
+    ///
+    /// A* on the turn graph, from the sections leaving the origin until a section arriving at the destination is examined.
+    /// The heuristic of a node is the one of the target of its section
+    /// \returns whether a path has been found, its road edges are then in path
+    template <typename Heuristic, typename CarWeightMap>
+    bool turn_search( const TurnGraph& turns,
+                      const Road::Graph& road_graph,
+                      Road::Vertex origin,
+                      Road::Vertex destination,
+                      Heuristic& h,
+                      CarWeightMap car_weight_map,
+                      std::vector<Road::Edge>& path,
+                      size_t& iterations )
+    {
+        typedef TurnGraph::Node Node;
+        path.clear();
+        if ( origin == destination ) {
+            return true;
+        }
+
+        // labels and queue of the calling thread, kept between queries.
+        // Queue entries are keyed by potential + heuristic and keep the potential they were pushed with
+        static thread_local TimestampedLabels<float> labels;
+        static thread_local ReusableMinQueue<float, std::pair<float, Node>> queue;
+        labels.reset( turns.num_nodes() );
+        queue.clear();
+
+        Road::OutEdgeIterator oi, oi_end;
+        for ( boost::tie( oi, oi_end ) = out_edges( origin, road_graph ); oi != oi_end; oi++ ) {
+            const float cost = get( car_weight_map, *oi );
+            // a path starts on the node of the edge itself
+            const Node n = oi->idx;
+            if ( cost < labels.potential( n ) ) {
+                labels.set( n, cost, n );
+                queue.push( cost + h( target( *oi, road_graph ) ), std::make_pair( cost, n ) );
+            }
+        }
+
+        while ( !queue.empty() ) {
+            float pi;
+            Node n;
+            std::tie( pi, n ) = queue.top().second;
+            queue.pop();
+            if ( pi > labels.potential( n ) ) {
+                // outdated queue entry, the label has been improved since
+                continue;
+            }
+            const Road::Vertex v = target( turns.road_edge( n ), road_graph );
+            if ( v == destination ) {
+                for ( Node m = n; ; m = labels.predecessor( m ) ) {
+                    path.push_back( turns.road_edge( m ) );
+                    if ( labels.predecessor( m ) == m ) {
+                        break;
+                    }
+                }
+                std::reverse( path.begin(), path.end() );
+                return true;
+            }
+            iterations++;
+
+            for ( uint32_t t = turns.first_turn( n ); t < turns.first_turn( n + 1 ); t++ ) {
+                const Node m = turns.turn_target( t );
+                const Road::Edge e = turns.road_edge( m );
+                const float cost = pi + get( car_weight_map, e ) + float( turns.turn_penalty( t ) );
+                if ( cost < labels.potential( m ) ) {
+                    labels.set( m, cost, n );
+                    queue.push( cost + h( target( e, road_graph ) ), std::make_pair( cost, m ) );
+                }
+            }
+        }
+        return false;
+    }
+
+    ///
+    /// A* from origin, stopped when the destination is examined.
+    /// Car routes are searched on the turn graph if there is one
+    template <typename Heuristic, typename CarWeightMap, typename ConstWeightMap>
+    void search( const Road::Graph& road_graph,
+                 std::vector<AStarRoadPlugin::VertexRoutingData>& vertex_data,
+                 Road::Vertex origin,
+                 Road::Vertex destination,
+                 Heuristic& h,
+                 bool car,
+                 CarWeightMap car_weight_map,
+                 ConstWeightMap const_weight_map,
+                 const TurnGraph* turns,
+                 std::vector<Road::Edge>& turn_path,
+                 bool& turn_path_found,
+                 size_t& iterations )
+    {
+        if ( car && turns ) {
+            turn_path_found = turn_search( *turns, road_graph, origin, destination, h, car_weight_map, turn_path, iterations );
+            return;
+        }
+
+        GoalVisitor vis( destination, iterations );
+
+        auto pred_map = make_struct_vector_member_property_map( vertex_data, &AStarRoadPlugin::VertexRoutingData::pred );
+        auto cost_map = make_struct_vector_member_property_map( vertex_data, &AStarRoadPlugin::VertexRoutingData::cost );
+        auto distance_map = make_struct_vector_member_property_map( vertex_data, &AStarRoadPlugin::VertexRoutingData::distance );
+        auto color_map = make_struct_vector_member_property_map( vertex_data, &AStarRoadPlugin::VertexRoutingData::color );
+
+        distance_map[origin] = 0.0;
+        cost_map[origin] = h( origin );
+
+        put( color_map, origin, boost::white_color );
+
+        auto vertex_index = get( boost::vertex_index, road_graph );
+        try {
+            if ( car ) {
+                astar_search_no_init( road_graph,
+                                      origin,
+                                      h,
+                                      vis,
+                                      pred_map,
+                                      cost_map,
+                                      distance_map,
+                                      car_weight_map,
+                                      color_map,
+                                      vertex_index,
+                                      std::less<float>(),
+                                      boost::closed_plus<float>(),
+                                      std::numeric_limits<float>::max(),
+                                      0.0 );
+            }
+            else {
+                astar_search( road_graph,
+                              origin,
+                              h,
+                              vis,
+                              pred_map,
+                              cost_map,
+                              distance_map,
+                              const_weight_map,
+                              vertex_index,
+                              color_map,
+                              std::less<float>(),
+                              boost::closed_plus<float>(),
+                              std::numeric_limits<float>::max(),
+                              0.0 );
+            }
+        }
+        catch ( astar_goal_found& ) {
+            // short cut
+        }
+    }
+
 public:
     AStarRoadPluginRequest( const AStarRoadPlugin* parent, const VariantMap& options, const Multimodal::Graph* graph )
         : PluginRequest( parent, options ), graph_( *graph )
@@ -238,78 +455,80 @@ public:
         std::cout << "origin " << origin << " destination " << destination << std::endl;
 
         size_t iterations = 0;
-        GoalVisitor vis( destination, iterations );
 
-        EuclidianHeuristic h( road_graph, destination, max_speed );
+        // car routes honour turn restrictions on the turn graph
+        const TurnGraph* turns = mode == TransportModePrivateCar ? p->turn_graph() : nullptr;
+        std::vector<Road::Edge> turn_path;
+        bool turn_path_found = false;
 
         auto pred_map = make_struct_vector_member_property_map( vertex_data, &AStarRoadPlugin::VertexRoutingData::pred );
-        auto cost_map = make_struct_vector_member_property_map( vertex_data, &AStarRoadPlugin::VertexRoutingData::cost );
-        auto distance_map = make_struct_vector_member_property_map( vertex_data, &AStarRoadPlugin::VertexRoutingData::distance );
-        auto color_map = make_struct_vector_member_property_map( vertex_data, &AStarRoadPlugin::VertexRoutingData::color );
 
-        distance_map[origin] = 0.0;
-        cost_map[origin] = h( origin );
-
-        put( color_map, origin, boost::white_color );
+        const std::string heuristic = get_string_option( "AStar/heuristic" );
+        if ( heuristic == "alt" ) {
+            const RoadLandmarks* landmarks = p->landmarks();
+            if ( landmarks == nullptr ) {
+                throw std::runtime_error( "The ALT heuristic needs landmarks, load the plugin with the AStar/landmarks option" );
+            }
+            // lengths of the walking / cycling metric are converted to minutes
+            ALTHeuristic h( *landmarks,
+                            mode == TransportModePrivateCar ? LandmarkMetricCarTravelTime : LandmarkMetricWalkingCyclingLength,
+                            origin,
+                            destination,
+                            mode == TransportModePrivateCar ? 1.0 : 60.0 / ( ( mode == TransportModeWalking ? walking_speed : cycling_speed ) * 1000.0 ),
+                            size_t( get_int_option( "AStar/active_landmarks" ) ) );
+            metrics_["active_landmarks"] = Variant::from_int( h.active_landmarks().size() );
+            search( road_graph, vertex_data, origin, destination, h, mode == TransportModePrivateCar, car_weight_map, const_weight_map, turns, turn_path, turn_path_found, iterations );
+        }
+        else if ( heuristic == "euclidian" ) {
+            EuclidianHeuristic h( road_graph, destination, max_speed );
+            search( road_graph, vertex_data, origin, destination, h, mode == TransportModePrivateCar, car_weight_map, const_weight_map, turns, turn_path, turn_path_found, iterations );
+        }
+        else {
+            throw std::invalid_argument( "Unknown A* heuristic " + heuristic );
+        }
 
         bool path_found = true;
+        // road edges of the path
+        std::vector<Road::Edge> path_edges;
 
-        auto vertex_index = get( boost::vertex_index, road_graph );
-        try {
-            if ( mode == TransportModePrivateCar ) {
-                astar_search_no_init( road_graph,
-                                      origin,
-                                      h,
-                                      vis,
-                                      pred_map,
-                                      cost_map,
-                                      distance_map,
-                                      car_weight_map,
-                                      color_map,
-                                      vertex_index,
-                                      std::less<float>(),
-                                      boost::closed_plus<float>(),
-                                      std::numeric_limits<float>::max(),
-                                      0.0 );
-            }
-            else {
-                astar_search( road_graph,
-                              origin,
-                              h,
-                              vis,
-                              pred_map,
-                              cost_map,
-                              distance_map,
-                              const_weight_map,
-                              vertex_index,
-                              color_map,
-                              std::less<float>(),
-                              boost::closed_plus<float>(),
-                              std::numeric_limits<float>::max(),
-                              0.0 );
-            }
-        }
-        catch ( astar_goal_found& ) {
-            // short cut
+        if ( turns ) {
+            path_found = turn_path_found;
+            path_edges.swap( turn_path );
         }
+        else {
+            // reorder the path
+            Road::Vertex current = destination;
 
-        // reorder the path
-        Road::Vertex current = destination;
+            while ( current != origin ) {
+                path.push_front( current );
 
-        while ( current != origin ) {
-            path.push_front( current );
+                std::cout << current << "->";
+                if ( pred_map[current] == current ) {
+                    path_found = false;
+                    break;
+                }
 
-            std::cout << current << "->";
-            if ( pred_map[current] == current ) {
-                path_found = false;
-                break;
+                current = pred_map[ current ];
             }
 
-            current = pred_map[ current ];
-        }
+            std::cout << origin << '\n';
+            path.push_front( origin );
 
-        std::cout << origin << '\n';
-        path.push_front( origin );
+            std::list<Road::Vertex>::iterator prev = path.begin();
+            std::list<Road::Vertex>::iterator it = prev;
+            it++;
+
+            for ( ; path_found && it != path.end(); ++it, ++prev) {
+                // Find an edge, based on a source and destination vertex
+                Road::Edge e;
+                bool found = false;
+                boost::tie( e, found ) = boost::edge( *prev, *it, road_graph );
+
+                if ( found ) {
+                    path_edges.push_back( e );
+                }
+            }
+        }
 
         metrics_[ "time_s" ] = Variant::from_float( timer.elapsed() );
         metrics_["iterations"] = Variant::from_int( iterations );
@@ -326,24 +545,7 @@ public:
         if ( prepare_result ) {
             std::auto_ptr<Roadmap::Step> step;
 
-            Road::Edge current_road;
-            std::list<Road::Vertex>::iterator prev = path.begin();
-            std::list<Road::Vertex>::iterator it = prev;
-            it++;
-
-            for ( ; it != path.end(); ++it, ++prev) {
-                Road::Vertex v = *it;
-                Road::Vertex previous = *prev;
-
-                // Find an edge, based on a source and destination vertex
-                Road::Edge e;
-                bool found = false;
-                boost::tie( e, found ) = boost::edge( previous, v, road_graph );
-
-                if ( !found ) {
-                    continue;
-                }
-
+            for ( const Road::Edge& e : path_edges ) {
                 step.reset( new Roadmap::RoadStep() );
                 step->set_cost(CostId::CostDistance, road_graph[e].length());
                 if ( mode == TransportModePrivateCar ) {
@@ -28,14 +28,36 @@
 ///
 /// The automaton is build upon sequences of forbidden movements and penalties
 /// The optimized graph (finite state machine) is constructed by following the Aho & Corasick algorithms
+///
+/// The graph only holds the "goto" function. The "next" function, used while searching, is compiled
+/// into flat tables: a bit per symbol telling if it starts a sequence, and an open addressing hash
+/// table of the other transitions.
 
 #ifndef AUTOMATION_LIB_AUTOMATON_HH
 #define AUTOMATION_LIB_AUTOMATON_HH
 
+#include <vector>
 #include <boost/graph/graphviz.hpp>
 #include <boost/graph/iteration_macros.hpp>
 
+#include "road_graph.hh"
+
 namespace Tempus {
+
+///
+/// Index of a symbol in the transition tables, small non negative integers are expected.
+/// Integral symbols (vertices) are their own index, other symbol types specialize it
+template <class Symbol>
+struct AutomatonSymbolTraits
+{
+    static size_t index( const Symbol& s ) { return size_t( s ); }
+};
+
+template <>
+struct AutomatonSymbolTraits<Road::Edge>
+{
+    static size_t index( const Road::Edge& e ) { return e.idx; }
+};
 	
 template <class Symbol>	
 class Automaton {
@@ -112,10 +134,10 @@ public:
     State initial_state_; 
 	
     // Constructor
-    Automaton() {}
+    Automaton() : initial_state_( 0 ) {}
 		
     // Methods
-    void build_graph( Road::Restrictions sequences )
+    void build_graph( const Road::Restrictions& sequences )
     {
         automaton_graph_.clear(); 
 			
@@ -127,8 +149,8 @@ public:
             add_sequence(it->road_edges(), it->cost_per_transport()); 
         } 
 	
-        // The automaton graph is modified to represent the "next" function, the "failure" function is used to operate this transformation. 
-        build_shortcuts( build_failure_function() );
+        // The "next" function is compiled from the "goto" function and the "failure" function
+        build_transitions( build_failure_function() );
     }
 
     ///
@@ -140,7 +162,7 @@ public:
 
         // Iterating over forbidden road sequences 
         for ( size_t j = 0; j < symbol_sequence.size(); j++ ) {
-            std::pair< State, bool > transition_result = find_transition( current_state, symbol_sequence[j] );
+            std::pair< State, bool > transition_result = find_goto_( current_state, symbol_sequence[j] );
 				
             if ( transition_result.second == true )  {// this state already exists
                 current_state = transition_result.first;
@@ -149,131 +171,195 @@ public:
                 State s = boost::add_vertex( automaton_graph_ );
 
                 add_transition_( current_state, s, symbol_sequence[j], automaton_graph_ );
-
-                if ( j == symbol_sequence.size()-1 ) {
-                    automaton_graph_[ s ].penalty_per_mode = penalty_per_mode;
-                }
                 current_state = s; 
             } 
+            if ( j == symbol_sequence.size()-1 ) {
+                // the same sequence may be restricted several times, the highest penalty is kept
+                Road::Restriction::CostPerTransport& state_penalty = automaton_graph_[ current_state ].penalty_per_mode;
+                for ( const auto& p : penalty_per_mode ) {
+                    auto it = state_penalty.insert( p ).first;
+                    it->second = (std::max)( it->second, p.second );
+                }
+            }
         }
     } 
 
-    /// Build the failure function (see Aho & al.)
-    std::map < State, State > build_failure_function()
+    /// Build the failure function (see Aho & al.), indexed by state
+    /// Penalties of the failure state are also given to each state, since its sequence is a suffix.
+    /// Penalties of the same traffic rules are merged by keeping the highest one
+    std::vector< State > build_failure_function()
     {
-        std::cout << "failure function" << std::endl;
-        std::map< State, State > failure_function_; 
-        failure_function_.clear(); 
-        std::list< State > q; 
+        std::vector< State > failure_function( boost::num_vertices( automaton_graph_ ), initial_state_ );
+
+        // states in breadth first order, a failure state is always before the states it is the failure of
+        std::vector< State > q;
+        q.reserve( boost::num_vertices( automaton_graph_ ) );
 				
         // All successors of the initial state return to initial state when failing
         BGL_FORALL_OUTEDGES_T( initial_state_, edge, automaton_graph_, Graph ) {
-            const State& s = target( edge, automaton_graph_ );
-            q.push_back( s );
-            failure_function_[ s ] = initial_state_;
+            q.push_back( target( edge, automaton_graph_ ) );
         } 
 				
-        // Iterating over the list of states which do not have failure state
-        State r, state;
-        while ( ! q.empty() ) {
-            r = q.front();
-            q.pop_front();
+        for ( size_t i = 0; i < q.size(); i++ ) {
+            const State r = q[i];
             BGL_FORALL_OUTEDGES_T( r, edge, automaton_graph_, Graph ) {
                 State s = target( edge, automaton_graph_ );
                 Symbol a = automaton_graph_[edge].symbol;
                 q.push_back( s );
-                state = failure_function_[ s ];
-                while ( find_transition( state, a ).second == false && state != initial_state_ ) {
-                    state = failure_function_[ state ];
+                State state = failure_function[ r ];
+                while ( find_goto_( state, a ).second == false && state != initial_state_ ) {
+                    state = failure_function[ state ];
                 }
-                std::pair<State,bool> t = find_transition( state, a );
+                std::pair<State,bool> t = find_goto_( state, a );
                 if ( t.second == true ) {
-                    failure_function_[ s ] = t.first;
-                }
-                else {
-                    failure_function_[ s ] = initial_state_;
+                    failure_function[ s ] = t.first;
+                    // the restrictions of the suffix apply as well, the highest penalty is kept
+                    Road::Restriction::CostPerTransport& s_penalty = automaton_graph_[ s ].penalty_per_mode;
+                    for ( const auto& p : automaton_graph_[ t.first ].penalty_per_mode ) {
+                        auto it = s_penalty.insert( p ).first;
+                        it->second = (std::max)( it->second, p.second );
+                    }
                 }
             } 
         }
-        std::cout << "end of failure" << std::endl;
 
-        return failure_function_;
+        return failure_function;
     }
 
     /// corresponds to building the "next" function
-    void build_shortcuts(const std::map < State, State >& failure_function_)
+    ///
+    /// Transitions of the initial state are flagged in starts_. Other states keep their "goto" transitions
+    /// and inherit those of their failure state. Transitions back to the initial state are not stored,
+    /// they are looked up again from the initial state by find_transition()
+    void build_transitions( const std::vector< State >& failure_function )
     {
-        using namespace boost;
+        const size_t n = boost::num_vertices( automaton_graph_ );
 
-        // copy vertices
-        Graph automaton_copy;
-        BGL_FORALL_VERTICES_T( v, automaton_graph_, Graph ) {
-            State s = add_vertex(automaton_copy);
-            automaton_copy[s].penalty_per_mode = automaton_graph_[s].penalty_per_mode;
+        size_t max_symbol = 0;
+        BGL_FORALL_EDGES_T( edge, automaton_graph_, Graph ) {
+            max_symbol = (std::max)( max_symbol, AutomatonSymbolTraits<Symbol>::index( automaton_graph_[edge].symbol ) );
         }
+        starts_.assign( boost::num_edges( automaton_graph_ ) ? max_symbol + 1 : 0, false );
 
-        std::list< State > q;
-
+        // next transitions of each state, as (symbol, target)
+        std::vector< std::vector< std::pair< size_t, State > > > next( n );
+        std::vector< State > q;
+        q.reserve( n );
+        size_t num_transitions = 0;
         BGL_FORALL_OUTEDGES_T( initial_state_, edge, automaton_graph_, Graph ) {
-            BOOST_ASSERT( edge.get_property() );
-            State s = target( edge, automaton_graph_ );
-            Symbol a = automaton_graph_[edge].symbol;
-
-            q.push_back( s );
-            add_transition_( initial_state_, s, a, automaton_copy );
+            const size_t a = AutomatonSymbolTraits<Symbol>::index( automaton_graph_[edge].symbol );
+            starts_[a] = true;
+            next[initial_state_].push_back( std::make_pair( a, target( edge, automaton_graph_ ) ) );
+            num_transitions++;
+            q.push_back( target( edge, automaton_graph_ ) );
         }
-
-        std::cout << "build shortcuts" << std::endl;
-        std::map<State, State> next;
-        State r; 
-        while ( ! q.empty() ) {
-            r = q.front();
-            q.pop_front();
-
-            State f = initial_state_;
-            typename std::map<State,State>::const_iterator fit = failure_function_.find(r);
-            BOOST_ASSERT( fit != failure_function_.end() );
-            f = fit->second;
+        for ( size_t i = 0; i < q.size(); i++ ) {
+            const State r = q[i];
+            std::vector< std::pair< size_t, State > >& r_next = next[r];
+            BGL_FORALL_OUTEDGES_T( r, edge, automaton_graph_, Graph ) {
+                r_next.push_back( std::make_pair( AutomatonSymbolTraits<Symbol>::index( automaton_graph_[edge].symbol ), target( edge, automaton_graph_ ) ) );
+                q.push_back( target( edge, automaton_graph_ ) );
+            }
+            const State f = failure_function[r];
             if ( f != initial_state_ ) {
-                BOOST_ASSERT( f != r ); // f != r, unless the failure function is not built correctly
-
-                BGL_FORALL_OUTEDGES_T( f, edge, automaton_graph_, Graph ) {
-                    State s = target( edge, automaton_graph_ );
-                    Symbol a = automaton_graph_[edge].symbol;
-
-                    // we add an edge from r to s in the copy
-                    // warning: it only works because vertices are stored as indices, not addresses (vecS)
-                    add_transition_( r, s, a, automaton_copy );
+                // the failure state is before r in the queue, its next transitions are complete
+                const size_t goto_size = r_next.size();
+                for ( const auto& t : next[f] ) {
+                    bool found = false;
+                    for ( size_t j = 0; j < goto_size && !found; j++ ) {
+                        found = r_next[j].first == t.first;
+                    }
+                    if ( !found ) {
+                        r_next.push_back( t );
+                    }
                 }
             }
-            BGL_FORALL_OUTEDGES_T( r, edge, automaton_graph_, Graph ) {
-                State s = target( edge, automaton_graph_ );
-                Symbol a = automaton_graph_[edge].symbol;
+            num_transitions += r_next.size();
+        }
 
-                q.push_back( target( edge, automaton_graph_ ) );
-                add_transition_( r, s, a, automaton_copy );
+        // at most half full
+        size_t capacity = 2;
+        while ( capacity < 2 * num_transitions ) {
+            capacity *= 2;
+        }
+        transitions_.assign( capacity, TransitionSlot{ NO_STATE, 0, 0 } );
+        for ( State r = 0; r < n; r++ ) {
+            for ( const auto& t : next[r] ) {
+                size_t i = hash_( r, t.first ) & ( capacity - 1 );
+                while ( transitions_[i].from != NO_STATE ) {
+                    i = ( i + 1 ) & ( capacity - 1 );
+                }
+                transitions_[i] = TransitionSlot{ r, t.first, t.second };
             }
         }
-        // the new automaton is ready, replace
-        automaton_graph_ = automaton_copy;
-        std::cout << "end shortcuts" << std::endl;
     }
 		
     ///
     /// Look for a transition in the automaton from the state q
     /// and involving an symbol (vertex or edge) e
+    /// If there is none, the initial state is returned
     std::pair< State, bool > find_transition( State q, Symbol e ) const
+    {
+        const size_t a = AutomatonSymbolTraits<Symbol>::index( e );
+        if ( q != initial_state_ ) {
+            const TransitionSlot* t = find_slot_( q, a );
+            if ( t ) {
+                return std::make_pair( t->to, true );
+            }
+        }
+        if ( a < starts_.size() && starts_[a] ) {
+            return std::make_pair( find_slot_( initial_state_, a )->to, true );
+        }
+        // If transition not found
+        return std::make_pair( initial_state_, false );
+    }
+
+private:
+    static const State NO_STATE = State(-1);
+
+    struct TransitionSlot
+    {
+        State from;
+        size_t symbol;
+        State to;
+    };
+
+    // whether a symbol has a transition from the initial state, indexed by AutomatonSymbolTraits<Symbol>::index()
+    std::vector<bool> starts_;
+    // next function, open addressing with linear probing
+    std::vector<TransitionSlot> transitions_;
+
+    static size_t hash_( State q, size_t a )
+    {
+        uint64_t h = uint64_t( a ) * 0x9E3779B97F4A7C15ULL ^ uint64_t( q ) * 0xC2B2AE3D27D4EB4FULL;
+        return size_t( h ^ ( h >> 32 ) );
+    }
+
+    const TransitionSlot* find_slot_( State q, size_t a ) const
+    {
+        if ( transitions_.empty() ) {
+            return nullptr;
+        }
+        const size_t mask = transitions_.size() - 1;
+        for ( size_t i = hash_( q, a ) & mask; transitions_[i].from != NO_STATE; i = ( i + 1 ) & mask ) {
+            if ( transitions_[i].from == q && transitions_[i].symbol == a ) {
+                return &transitions_[i];
+            }
+        }
+        return nullptr;
+    }
+
+    // "goto" function, only used while building
+    std::pair< State, bool > find_goto_( State q, Symbol e ) const
     {
         BGL_FORALL_OUTEDGES_T( q, edge, automaton_graph_, Graph ) {
             if ( automaton_graph_[ edge ].symbol == e ) {
                 return std::make_pair( target( edge, automaton_graph_ ), true );
             }
         }
-        // If transition not found
-        return std::make_pair( 0, false );
+        return std::make_pair( initial_state_, false );
     }
 
-private:
     // helper function
     void add_transition_( State r, State s, Symbol a, Graph& graph )
     {
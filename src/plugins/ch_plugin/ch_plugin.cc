@@ -24,16 +24,17 @@
 #ifdef _WIN32
 #pragma warning(push, 0)
 #endif
-#include <queue>
-#include <boost/pending/indirect_cmp.hpp>
 #include <boost/graph/visitors.hpp>
 #include <boost/graph/dijkstra_shortest_paths_no_color_map.hpp>
 #include <boost/property_map/function_property_map.hpp>
 #include <boost/format.hpp>
+#include <boost/lexical_cast.hpp>
 #ifdef _WIN32
 #pragma warning(pop)
 #endif
 
+#include "ch_query_workspace.hh"
+#include "ch_distance_table.hh"
 #include "utils/associative_property_map_default_value.hh"
 #include "utils/timer.hh"
 
@@ -44,6 +45,11 @@ namespace Tempus {
 const Plugin::OptionDescriptionList CHPlugin::option_descriptions()
 {
     Plugin::OptionDescriptionList odl;
+    declare_option( odl, "ch/phast", "Compute costs from the origin to every node (PHAST), returned as an isochrone", Variant::from_bool( false ) );
+    declare_option( odl, "ch/phast_origins", "Other PHAST origins (road node id, comma separated), one isochrone is returned per origin", Variant::from_string( "" ) );
+    declare_option( odl, "ch/phast_limit", "Maximum cost of the nodes returned by PHAST (0: no limit)", Variant::from_float( 0.0 ) );
+    declare_option( odl, "Time/walking_speed", "Average walking speed (km/h), customizable CH only", Variant::from_float( 3.6 ) );
+    declare_option( odl, "Time/cycling_speed", "Average cycling speed (km/h), customizable CH only", Variant::from_float( 12.0 ) );
     return odl;
 }
 
@@ -54,46 +60,72 @@ const Plugin::Capabilities CHPlugin::plugin_capabilities()
     return caps;
 }
 
-CHPlugin::CHPlugin( ProgressionCallback& progression, const VariantMap& options ) : Plugin( "ch_plugin", options )
+CHPlugin::CHPlugin( ProgressionCallback& progression, const VariantMap& options ) : Plugin( "ch_plugin", options ), rd_( nullptr ), cch_( nullptr ), tch_( nullptr ), turn_ch_( nullptr )
 {
+    auto tit = options.find( "ch/time_dependent" );
+    if ( tit != options.end() && !tit->second.str().empty() ) {
+        // time-dependent CH of cars, dumped by ch_preprocess --time-dependent
+        VariantMap tch_options( options );
+        tch_options["from_file"] = Variant::from_string( tit->second.str() );
+        const RoutingData* rd = load_routing_data( "tch_graph", progression, tch_options );
+        tch_ = dynamic_cast<const TCHRoutingData*>( rd );
+        if ( tch_ == nullptr ) {
+            throw std::runtime_error( "Problem loading the time-dependent CH routing data" );
+        }
+        return;
+    }
+
+    auto rit = options.find( "ch/turn_restrictions" );
+    if ( rit != options.end() && !rit->second.str().empty() ) {
+        // turn-aware CH of cars, dumped by ch_preprocess --turn-restrictions
+        VariantMap turn_options( options );
+        turn_options["from_file"] = Variant::from_string( rit->second.str() );
+        const RoutingData* rd = load_routing_data( "turn_ch_graph", progression, turn_options );
+        turn_ch_ = dynamic_cast<const TurnCHRoutingData*>( rd );
+        if ( turn_ch_ == nullptr ) {
+            throw std::runtime_error( "Problem loading the turn-aware CH routing data" );
+        }
+        return;
+    }
+
+    auto it = options.find( "ch/customizable" );
+    if ( it != options.end() && it->second.as<bool>() ) {
+        // one CH per transport mode, customized out of a metric independent ordering
+        const RoutingData* rd = load_routing_data( "cch_graph", progression, options );
+        cch_ = dynamic_cast<const CCHRoutingData*>( rd );
+        if ( cch_ == nullptr ) {
+            throw std::runtime_error( "Problem loading the customizable CH routing data" );
+        }
+        // all the metrics share the vertices of the topology
+        load_node_coordinates( cch_->metric( TransportModeWalking ) );
+        return;
+    }
+
     // load graph
     const RoutingData* rd = load_routing_data( "ch_graph", progression, options );
     rd_ = dynamic_cast<const CHRoutingData*>( rd );
     if ( rd_ == nullptr ) {
         throw std::runtime_error( "Problem loading the CH routing data" );
     }
+    load_node_coordinates( *rd_ );
 }
 
-
-
-template <typename OutIterator>
-void unpack_edge( CHVertex v1, CHVertex v2, const MiddleNodeMap& middle_node, OutIterator out_it )
+void CHPlugin::load_node_coordinates( const CHRoutingData& rd )
 {
-    auto it = middle_node.find( std::make_pair(v1,v2) );
-    if ( it != middle_node.end() ) {
-        unpack_edge( v1, it->second, middle_node, out_it );
-        unpack_edge( it->second, v2, middle_node, out_it );
-    }
-    else {
-        *out_it = v1;
-        out_it++;
+    // node coordinates are not part of the CH graph
+    node_coordinates_.resize( num_vertices( rd.ch_query() ) );
+    Db::Connection connection( db_options() );
+    Db::ResultIterator res_it = connection.exec_it( "SELECT id, st_x(geom), st_y(geom) FROM tempus.road_node" );
+    Db::ResultIterator it_end;
+    for ( ; res_it != it_end; res_it++ ) {
+        Db::RowValue res_i = *res_it;
+        boost::optional<CHVertex> v = rd.vertex_from_id( res_i[0].as<db_id_t>() );
+        if ( v ) {
+            node_coordinates_[v.get()] = Point2D( res_i[1].as<float>(), res_i[2].as<float>() );
+        }
     }
 }
 
-template <typename InIterator, typename OutIterator>
-void unpack_path( InIterator it_begin, InIterator it_end, const MiddleNodeMap& middle_node, OutIterator out_it )
-{
-    if ( it_begin == it_end )
-        return;
-    auto it = it_begin;
-    auto it2 = it_begin;
-    it2++;
-    for ( ; it2 != it_end; it++, it2++ ) {
-        unpack_edge( *it, *it2, middle_node, out_it );
-    }
-    *out_it = *it;
-    out_it++;
-}
 
 
 template <typename CostType, typename WeightMap>
@@ -101,34 +133,19 @@ std::list<CHVertex> bidirectional_ch_dijkstra( const CHRoutingData& rd, CHVertex
 {
     const CHQuery& graph = rd.ch_query();
 
-    std::map<CHVertex, CostType> costs;
     std::list<CHVertex> returned_path;
 
     const CostType infinity = std::numeric_limits<CostType>::max();
 
-    typedef std::vector<CostType> PotentialMap;
-    size_t n = num_vertices( graph );
-    PotentialMap potential[2] = { PotentialMap( n, infinity ),
-                                  PotentialMap( n, infinity ) };
-    typedef CostType* PotentialPMap;
-    PotentialPMap potential_map[2] = { &potential[0][0], &potential[1][0] };
-
-    typedef boost::indirect_cmp<PotentialPMap, std::greater<CostType>> Cmp;
-
-    // FIXME is the heap needed ? since the graph is partitioned in two acyclic graphs with a topological order on nodes
-    // There may be a way to be faster: loop over each node in order and relax out edges
-    //typedef boost::heap::d_ary_heap< CHVertex, boost::heap::arity<4>, boost::heap::compare< Cmp >, boost::heap::mutable_<true> > VertexQueue;
-    typedef std::priority_queue<CHVertex, std::vector<CHVertex>, Cmp> VertexQueue;
-    Cmp cmp_fw( potential_map[0] );
-    Cmp cmp_bw( potential_map[1] );
-    VertexQueue vertex_queue[2] = { VertexQueue( cmp_fw ), VertexQueue( cmp_bw ) };
+    // labels and queues are reused from one query to another by the calling thread
+    CHQueryWorkspace<CostType>& ws = ch_query_workspace<CostType>( num_vertices( graph ) );
+    auto& labels = ws.labels;
+    auto& vertex_queue = ws.queue;
 
-    std::map<CHVertex, CHVertex> predecessor[2];
-
-    vertex_queue[0].push( origin );
-    put( potential_map[0], origin, 0.0 );
-    vertex_queue[1].push( destination );
-    put( potential_map[1], destination, 0.0 );
+    vertex_queue[0].push( 0, origin );
+    labels[0].set( origin, 0, origin );
+    vertex_queue[1].push( 0, destination );
+    labels[1].set( destination, 0, destination );
 
     // direction : 0 = forward, 1 = backward
     int dir = 1;
@@ -137,9 +154,9 @@ std::list<CHVertex> bidirectional_ch_dijkstra( const CHRoutingData& rd, CHVertex
     CostType total_cost = infinity;
     bool path_found = false;
 
-    auto get_min_pi = [&vertex_queue,&potential_map]( int ldir ) {
+    auto get_min_pi = [&vertex_queue]( int ldir ) {
         if ( !vertex_queue[ldir].empty() ) {
-            return get( potential_map[ldir], vertex_queue[ldir].top() );
+            return vertex_queue[ldir].top().first;
         }
         return std::numeric_limits<CostType>::max();
     };
@@ -157,16 +174,21 @@ std::list<CHVertex> bidirectional_ch_dijkstra( const CHRoutingData& rd, CHVertex
         if ( vertex_queue[dir].empty() )
             dir = 1 - dir;
 
-        CHVertex min_v = vertex_queue[dir].top();
+        CostType min_pi;
+        CHVertex min_v;
+        std::tie( min_pi, min_v ) = vertex_queue[dir].top();
         vertex_queue[dir].pop();
-        CostType min_pi = get( potential_map[dir], min_v );
+        if ( min_pi > labels[dir].potential( min_v ) ) {
+            // outdated queue entry, the vertex has already been settled with a lower cost
+            continue;
+        }
 
         {
-            CostType min_pi2 = get( potential_map[1-dir], min_v );
+            CostType min_pi2 = labels[1-dir].potential( min_v );
             // if min_pi2 is not infinity, it means this node has already been seen
             // in the other direction
             // so it is a candidate top node
-            if ( min_pi + min_pi2 < total_cost ) {
+            if ( min_pi2 != infinity && min_pi + min_pi2 < total_cost ) {
                 top_node = min_v;
                 total_cost = min_pi + min_pi2;
                 path_found = true;
@@ -179,13 +201,12 @@ std::list<CHVertex> bidirectional_ch_dijkstra( const CHRoutingData& rd, CHVertex
                   oei++ ) {
                 CHVertex vv = target( *oei, graph );
 
-                CostType new_pi = get( potential_map[dir], vv );
+                CostType new_pi = labels[dir].potential( vv );
                 CostType cost = get( weight_map, *oei );
                 if ( min_pi + cost < new_pi ) {
                     // relax edge
-                    put( potential_map[dir], vv, min_pi + cost );
-                    vertex_queue[dir].push( vv );
-                    predecessor[dir][vv] = min_v;
+                    labels[dir].set( vv, min_pi + cost, min_v );
+                    vertex_queue[dir].push( min_pi + cost, vv );
                 }
             }
         }
@@ -195,36 +216,29 @@ std::list<CHVertex> bidirectional_ch_dijkstra( const CHRoutingData& rd, CHVertex
                   iei++ ) {
                 CHVertex vv = source( *iei, graph );
 
-                CostType new_pi = get( potential_map[dir], vv );
+                CostType new_pi = labels[dir].potential( vv );
                 CostType cost = get( weight_map, *iei );
                 if ( min_pi + cost < new_pi ) {
                     // relax edge
-                    put( potential_map[dir], vv, min_pi + cost );
-                    vertex_queue[dir].push( vv );
-                    predecessor[dir][vv] = min_v;
+                    labels[dir].set( vv, min_pi + cost, min_v );
+                    vertex_queue[dir].push( min_pi + cost, vv );
                 }
             }
         }
     }
 
     if ( !path_found ) {
-        //std::cout << "NO PATH FOUND" << std::endl;
         return returned_path;
     }
-    //std::cout << "PATH FOUND" << std::endl;
 
     // path from origin (s) to top node (x)
     // s = p[p[p[p[p[...[x]]]]]] , ..., p[x], x
-    //std::cout << "top node " << node_id[top_node] << std::endl;
-
-    std::list<CHVertex> path;
     CHVertex x = top_node;
     while (x != origin)
     {
         returned_path.push_front( x );
-        auto it = predecessor[0].find( x );
-        BOOST_ASSERT_MSG( it != predecessor[0].end(), "Can't find upward predecessor" );
-        x = it->second;
+        BOOST_ASSERT_MSG( labels[0].reached( x ), "Can't find upward predecessor" );
+        x = labels[0].predecessor( x );
     }
     returned_path.push_front( origin );
 
@@ -233,9 +247,8 @@ std::list<CHVertex> bidirectional_ch_dijkstra( const CHRoutingData& rd, CHVertex
     CHVertex t = top_node;
     while ( t != destination )
     {
-        auto it = predecessor[1].find( t );
-        BOOST_ASSERT_MSG( it != predecessor[0].end(), "Can't find downward predecessor" );
-        t = it->second;
+        BOOST_ASSERT_MSG( labels[1].reached( t ), "Can't find downward predecessor" );
+        t = labels[1].predecessor( t );
         returned_path.push_back( t );
     }
 
@@ -243,9 +256,11 @@ std::list<CHVertex> bidirectional_ch_dijkstra( const CHRoutingData& rd, CHVertex
     return returned_path;
 }
 
-std::pair<std::list<CHVertex>, float> ch_query( const CHRoutingData& rd, CHVertex ch_origin, CHVertex ch_destination )
+///
+/// Shortest path between two vertices, as a list of original (non shortcut) edges
+std::pair<std::vector<CHEdge>, float> ch_query( const CHRoutingData& rd, CHVertex ch_origin, CHVertex ch_destination )
 {
-    std::pair<std::list<CHVertex>, float> ret;
+    std::pair<std::vector<CHEdge>, float> ret;
 
     auto weight_map_fn = []( const CHQuery::edge_descriptor& e ) {
         return float(e.property().b.cost / 100.0);
@@ -255,7 +270,22 @@ std::pair<std::list<CHVertex>, float> ch_query( const CHRoutingData& rd, CHVerte
     auto path = bidirectional_ch_dijkstra( rd, ch_origin, ch_destination, weight_map, ret_cost );
 
     auto& ret_path = ret.first;
-    unpack_path( path.begin(), path.end(), rd.middle_node(), std::back_inserter( ret_path ) );
+    if ( path.size() > 1 ) {
+        const CHQuery& graph = rd.ch_query();
+        auto prev = path.begin();
+        auto it = prev;
+        it++;
+        for ( ; it != path.end(); ++it, ++prev ) {
+            // Find an edge, based on a source and destination vertex
+            CHEdge e;
+            bool found = false;
+            boost::tie( e, found ) = edge( *prev, *it, graph );
+            if ( !found ) {
+                throw std::runtime_error( (boost::format("Cannot find edge (%1%->%2%)") % rd.vertex_id( *prev ) % rd.vertex_id( *it )).str() );
+            }
+            rd.unpack_edge( e, ret_path );
+        }
+    }
     ret.second = ret_cost;
 
     return ret;
@@ -264,33 +294,71 @@ std::pair<std::list<CHVertex>, float> ch_query( const CHRoutingData& rd, CHVerte
 class CHPluginRequest : public PluginRequest
 {
 private:
-    const CHRoutingData& rd_;
+    const CHRoutingData* rd_;
+    const CCHRoutingData* cch_;
+    const TCHRoutingData* tch_;
+    const TurnCHRoutingData* turn_ch_;
+    const std::vector<Point2D>& node_coordinates_;
 public:
-    CHPluginRequest( const CHPlugin* parent, const VariantMap& options, const CHRoutingData& rd )
-        : PluginRequest( parent, options), rd_(rd)
+    CHPluginRequest( const CHPlugin* parent, const VariantMap& options, const CHRoutingData* rd, const CCHRoutingData* cch, const TCHRoutingData* tch,
+                     const TurnCHRoutingData* turn_ch, const std::vector<Point2D>& node_coordinates )
+        : PluginRequest( parent, options), rd_(rd), cch_(cch), tch_(tch), turn_ch_(turn_ch), node_coordinates_(node_coordinates)
     {}
 
     std::unique_ptr<Result> process( const Request& request ) override
     {
         Timer timer;
 
-        boost::optional<CHVertex> origin = rd_.vertex_from_id( request.origin() );
-        boost::optional<CHVertex> destination = rd_.vertex_from_id( request.destination() );
+        if ( tch_ ) {
+            return process_time_dependent( request, timer );
+        }
+        if ( turn_ch_ ) {
+            return process_turn_aware( request, timer );
+        }
+
+        // CH of the request
+        const CHRoutingData* rd = rd_;
+        db_id_t mode = TransportModeWalking;
+        // weights are hundredths of seconds with a customizable CH, centimeters otherwise
+        bool duration_weights = false;
+        std::shared_ptr<const CHRoutingData> customized;
+        if ( cch_ ) {
+            mode = customized_mode( request );
+            duration_weights = true;
+            CCHSpeeds speeds;
+            speeds.walking_speed = get_float_option( "Time/walking_speed" );
+            speeds.cycling_speed = get_float_option( "Time/cycling_speed" );
+            if ( ( mode == TransportModeWalking && speeds.walking_speed != cch_->speeds().walking_speed ) ||
+                 ( mode == TransportModePrivateBicycle && speeds.cycling_speed != cch_->speeds().cycling_speed ) ) {
+                customized = static_cast<const CHPlugin*>( plugin_ )->customized_metric( mode, speeds );
+                rd = customized.get();
+            }
+            else {
+                rd = &cch_->metric( mode );
+            }
+        }
+
+        boost::optional<CHVertex> origin = rd->vertex_from_id( request.origin() );
 
         if ( !origin ) {
             throw std::runtime_error( (boost::format("Can't find vertex of ID %1%") % request.origin()).str() );
         }
+
+        if ( get_bool_option( "ch/phast" ) ) {
+            return process_one_to_all( *rd, origin.get(), mode, duration_weights, timer );
+        }
+
+        boost::optional<CHVertex> destination = rd->vertex_from_id( request.destination() );
         if ( !destination ) {
             throw std::runtime_error( (boost::format("Can't find vertex of ID %1%") % request.destination()).str() );
         }
         std::cout << "From " << request.origin() << " to " << request.destination() << std::endl;
 
-        auto ch_ret = ch_query( rd_, origin.get(), destination.get() );
-        auto& ch_graph = rd_.ch_query();
+        auto ch_ret = ch_query( *rd, origin.get(), destination.get() );
 
         auto& path = ch_ret.first;
 
-        if ( path.empty() ) {
+        if ( path.empty() && origin.get() != destination.get() ) {
             throw std::runtime_error( "No path found !" );
         }
 
@@ -304,30 +372,106 @@ public:
 
         std::auto_ptr<Roadmap::Step> step;
 
-        Road::Edge current_road;
-        auto prev = path.begin();
-        auto it = prev;
-        it++;
+        for ( const CHEdge& e : path ) {
+            step.reset( new Roadmap::RoadStep() );
+            if ( duration_weights ) {
+                // in minutes
+                step->set_cost( CostId::CostDuration, e.property().b.cost / 6000.0 );
+            }
+            else {
+                step->set_cost( CostId::CostDistance, e.property().b.cost / 100.0 );
+            }
+            step->set_transport_mode( mode );
+            Roadmap::RoadStep* rstep = static_cast<Roadmap::RoadStep*>(step.get());
+            rstep->set_road_edge_id( e.property().db_id );
+            roadmap.add_step( step );
+        }
 
-        for ( ; it != path.end(); ++it, ++prev) {
-            CHVertex v = *it;
-            CHVertex previous = *prev;
+        Db::Connection connection( plugin_->db_options() );
+        fill_roadmap_from_db( roadmap.begin(), roadmap.end(), connection );
+        return result;
+    }
 
-            // Find an edge, based on a source and destination vertex
-            CHEdge e;
-            bool found = false;
-            boost::tie( e, found ) = edge( previous, v, ch_graph );
+    ///
+    /// Earliest arrival by car on the time-dependent CH, leaving after the time of the request
+    std::unique_ptr<Result> process_time_dependent( const Request& request, Timer& timer )
+    {
+        if ( get_bool_option( "ch/phast" ) ) {
+            throw std::invalid_argument( "PHAST is not available with a time-dependent CH" );
+        }
+        if ( request.steps()[1].constraint().type() != Request::TimeConstraint::ConstraintAfter ) {
+            throw std::runtime_error( "A 'depart after' constraint must be specified for a time-dependent CH" );
+        }
+        boost::optional<uint32_t> origin = tch_->vertex_from_id( request.origin() );
+        if ( !origin ) {
+            throw std::runtime_error( (boost::format("Can't find vertex of ID %1%") % request.origin()).str() );
+        }
+        boost::optional<uint32_t> destination = tch_->vertex_from_id( request.destination() );
+        if ( !destination ) {
+            throw std::runtime_error( (boost::format("Can't find vertex of ID %1%") % request.destination()).str() );
+        }
 
-            if ( !found ) {
-                std::cout << "Cannot find edge (" << rd_.vertex_id( previous ) << "->" << rd_.vertex_id( v ) << ")" << std::endl;
-            }
-            BOOST_ASSERT( found );
+        // minutes since midnight
+        const double departure_time = request.steps()[1].constraint().date_time().time_of_day().total_seconds() / 60.0;
+        std::vector<TCHRoutingData::PathStep> path;
+        const double travel_time = tch_->query( origin.get(), destination.get(), departure_time, &path );
+        if ( travel_time == TCHRoutingData::infinity() ) {
+            throw std::runtime_error( "No path found !" );
+        }
 
+        metrics_[ "time_s" ] = Variant::from_float( timer.elapsed() );
+
+        std::unique_ptr<Result> result( new Result() );
+        result->push_back( Roadmap() );
+        Roadmap& roadmap = result->back().roadmap();
+
+        roadmap.set_starting_date_time( request.steps()[1].constraint().date_time() );
+
+        std::auto_ptr<Roadmap::Step> step;
+        for ( const TCHRoutingData::PathStep& s : path ) {
             step.reset( new Roadmap::RoadStep() );
-            step->set_cost( CostId::CostDistance, e.property().b.cost / 100.0 );
-            step->set_transport_mode(1);
-            Roadmap::RoadStep* rstep = static_cast<Roadmap::RoadStep*>(step.get());
-            rstep->set_road_edge_id( e.property().db_id );
+            step->set_cost( CostId::CostDuration, s.travel_time );
+            step->set_transport_mode( TransportModePrivateCar );
+            static_cast<Roadmap::RoadStep*>(step.get())->set_road_edge_id( s.section_id );
+            roadmap.add_step( step );
+        }
+
+        Db::Connection connection( plugin_->db_options() );
+        fill_roadmap_from_db( roadmap.begin(), roadmap.end(), connection );
+        return result;
+    }
+
+    ///
+    /// Fastest path by car on the turn-aware CH, honouring turn restrictions and penalties
+    std::unique_ptr<Result> process_turn_aware( const Request& request, Timer& timer )
+    {
+        if ( get_bool_option( "ch/phast" ) ) {
+            throw std::invalid_argument( "PHAST is not available with a turn-aware CH" );
+        }
+        if ( std::find( request.allowed_modes().begin(), request.allowed_modes().end(), TransportModePrivateCar ) == request.allowed_modes().end() ) {
+            throw std::invalid_argument( "The turn-aware CH only supports the private car mode" );
+        }
+
+        std::vector<TurnCHRoutingData::PathStep> path;
+        const double travel_time = turn_ch_->query( request.origin(), request.destination(), &path );
+        if ( travel_time == TurnCHRoutingData::infinity() ) {
+            throw std::runtime_error( "No path found !" );
+        }
+
+        metrics_[ "time_s" ] = Variant::from_float( timer.elapsed() );
+
+        std::unique_ptr<Result> result( new Result() );
+        result->push_back( Roadmap() );
+        Roadmap& roadmap = result->back().roadmap();
+
+        roadmap.set_starting_date_time( request.steps()[1].constraint().date_time() );
+
+        std::auto_ptr<Roadmap::Step> step;
+        for ( const TurnCHRoutingData::PathStep& s : path ) {
+            step.reset( new Roadmap::RoadStep() );
+            step->set_cost( CostId::CostDuration, s.travel_time );
+            step->set_transport_mode( TransportModePrivateCar );
+            static_cast<Roadmap::RoadStep*>(step.get())->set_road_edge_id( s.section_id );
             roadmap.add_step( step );
         }
 
@@ -335,12 +479,116 @@ public:
         fill_roadmap_from_db( roadmap.begin(), roadmap.end(), connection );
         return result;
     }
+
+    ///
+    /// Transport mode of a request on a customizable CH: the first allowed mode
+    /// among walking, private bicycle and private car
+    static db_id_t customized_mode( const Request& request )
+    {
+        for ( db_id_t mode : request.allowed_modes() ) {
+            if ( mode == TransportModeWalking || mode == TransportModePrivateBicycle || mode == TransportModePrivateCar ) {
+                return mode;
+            }
+        }
+        throw std::invalid_argument( "The customizable CH only supports walking, private bicycle and private car modes" );
+    }
+
+    ///
+    /// Costs from the origin to every node, returned as an isochrone
+    /// (meters with the pedestrian CH, minutes with a customizable CH).
+    /// With the "ch/phast_origins" option, one isochrone is returned for each origin,
+    /// the origin of the request first
+    std::unique_ptr<Result> process_one_to_all( const CHRoutingData& rd, CHVertex origin, db_id_t mode, bool duration_weights, Timer& timer )
+    {
+        float limit = get_float_option( "ch/phast_limit" );
+        if ( limit <= 0.0 ) {
+            limit = std::numeric_limits<float>::max();
+        }
+
+        std::vector<CHVertex> origins( 1, origin );
+        std::string origins_str = get_string_option( "ch/phast_origins" );
+        while ( !origins_str.empty() ) {
+            const size_t p = origins_str.find( ',' );
+            const std::string id_str = origins_str.substr( 0, p );
+            origins_str = p == std::string::npos ? std::string() : origins_str.substr( p + 1 );
+            db_id_t id;
+            try {
+                id = boost::lexical_cast<db_id_t>( id_str );
+            }
+            catch ( std::exception& ) {
+                throw std::runtime_error( "Cannot parse " + id_str );
+            }
+            boost::optional<CHVertex> v = rd.vertex_from_id( id );
+            if ( !v ) {
+                throw std::runtime_error( (boost::format("Can't find vertex of ID %1%") % id).str() );
+            }
+            origins.push_back( v.get() );
+        }
+
+        std::vector<std::vector<float>> costs;
+        if ( origins.size() == 1 ) {
+            costs.push_back( ch_one_to_all( rd, origin ) );
+        }
+        else {
+            costs = ch_many_to_all( rd, origins );
+        }
+
+        metrics_[ "time_s" ] = Variant::from_float( timer.elapsed() );
+
+        std::unique_ptr<Result> result( new Result() );
+        for ( const std::vector<float>& origin_costs : costs ) {
+            result->push_back( Isochrone() );
+            Isochrone& isochrone = result->back().isochrone();
+            for ( CHVertex v = 0; v < origin_costs.size(); v++ ) {
+                if ( origin_costs[v] == CHDistanceTable::infinity() ) {
+                    continue;
+                }
+                // seconds -> minutes
+                const float c = duration_weights ? origin_costs[v] / 60.0f : origin_costs[v];
+                if ( c < limit ) {
+                    isochrone.emplace_back( node_coordinates_[v].x(), node_coordinates_[v].y(), mode, c );
+                }
+            }
+        }
+        return result;
+    }
 };
 
 
+std::shared_ptr<const CHRoutingData> CHPlugin::customized_metric( db_id_t transport_mode, const CCHSpeeds& speeds ) const
+{
+    const std::pair<db_id_t, float> key( transport_mode, transport_mode == TransportModeWalking ? speeds.walking_speed : speeds.cycling_speed );
+    {
+        boost::lock_guard<boost::mutex> lock( mutex_ );
+        for ( auto it = customized_cache_.begin(); it != customized_cache_.end(); ++it ) {
+            if ( it->first == key ) {
+                customized_cache_.splice( customized_cache_.begin(), customized_cache_, it );
+                return customized_cache_.front().second;
+            }
+        }
+    }
+
+    // customized without the lock, requests on cached metrics are not blocked meanwhile
+    std::shared_ptr<const CHRoutingData> rd( cch_->customize( transport_mode, speeds ).release() );
+
+    boost::lock_guard<boost::mutex> lock( mutex_ );
+    for ( auto it = customized_cache_.begin(); it != customized_cache_.end(); ++it ) {
+        if ( it->first == key ) {
+            // customized by another request in the meantime
+            customized_cache_.splice( customized_cache_.begin(), customized_cache_, it );
+            return customized_cache_.front().second;
+        }
+    }
+    customized_cache_.push_front( std::make_pair( key, rd ) );
+    if ( customized_cache_.size() > CUSTOMIZED_CACHE_SIZE ) {
+        customized_cache_.pop_back();
+    }
+    return rd;
+}
+
 std::unique_ptr<PluginRequest> CHPlugin::request( const VariantMap& options ) const
 {
-    return std::unique_ptr<PluginRequest>( new CHPluginRequest( this, options, *rd_ ) );
+    return std::unique_ptr<PluginRequest>( new CHPluginRequest( this, options, rd_, cch_, tch_, turn_ch_, node_coordinates_ ) );
 }
 
 } // namespace Tempus
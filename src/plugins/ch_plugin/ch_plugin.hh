@@ -17,8 +17,16 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <list>
+#include <memory>
+#include <boost/thread/mutex.hpp>
+
 #include "plugin.hh"
 #include "ch_routing_data.hh"
+#include "cch_routing_data.hh"
+#include "tch_routing_data.hh"
+#include "turn_ch_routing_data.hh"
+#include "point.hh"
 
 namespace Tempus
 {
@@ -32,12 +40,45 @@ public:
 
     CHPlugin( ProgressionCallback& progression, const VariantMap& options );
 
-    const RoutingData* routing_data() const override { return rd_; }
+    const RoutingData* routing_data() const override
+    {
+        if ( tch_ ) {
+            return tch_;
+        }
+        if ( turn_ch_ ) {
+            return turn_ch_;
+        }
+        return cch_ ? static_cast<const RoutingData*>( cch_ ) : rd_;
+    }
 
     std::unique_ptr<PluginRequest> request( const VariantMap& options = VariantMap() ) const override;
 
+    ///
+    /// Customizable CH metric of a transport mode, with other walking or cycling speeds than the loaded ones.
+    /// The least recently used metric is evicted once more than CUSTOMIZED_CACHE_SIZE are cached.
+    /// Thread-safe, the returned CH stays valid after its eviction.
+    std::shared_ptr<const CHRoutingData> customized_metric( db_id_t transport_mode, const CCHSpeeds& speeds ) const;
+
+    static const size_t CUSTOMIZED_CACHE_SIZE = 4;
+
 private:
+    void load_node_coordinates( const CHRoutingData& rd );
+
+    /// CH of pedestrians, with distances as weights
     const CHRoutingData* rd_;
+    /// customizable CH, if the plugin has been loaded with the "ch/customizable" option
+    const CCHRoutingData* cch_;
+    /// time-dependent CH of cars, if the plugin has been loaded with the "ch/time_dependent" option
+    const TCHRoutingData* tch_;
+    /// turn-aware CH of cars, if the plugin has been loaded with the "ch/turn_restrictions" option
+    const TurnCHRoutingData* turn_ch_;
+    /// coordinates of the road node of each CH vertex, for PHAST isochrones
+    std::vector<Point2D> node_coordinates_;
+
+    // ((transport mode, speed), customized CH), most recently used first
+    mutable std::list<std::pair<std::pair<db_id_t, float>, std::shared_ptr<const CHRoutingData>>> customized_cache_;
+    // guards the cache of customized metrics
+    mutable boost::mutex mutex_;
 };
 
 } // namespace Tempus
@@ -19,17 +19,16 @@
 
 #include "common.hh"
 #include "ch_preprocess.hh"
+#include "ch_query_workspace.hh"
 #include "utils/timer.hh"
 
 #include <chrono>
 #include <unordered_set>
-#include <queue>
+#include <set>
 
 using namespace Tempus;
 using namespace std;
 
-using TTargetSet = std::set<CHVertex>;
-
 using TNodeContractionCost = int;
 using TRemainingNodeSet = std::unordered_set<CHVertex>;
 
@@ -40,16 +39,158 @@ struct TEdge
     TCost cost;
 };
 
-void add_edge_or_update( CHGraph& graph, CHVertex u, CHVertex v, TCost cost )
+namespace Tempus
+{
+
+CHGraph::CHGraph( size_t n ) :
+    vertices_( n ),
+    out_blocks_( n, Block() ),
+    in_blocks_( n, Block() ),
+    n_edges_( 0 ),
+    n_unused_( 0 )
+{
+}
+
+CHVertex CHGraph::add_vertex()
+{
+    vertices_.push_back( VertexProperty() );
+    out_blocks_.push_back( Block() );
+    in_blocks_.push_back( Block() );
+    return CHVertex( vertices_.size() - 1 );
+}
+
+CHGraph::Arc* CHGraph::find_arc( std::vector<Block>& blocks, std::vector<Arc>& arcs, CHVertex v, CHVertex w )
+{
+    const Block& b = blocks[v];
+    for ( uint32_t i = b.begin; i < b.begin + b.size; i++ ) {
+        if ( arcs[i].vertex == w ) {
+            return &arcs[i];
+        }
+    }
+    return nullptr;
+}
+
+void CHGraph::push_arc( std::vector<Block>& blocks, std::vector<Arc>& arcs, CHVertex v, const Arc& arc )
+{
+    Block& b = blocks[v];
+    if ( b.size == b.capacity ) {
+        // move the block at the end of the array
+        uint32_t new_capacity = std::max( b.capacity * 2, uint32_t(2) );
+        uint32_t new_begin = uint32_t( arcs.size() );
+        arcs.resize( arcs.size() + new_capacity );
+        std::copy( arcs.begin() + b.begin, arcs.begin() + b.begin + b.size, arcs.begin() + new_begin );
+        n_unused_ += new_capacity;
+        b.begin = new_begin;
+        b.capacity = new_capacity;
+    }
+    arcs[b.begin + b.size] = arc;
+    b.size++;
+    n_unused_--;
+}
+
+void CHGraph::remove_arc( std::vector<Block>& blocks, std::vector<Arc>& arcs, CHVertex v, CHVertex w )
+{
+    Block& b = blocks[v];
+    for ( uint32_t i = b.begin; i < b.begin + b.size; i++ ) {
+        if ( arcs[i].vertex == w ) {
+            arcs[i] = arcs[b.begin + b.size - 1];
+            b.size--;
+            n_unused_++;
+            return;
+        }
+    }
+}
+
+TCost CHGraph::edge_weight( CHVertex u, CHVertex v ) const
+{
+    for ( const Arc& a : pair_range( out_arcs( u ) ) ) {
+        if ( a.vertex == v ) {
+            return a.weight;
+        }
+    }
+    return 0;
+}
+
+bool CHGraph::add_edge( CHVertex u, CHVertex v, TCost weight )
+{
+    Arc* out = find_arc( out_blocks_, out_arcs_, u, v );
+    if ( out ) {
+        if ( weight < out->weight ) {
+            out->weight = weight;
+            find_arc( in_blocks_, in_arcs_, v, u )->weight = weight;
+        }
+        return false;
+    }
+    set_edge( u, v, weight );
+    return true;
+}
+
+void CHGraph::set_edge( CHVertex u, CHVertex v, TCost weight )
+{
+    Arc* out = find_arc( out_blocks_, out_arcs_, u, v );
+    if ( out ) {
+        out->weight = weight;
+        find_arc( in_blocks_, in_arcs_, v, u )->weight = weight;
+        return;
+    }
+    push_arc( out_blocks_, out_arcs_, u, Arc{ v, weight } );
+    push_arc( in_blocks_, in_arcs_, v, Arc{ u, weight } );
+    n_edges_++;
+
+    if ( n_unused_ > out_arcs_.size() + in_arcs_.size() - n_unused_ ) {
+        compact();
+    }
+}
+
+void CHGraph::clear_vertex( CHVertex v )
+{
+    for ( const Arc& a : pair_range( out_arcs( v ) ) ) {
+        remove_arc( in_blocks_, in_arcs_, a.vertex, v );
+    }
+    for ( const Arc& a : pair_range( in_arcs( v ) ) ) {
+        remove_arc( out_blocks_, out_arcs_, a.vertex, v );
+    }
+    n_edges_ -= out_blocks_[v].size + in_blocks_[v].size;
+    n_unused_ += out_blocks_[v].size + in_blocks_[v].size;
+    out_blocks_[v].size = 0;
+    in_blocks_[v].size = 0;
+}
+
+void CHGraph::compact( std::vector<Block>& blocks, std::vector<Arc>& arcs )
 {
-    bool found = false;
-    CHEdge e;
-    boost::tie( e, found ) = edge( u, v, graph );
-    if ( !found ) {
-        boost::tie( e, found ) = add_edge( u, v, graph );
+    size_t n_arcs = 0;
+    for ( const Block& b : blocks ) {
+        n_arcs += b.size;
+    }
+    std::vector<Arc> new_arcs( n_arcs );
+    uint32_t i = 0;
+    for ( Block& b : blocks ) {
+        std::copy( arcs.begin() + b.begin, arcs.begin() + b.begin + b.size, new_arcs.begin() + i );
+        b.begin = i;
+        b.capacity = b.size;
+        i += b.size;
     }
-    // update the cost
-    graph[e].weight = cost;
+    arcs.swap( new_arcs );
+}
+
+void CHGraph::compact()
+{
+    compact( out_blocks_, out_arcs_ );
+    compact( in_blocks_, in_arcs_ );
+    n_unused_ = 0;
+}
+
+void CHGraph::clear()
+{
+    vertices_.clear();
+    out_blocks_.clear();
+    in_blocks_.clear();
+    std::vector<Arc>().swap( out_arcs_ );
+    std::vector<Arc>().swap( in_arcs_ );
+    n_edges_ = 0;
+    n_unused_ = 0;
+}
+
 }
 
 // If set to 1, the graph is really contracted (i.e. a node and its references are removed from the graph after contraction)
@@ -57,66 +198,84 @@ void add_edge_or_update( CHGraph& graph, CHVertex u, CHVertex v, TCost cost )
 // Actually reducing the graph seems a bit faster
 #define REDUCE_GRAPH 1
 
-map<CHVertex, TCost> witness_search(const CHGraph& graph, CHVertex contracted_node, CHVertex source, const TTargetSet& targets, TCost cutoff, int& search_space)
+///
+/// Buffers of the witness searches, kept by each thread from one search to another
+struct WitnessSearchWorkspace
 {
-    struct DijkstraNode
-    {
-        CHVertex node;
-        TCost cost;
-        int hops;
-        int order;
-    };
-
-    class CompareNode
+    /// costs from the source. The predecessor field is not needed and holds the number of hops instead
+    TimestampedLabels<TCost, CHVertex> labels;
+    ReusableMinQueue<TCost, CHVertex> queue;
+    /// target_stamp[v] == stamp if v is a target of the current search
+    vector<uint32_t> target_stamp;
+    uint32_t stamp = 0;
+
+    void reset( size_t n )
     {
-    public:
-        bool operator()(const DijkstraNode& node1, const DijkstraNode& node2) const
-        {
-            // node2 has higher priority if it has a smaller cost
-            // (DijkstraNode::order used in case of cost equality, for non-random heap.pop())
-            return node1.cost > node2.cost || (node1.cost == node2.cost && node1.order > node2.order);
+        labels.reset( n );
+        queue.clear();
+        if ( target_stamp.size() != n ) {
+            target_stamp.assign( n, 0 );
+            stamp = 0;
+        }
+        stamp++;
+        if ( stamp == 0 ) {
+            std::fill( target_stamp.begin(), target_stamp.end(), 0 );
+            stamp = 1;
         }
-    };
+    }
+};
 
-    // Dijkstra from one source to multiple targets.
+WitnessSearchWorkspace& witness_search_workspace()
+{
+    static thread_local WitnessSearchWorkspace ws;
+    return ws;
+}
+
+///
+/// Dijkstra from one source to multiple targets, ignoring the contracted node.
+/// Costs of the paths found are then given by ws.labels.potential()
+void witness_search( const CHGraph& graph, CHVertex contracted_node, CHVertex source, const vector<CHVertex>& targets, TCost cutoff, WitnessSearchWorkspace& ws, int& search_space )
+{
     REQUIRE(!targets.empty());
 
-    TTargetSet found; // targets found
-    map<CHVertex, TCost> relaxed; // minimal costs of relaxed nodes (from 'source')
-    relaxed[source] = 0; // the cost from 'source' to 'source' is 0
-    search_space = 1; // search-space of Dijkstra (used for node-ordering)
+    ws.reset( graph.num_vertices() );
+    size_t n_targets = 0;
+    for ( CHVertex t : targets ) {
+        if ( ws.target_stamp[t] != ws.stamp ) {
+            ws.target_stamp[t] = ws.stamp;
+            n_targets++;
+        }
+    }
 
-    int order = 0;
-#if 1
-    priority_queue<DijkstraNode, vector<DijkstraNode>, CompareNode> heap; // priority queue
-#else
-    CompareNode cmp;
-    boost::heap::d_ary_heap< DijkstraNode, boost::heap::arity<2>, boost::heap::compare< CompareNode >, boost::heap::mutable_<true> > heap( cmp );
-#endif
-    heap.push( {source, 0, 1, order++} );
+    ws.labels.set( source, 0, 1 ); // the cost from 'source' to 'source' is 0
+    ws.queue.push( 0, source );
+    search_space = 1; // search-space of Dijkstra (used for node-ordering)
 
-    while( !heap.empty() )
+    size_t n_found = 0;
+    while( !ws.queue.empty() )
     {
         // Get less costly node in priority queue:
-        const DijkstraNode& top = heap.top();
-        CHVertex node = top.node;
-        TCost cost = top.cost;
-        int num_hops = top.hops;
-        heap.pop();
+        TCost cost;
+        CHVertex node;
+        std::tie( cost, node ) = ws.queue.top();
+        ws.queue.pop();
+        if ( cost > ws.labels.potential( node ) ) {
+            // outdated entry
+            continue;
+        }
+        int num_hops = int(ws.labels.predecessor( node ));
 
-        if( targets.find( node ) != targets.end() ) // found one of the targets
+        if( ws.target_stamp[node] == ws.stamp ) // found one of the targets
         {
-            found.emplace( node );
-
-            if( found == targets ) // all targets have been found
+            if( ++n_found == n_targets ) // all targets have been found
             {
                 break;
             }
         }
 
-        for ( auto succ : pair_range( out_edges( node, graph ) ) )
+        for ( const CHGraph::Arc& succ : pair_range( graph.out_arcs( node ) ) )
         {
-            CHVertex successor_node = target( succ, graph );
+            CHVertex successor_node = succ.vertex;
 #if REDUCE_GRAPH
             if( successor_node == contracted_node ) // ignore contracted node
                 continue;
@@ -125,51 +284,50 @@ map<CHVertex, TCost> witness_search(const CHGraph& graph, CHVertex contracted_no
                 continue;
 #endif
 
-            TCost vu_cost = cost + graph[succ].weight;
+            TCost vu_cost = cost + succ.weight;
             if(cutoff && vu_cost > cutoff) // do not search beyond 'cutoff'
             {
                 continue;
             }
 
-            auto iter = relaxed.find( successor_node );
-            if( iter == relaxed.end() || vu_cost < iter->second )
+            if( vu_cost < ws.labels.potential( successor_node ) )
             {
                 // Add node to priority queue:
-                heap.push( {successor_node, vu_cost, num_hops + 1, order++} );
-                relaxed[successor_node] = vu_cost;
+                ws.labels.set( successor_node, vu_cost, CHVertex( num_hops + 1 ) );
+                ws.queue.push( vu_cost, successor_node );
 
                 if(num_hops + 1 > search_space)
                     search_space = num_hops + 1;
             }
         }
     }
-
-    map<CHVertex, TCost> target_costs;
-    for(CHVertex t : found)
-        target_costs.emplace( t, relaxed[t] );
-    return target_costs;
 }
 
-std::vector<TEdge> get_contraction_shortcuts( const CHGraph& graph, CHVertex v )
+///
+/// Witness searches from each predecessor u of v to the successors w of v.
+/// fn( u, w, uvw_cost ) is called for each path u->v->w that must be replaced by a shortcut.
+/// Returns the maximal search space of the witness searches
+template <typename Fn>
+int for_each_needed_shortcut( const CHGraph& graph, CHVertex v, Fn fn )
 {
-    // Contraction of 'node'.
+    WitnessSearchWorkspace& ws = witness_search_workspace();
+    vector<CHVertex> targets;
+    int max_search_space = 0;
 
-    vector<TEdge> shortcuts;
-    for ( auto uv : pair_range( in_edges( v, graph ) ) )
+    for ( const CHGraph::Arc& uv : pair_range( graph.in_arcs( v ) ) )
     {
-        TTargetSet targets;
+        targets.clear();
         TCost mx = 0;
-        CHVertex u = source( uv, graph );
+        CHVertex u = uv.vertex;
 
 #if !REDUCE_GRAPH
         if ( u < v ) // only consider upper predecessors
             continue;
 #endif
 
-        //std::cout << s << " " << node << std::endl;
-        for ( auto vw : pair_range( out_edges( v, graph ) ) )
+        for ( const CHGraph::Arc& vw : pair_range( graph.out_arcs( v ) ) )
         {
-            CHVertex w = target( vw, graph );
+            CHVertex w = vw.vertex;
             if ( w == u )
                 continue;
 #if !REDUCE_GRAPH
@@ -177,25 +335,28 @@ std::vector<TEdge> get_contraction_shortcuts( const CHGraph& graph, CHVertex v )
                 continue;
 #endif
 
-            targets.emplace( w );
+            targets.push_back( w );
 
-            if ( graph[vw].weight > mx )
-                mx = graph[vw].weight;
+            if ( vw.weight > mx )
+                mx = vw.weight;
         }
 
         if ( targets.empty() )
             continue;
 
         // It is not useful to search shortcuts beyond 'cutoff'
-        TCost cutoff = graph[uv].weight + mx;
+        TCost cutoff = uv.weight + mx;
 
         // Perform Dijkstra from 'predecessor' to all 'targets' while ignoring 'node'
-        int _ = 0; // not used
-        auto target_costs = witness_search( graph, v, u, targets, cutoff, _ );
+        int search_space = 0;
+        witness_search( graph, v, u, targets, cutoff, ws, search_space );
 
-        for ( auto vw : pair_range( out_edges( v, graph ) ) )
+        if ( search_space > max_search_space )
+            max_search_space = search_space;
+
+        for ( const CHGraph::Arc& vw : pair_range( graph.out_arcs( v ) ) )
         {
-            CHVertex w = target( vw, graph );
+            CHVertex w = vw.vertex;
             if ( w == u )
                 continue;
 #if !REDUCE_GRAPH
@@ -203,78 +364,35 @@ std::vector<TEdge> get_contraction_shortcuts( const CHGraph& graph, CHVertex v )
                 continue;
 #endif
 
-            auto iter_shortcut = target_costs.find( w );
-            TCost uvw_cost = graph[uv].weight + graph[vw].weight;
-            if( iter_shortcut == target_costs.end() || iter_shortcut->second > uvw_cost )
+            TCost uvw_cost = uv.weight + vw.weight;
+            if( ws.labels.potential( w ) > uvw_cost )
             {
-                // If no shortest path was found from 'predecessor' to 'successor' during the Dijkstra
+                // If no shorter path was found from 'predecessor' to 'successor' during the Dijkstra
                 // propagation, then it means the shortest path from 'predecessor' to 'successor' is
                 // <predecessor, node, successor>, and a shortcut must be added.
-                shortcuts.push_back( {u, w, uvw_cost} );
+                fn( u, w, uvw_cost );
             }
         }
     }
+    return max_search_space;
+}
 
-    // cout << "Contracted " << node << "." << endl;
+std::vector<TEdge> get_contraction_shortcuts( const CHGraph& graph, CHVertex v )
+{
+    // Contraction of 'node'.
+    vector<TEdge> shortcuts;
+    for_each_needed_shortcut( graph, v, [&shortcuts]( CHVertex u, CHVertex w, TCost uvw_cost ) {
+            shortcuts.push_back( {u, w, uvw_cost} );
+        });
     return shortcuts;
 }
 
 void get_node_edge_impact( const CHGraph& graph, CHVertex v, int& nb_added_edges, int& max_search_space )
 {
-    // Contraction of 'node'.
-
     nb_added_edges = 0;
-    max_search_space = 0;
-
-    for ( auto uv : pair_range( in_edges( v, graph ) ) )
-    {
-        TTargetSet targets;
-        TCost mx = 0;
-        CHVertex u = source( uv, graph );
-
-        //std::cout << s << " " << node << std::endl;
-        for ( auto vw : pair_range( out_edges( v, graph ) ) )
-        {
-            CHVertex w = target( vw, graph );
-            if ( w == u )
-                continue;
-
-            targets.emplace( w );
-
-            if ( graph[vw].weight > mx )
-                mx = graph[vw].weight;
-        }
-
-        if ( targets.empty() )
-            continue;
-
-        // It is not useful to search shortcuts beyond 'cutoff'
-        TCost cutoff = graph[uv].weight + mx;
-
-        // Perform Dijkstra from 'predecessor' to all 'targets' while ignoring 'node'
-        int search_space = 0;
-        auto target_costs = witness_search( graph, v, u, targets, cutoff, search_space );
-
-        if ( search_space > max_search_space )
-            max_search_space = search_space;
-
-        for ( auto vw : pair_range( out_edges( v, graph ) ) )
-        {
-            CHVertex w = target( vw, graph );
-            if ( w == u )
-                continue;
-
-            auto iter_shortcut = target_costs.find( w );
-            TCost uvw_cost = graph[uv].weight + graph[vw].weight;
-            if( iter_shortcut == target_costs.end() || iter_shortcut->second > uvw_cost )
-            {
-                // If no shortest path was found from 'predecessor' to 'successor' during the Dijkstra
-                // propagation, then it means the shortest path from 'predecessor' to 'successor' is
-                // <predecessor, node, successor>, and a shortcut must be added.
-                nb_added_edges++;
-            }
-        }
-    }
+    max_search_space = for_each_needed_shortcut( graph, v, [&nb_added_edges]( CHVertex, CHVertex, TCost ) {
+            nb_added_edges++;
+        });
 }
 
 TNodeContractionCost get_node_cost( const CHGraph& graph,
@@ -286,7 +404,7 @@ TNodeContractionCost get_node_cost( const CHGraph& graph,
     int nbAddedEdges = 0;
     int maxSearchSpace = 0;
 
-    nbRemovedEdges = in_degree( node, graph ) + out_degree( node, graph );
+    nbRemovedEdges = int(graph.in_degree( node ) + graph.out_degree( node ));
 
     get_node_edge_impact(graph, node, nbAddedEdges, maxSearchSpace);
 
@@ -310,41 +428,41 @@ inline bool is_node_independent(const CHGraph& graph,
     // A node is 'independent' if all its neighbors, and the neighbors
     // of its neighbors have a higher cost.
 
-    for ( const auto& pred : pair_range( in_edges( node, graph ) ) )
+    for ( const CHGraph::Arc& pred : pair_range( graph.in_arcs( node ) ) )
     {
-        CHVertex u = source( pred, graph );
+        CHVertex u = pred.vertex;
         if ( nodeCosts[u] < nodeCost )
             return false;
 
-        for ( const auto& pred2 : pair_range( in_edges( u, graph ) ) )
+        for ( const CHGraph::Arc& pred2 : pair_range( graph.in_arcs( u ) ) )
         {
-            CHVertex v = source( pred2, graph );
+            CHVertex v = pred2.vertex;
             if ( nodeCosts[v] < nodeCost )
                 return false;
         }
-        for ( const auto& succ2 : pair_range( out_edges( u, graph ) ) )
+        for ( const CHGraph::Arc& succ2 : pair_range( graph.out_arcs( u ) ) )
         {
-            CHVertex v = target( succ2, graph );
+            CHVertex v = succ2.vertex;
             if ( nodeCosts[v] < nodeCost )
                 return false;
         }
     }
 
-    for ( const auto& succ : pair_range( out_edges( node, graph ) ) )
+    for ( const CHGraph::Arc& succ : pair_range( graph.out_arcs( node ) ) )
     {
-        CHVertex u = target( succ, graph );
+        CHVertex u = succ.vertex;
         if ( nodeCosts[u] < nodeCost )
             return false;
 
-        for ( const auto& pred2 : pair_range( in_edges( u, graph ) ) )
+        for ( const CHGraph::Arc& pred2 : pair_range( graph.in_arcs( u ) ) )
         {
-            CHVertex v = source( pred2, graph );
+            CHVertex v = pred2.vertex;
             if ( nodeCosts[v] < nodeCost )
                 return false;
         }
-        for ( const auto& succ2 : pair_range( out_edges( u, graph ) ) )
+        for ( const CHGraph::Arc& succ2 : pair_range( graph.out_arcs( u ) ) )
         {
-            CHVertex v = target( succ2, graph );
+            CHVertex v = succ2.vertex;
             if ( nodeCosts[v] < nodeCost )
                 return false;
         }
@@ -357,15 +475,15 @@ inline bool is_node_independent(const CHGraph& graph,
 template <typename Foo>
 void apply_on_1_neighbourhood( const CHGraph& graph, CHVertex node, Foo foo )
 {
-    for ( const auto& pred : pair_range( in_edges( node, graph ) ) )
+    for ( const CHGraph::Arc& pred : pair_range( graph.in_arcs( node ) ) )
     {
-        CHVertex u = source( pred, graph );
+        CHVertex u = pred.vertex;
         foo( u );
     }
 
-    for ( const auto& succ : pair_range( out_edges( node, graph ) ) )
+    for ( const CHGraph::Arc& succ : pair_range( graph.out_arcs( node ) ) )
     {
-        CHVertex u = target( succ, graph );
+        CHVertex u = succ.vertex;
         foo( u );
     }
 }
@@ -373,36 +491,36 @@ void apply_on_1_neighbourhood( const CHGraph& graph, CHVertex node, Foo foo )
 template <typename Foo>
 void apply_on_2_neighbourhood( const CHGraph& graph, CHVertex node, Foo foo )
 {
-    for ( const auto& pred : pair_range( in_edges( node, graph ) ) )
+    for ( const CHGraph::Arc& pred : pair_range( graph.in_arcs( node ) ) )
     {
-        CHVertex u = source( pred, graph );
+        CHVertex u = pred.vertex;
         foo( u );
 
-        for ( const auto& pred2 : pair_range( in_edges( u, graph ) ) )
+        for ( const CHGraph::Arc& pred2 : pair_range( graph.in_arcs( u ) ) )
         {
-            CHVertex v = source( pred2, graph );
+            CHVertex v = pred2.vertex;
             foo( v );
         }
-        for ( const auto& succ2 : pair_range( out_edges( u, graph ) ) )
+        for ( const CHGraph::Arc& succ2 : pair_range( graph.out_arcs( u ) ) )
         {
-            CHVertex v = target( succ2, graph );
+            CHVertex v = succ2.vertex;
             foo( v );
         }
     }
 
-    for ( const auto& succ : pair_range( out_edges( node, graph ) ) )
+    for ( const CHGraph::Arc& succ : pair_range( graph.out_arcs( node ) ) )
     {
-        CHVertex u = target( succ, graph );
+        CHVertex u = succ.vertex;
         foo( u );
 
-        for ( const auto& pred2 : pair_range( in_edges( u, graph ) ) )
+        for ( const CHGraph::Arc& pred2 : pair_range( graph.in_arcs( u ) ) )
         {
-            CHVertex v = source( pred2, graph );
+            CHVertex v = pred2.vertex;
             foo( v );
         }
-        for ( const auto& succ2 : pair_range( out_edges( u, graph ) ) )
+        for ( const CHGraph::Arc& succ2 : pair_range( graph.out_arcs( u ) ) )
         {
-            CHVertex v = target( succ2, graph );
+            CHVertex v = succ2.vertex;
             foo( v );
         }
     }
@@ -453,10 +571,10 @@ vector<CHVertex> order_graph( CHGraph& graph, std::function<db_id_t(CHVertex)> n
 
     Timer t;
 
-    processed_nodes.reserve( num_vertices( graph ) );
-    node_costs.resize( num_vertices( graph ) );
+    processed_nodes.reserve( graph.num_vertices() );
+    node_costs.resize( graph.num_vertices() );
 
-    vector<int> hierarchy_depths( num_vertices( graph ) );
+    vector<int> hierarchy_depths( graph.num_vertices() );
 
     cout << "Processing initial contraction costs..." << endl;
 
@@ -467,14 +585,14 @@ vector<CHVertex> order_graph( CHGraph& graph, std::function<db_id_t(CHVertex)> n
     #pragma omp parallel
     {
         #pragma omp for schedule(dynamic)
-        for ( int node_i = 0; node_i < int(num_vertices( graph )); node_i++ )
+        for ( int node_i = 0; node_i < int(graph.num_vertices()); node_i++ )
         {
             CHVertex node = CHVertex( node_i );
             node_costs[node] = get_node_cost( graph, node, hierarchy_depths, node_id(node) );
         }
     }
 
-    for ( CHVertex node=0; node < num_vertices( graph ); ++node )
+    for ( CHVertex node=0; node < graph.num_vertices(); ++node )
     {
         remaining_nodes.insert( node );
     }
@@ -491,7 +609,10 @@ vector<CHVertex> order_graph( CHGraph& graph, std::function<db_id_t(CHVertex)> n
 
         // Sort all remaining nodes by cost
         vector<CHVertex> sorted_nodes(remaining_nodes.begin(), remaining_nodes.end());
-        sort(sorted_nodes.begin(), sorted_nodes.end(), [&node_costs](CHVertex a, CHVertex b) { return node_costs[a] < node_costs[b]; });
+        // (ties are broken by vertex index, so that the ordering does not depend on the set iteration order)
+        sort(sorted_nodes.begin(), sorted_nodes.end(), [&node_costs](CHVertex a, CHVertex b) {
+                return node_costs[a] < node_costs[b] || ( node_costs[a] == node_costs[b] && a < b );
+            });
 
         // Only contract among the best 20% of remaining nodes during this iteration.
         int step = max(static_cast<size_t>(1), sorted_nodes.size()/5);
@@ -530,10 +651,10 @@ vector<CHVertex> order_graph( CHGraph& graph, std::function<db_id_t(CHVertex)> n
             remaining_nodes.erase(nodeID);
 
             for (const TEdge& shortcut : node_shortcuts[i])
-                add_edge_or_update( graph, shortcut.from, shortcut.to, shortcut.cost );
+                graph.set_edge( shortcut.from, shortcut.to, shortcut.cost );
 
             //graph.removeNode(nodeID);
-            clear_vertex( nodeID, graph );
+            graph.clear_vertex( nodeID );
         }
 
         cout << "Updating " << impacted_neighbors.size()
@@ -556,8 +677,8 @@ vector<CHVertex> order_graph( CHGraph& graph, std::function<db_id_t(CHVertex)> n
     }
 
     cout << "Shortcuts: " << num_shortcuts << endl;
-    REQUIRE(processed_nodes.size() == num_vertices( graph ));
-    REQUIRE(node_costs.size() == num_vertices( graph ));
+    REQUIRE(processed_nodes.size() == graph.num_vertices());
+    REQUIRE(node_costs.size() == graph.num_vertices());
 
     // IDF: 31019ms
     // France: 1237s.
@@ -565,12 +686,104 @@ vector<CHVertex> order_graph( CHGraph& graph, std::function<db_id_t(CHVertex)> n
     return processed_nodes;
 }
 
-vector<Shortcut> contract_graph( CHGraph& graph )
+///
+/// Contraction by rounds of independent nodes.
+///
+/// A node is contracted in a round if it has the lowest order of its 2-neighbourhood.
+/// Nodes of a round then have disjoint neighbourhoods and can be contracted in parallel.
+/// Their shortcuts are merged in ascending node order, so the result does not depend on the number of threads.
+static vector<Shortcut> contract_graph_by_independent_sets( CHGraph& graph )
 {
     vector<Shortcut> r;
     Timer t;
 
-    for ( auto node : pair_range( vertices( graph ) ) )
+    // remaining nodes, in ascending order
+    vector<CHVertex> remaining;
+    remaining.reserve( graph.num_vertices() );
+    for ( CHVertex node = 0; node < graph.num_vertices(); node++ ) {
+        remaining.push_back( node );
+    }
+
+    size_t n_contracted = 0;
+    while ( !remaining.empty() )
+    {
+        // select the independent nodes
+        vector<char> is_independent( remaining.size(), 0 );
+        #pragma omp parallel
+        {
+            #pragma omp for schedule(dynamic, 256)
+            for ( int i = 0; i < int(remaining.size()); i++ )
+            {
+                CHVertex node = remaining[i];
+                bool independent = true;
+                apply_on_2_neighbourhood( graph, node, [&independent, node]( CHVertex u ) {
+                        if ( u < node ) {
+                            independent = false;
+                        }
+                    });
+                is_independent[i] = independent ? 1 : 0;
+            }
+        }
+
+        vector<CHVertex> next_nodes, next_remaining;
+        for ( size_t i = 0; i < remaining.size(); i++ ) {
+            if ( is_independent[i] ) {
+                next_nodes.push_back( remaining[i] );
+            }
+            else {
+                next_remaining.push_back( remaining[i] );
+            }
+        }
+        // at least the lowest remaining node is independent
+        REQUIRE( !next_nodes.empty() );
+        remaining.swap( next_remaining );
+
+        // parallel witness searches
+        vector<vector<TEdge>> node_shortcuts( next_nodes.size() );
+        #pragma omp parallel
+        {
+            #pragma omp for schedule(dynamic)
+            for ( int i = 0; i < int(next_nodes.size()); i++ )
+            {
+                node_shortcuts[i] = get_contraction_shortcuts( graph, next_nodes[i] );
+            }
+        }
+
+        // sequential update of the graph, in node order
+        for ( size_t i = 0; i < next_nodes.size(); i++ )
+        {
+            CHVertex node = next_nodes[i];
+            for ( const TEdge& edge : node_shortcuts[i] )
+            {
+                r.push_back( {edge.from, edge.to, edge.cost, node} );
+                graph.set_edge( edge.from, edge.to, edge.cost );
+            }
+            graph.clear_vertex( node );
+        }
+
+        n_contracted += next_nodes.size();
+        cout << "Contracted " << n_contracted << " nodes, " << remaining.size() << " remaining, "
+             << r.size() << " shortcuts [elapsed=" << t.elapsed_ms() << "ms]" << endl;
+    }
+
+    cout << "Contracted entire graph in " << t.elapsed_ms() << "ms." << endl;
+    return r;
+}
+
+vector<Shortcut> contract_graph( CHGraph& graph, bool parallel )
+{
+#if REDUCE_GRAPH
+    if ( parallel ) {
+        return contract_graph_by_independent_sets( graph );
+    }
+#else
+    (void)parallel;
+#endif
+
+    vector<Shortcut> r;
+    Timer t;
+
+    for ( CHVertex node = 0; node < graph.num_vertices(); node++ )
     {
         if(node % 10000 == 0)
             cout << "Contracting nodes " << node << "... [elapsed=" << t.elapsed_ms() << "ms]" << endl;
@@ -584,12 +797,12 @@ vector<Shortcut> contract_graph( CHGraph& graph )
             r.push_back( {edge.from, edge.to, edge.cost, node} );
 
             // add the shortcut to the graph
-            add_edge_or_update( graph, edge.from, edge.to, edge.cost );
+            graph.set_edge( edge.from, edge.to, edge.cost );
         }
 
 #if REDUCE_GRAPH
         // clear any reference to this node
-        clear_vertex( node, graph );
+        graph.clear_vertex( node );
 #endif
     }
     // IDF: 7289ms
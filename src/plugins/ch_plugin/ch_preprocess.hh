@@ -22,16 +22,15 @@
 
 #include <vector>
 #include <functional>
-#include <boost/graph/adjacency_list.hpp>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
 
 #include "base.hh"
 
 namespace Tempus
 {
 
-///
-/// Updateable CH graph used for node ordering and contraction
-
 struct VertexProperty
 {
     db_id_t id;
@@ -42,19 +41,101 @@ struct VertexProperty
 /// Type used for road cost
 using TCost = int; // fixed point
 
-struct EdgeProperty
+typedef uint32_t CHVertex;
+
+///
+/// Updateable CH graph used for node ordering and contraction.
+///
+/// Out arcs and in arcs of each vertex are stored in blocks of two flat arrays.
+/// When a block is full, it is moved at the end of its array with a doubled capacity and
+/// the space left behind is reclaimed by compact(), which is called automatically when
+/// more than half of the arrays is unused.
+/// An edge u->v is stored twice: as an out arc of u and as an in arc of v.
+class CHGraph
 {
-    TCost weight;
-};
+public:
+    struct Arc
+    {
+        /// target of an out arc, source of an in arc
+        CHVertex vertex;
+        TCost weight;
+    };
+    typedef const Arc* ArcIterator;
+
+    explicit CHGraph( size_t n = 0 );
+
+    size_t num_vertices() const { return vertices_.size(); }
+    size_t num_edges() const { return n_edges_; }
+
+    ///
+    /// Add a new vertex, without any edge
+    CHVertex add_vertex();
+
+    VertexProperty& operator[]( CHVertex v ) { return vertices_[v]; }
+    const VertexProperty& operator[]( CHVertex v ) const { return vertices_[v]; }
 
-typedef boost::adjacency_list<boost::vecS,
-                              boost::vecS,
-                              boost::bidirectionalS,
-                              VertexProperty,
-                              EdgeProperty> CHGraph;
+    std::pair<ArcIterator, ArcIterator> out_arcs( CHVertex v ) const
+    {
+        const Arc* b = out_arcs_.data() + out_blocks_[v].begin;
+        return std::make_pair( b, b + out_blocks_[v].size );
+    }
+    std::pair<ArcIterator, ArcIterator> in_arcs( CHVertex v ) const
+    {
+        const Arc* b = in_arcs_.data() + in_blocks_[v].begin;
+        return std::make_pair( b, b + in_blocks_[v].size );
+    }
+    size_t out_degree( CHVertex v ) const { return out_blocks_[v].size; }
+    size_t in_degree( CHVertex v ) const { return in_blocks_[v].size; }
 
-typedef typename boost::graph_traits<CHGraph>::vertex_descriptor CHVertex;
-typedef typename boost::graph_traits<CHGraph>::edge_descriptor CHEdge;
+    ///
+    /// Weight of the edge u->v, or 0 if there is no such edge
+    TCost edge_weight( CHVertex u, CHVertex v ) const;
+
+    ///
+    /// Add the edge u->v.
+    /// If the edge already exists, the lowest weight is kept and false is returned.
+    /// Arc iterators are invalidated.
+    bool add_edge( CHVertex u, CHVertex v, TCost weight );
+
+    ///
+    /// Add the edge u->v or replace the weight of an existing one.
+    /// Arc iterators are invalidated.
+    void set_edge( CHVertex u, CHVertex v, TCost weight );
+
+    ///
+    /// Remove every edge coming from or going to v
+    void clear_vertex( CHVertex v );
+
+    ///
+    /// Move blocks next to each other, with no spare capacity
+    void compact();
+
+    ///
+    /// Remove every vertex and edge
+    void clear();
+
+private:
+    struct Block
+    {
+        uint32_t begin;
+        uint32_t size;
+        uint32_t capacity;
+    };
+
+    std::vector<VertexProperty> vertices_;
+    std::vector<Block> out_blocks_;
+    std::vector<Block> in_blocks_;
+    std::vector<Arc> out_arcs_;
+    std::vector<Arc> in_arcs_;
+    size_t n_edges_;
+    /// number of unused arcs in out_arcs_ and in_arcs_
+    size_t n_unused_;
+
+    Arc* find_arc( std::vector<Block>& blocks, std::vector<Arc>& arcs, CHVertex v, CHVertex w );
+    void push_arc( std::vector<Block>& blocks, std::vector<Arc>& arcs, CHVertex v, const Arc& arc );
+    void remove_arc( std::vector<Block>& blocks, std::vector<Arc>& arcs, CHVertex v, CHVertex w );
+    void compact( std::vector<Block>& blocks, std::vector<Arc>& arcs );
+};
 
 ///
 /// The node ordering processing
@@ -74,8 +155,9 @@ struct Shortcut
 ///
 /// The graph contraction processing
 /// \param[inout] graph The input graph that will be contracted
+/// \param[in] parallel Contract independent sets of nodes on several threads instead of one node at a time
 /// \returns the shortcuts created
-std::vector<Shortcut> contract_graph( CHGraph& graph );
+std::vector<Shortcut> contract_graph( CHGraph& graph, bool parallel = false );
 
 }
 
@@ -18,12 +18,236 @@
  */
 
 #include "ch_preprocess.hh"
+#include "ch_customization.hh"
+#include "tch_routing_data.hh"
+#include "mm_lib/turn_graph.hh"
+#include "turn_ch_routing_data.hh"
+#include "multimodal_graph_builder.hh"
 #include "routing_data.hh"
 #include "multimodal_graph.hh"
 #include "db.hh"
+#include "mm_lib/cost_calculator.hh"
 
 #include <string>
+#include <algorithm>
+#include <tuple>
 #include <boost/program_options.hpp>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+///
+/// Road node ids, in contraction order, from the ordered_nodes table of a schema
+static std::vector<Tempus::db_id_t> load_ordering( Db::Connection& conn, const std::string& schema )
+{
+    std::vector<Tempus::db_id_t> order_id;
+    Db::ResultIterator res_it = conn.exec_it( "select node_id from " + schema + ".ordered_nodes order by id asc" );
+    Db::ResultIterator it_end;
+    for ( ; res_it != it_end; res_it++ ) {
+        Db::RowValue res_i = *res_it;
+        order_id.push_back( res_i[0].as<Tempus::db_id_t>() );
+    }
+    return order_id;
+}
+
+///
+/// Travel time functions of the road edges, by edge index, for cars.
+/// Edges cars are not allowed on are given an empty function
+static std::vector<Tempus::TravelTimeFunction> car_travel_times( const Tempus::Multimodal::Graph& graph, const std::string& db_options )
+{
+    using namespace Tempus;
+    const Road::Graph& road_graph = graph.road();
+    boost::optional<TransportMode> car = graph.transport_mode( TransportModePrivateCar );
+    if ( !car ) {
+        throw std::runtime_error( "No private car transport mode" );
+    }
+
+    RoadEdgeSpeedProfile profile;
+    Db::Connection conn( db_options );
+    Db::ResultIterator res_it = conn.exec_it( "SELECT road_section_id, begin_time, end_time, average_speed FROM\n"
+                                              "tempus.road_section_speed as ss,\n"
+                                              "tempus.road_daily_profile as p\n"
+                                              "WHERE\n"
+                                              "p.profile_id = ss.profile_id AND p.speed_rule = " + std::to_string( int( SpeedRuleCar ) ) );
+    Db::ResultIterator it_end;
+    for ( ; res_it != it_end; res_it++ ) {
+        Db::RowValue res_i = *res_it;
+        double begin_time = res_i[1].as<double>();
+        double end_time = res_i[2].as<double>();
+        profile.add_period( res_i[0].as<db_id_t>(), SpeedRuleCar, begin_time, end_time - begin_time, res_i[3].as<double>() );
+    }
+    profile.compile( road_graph );
+
+    std::vector<TravelTimeFunction> travel_times( num_edges( road_graph ) );
+    for ( Road::Edge e : pair_range( edges( road_graph ) ) ) {
+        if ( (road_graph[e].traffic_rules() & TrafficRuleCar) == 0 ) {
+            continue;
+        }
+        const double length = road_graph[e].length();
+        if ( !profile.travel_time_function( e, SpeedRuleCar, length, travel_times[e.idx] ) ) {
+            // same fallback as time-dependent searches without profile
+            travel_times[e.idx] = TravelTimeFunction( avg_road_travel_time( road_graph, e, length, car.get() ) );
+        }
+    }
+    return travel_times;
+}
+
+///
+/// Turn-aware CH of a turn graph of cars.
+/// Vertices are ordered and contracted as for a node-based CH, the graph is only larger
+static std::unique_ptr<Tempus::TurnCHRoutingData> contract_turn_graph( const Tempus::Road::Graph& road_graph, const Tempus::TurnGraph& turns,
+                                                                       const Tempus::TransportMode& car, bool parallel )
+{
+    using namespace Tempus;
+
+    // a vertex for each node of a car section, weighted by its travel time in hundredths of seconds
+    const uint32_t none = uint32_t( -1 );
+    std::vector<uint32_t> node_vertex( turns.num_nodes(), none );
+    std::vector<TurnGraph::Node> vertex_node;
+    std::vector<TCost> vertex_cost;
+    for ( TurnGraph::Node n = 0; n < turns.num_nodes(); n++ ) {
+        const Road::Edge e = turns.road_edge( n );
+        if ( (road_graph[e].traffic_rules() & TrafficRuleCar) == 0 ) {
+            continue;
+        }
+        node_vertex[n] = uint32_t( vertex_node.size() );
+        vertex_node.push_back( n );
+        vertex_cost.push_back( std::max( int( avg_road_travel_time( road_graph, e, road_graph[e].length(), car ) * 6000.0 ), 1 ) );
+    }
+    const size_t n_vertices = vertex_node.size();
+
+    // a turn costs the travel time of the section it goes to and its penalty
+    struct TurnArc
+    {
+        uint32_t from;
+        uint32_t to;
+        TCost weight;
+    };
+    std::vector<TurnArc> arcs;
+    for ( uint32_t u = 0; u < n_vertices; u++ ) {
+        const TurnGraph::Node n = vertex_node[u];
+        for ( uint32_t t = turns.first_turn( n ); t < turns.first_turn( n + 1 ); t++ ) {
+            const uint32_t v = node_vertex[turns.turn_target( t )];
+            if ( v == u ) {
+                continue;
+            }
+            arcs.push_back( TurnArc{ u, v, vertex_cost[v] + int( turns.turn_penalty( t ) * 6000.0 ) } );
+        }
+    }
+
+    std::cout << "* Computing node ordering" << std::endl;
+    std::vector<uint32_t> rank( n_vertices );
+    {
+        CHGraph ch_graph( n_vertices );
+        for ( uint32_t v = 0; v < n_vertices; v++ ) {
+            ch_graph[v].id = v;
+        }
+        for ( const TurnArc& a : arcs ) {
+            ch_graph.add_edge( a.from, a.to, a.weight );
+        }
+        std::vector<CHVertex> ordered = order_graph( ch_graph, [&ch_graph](CHVertex v){ return ch_graph[v].id; } );
+        for ( uint32_t i = 0; i < ordered.size(); i++ ) {
+            rank[ordered[i]] = i;
+        }
+    }
+
+    std::cout << "* Compute graph contraction" << std::endl;
+    CHGraph ch_graph( n_vertices );
+    for ( const TurnArc& a : arcs ) {
+        ch_graph.add_edge( rank[a.from], rank[a.to], a.weight );
+    }
+    std::vector<Shortcut> shortcuts = contract_graph( ch_graph, parallel );
+
+    // edges of the query graph, (lower vertex, dir, upper vertex), the cheapest first
+    struct QueryEdge
+    {
+        uint32_t id1;
+        uint32_t id2;
+        int dir;
+        CHEdgeProperty p;
+    };
+    std::vector<QueryEdge> query_edges;
+    auto add_query_edge = [&query_edges]( uint32_t from, uint32_t to, TCost cost, bool is_shortcut, uint32_t middle, db_id_t db_id ) {
+        QueryEdge qe;
+        qe.id1 = std::min( from, to );
+        qe.id2 = std::max( from, to );
+        qe.dir = from < to ? 0 : 1;
+        qe.p.b.cost = cost;
+        qe.p.b.is_shortcut = is_shortcut ? 1 : 0;
+        qe.p.middle_node = middle;
+        qe.p.db_id = db_id;
+        query_edges.push_back( qe );
+    };
+    for ( const TurnArc& a : arcs ) {
+        add_query_edge( rank[a.from], rank[a.to], a.weight, false, 0, road_graph[turns.road_edge( vertex_node[a.to] )].db_id() );
+    }
+    for ( const Shortcut& s : shortcuts ) {
+        add_query_edge( s.from, s.to, s.cost, true, s.contracted, 0 );
+    }
+    std::sort( query_edges.begin(), query_edges.end(), []( const QueryEdge& a, const QueryEdge& b ) {
+            return std::make_tuple( a.id1, a.dir, a.id2, uint32_t( a.p.b.cost ) ) < std::make_tuple( b.id1, b.dir, b.id2, uint32_t( b.p.b.cost ) );
+        } );
+    std::vector<std::pair<uint32_t, uint32_t>> targets;
+    std::vector<CHEdgeProperty> properties;
+    std::vector<uint32_t> up_degrees( n_vertices, 0 );
+    for ( size_t i = 0; i < query_edges.size(); i++ ) {
+        const QueryEdge& qe = query_edges[i];
+        if ( i > 0 && qe.id1 == query_edges[i-1].id1 && qe.id2 == query_edges[i-1].id2 && qe.dir == query_edges[i-1].dir ) {
+            // only the cheapest of parallel edges is kept
+            continue;
+        }
+        if ( qe.dir == 0 ) {
+            up_degrees[qe.id1]++;
+        }
+        targets.push_back( std::make_pair( qe.id1, qe.id2 ) );
+        properties.push_back( qe.p );
+    }
+    std::unique_ptr<CHQuery> ch_query( new CHQuery( targets.begin(), targets.end(), n_vertices, up_degrees.begin(), properties.begin() ) );
+
+    std::vector<TurnCHNode> nodes( n_vertices );
+    for ( uint32_t v = 0; v < n_vertices; v++ ) {
+        const Road::Edge e = turns.road_edge( vertex_node[v] );
+        TurnCHNode& node = nodes[rank[v]];
+        node.section_id = road_graph[e].db_id();
+        node.from_node = road_graph[source( e, road_graph )].db_id();
+        node.to_node = road_graph[target( e, road_graph )].db_id();
+        node.cost = uint32_t( vertex_cost[v] );
+        // copies of nodes are only reached while a restriction is in progress
+        node.start = vertex_node[v] < num_edges( road_graph ) ? 1 : 0;
+    }
+
+    return std::unique_ptr<TurnCHRoutingData>( new TurnCHRoutingData( std::move( ch_query ), std::move( nodes ) ) );
+}
+
+///
+/// Contract the turn graph of cars, with the turn restrictions of a schema, and dump it (turn_ch_graph)
+static void turn_aware_contraction( const Tempus::Multimodal::Graph& graph, const std::string& db_options, const std::string& schema,
+                                    const std::string& file, bool parallel, Tempus::ProgressionCallback& progression )
+{
+    using namespace Tempus;
+    const Road::Graph& road_graph = graph.road();
+    boost::optional<TransportMode> car = graph.transport_mode( TransportModePrivateCar );
+    if ( !car ) {
+        throw std::runtime_error( "No private car transport mode" );
+    }
+
+    std::cout << "* Loading turn restrictions" << std::endl;
+    Road::Restrictions restrictions( road_graph );
+    {
+        Db::Connection conn( db_options );
+        restrictions = import_turn_restrictions( conn, road_graph, schema );
+    }
+    const TurnGraph turns( road_graph, restrictions, TrafficRuleCar );
+    std::cout << "* Turn graph of " << turns.num_nodes() << " nodes and " << turns.num_turns() << " turns" << std::endl;
+
+    std::unique_ptr<TurnCHRoutingData> turn_ch = contract_turn_graph( road_graph, turns, car.get(), parallel );
+    RoutingData::TransportModes modes;
+    modes[TransportModePrivateCar] = car.get();
+    turn_ch->set_transport_modes( modes );
+
+    std::cout << "* Dumping the turn-aware CH to " << file << std::endl;
+    dump_routing_data( turn_ch.get(), file, progression );
+}
 
 int main( int argc, char *argv[] )
 {
@@ -35,6 +259,8 @@ int main( int argc, char *argv[] )
 
     bool compute_contraction = true;
     bool save_to_db = true;
+    bool nested_dissection = false;
+    bool time_dependent = false;
 
     std::string db_options = "dbname=tempus_test_db";
     std::string in_schema = "tempus";
@@ -42,6 +268,9 @@ int main( int argc, char *argv[] )
     std::string ordering_out_schema = "ch";
     std::string ordering_in_schema = "ch";
     std::string contraction_out_schema = "ch";
+    std::string tch_file;
+    std::string turn_ch_file;
+    int n_threads = 0;
 
     namespace po = boost::program_options;
     po::options_description desc( "Allowed options" );
@@ -57,6 +286,10 @@ int main( int argc, char *argv[] )
         ( "ordering-in-schema", po::value<string>(&ordering_in_schema), "set database schema used for reading the node ordering" )
         ( "contraction-out-schema", po::value<string>(&contraction_out_schema), "set database schema used for writing the contraction" )
         ( "no-db-saving", "do not save to db" )
+        ( "nested-dissection", "compute a metric independent ordering for a customizable CH (cch_graph), no contraction is needed afterwards" )
+        ( "time-dependent", po::value<string>(&tch_file), "contract with the car speed profiles of tempus.road_daily_profile and dump the time-dependent CH (tch_graph) to the given file" )
+        ( "turn-restrictions", po::value<string>(&turn_ch_file), "contract the edge-based graph of cars with the turn restrictions of the input schema and dump the turn-aware CH (turn_ch_graph) to the given file, nothing else is computed" )
+        ( "threads,j", po::value<int>(&n_threads), "set the number of threads used for the ordering and the contraction (0: all available cores, 1: sequential contraction)" )
         ;
 
     po::variables_map vm;
@@ -68,6 +301,16 @@ int main( int argc, char *argv[] )
         return 1;
     }
 
+    if ( n_threads < 0 ) {
+        std::cerr << "The number of threads must be positive" << std::endl;
+        return 1;
+    }
+#ifdef _OPENMP
+    if ( n_threads > 0 ) {
+        omp_set_num_threads( n_threads );
+    }
+#endif
+
     if ( vm.count( "no-ordering" ) ) {
         compute_node_ordering = false;
         load_ordering_from_db = true;
@@ -81,6 +324,16 @@ int main( int argc, char *argv[] )
     if ( vm.count( "ordering-loading" ) ) {
         load_ordering_from_db = true;
     }
+    if ( vm.count( "nested-dissection" ) ) {
+        nested_dissection = true;
+        compute_node_ordering = true;
+        compute_contraction = false;
+    }
+    // the time-dependent contraction replaces the static one
+    if ( vm.count( "time-dependent" ) ) {
+        time_dependent = vm.count( "no-contraction" ) == 0;
+        compute_contraction = false;
+    }
 
     TextProgression progression;
     VariantMap options;
@@ -95,54 +348,135 @@ int main( int argc, char *argv[] )
 
     const Road::Graph& road_graph = graph.road();
 
+    if ( vm.count( "turn-restrictions" ) ) {
+        turn_aware_contraction( graph, db_options, in_schema, turn_ch_file, /* parallel */ n_threads != 1, progression );
+        return 0;
+    }
+
+    std::vector<TravelTimeFunction> travel_times;
+    if ( vm.count( "time-dependent" ) ) {
+        std::cout << "* Loading car speed profiles" << std::endl;
+        travel_times = car_travel_times( graph, db_options );
+    }
+
     std::vector<CHVertex> ordered_nodes;
     //
     // Node ordering
     //
     CHGraph ch_graph;
-    if ( compute_node_ordering ) {
+    if ( compute_node_ordering && nested_dissection ) {
+        std::cout << "* Computing node ordering by nested dissection" << std::endl;
+        // every road section is part of the topology, whatever its traffic rules
+        std::vector<Point2D> coordinates;
+        for ( Road::Vertex v : pair_range( vertices( road_graph ) ) ) {
+            CHVertex new_v = ch_graph.add_vertex();
+            ch_graph[new_v].id = road_graph[v].db_id();
+            coordinates.push_back( Point2D( road_graph[v].coordinates().x(), road_graph[v].coordinates().y() ) );
+        }
+        std::vector<std::pair<uint32_t, uint32_t>> road_edges;
+        for ( Road::Edge e : pair_range( edges( road_graph ) ) ) {
+            road_edges.push_back( std::make_pair( uint32_t( source( e, road_graph ) ), uint32_t( target( e, road_graph ) ) ) );
+        }
+        std::vector<uint32_t> order = nested_dissection_order( coordinates, road_edges );
+        ordered_nodes.assign( order.begin(), order.end() );
+    }
+    else if ( compute_node_ordering ) {
         std::cout << "* Computing node ordering" << std::endl;
         // copy to ch_graph
         for ( Road::Vertex v : pair_range( vertices( road_graph ) ) ) {
-            CHVertex new_v = add_vertex( ch_graph );
+            CHVertex new_v = ch_graph.add_vertex();
             ch_graph[new_v].id = road_graph[v].db_id();
         }
 
         for ( Road::Edge e : pair_range( edges( road_graph )) ) {
+            CHVertex v1 = CHVertex( source( e, road_graph ) );
+            CHVertex v2 = CHVertex( target( e, road_graph ) );
+            if ( !travel_times.empty() ) {
+                // ordered on the car graph, by the lower bounds of the travel times (hundredths of seconds)
+                if ( travel_times[e.idx].empty() ) {
+                    continue;
+                }
+                ch_graph.add_edge( v1, v2, std::max( int(travel_times[e.idx].min() * 6000.0), 1 ) );
+                continue;
+            }
             if ( (road_graph[e].traffic_rules() & TrafficRulePedestrian) == 0 ) {
                 continue;
             }
 
-            CHVertex v1 = source( e, road_graph );
-            CHVertex v2 = target( e, road_graph );
-            bool added = false;
-            CHEdge new_e;
-            boost::tie( new_e, added ) = add_edge( v1, v2, ch_graph );
-
-            BOOST_ASSERT( added );
-            ch_graph[new_e].weight = int(road_graph[e].length() * 100.0);
+            // parallel road sections are merged, the shortest one is kept
+            ch_graph.add_edge( v1, v2, int(road_graph[e].length() * 100.0) );
         }
 
         ordered_nodes = order_graph( ch_graph, [&ch_graph](CHVertex v){ return ch_graph[v].id; } );
+    }
 
-        if ( save_to_db ) {
-            std::cout << "* Saving node ordering to schema " << ordering_out_schema << std::endl;
+    if ( compute_node_ordering && save_to_db ) {
+        std::cout << "* Saving node ordering to schema " << ordering_out_schema << std::endl;
+        Db::Connection conn( db_options );
+        conn.exec( "CREATE SCHEMA IF NOT EXISTS " + ordering_out_schema );
+        conn.exec( "DROP TABLE IF EXISTS " + ordering_out_schema + ".ordered_nodes CASCADE" );
+        conn.exec( "CREATE TABLE " + ordering_out_schema + ".ordered_nodes (id SERIAL PRIMARY KEY, node_id BIGINT NOT NULL, sort_order INT NOT NULL)" );
+
+        conn.exec( "BEGIN" );
+        uint32_t i = 0;
+        for ( CHVertex v : ordered_nodes )
+        {
+            std::ostringstream ostr;
+            ostr << "INSERT INTO " << ordering_out_schema << ".ordered_nodes (node_id, sort_order) VALUES (" << ch_graph[v].id << "," << i << ")";
+            conn.exec( ostr.str() );
+            i++;
+        }
+        conn.exec( "COMMIT" );
+    }
+
+    //
+    // Time-dependent contraction
+    //
+    if ( time_dependent ) {
+        std::cout << "* Compute time-dependent graph contraction" << std::endl;
+        std::vector<db_id_t> order_id;
+        if ( load_ordering_from_db ) {
+            std::cout << "* Loading node ordering from schema " << ordering_in_schema << std::endl;
             Db::Connection conn( db_options );
-            conn.exec( "CREATE SCHEMA IF NOT EXISTS " + ordering_out_schema );
-            conn.exec( "DROP TABLE IF EXISTS " + ordering_out_schema + ".ordered_nodes CASCADE" );
-            conn.exec( "CREATE TABLE " + ordering_out_schema + ".ordered_nodes (id SERIAL PRIMARY KEY, node_id BIGINT NOT NULL, sort_order INT NOT NULL)" );
+            order_id = load_ordering( conn, ordering_in_schema );
+        }
+        else {
+            for ( CHVertex v : ordered_nodes ) {
+                order_id.push_back( ch_graph[v].id );
+            }
+        }
+        std::map<db_id_t, uint32_t> id_order_map; // id -> order
+        for ( uint32_t i = 0; i < order_id.size(); i++ ) {
+            id_order_map[order_id[i]] = i;
+        }
 
-            conn.exec( "BEGIN" );
-            uint32_t i = 0;
-            for ( CHVertex v : ordered_nodes )
-            {
-                std::ostringstream ostr;
-                ostr << "INSERT INTO " << ordering_out_schema << ".ordered_nodes (node_id, sort_order) VALUES (" << ch_graph[v].id << "," << i << ")";
-                conn.exec( ostr.str() );
-                i++;
+        std::vector<TCHSection> sections;
+        for ( Road::Edge e : pair_range( edges( road_graph ) ) ) {
+            if ( travel_times[e.idx].empty() ) {
+                continue;
             }
-            conn.exec( "COMMIT" );
+            auto from_it = id_order_map.find( road_graph[source( e, road_graph )].db_id() );
+            auto to_it = id_order_map.find( road_graph[target( e, road_graph )].db_id() );
+            if ( from_it == id_order_map.end() || to_it == id_order_map.end() ) {
+                std::cerr << "Road section " << road_graph[e].db_id() << " has a node that is not ordered" << std::endl;
+                return 1;
+            }
+            TCHSection s;
+            s.from = from_it->second;
+            s.to = to_it->second;
+            s.db_id = road_graph[e].db_id();
+            s.travel_time = std::move( travel_times[e.idx] );
+            sections.push_back( std::move( s ) );
         }
+        travel_times.clear();
+
+        TCHRoutingData tch( std::move( order_id ), sections );
+        RoutingData::TransportModes modes;
+        modes[TransportModePrivateCar] = graph.transport_mode( TransportModePrivateCar ).get();
+        tch.set_transport_modes( modes );
+
+        std::cout << "* Dumping the time-dependent CH to " << tch_file << std::endl;
+        dump_routing_data( &tch, tch_file, progression );
     }
 
     //
@@ -156,16 +490,9 @@ int main( int argc, char *argv[] )
         Db::Connection conn( db_options );
         if ( load_ordering_from_db ) {
             std::cout << "* Loading node ordering from schema " << ordering_in_schema << std::endl;
-            Db::ResultIterator res_it = conn.exec_it( "select node_id from " + ordering_in_schema + ".ordered_nodes order by id asc" );
-            Db::ResultIterator it_end;
-
-            CHVertex i = 0;
-            for ( ; res_it != it_end; res_it++, i++ ) {
-                Db::RowValue res_i = *res_it;
-                db_id_t db_id = res_i[0];
-                order_id.push_back( db_id );
-                //std::cout << i << " -> " << db_id << std::endl;
-                id_order_map[db_id] = i;
+            order_id = load_ordering( conn, ordering_in_schema );
+            for ( uint32_t i = 0; i < order_id.size(); i++ ) {
+                id_order_map[order_id[i]] = i;
             }
         }
         else {
@@ -180,7 +507,7 @@ int main( int argc, char *argv[] )
 
         std::map<db_id_t, Road::Vertex> id_vertex_map; // id -> vertex
         for ( auto it = vertices( road_graph ).first; it != vertices( road_graph ).second; it++ ) {
-            add_vertex( ch_graph );
+            ch_graph.add_vertex();
             id_vertex_map[road_graph[*it].db_id()] = *it;
         }
         for ( CHVertex i = 0; i < order_id.size(); i++ ) {
@@ -205,17 +532,14 @@ int main( int argc, char *argv[] )
                 }
                 Road::Vertex s = target( *it, road_graph );
                 db_id_t id = road_graph[s].db_id();
-                bool added = false;
-                CHEdge e;
-                boost::tie( e, added ) = add_edge( order, id_order_map[id], ch_graph );
-                BOOST_ASSERT( added );
-                ch_graph[e].weight = std::max(int(road_graph[*it].length()*100.0),1);
+                TCost weight = std::max(int(road_graph[*it].length()*100.0),1);
+                ch_graph.add_edge( order, id_order_map[id], weight );
                 if ( save_to_db ) {
                     std::ostringstream ss;
                     if ( order < id_order_map[id] ) {
-                        ss << "(" << order_id[order] << "," << id << "," << ch_graph[e].weight << ",1)";
+                        ss << "(" << order_id[order] << "," << id << "," << weight << ",1)";
                     } else {
-                        ss << "(" << id << "," << order_id[order] << "," << ch_graph[e].weight << ",2)";
+                        ss << "(" << id << "," << order_id[order] << "," << weight << ",2)";
                     }
                     conn.exec( "INSERT INTO " + contraction_out_schema + ".query_graph (node_inf, node_sup, weight, constraints) VALUES " + ss.str() );
                 }
@@ -225,7 +549,7 @@ int main( int argc, char *argv[] )
             conn.exec( "COMMIT" );
         }
 
-        std::vector<Shortcut> shortcuts = contract_graph( ch_graph );
+        std::vector<Shortcut> shortcuts = contract_graph( ch_graph, /* parallel */ n_threads != 1 );
 
         if ( save_to_db ) {
             std::cout << "* Saving contraction to schema " << contraction_out_schema << std::endl;
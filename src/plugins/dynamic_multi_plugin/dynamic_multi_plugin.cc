@@ -156,7 +156,8 @@ public:
 
     float operator()( const Multimodal::Vertex& v )
     {
-        return distance( destination_, Point2D( v.coordinates().x(), v.coordinates().y() ) ) / max_speed_;
+        const Point3D p( v.coordinates( underlying_graph( graph_ ) ) );
+        return distance( destination_, Point2D( p.x(), p.y() ) ) / max_speed_;
     }
 private:
     const Graph& graph_;
@@ -262,6 +263,7 @@ Plugin::OptionDescriptionList DynamicMultiPlugin::option_descriptions()
     declare_option( odl, "AStar/heuristic", "Use an heuristic based on euclidian distance", Variant::from_bool(false) );
     declare_option( odl, "AStar/speed_heuristic", "Max speed (km/h) to use in the heuristic", Variant::from_float(90.0) );
     declare_option( odl, "Time/use_speed_profiles", "Use road speed profiles", Variant::from_bool(false) );
+    declare_option( odl, "Time/travel_time_profile", "Return the travel time as a function of the departure time instead of a roadmap, road modes only, without turn restrictions", Variant::from_bool(false) );
     declare_option( odl, "multi_destinations", "Destination list (road vertex id, comma separated)", Variant::from_string("") );
     return odl;
 }
@@ -304,6 +306,201 @@ DynamicMultiPlugin::DynamicMultiPlugin( ProgressionCallback& progression, const
         boost::write_graphviz( ofs, automaton_.automaton_graph_, nodeWriter, arcWriter);
         std::cout << "Automaton exported" << std::endl;
     }
+
+    Db::Connection connection( db_options() );
+
+    // transport modes of trips
+    {
+        Db::Result res( connection.exec( "SELECT pt_trip.id, pt_route.transport_mode FROM tempus.pt_trip "
+                                         "JOIN tempus.pt_route ON pt_route.id = pt_trip.route_id" ) );
+        for ( size_t i = 0; i < res.size(); i++ ) {
+            trip_modes_[res[i][0].as<db_id_t>()] = res[i][1].as<int>();
+        }
+    }
+
+    // frequency-based sections, the service days are given by the service map of each network
+    {
+        std::map<PublicTransportGraphIndex, std::map<db_id_t, PublicTransport::Vertex>> vertex_from_id;
+        Db::Result res( connection.exec( "SELECT pt_agency.network_id, t1.stop_id as origin_stop, t2.stop_id as destination_stop, "
+                                         "t1.trip_id, pt_trip.service_id, pt_route.transport_mode, extract(epoch from pt_frequency.start_time)/60 as start_time, extract(epoch from pt_frequency.end_time)/60 as end_time, "
+                                         "pt_frequency.headway_secs/60 as headway, extract(epoch from t2.departure_time - t1.arrival_time)/60 as travel_time "
+                                         "FROM tempus.pt_stop_time t1, tempus.pt_stop_time t2, tempus.pt_trip, tempus.pt_frequency, tempus.pt_route, tempus.pt_agency "
+                                         "WHERE t1.trip_id=t2.trip_id AND t1.stop_sequence + 1 = t2.stop_sequence AND pt_trip.id=t1.trip_id AND pt_frequency.trip_id = t1.trip_id "
+                                         "AND pt_route.id = pt_trip.route_id AND pt_agency.id = pt_route.agency_id" ) );
+        for ( size_t i = 0; i < res.size(); i++ ) {
+            boost::optional<PublicTransportGraphIndex> idx = graph_->public_transport_index( res[i][0].as<db_id_t>() );
+            if ( !idx ) {
+                continue;
+            }
+            const PublicTransport::Graph& pt_graph = graph_->public_transport( *idx );
+            std::map<db_id_t, PublicTransport::Vertex>& vertices_by_id = vertex_from_id[*idx];
+            if ( vertices_by_id.empty() ) {
+                PublicTransport::Graph::vertex_iterator vit, vend;
+                for ( boost::tie( vit, vend ) = vertices( pt_graph ); vit != vend; ++vit ) {
+                    vertices_by_id[ pt_graph[*vit].db_id() ] = *vit;
+                }
+            }
+            auto departure = vertices_by_id.find( res[i][1].as<db_id_t>() );
+            auto arrival = vertices_by_id.find( res[i][2].as<db_id_t>() );
+            if ( departure == vertices_by_id.end() || arrival == vertices_by_id.end() ) {
+                continue;
+            }
+            FrequencySection f;
+            bool found;
+            boost::tie( f.edge, found ) = boost::edge( departure->second, arrival->second, pt_graph );
+            if ( !found ) {
+                continue;
+            }
+            f.graph = *idx;
+            f.data.trip_id = res[i][3].as<int>();
+            f.service_id = res[i][4].as<db_id_t>();
+            f.mode_id = res[i][5].as<int>();
+            f.start_time = res[i][6].as<double>();
+            f.data.end_time = res[i][7].as<double>();
+            f.data.headway = res[i][8].as<double>();
+            f.data.travel_time = res[i][9].as<double>();
+            frequency_sections_.push_back( f );
+        }
+    }
+
+    load_speed_profile();
+
+    // timetables of the first service days
+    Date first_day = boost::gregorian::day_clock::local_day();
+    auto it = options.find( "timetable/first_day" );
+    if ( it != options.end() ) {
+        first_day = boost::gregorian::from_string( it->second.str() );
+    }
+    int64_t n_days = 7;
+    it = options.find( "timetable/days" );
+    if ( it != options.end() ) {
+        n_days = it->second.as<int64_t>();
+    }
+    cache_size_ = size_t( std::max( n_days, int64_t(1) ) );
+    if ( graph_->public_transports().size() > 0 ) {
+        Timer timer;
+        for ( int64_t d = n_days - 1; d >= 0; d-- ) {
+            const Date day = first_day + boost::gregorian::days( d );
+            day_cache_.push_back( std::make_pair( day, build_day_timetable( day ) ) );
+        }
+        day_cache_.reverse();
+        std::cout << "Timetables of " << n_days << " days from " << first_day << " built in " << timer.elapsed() << "s" << std::endl;
+    }
+}
+
+std::shared_ptr<const DayTimetable> DynamicMultiPlugin::day_timetable( const Date& day ) const
+{
+    {
+        boost::lock_guard<boost::mutex> lock( mutex_ );
+        for ( auto it = day_cache_.begin(); it != day_cache_.end(); ++it ) {
+            if ( it->first == day ) {
+                day_cache_.splice( day_cache_.begin(), day_cache_, it );
+                return day_cache_.front().second;
+            }
+        }
+    }
+
+    // built without the lock, requests on cached days are not blocked meanwhile
+    std::shared_ptr<const DayTimetable> t = build_day_timetable( day );
+
+    boost::lock_guard<boost::mutex> lock( mutex_ );
+    for ( auto it = day_cache_.begin(); it != day_cache_.end(); ++it ) {
+        if ( it->first == day ) {
+            // built by another request in the meantime
+            day_cache_.splice( day_cache_.begin(), day_cache_, it );
+            return day_cache_.front().second;
+        }
+    }
+    day_cache_.push_front( std::make_pair( day, t ) );
+    if ( day_cache_.size() > cache_size_ ) {
+        day_cache_.pop_back();
+    }
+    return t;
+}
+
+std::shared_ptr<const RoadEdgeSpeedProfile> DynamicMultiPlugin::speed_profile() const
+{
+    boost::lock_guard<boost::mutex> lock( mutex_ );
+    return speed_profile_;
+}
+
+void DynamicMultiPlugin::load_speed_profile()
+{
+    std::shared_ptr<RoadEdgeSpeedProfile> profile( new RoadEdgeSpeedProfile() );
+    Db::Connection connection( db_options() );
+    Db::Result res( connection.exec( "SELECT road_section_id, speed_rule, begin_time, end_time, average_speed FROM\n"
+                                     "tempus.road_section_speed as ss,\n"
+                                     "tempus.road_daily_profile as p\n"
+                                     "WHERE\n"
+                                     "p.profile_id = ss.profile_id" ) );
+    for ( size_t i = 0; i < res.size(); i++ ) {
+        db_id_t road_section = res[i][0].as<db_id_t>();
+        int speed_rule = res[i][1].as<int>();
+        double begin_time = res[i][2].as<double>();
+        double end_time = res[i][3].as<double>();
+        double speed = res[i][4].as<double>();
+
+        profile->add_period( road_section, static_cast<TransportModeSpeedRule>(speed_rule), begin_time, end_time-begin_time, speed );
+    }
+    profile->compile( graph_->road() );
+
+    // requests running with the previous profiles keep their own reference
+    boost::lock_guard<boost::mutex> lock( mutex_ );
+    speed_profile_ = profile;
+    std::cout << "Speed profiles loaded" << std::endl;
+}
+
+std::shared_ptr<const DayTimetable> DynamicMultiPlugin::build_day_timetable( const Date& day ) const
+{
+    std::shared_ptr<DayTimetable> t( new DayTimetable() );
+
+    // timetable model, from the trip times of the public transport sections
+    for ( auto p : graph_->public_transports() ) {
+        const PublicTransport::Graph& pt_graph = *p.second;
+        const PublicTransportGraphIndex graph_idx = graph_->public_transport_index( p.first ).get();
+        const PublicTransport::ActiveServices services = get_property( pt_graph ).service_map().active_services( day );
+        PublicTransport::EdgeIterator eit, eend;
+        for ( boost::tie( eit, eend ) = edges( pt_graph ); eit != eend; ++eit ) {
+            const PublicTransport::Edge& e = *eit;
+            const PublicTransportEdgeKey key = public_transport_edge_key( graph_idx, e );
+            for ( const PublicTransport::Timetable::TripTime& tt : PublicTransport::time_table( pt_graph, e ).table() ) {
+                if ( !services[tt.service_index()] ) {
+                    continue;
+                }
+                auto mit = trip_modes_.find( tt.trip_id() );
+                if ( mit == trip_modes_.end() ) {
+                    continue;
+                }
+                const int mode_id = mit->second;
+                TimetableData td, rtd;
+                td.trip_id = tt.trip_id();
+                td.arrival_time = tt.arrival_time();
+                t->timetable[mode_id][key].emplace( tt.departure_time(), td );
+
+                // reverse timetable
+                rtd.trip_id = td.trip_id;
+                rtd.arrival_time = tt.departure_time();
+                t->rtimetable[mode_id][key].emplace( tt.arrival_time(), rtd );
+            }
+        }
+    }
+
+    // frequency model
+    for ( const FrequencySection& f : frequency_sections_ ) {
+        if ( !get_property( graph_->public_transport( f.graph ) ).service_map().is_available_on( f.service_id, day ) ) {
+            continue;
+        }
+        t->frequency[f.mode_id][public_transport_edge_key( f.graph, f.edge )].emplace( f.start_time, f.data );
+
+        // reverse frequency data
+        FrequencyData rf;
+        rf.trip_id = f.data.trip_id;
+        rf.end_time = f.start_time;
+        rf.headway = f.data.headway;
+        rf.travel_time = f.data.travel_time;
+        t->rfrequency[f.mode_id][public_transport_edge_key( f.graph, f.edge )].emplace( f.data.end_time, rf );
+    }
+    return t;
 }
 
 std::unique_ptr<PluginRequest> DynamicMultiPlugin::request( const VariantMap& options ) const
@@ -311,8 +508,18 @@ std::unique_ptr<PluginRequest> DynamicMultiPlugin::request( const VariantMap& op
     return std::unique_ptr<PluginRequest>( new DynamicMultiPluginRequest( this, options, graph_ ) );
 }
 
+namespace
+{
+// labels are kept from one request to another by each thread, only their index is reused
+MMVertexDataMap& thread_vertex_data_map()
+{
+    static thread_local MMVertexDataMap labels;
+    return labels;
+}
+}
+
 DynamicMultiPluginRequest::DynamicMultiPluginRequest( const DynamicMultiPlugin* plugin, const VariantMap& options, const Multimodal::Graph* graph )
-    : PluginRequest( plugin, options ), graph_(graph)
+    : PluginRequest( plugin, options ), vertex_data_map_( thread_vertex_data_map() ), graph_(graph)
 {
 }
 
@@ -321,7 +528,6 @@ std::unique_ptr<Result> DynamicMultiPluginRequest::process( const Request& reque
     std::unique_ptr<Result> result( new Result );
 
     const DynamicMultiPlugin* parent = static_cast<const DynamicMultiPlugin*>( plugin_ );
-    Db::Connection db_( plugin_->db_options() );
 
     const Automaton<Road::Edge>& automaton_ = parent->automaton();
 
@@ -381,167 +587,36 @@ std::unique_ptr<Result> DynamicMultiPluginRequest::process( const Request& reque
         }
     }
 
+    if ( get_bool_option( "Time/travel_time_profile" ) ) {
+        // keeps the profiles alive until the end of the request
+        std::shared_ptr<const RoadEdgeSpeedProfile> speed_profile;
+        if ( use_speed_profiles_ ) {
+            speed_profile = parent->speed_profile();
+        }
+        return process_travel_time_profile( request, speed_profile.get(), walking_speed_, cycling_speed_ );
+    }
+
     if ( use_speed_profiles_ && (request.steps()[1].constraint().type() != Request::TimeConstraint::ConstraintAfter) ) {
         throw std::runtime_error( "A 'depart after' constraint must be specified for speed profiles" );
     }
 
-    // If current date changed, reload timetable / frequency
-    if (
-        ( (request.steps()[1].constraint().type() == Request::TimeConstraint::ConstraintAfter) ||
-          (request.steps()[1].constraint().type() == Request::TimeConstraint::ConstraintBefore) ) &&
-        (s_.current_day != request.steps()[1].constraint().date_time().date())
-        ) {
-        if ( pt_allowed && (graph_->public_transports().size() > 0) ) {
-            s_.current_day = request.steps()[1].constraint().date_time().date();
-
-            for ( auto p : graph_->public_transports() ) {
-                const PublicTransport::Graph& pt_graph = *p.second;
-                std::cout << "Load timetable for PT graph #" << p.first << std::endl;
-
-                // cache graph id to descriptor
-                // FIXME - integrate the cache into the graphs ?
-                std::map<db_id_t, PublicTransport::Vertex> vertex_from_id_;
-                PublicTransport::Graph::vertex_iterator vit, vend;
-                for ( boost::tie( vit, vend ) = vertices( pt_graph ); vit != vend; ++vit ) {
-                    vertex_from_id_[ pt_graph[*vit].db_id() ] = *vit;
-                }
-
-                if (timetable_frequency_ == 0) // timetable model
-                {
-                    // Charging necessary timetable data for request processing
-                    Db::Result res = db_.exec( ( boost::format( "SELECT t1.stop_id as origin_stop, t2.stop_id as destination_stop, "
-                                                                "t1.trip_id, pt_route.transport_mode, extract(epoch from t1.arrival_time)/60 as departure_time, extract(epoch from t2.departure_time)/60 as arrival_time "
-                                                                "FROM tempus.pt_stop_time t1, tempus.pt_stop_time t2, tempus.pt_trip, tempus.pt_route "
-                                                                "WHERE t1.trip_id = t2.trip_id AND t1.stop_sequence + 1 = t2.stop_sequence AND pt_trip.id = t1.trip_id "
-                                                                "AND pt_route.id = pt_trip.route_id "
-                                                                "AND pt_trip.service_id IN "
-                                                                "("
-                                                                "	(WITH calend AS ("
-                                                                "		SELECT service_id, start_date, end_date, ARRAY[sunday, monday, tuesday, wednesday, thursday, friday, saturday] AS days "
-                                                                "		FROM tempus.pt_calendar	)"
-                                                                "	SELECT service_id "
-                                                                "		FROM calend "
-                                                                "		WHERE days[(SELECT EXTRACT(dow FROM TIMESTAMP '%1%')+1)] AND start_date <= '%1%' AND end_date >= '%1%' ) "
-                                                                "EXCEPT ( "
-                                                                "	SELECT service_id "
-                                                                "		FROM tempus.pt_calendar_date "
-                                                                "		WHERE calendar_date='%1%' AND exception_type=2"
-                                                                "	) "
-                                                                "UNION ("
-                                                                "	SELECT service_id "
-                                                                "		FROM tempus.pt_calendar_date	"
-                                                                "		WHERE calendar_date='%1%' AND exception_type=1"
-                                                                "	)"
-                                                                ")") % boost::gregorian::to_simple_string(s_.current_day) ).str() );
-
-                    for ( size_t i = 0; i < res.size(); i++ ) {
-                        PublicTransport::Vertex departure, arrival;
-                        PublicTransport::Edge e;
-                        bool found;
-                        departure = vertex_from_id_[ res[i][0].as<db_id_t>() ];
-                        arrival = vertex_from_id_[ res[i][1].as<db_id_t>() ];
-                        boost::tie( e, found ) = boost::edge( departure, arrival, pt_graph );
-                        TimetableData t, rt;
-                        t.trip_id = res[i][2].as<int>();
-                        int mode_id = res[i][3].as<int>();
-                        double departure_time = res[i][4].as<double>();
-                        double arrival_time = res[i][5].as<double>();
-                        t.arrival_time = arrival_time;
-                        s_.timetable.emplace( mode_id, std::map<PublicTransport::Edge, std::map<double, TimetableData> >() );
-                        s_.timetable[mode_id].emplace( e, std::map<double, TimetableData>() );
-                        s_.timetable[mode_id][e].emplace( departure_time, t );
-
-                        // reverse timetable
-                        rt.trip_id = t.trip_id;
-                        rt.arrival_time = departure_time;
-
-                        s_.rtimetable.emplace( mode_id, std::map<PublicTransport::Edge, std::map<double, TimetableData> >() );
-                        s_.rtimetable[mode_id].emplace( e, std::map<double, TimetableData>() );
-                        s_.rtimetable[mode_id][e].emplace( arrival_time, rt );
-                    }
-                }
-                else if (timetable_frequency_ == 1) // frequency model
-                {
-                    // Charging necessary frequency data for request processing
-                    Db::Result res = db_.exec( ( boost::format( "SELECT t1.stop_id as origin_stop, t2.stop_id as destination_stop, "
-                                                                "t1.trip_id, pt_route.transport_mode, extract(epoch from pt_frequency.start_time)/60 as start_time, extract(epoch from pt_frequency.end_time)/60 as end_time, "
-                                                                "pt_frequency.headway_secs/60 as headway, extract(epoch from t2.departure_time - t1.arrival_time)/60 as travel_time "
-                                                                "FROM tempus.pt_stop_time t1, tempus.pt_stop_time t2, tempus.pt_trip, tempus.pt_frequency, tempus.pt_route "
-                                                                "WHERE t1.trip_id=t2.trip_id AND t1.stop_sequence + 1 = t2.stop_sequence AND pt_trip.id=t1.trip_id AND pt_frequency.trip_id = t1.trip_id "
-                                                                "AND pt_route.id = pt_trip.route_id "
-                                                                "AND pt_trip.service_id IN "
-                                                                "("
-                                                                "	(WITH calend AS ("
-                                                                "		SELECT service_id, start_date, end_date, ARRAY[sunday, monday, tuesday, wednesday, thursday, friday, saturday] AS days "
-                                                                "		FROM tempus.pt_calendar	)"
-                                                                "	SELECT service_id "
-                                                                "		FROM calend "
-                                                                "		WHERE days[(SELECT EXTRACT(dow FROM TIMESTAMP '%1%')+1)] AND start_date <= '%1%' AND end_date >= '%1%' ) "
-                                                                "EXCEPT ( "
-                                                                "	SELECT service_id "
-                                                                "		FROM tempus.pt_calendar_date "
-                                                                "		WHERE calendar_date='%1%' AND exception_type=2"
-                                                                "	) "
-                                                                "UNION ("
-                                                                "	SELECT service_id "
-                                                                "		FROM tempus.pt_calendar_date	"
-                                                                "		WHERE calendar_date='%1%' AND exception_type=1"
-                                                                "	)"
-                                                                ")") % boost::gregorian::to_simple_string(s_.current_day) ).str() );
-                    for ( size_t i = 0; i < res.size(); i++ ) {
-                        PublicTransport::Vertex departure, arrival;
-                        PublicTransport::Edge e;
-                        bool found;
-                        departure = vertex_from_id_[ res[i][0].as<db_id_t>() ];
-                        arrival = vertex_from_id_[ res[i][1].as<db_id_t>() ];
-                        boost::tie( e, found ) = boost::edge( departure, arrival, pt_graph );
-
-                        FrequencyData f;
-                        f.trip_id = res[i][2].as<int>();
-                        int mode_id = res[i][3].as<int>();
-                        f.end_time = res[i][5].as<double>();
-                        f.headway = res[i][6].as<double>();
-                        f.travel_time = res[i][7].as<double>();
-                        double start_time = res[i][4].as<double>();
-
-                        s_.frequency.emplace( mode_id, std::map<PublicTransport::Edge, std::map<double, FrequencyData> >() );
-                        s_.frequency[mode_id].emplace( e, std::map<double, FrequencyData>() );
-                        s_.frequency[mode_id][e].emplace( start_time, f );
-
-                        // reverse frequency data
-                        FrequencyData rf;
-                        rf.trip_id = f.trip_id;
-                        rf.end_time = start_time;
-                        rf.headway = f.headway;
-                        rf.travel_time = f.travel_time;
-
-                        s_.rfrequency.emplace( mode_id, std::map<PublicTransport::Edge, std::map<double, FrequencyData> >() );
-                        s_.rfrequency[mode_id].emplace( e, std::map<double, FrequencyData>() );
-                        s_.rfrequency[mode_id][e].emplace( f.end_time, rf );
-                    }
-                }
-            }
-
-            std::cout << "Load speed profiles" << std::endl;
-            // load speed profiles
-            // FIXME: must take day into account
-            Db::Result res = db_.exec("SELECT road_section_id, speed_rule, begin_time, end_time, average_speed FROM\n"
-                                      "tempus.road_section_speed as ss,\n"
-                                      "tempus.road_daily_profile as p\n"
-                                      "WHERE\n"
-                                      "p.profile_id = ss.profile_id");
-
-            for ( size_t i = 0; i < res.size(); i++ ) {
-                db_id_t road_section = res[i][0].as<db_id_t>();
-                int speed_rule = res[i][1].as<int>();
-                double begin_time = res[i][2].as<double>();
-                double end_time = res[i][3].as<double>();
-                double speed = res[i][4].as<double>();
-
-                s_.speed_profile.add_period( road_section, static_cast<TransportModeSpeedRule>(speed_rule), begin_time, end_time-begin_time, speed );
-            }
-        }
+    // timetable / frequency data of the request day
+    std::shared_ptr<const DayTimetable> day_timetable;
+    if ( pt_allowed && (graph_->public_transports().size() > 0) &&
+         ( (request.steps()[1].constraint().type() == Request::TimeConstraint::ConstraintAfter) ||
+           (request.steps()[1].constraint().type() == Request::TimeConstraint::ConstraintBefore) ) ) {
+        day_timetable = parent->day_timetable( request.steps()[1].constraint().date_time().date() );
+    }
+    else {
+        day_timetable.reset( new DayTimetable() );
     }
+    // only the data of the requested model is used
+    static const TimetableMap no_timetable;
+    static const FrequencyMap no_frequency;
+    const TimetableMap& timetable = timetable_frequency_ == 0 ? day_timetable->timetable : no_timetable;
+    const TimetableMap& rtimetable = timetable_frequency_ == 0 ? day_timetable->rtimetable : no_timetable;
+    const FrequencyMap& frequency = timetable_frequency_ == 1 ? day_timetable->frequency : no_frequency;
+    const FrequencyMap& rfrequency = timetable_frequency_ == 1 ? day_timetable->rfrequency : no_frequency;
 
     // Update timer for preprocessing
     time_+=timer.elapsed();
@@ -556,8 +631,8 @@ std::unique_ptr<Result> DynamicMultiPluginRequest::process( const Request& reque
     Multimodal::Vertex destination_; // Current request destination
 
     // Get origin and destination nodes
-    Multimodal::Vertex origin = Multimodal::Vertex( *graph_, graph_->road_vertex_from_id(request.origin()).get(), Multimodal::Vertex::road_t() );
-    destination_ = Multimodal::Vertex( *graph_, graph_->road_vertex_from_id(request.destination()).get(), Multimodal::Vertex::road_t() );
+    Multimodal::Vertex origin = Multimodal::Vertex( graph_->road_vertex_from_id(request.origin()).get(), Multimodal::Vertex::road_t() );
+    destination_ = Multimodal::Vertex( graph_->road_vertex_from_id(request.destination()).get(), Multimodal::Vertex::road_t() );
 
     bool reversed = request.steps().back().constraint().type() == Request::TimeConstraint::ConstraintBefore;
 
@@ -573,6 +648,7 @@ std::unique_ptr<Result> DynamicMultiPluginRequest::process( const Request& reque
     destination_o.mode = request.allowed_modes()[0];
 
     // make a property map out of the vertex data map
+    vertex_data_map_.reset( *graph_, request.allowed_modes() );
     associative_property_map_default_value<MMVertexDataMap> vertex_data_pmap( vertex_data_map_, MMVertexData() );
 
     double start_time = request.steps()[1].constraint().date_time().time_of_day().total_seconds()/60;
@@ -592,8 +668,11 @@ std::unique_ptr<Result> DynamicMultiPluginRequest::process( const Request& reque
 
     // Define and initialize the cost calculator
     const RoadEdgeSpeedProfile* profile;
+    // keeps the profiles alive until the end of the request
+    std::shared_ptr<const RoadEdgeSpeedProfile> speed_profile;
     if ( use_speed_profiles_ ) {
-        profile = &s_.speed_profile;
+        speed_profile = parent->speed_profile();
+        profile = speed_profile.get();
     }
     else {
         profile = 0;
@@ -603,12 +682,12 @@ std::unique_ptr<Result> DynamicMultiPluginRequest::process( const Request& reque
 
     // cost calculator for the "forward" graph
     CostCalculatorExternalTimetable<Multimodal::Graph> cost_calculator( *graph_, request.steps()[1].constraint().date_time().date(),
-                                                                        s_.timetable, s_.rtimetable, s_.frequency, s_.rfrequency,
+                                                                        timetable, rtimetable, frequency, rfrequency,
                                                                         request.allowed_modes(), walking_speed_, cycling_speed_, min_transfer_time_, car_parking_search_time_, parking_location_, profile );
 
     // cost calculator for the reverse graph
     CostCalculatorExternalTimetable<Multimodal::ReverseGraph> rcost_calculator( rgraph, request.steps()[1].constraint().date_time().date(),
-                                                                                s_.timetable, s_.rtimetable, s_.frequency, s_.rfrequency,
+                                                                                timetable, rtimetable, frequency, rfrequency,
                                                                                 request.allowed_modes(), walking_speed_, cycling_speed_, min_transfer_time_, car_parking_search_time_, parking_location_, profile );
     
     // destinations
@@ -756,6 +835,40 @@ std::string sec2hm( double s )
     return (s<0?"-":"") + (boost::format("%02d:%02d:%02d") % (int(s2)/60) % (int(s2) % 60) % int((s2-int(s2)) * 60)).str();
 }
 
+std::unique_ptr<Result> DynamicMultiPluginRequest::process_travel_time_profile( const Request& request, const RoadEdgeSpeedProfile* profile,
+                                                                              double walking_speed, double cycling_speed )
+{
+    Timer timer;
+    const TransportMode mode = graph_->transport_mode( request.allowed_modes()[0] ).get();
+    if ( mode.is_public_transport() ) {
+        throw std::invalid_argument( "Travel time profiles are only available for road transport modes" );
+    }
+    const boost::optional<Road::Vertex> origin = graph_->road_vertex_from_id( request.origin() );
+    if ( !origin ) {
+        throw std::invalid_argument( (boost::format("Can't find vertex of ID %1%") % request.origin()).str() );
+    }
+    const boost::optional<Road::Vertex> destination = graph_->road_vertex_from_id( request.destination() );
+    if ( !destination ) {
+        throw std::invalid_argument( (boost::format("Can't find vertex of ID %1%") % request.destination()).str() );
+    }
+
+    size_t iterations = 0;
+    TravelTimeProfile profile_result = road_travel_time_profile( graph_->road(), *origin, *destination, mode, profile,
+                                                                 walking_speed, cycling_speed, &iterations );
+    if ( profile_result.empty() ) {
+        throw std::runtime_error( "No path found" );
+    }
+
+    metrics_[ "iterations" ] = Variant::from_int( iterations );
+    metrics_[ "time_s" ] = Variant::from_float( timer.elapsed() );
+    if ( verbose_ ) {
+        cout << "Travel time profile of " << profile_result.size() << " breakpoints" << endl;
+    }
+    std::unique_ptr<Result> result( new Result );
+    result->push_back( profile_result );
+    return result;
+}
+
 void DynamicMultiPluginRequest::add_roadmap( const Request& request, Result& result, const Path& path, bool reverse )
 {
     result.push_back( Roadmap() );
@@ -858,7 +971,7 @@ void DynamicMultiPluginRequest::add_roadmap( const Request& request, Result& res
             Roadmap::RoadStep* step = static_cast<Roadmap::RoadStep*>( mstep.get() );
             Road::Edge e;
             bool found = false;
-            boost::tie( e, found ) = edge( it->vertex.road_vertex(), next->vertex.road_vertex(), *it->vertex.road_graph() );
+            boost::tie( e, found ) = edge( it->vertex.road_vertex(), next->vertex.road_vertex(), graph_->road() );
 
             if ( !found ) {
                 throw std::runtime_error( (boost::format("Can't find the road edge ! %d %d") % it->vertex.road_vertex() % next->vertex.road_vertex()).str() );
@@ -874,26 +987,20 @@ void DynamicMultiPluginRequest::add_roadmap( const Request& request, Result& res
             Roadmap::PublicTransportStep* step = static_cast<Roadmap::PublicTransportStep*>( mstep.get() );
 
             step->set_transport_mode( it->mode );
-            step->set_departure_stop( (*it->vertex.pt_graph())[it->vertex.pt_vertex()].db_id() );
-            step->set_arrival_stop( (*next->vertex.pt_graph())[next->vertex.pt_vertex()].db_id() );
+            step->set_departure_stop( get_pt_stop( it->vertex, *graph_ ).db_id() );
+            step->set_arrival_stop( get_pt_stop( next->vertex, *graph_ ).db_id() );
 
             step->set_departure_time( it_data.potential() );
             step->set_arrival_time( next_data.potential() );
             step->set_trip_id( next_data.trip() );
             step->set_wait( next_data.wait_time() );
 
-            // find the network_id
-            for ( auto p : graph_->public_transports() ) {
-                if ( it->vertex.pt_graph() == p.second ) {
-                    step->set_network_id(p.first);
-                    break;
-                }
-            }
+            step->set_network_id( graph_->public_transport_rindex( it->vertex.pt_graph_idx() ) );
             step->set_cost( CostId::CostDuration, step->arrival_time() - step->departure_time() );
         }
         else {
             // Make a multimodal edge and copy it into the roadmap as a 'generic' step
-            mstep.reset( new Roadmap::TransferStep( get_mm_vertex( it->vertex ), get_mm_vertex( next->vertex ) ) );
+            mstep.reset( new Roadmap::TransferStep( get_mm_vertex( it->vertex, *graph_ ), get_mm_vertex( next->vertex, *graph_ ) ) );
             Roadmap::TransferStep* step = static_cast<Roadmap::TransferStep*>(mstep.get());
             step->set_transport_mode( it->mode );
             step->set_final_mode( next->mode );
@@ -930,7 +1037,7 @@ void DynamicMultiPluginRequest::add_roadmap( const Request& request, Result& res
                 d = vit->first;
             }
             if ( !o.vertex.is_null() && !d.vertex.is_null() ) {
-                ValuedEdge ve( get_mm_vertex( o.vertex ), get_mm_vertex( d.vertex ) );
+                ValuedEdge ve( get_mm_vertex( o.vertex, *graph_ ), get_mm_vertex( d.vertex, *graph_ ) );
                 ve.set_value( "duration", Variant::from_float( vertex_data_map_[d].potential() ) );
                 ve.set_value( "imode", Variant::from_int(o.mode) );
                 ve.set_value( "fmode", Variant::from_int(d.mode) );
@@ -943,7 +1050,6 @@ void DynamicMultiPluginRequest::add_roadmap( const Request& request, Result& res
     }
 }
 
-StaticVariables DynamicMultiPluginRequest::s_;
 } // namespace DynamicMultiPlugin
 } // namespace Tempus
 
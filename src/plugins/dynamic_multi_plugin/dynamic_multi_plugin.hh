@@ -18,11 +18,15 @@
  */
 
 
+#include <list>
+#include <memory>
 #include <boost/tuple/tuple_comparison.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include "plugin.hh"
 #include "automaton_lib/automaton.hh"
 #include "mm_lib/cost_calculator.hh"
+#include "mm_lib/label_map.hh"
 
 namespace Tempus {
 namespace DynamicMultiPlugin {
@@ -66,21 +70,16 @@ public:
     {}
 };
 
-typedef std::map< Triple, MMVertexData > MMVertexDataMap;
+typedef MultimodalLabelMap< Triple, MMVertexData > MMVertexDataMap;
 
-// variables to retain between two requests
-struct StaticVariables
+///
+/// Timetable and frequency data of a service day, never modified once built
+struct DayTimetable
 {
-    Date current_day; // Day for which timetable or frequency data are loaded
-    TimetableMap timetable; // Timetable data for the current request
-    FrequencyMap frequency; // Frequency data for the current request
+    TimetableMap timetable; // Timetable data
+    FrequencyMap frequency; // Frequency data
     TimetableMap rtimetable; // Reverse time table
-    FrequencyMap rfrequency; // Reverse frequency data for the current request
-
-    RoadEdgeSpeedProfile speed_profile; // daily speed profile
-
-    StaticVariables() : current_day( boost::gregorian::from_string("2013/11/12") )
-    {}
+    FrequencyMap rfrequency; // Reverse frequency data
 };
 
 class DynamicMultiPlugin : public Plugin
@@ -95,12 +94,53 @@ public:
 
     const RoutingData* routing_data() const { return graph_; }
 
+    ///
+    /// Timetable of a service day, built from the public transport graphs if it is not cached yet.
+    /// The least recently used day is evicted once more days than the cache size are cached.
+    /// Thread-safe, the returned timetable stays valid after its eviction.
+    std::shared_ptr<const DayTimetable> day_timetable( const Date& day ) const;
+
+    ///
+    /// Current speed profiles. Thread-safe, the returned profiles are not modified by a later reload.
+    std::shared_ptr<const RoadEdgeSpeedProfile> speed_profile() const;
+
+    ///
+    /// Load the speed profiles from the database and publish them for the next requests
+    void load_speed_profile();
+
 public:
     virtual std::unique_ptr<PluginRequest> request( const VariantMap& options = VariantMap() ) const;
 
 private:
+    std::shared_ptr<const DayTimetable> build_day_timetable( const Date& day ) const;
+
     const Multimodal::Graph* graph_;
     Automaton<Road::Edge> automaton_;
+
+    // trip db id -> transport mode
+    std::map<db_id_t, int> trip_modes_;
+
+    // a frequency-based section of a trip, for any day
+    struct FrequencySection
+    {
+        PublicTransportGraphIndex graph;
+        PublicTransport::Edge edge;
+        db_id_t service_id;
+        int mode_id;
+        double start_time;
+        FrequencyData data;
+    };
+    std::vector<FrequencySection> frequency_sections_;
+
+    size_t cache_size_;
+    // most recently used day first
+    mutable std::list<std::pair<Date, std::shared_ptr<const DayTimetable>>> day_cache_;
+
+    std::shared_ptr<const RoadEdgeSpeedProfile> speed_profile_; // daily speed profile
+
+    // guards the day cache and the speed profile pointer, not the data they point to,
+    // which is never modified once published
+    mutable boost::mutex mutex_;
 };
 
 class DynamicMultiPluginRequest : public PluginRequest
@@ -114,9 +154,14 @@ private:
     Path reorder_path( Triple departure, Triple arrival, bool reverse = false );
     void add_roadmap( const Request& request, Result& r, const Path& path, bool reverse = false );
 
-    static StaticVariables s_;
+    ///
+    /// Travel time from the origin to the destination as a function of the departure time,
+    /// in the first allowed mode, returned as a TravelTimeProfile result
+    std::unique_ptr<Result> process_travel_time_profile( const Request& request, const RoadEdgeSpeedProfile* profile,
+                                                         double walking_speed, double cycling_speed );
 
-    MMVertexDataMap vertex_data_map_;
+    // labels of the thread that created the request
+    MMVertexDataMap& vertex_data_map_;
 
     bool enable_trace_;
 
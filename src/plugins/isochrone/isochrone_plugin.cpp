@@ -2,6 +2,7 @@
 #include "isochrone_plugin.h"
 #include "mm_lib/cost_calculator.hh"
 #include "mm_lib/algorithms.hh"
+#include "mm_lib/label_map.hh"
 #include "utils/timer.hh"
 
 #include <functional>
@@ -84,7 +85,7 @@ public:
     {}
 };
 
-typedef std::unordered_map<VertexLabel, MMVertexData> MMVertexDataMap;
+typedef MultimodalLabelMap<VertexLabel, MMVertexData> MMVertexDataMap;
 
 // IsochroneVisitor
 struct IsochroneVisitor
@@ -151,10 +152,11 @@ std::unique_ptr<Result> IsochronePluginRequest::process( const Request& request
                                                                         boost::none );
     
     MMVertexDataMap vertex_data_map;
+    vertex_data_map.reset( *graph_, request.allowed_modes() );
     boost::associative_property_map< MMVertexDataMap > vertex_data_pmap( vertex_data_map );
 
     // we start on a road node
-    Multimodal::Vertex origin = Multimodal::Vertex( *graph_, graph_->road_vertex_from_id(request.origin()).get(), Multimodal::Vertex::road_t() );
+    Multimodal::Vertex origin = Multimodal::Vertex( graph_->road_vertex_from_id(request.origin()).get(), Multimodal::Vertex::road_t() );
 
     // add each transport mode as a source
     std::vector<VertexLabel> sources;
@@ -183,7 +185,7 @@ std::unique_ptr<Result> IsochronePluginRequest::process( const Request& request
     Isochrone& isochrone = result->back().isochrone();
     for ( const auto& v : vertex_data_map ) {
         if ( v.second.potential() < isochrone_limit ) {
-            Point3D pt = v.first.vertex.coordinates();
+            Point3D pt = v.first.vertex.coordinates( *graph_ );
             isochrone.emplace_back( pt.x(), pt.y(), v.first.mode, v.second.potential() );
         }
     }
@@ -30,8 +30,12 @@
 #endif
 
 #include <type_traits>
+#include <queue>
 
 #include "reverse_multimodal_graph.hh"
+#include "travel_time_function.hh"
+#include "roadmap.hh"
+#include "cost_calculator.hh"
 
 namespace Tempus {
 
@@ -43,17 +47,61 @@ struct NullHeuristic
     }
 };
 
-template <class Object, class VertexDataMap, class Heuristic >
-struct HeuristicCompare
+///
+/// Queue entry of a label setting search: the heuristic is evaluated once, when the object is pushed
+template <class Object>
+struct HeuristicQueueEntry
 {
-    VertexDataMap pmap_;
-    Heuristic h_;
-    HeuristicCompare( const VertexDataMap& pmap, Heuristic h ) : pmap_(pmap), h_(h) {}
-    bool operator()( const Object& a, const Object& b ) const {
-        return (get( pmap_, a ).potential() + h_(a.vertex)) > (get( pmap_, b ).potential() + h_(b.vertex));
+    /// potential + heuristic
+    double key;
+    /// potential when pushed, the entry is outdated if the label has been improved since
+    double potential;
+    Object object;
+
+    bool operator<( const HeuristicQueueEntry& other ) const {
+        // boost heaps are max-heaps
+        return key > other.key;
     }
 };
 
+///
+/// Transport modes allowed in a request, looked up once per search
+class RequestTransportModes
+{
+public:
+    template <class Graph>
+    RequestTransportModes( const Graph& graph, const std::vector<db_id_t>& allowed_modes )
+    {
+        for ( db_id_t id : allowed_modes ) {
+            boost::optional<TransportMode> mode = graph.transport_mode( id );
+            BOOST_ASSERT( mode );
+            if ( size_t( id ) >= slot_.size() ) {
+                slot_.resize( size_t( id ) + 1, -1 );
+            }
+            slot_[id] = int( modes_.size() );
+            modes_.push_back( *mode );
+            traffic_rules_.push_back( mode->traffic_rules() );
+        }
+    }
+
+    size_t size() const { return modes_.size(); }
+    const TransportMode& operator[]( size_t i ) const { return modes_[i]; }
+    unsigned traffic_rules( size_t i ) const { return traffic_rules_[i]; }
+
+    ///
+    /// Allowed mode from its id, or null
+    const TransportMode* find( db_id_t id ) const
+    {
+        return size_t( id ) < slot_.size() && slot_[id] >= 0 ? &modes_[slot_[id]] : nullptr;
+    }
+
+private:
+    std::vector<TransportMode> modes_;
+    std::vector<unsigned> traffic_rules_;
+    // mode id -> index in modes_, or -1
+    std::vector<int> slot_;
+};
+
 //
 // Implementation of the Dijkstra algorithm (label-setting) for a graph and an automaton
 template < class NetworkGraph,
@@ -61,7 +109,8 @@ template < class NetworkGraph,
            class Object, 
            class VertexDataMap,
            class Visitor,
-           class CostCalculator>
+           class CostCalculator,
+           class Heuristic = NullHeuristic>
 void combined_ls_algorithm_no_init(
                                    const NetworkGraph& graph,
                                    const Automaton& automaton,
@@ -70,41 +119,48 @@ void combined_ls_algorithm_no_init(
                                    CostCalculator cost_calculator, 
                                    const std::vector<db_id_t>& request_allowed_modes,
                                    Visitor vis,
-                                   std::function<double (const Multimodal::Vertex&)> heuristic = NullHeuristic() )
+                                   Heuristic heuristic = Heuristic() )
 {
     using VertexData = typename boost::property_traits<VertexDataMap>::value_type;
 
     static_assert( std::is_same<typename boost::property_traits<VertexDataMap>::key_type, Object>::value, "The key type of the vertex data map must be the same as the type of the source" );
 
-    typedef HeuristicCompare<Object, VertexDataMap, std::function<double (const Multimodal::Vertex&)> > Cmp;
-    Cmp cmp( vertex_data_map, heuristic );
-
-    typedef boost::heap::d_ary_heap< Object, boost::heap::arity<4>, boost::heap::compare< Cmp >, boost::heap::mutable_<true> > VertexQueue;
-    VertexQueue vertex_queue( cmp ); 
-    vertex_queue.push( source_object ); 
+    typedef HeuristicQueueEntry<Object> QueueEntry;
+    typedef boost::heap::d_ary_heap< QueueEntry, boost::heap::arity<4> > VertexQueue;
+    VertexQueue vertex_queue;
+    {
+        const double pi = get( vertex_data_map, source_object ).potential();
+        vertex_queue.push( QueueEntry{ pi + heuristic( source_object.vertex ), pi, source_object } );
+    }
     vis.discover_vertex( source_object, graph );
 
     Object min_object; 
 
     // get transport mode objet for each allowed mode
-    std::vector<TransportMode> modes;
-    for ( size_t i = 0; i < request_allowed_modes.size(); i++ )
-    {
-        boost::optional<TransportMode> mode = graph.transport_mode( request_allowed_modes[i] );
-        BOOST_ASSERT( mode );
-        modes.push_back( *mode );
-    }
+    const RequestTransportModes modes( graph, request_allowed_modes );
 
     while ( !vertex_queue.empty() ) {
-        min_object = vertex_queue.top();
-        vis.examine_vertex( min_object, graph );
+        const double queued_pi = vertex_queue.top().potential;
+        min_object = vertex_queue.top().object;
         vertex_queue.pop();
 
-        const VertexData& min_vd = get( vertex_data_map, min_object );
+        // copied, inserting labels may move the others
+        const VertexData min_vd = get( vertex_data_map, min_object );
         double min_pi = min_vd.potential();
+        if ( queued_pi > min_pi ) {
+            // the object has been pushed again since, with a lower potential
+            continue;
+        }
+        vis.examine_vertex( min_object, graph );
         db_id_t initial_trip_id = min_vd.trip();
-			
-        const TransportMode& initial_mode = *graph.transport_mode( min_object.mode );
+
+        boost::optional<TransportMode> other_mode;
+        const TransportMode* initial_mode_ptr = modes.find( min_object.mode );
+        if ( !initial_mode_ptr ) {
+            other_mode = graph.transport_mode( min_object.mode );
+            initial_mode_ptr = &other_mode.get();
+        }
+        const TransportMode& initial_mode = *initial_mode_ptr;
 
         BGL_FORALL_OUTEDGES_T( min_object.vertex, current_edge, graph, NetworkGraph ) {
             vis.examine_edge( current_edge, graph );
@@ -125,7 +181,7 @@ void combined_ls_algorithm_no_init(
                 const TransportMode& mode = modes[i];
 
                 // if this mode is not allowed on the current edge, skip it
-                if ( ! (current_edge.traffic_rules() & mode.traffic_rules() ) ) {
+                if ( ! (current_edge.traffic_rules( underlying_graph( graph ) ) & modes.traffic_rules( i ) ) ) {
                     vis.edge_not_relaxed( current_edge, mode.db_id(), graph );
                     continue;
                 }
@@ -147,7 +203,7 @@ void combined_ls_algorithm_no_init(
                     initial_shift_time = min_vd.shift_time();
                     // will update final_trip_id and wait_time
                     double travel_time = cost_calculator.travel_time( current_edge,
-                                                                      mode.db_id(),
+                                                                      mode,
                                                                       min_pi,
                                                                       initial_shift_time,
                                                                       final_shift_time,
@@ -156,7 +212,7 @@ void combined_ls_algorithm_no_init(
                                                                       wait_time );
                     cost += travel_time;
                     if ( ( cost < std::numeric_limits<double>::max() ) && ( s != min_object.state ) ) {
-                        cost += penalty( automaton.automaton_graph_, s, mode.traffic_rules() ) ;
+                        cost += penalty( automaton.automaton_graph_, s, modes.traffic_rules( i ) ) ;
                     }
                 }
 
@@ -170,7 +226,7 @@ void combined_ls_algorithm_no_init(
                     new_vd.set_shift_time( final_shift_time );
                     put( vertex_data_map, new_object, new_vd );
 
-                    vertex_queue.push( new_object ); 
+                    vertex_queue.push( QueueEntry{ min_pi + cost + heuristic( new_object.vertex ), min_pi + cost, new_object } );
                     vis.discover_vertex( new_object, graph );
                 }
                 else {
@@ -189,7 +245,8 @@ template < class Graph,
            class Object, 
            class VertexDataMap,
            class Visitor,
-           class CostCalculator>
+           class CostCalculator,
+           class Heuristic = NullHeuristic>
 void combined_ls_algorithm_no_init(
                                    const Graph& graph,
                                    std::vector<Object> sources,
@@ -197,43 +254,48 @@ void combined_ls_algorithm_no_init(
                                    CostCalculator cost_calculator, 
                                    const std::vector<db_id_t>& request_allowed_modes,
                                    Visitor vis,
-                                   std::function<double (const Multimodal::Vertex&)> heuristic = NullHeuristic() )
+                                   Heuristic heuristic = Heuristic() )
 {
     using VertexData = typename boost::property_traits<VertexDataMap>::value_type;
 
     static_assert( std::is_same<typename boost::property_traits<VertexDataMap>::key_type, Object>::value, "The key type of the vertex data map must be the same as the type of the source" );
 
-    typedef HeuristicCompare<Object, VertexDataMap, std::function<double (const Multimodal::Vertex&)> > Cmp;
-    Cmp cmp( vertex_data_map, heuristic );
-
-    typedef boost::heap::d_ary_heap< Object, boost::heap::arity<4>, boost::heap::compare< Cmp >, boost::heap::mutable_<true> > VertexQueue;
-    VertexQueue vertex_queue( cmp );
+    typedef HeuristicQueueEntry<Object> QueueEntry;
+    typedef boost::heap::d_ary_heap< QueueEntry, boost::heap::arity<4> > VertexQueue;
+    VertexQueue vertex_queue;
     for ( const auto& s: sources ) {
-        vertex_queue.push( s ); 
+        const double pi = get( vertex_data_map, s ).potential();
+        vertex_queue.push( QueueEntry{ pi + heuristic( s.vertex ), pi, s } );
         vis.discover_vertex( s, graph );
     }
 
     Object min_object; 
 
     // get transport mode objet for each allowed mode
-    std::vector<TransportMode> modes;
-    for ( size_t i = 0; i < request_allowed_modes.size(); i++ )
-    {
-        boost::optional<TransportMode> mode = graph.transport_mode( request_allowed_modes[i] );
-        BOOST_ASSERT( mode );
-        modes.push_back( *mode );
-    }
+    const RequestTransportModes modes( graph, request_allowed_modes );
 
     while ( !vertex_queue.empty() ) {
-        min_object = vertex_queue.top();
-        vis.examine_vertex( min_object, graph );
+        const double queued_pi = vertex_queue.top().potential;
+        min_object = vertex_queue.top().object;
         vertex_queue.pop();
 
-        const VertexData& min_vd = get( vertex_data_map, min_object );
+        // copied, inserting labels may move the others
+        const VertexData min_vd = get( vertex_data_map, min_object );
         double min_pi = min_vd.potential();
+        if ( queued_pi > min_pi ) {
+            // the object has been pushed again since, with a lower potential
+            continue;
+        }
+        vis.examine_vertex( min_object, graph );
         db_id_t initial_trip_id = min_vd.trip();
-			
-        const TransportMode& initial_mode = *graph.transport_mode( min_object.mode );
+
+        boost::optional<TransportMode> other_mode;
+        const TransportMode* initial_mode_ptr = modes.find( min_object.mode );
+        if ( !initial_mode_ptr ) {
+            other_mode = graph.transport_mode( min_object.mode );
+            initial_mode_ptr = &other_mode.get();
+        }
+        const TransportMode& initial_mode = *initial_mode_ptr;
 
         BGL_FORALL_OUTEDGES_T( min_object.vertex, current_edge, graph, Graph ) {
             vis.examine_edge( current_edge, graph );
@@ -246,7 +308,7 @@ void combined_ls_algorithm_no_init(
                 const TransportMode& mode = modes[i];
 
                 // if this mode is not allowed on the current edge, skip it
-                if ( ! (current_edge.traffic_rules() & mode.traffic_rules() ) ) {
+                if ( ! (current_edge.traffic_rules( underlying_graph( graph ) ) & modes.traffic_rules( i ) ) ) {
                     vis.edge_not_relaxed( current_edge, mode.db_id(), graph );
                     continue;
                 }
@@ -268,7 +330,7 @@ void combined_ls_algorithm_no_init(
                     initial_shift_time = min_vd.shift_time();
                     // will update final_trip_id and wait_time
                     double travel_time = cost_calculator.travel_time( current_edge,
-                                                                      mode.db_id(),
+                                                                      mode,
                                                                       min_pi,
                                                                       initial_shift_time,
                                                                       final_shift_time,
@@ -288,7 +350,7 @@ void combined_ls_algorithm_no_init(
                     new_vd.set_shift_time( final_shift_time );
                     put( vertex_data_map, new_object, new_vd );
 
-                    vertex_queue.push( new_object ); 
+                    vertex_queue.push( QueueEntry{ min_pi + cost + heuristic( new_object.vertex ), min_pi + cost, new_object } );
                     vis.discover_vertex( new_object, graph );
                 }
                 else {
@@ -301,4 +363,104 @@ void combined_ls_algorithm_no_init(
     }
 }
 
+///
+/// Travel time from an origin to a destination of a road graph, as a function of the departure time (profile search).
+///
+/// Labels are travel time functions from the origin, extended by linking the functions of the edges.
+/// Vertices are scanned by increasing lower bound of their label, and scanned again when their label is improved.
+/// The search stops when this lower bound exceeds the upper bound of the destination label.
+/// @param edge_function Functor ( const Road::Edge&, TravelTimeFunction& ) -> bool that sets the travel time function
+/// of an edge, or returns false if the edge can't be used
+/// @param iterations If not null, set to the number of scanned vertices
+/// @returns the travel time function of the destination, empty if it can't be reached
+template <class EdgeFunction>
+TravelTimeFunction road_travel_time_profile( const Road::Graph& road_graph, Road::Vertex origin, Road::Vertex destination,
+                                             EdgeFunction edge_function, size_t* iterations = nullptr )
+{
+    std::vector<TravelTimeFunction> labels( num_vertices( road_graph ) );
+    // whether a vertex has been improved since its last scan
+    std::vector<bool> improved( num_vertices( road_graph ), false );
+    typedef std::pair<double, Road::Vertex> QueueEntry;
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> queue;
+
+    labels[origin] = TravelTimeFunction( 0.0 );
+    improved[origin] = true;
+    queue.push( QueueEntry( 0.0, origin ) );
+    size_t n_iterations = 0;
+    TravelTimeFunction edge_tt;
+    while ( !queue.empty() ) {
+        const Road::Vertex u = queue.top().second;
+        const double bound = queue.top().first;
+        queue.pop();
+        if ( !labels[destination].empty() && bound >= labels[destination].max() ) {
+            // any other path is slower at any time
+            break;
+        }
+        if ( !improved[u] ) {
+            continue;
+        }
+        improved[u] = false;
+        n_iterations++;
+
+        Road::OutEdgeIterator ei, ei_end;
+        for ( boost::tie( ei, ei_end ) = out_edges( u, road_graph ); ei != ei_end; ei++ ) {
+            if ( !edge_function( *ei, edge_tt ) ) {
+                continue;
+            }
+            const Road::Vertex w = target( *ei, road_graph );
+            if ( !labels[destination].empty() && labels[u].min() + edge_tt.min() >= labels[destination].max() ) {
+                continue;
+            }
+            TravelTimeFunction f = labels[u].link( edge_tt );
+            if ( labels[w].empty() ) {
+                labels[w] = std::move( f );
+            }
+            else {
+                bool improves;
+                TravelTimeFunction merged = labels[w].merge( f, &improves );
+                if ( !improves ) {
+                    continue;
+                }
+                labels[w] = std::move( merged );
+            }
+            improved[w] = true;
+            queue.push( QueueEntry( labels[w].min(), w ) );
+        }
+    }
+    if ( iterations ) {
+        *iterations = n_iterations;
+    }
+    return labels[destination];
+}
+
+///
+/// Travel time profile of a road transport mode, with the travel times of road_travel_time():
+/// edges without speed profile are traveled at their average speed.
+/// @param profile Speed profiles, or null
+/// @param iterations If not null, set to the number of scanned vertices
+/// @returns the breakpoints of the travel time function, empty if the destination can't be reached
+inline TravelTimeProfile road_travel_time_profile( const Road::Graph& road_graph, Road::Vertex origin, Road::Vertex destination,
+                                                   const TransportMode& mode, const RoadEdgeSpeedProfile* profile,
+                                                   double walking_speed, double cycling_speed, size_t* iterations = nullptr )
+{
+    auto edge_function = [&]( const Road::Edge& e, TravelTimeFunction& f ) {
+        if ( (road_graph[e].traffic_rules() & mode.traffic_rules()) == 0 ) {
+            return false;
+        }
+        const double length = road_graph[e].length();
+        if ( !profile || !profile->travel_time_function( e, mode.speed_rule(), length, f ) ) {
+            f = TravelTimeFunction( avg_road_travel_time( road_graph, e, length, mode, walking_speed, cycling_speed ) );
+        }
+        return true;
+    };
+    const TravelTimeFunction f = road_travel_time_profile( road_graph, origin, destination, edge_function, iterations );
+
+    TravelTimeProfile r;
+    r.reserve( f.points().size() );
+    for ( const TravelTimeFunction::Point& p : f.points() ) {
+        r.push_back( TravelTimeProfileValue( p.time, p.travel_time ) );
+    }
+    return r;
+}
+
 }// end namespace
@@ -61,22 +61,9 @@ double road_travel_time( const RoadGraph& road_graph, const Road::Edge& road_e,
     if ( (road_graph[ road_e ].traffic_rules() & mode.traffic_rules()) == 0 ) { // Not allowed mode 
         return std::numeric_limits<double>::infinity() ;
     }
-    if (profile) {
-        RoadEdgeSpeedProfile::PeriodIterator it, it_end;
-        bool found = false;
-        boost::tie(it, it_end) = profile->periods_after( road_graph[road_e].db_id(), mode.speed_rule(), time, found );
-        if ( found ) {
-            double t_end, t_begin, speed = 50000.0/60.0;
-            t_begin = time;
-            while ( (it != it_end) && (length > 0) ) {
-                speed = it->second.speed * 1000.0 / 60.0; // km/h -> m/min
-                t_end = it->first + it->second.length;
-                length -= speed * (t_end - t_begin);
-                t_begin = t_end;
-                it++;
-            }
-            return t_begin + (length / speed) - time;
-        }
+    double tt;
+    if ( profile && profile->travel_time( road_e, mode.speed_rule(), length, time, tt ) ) {
+        return tt;
     }
     return avg_road_travel_time( road_graph, road_e, length, mode, walking_speed, cycling_speed );
 }
@@ -105,9 +92,19 @@ struct FrequencyData {
     double travel_time; 
 };
 	
-// transport_mode -> Edge -> departure_time -> Timetable
-typedef std::map<int, std::map<PublicTransport::Edge, std::map<double, TimetableData> > > TimetableMap; 
-typedef std::map<int, std::map<PublicTransport::Edge, std::map<double, FrequencyData> > > FrequencyMap;
+///
+/// Public transport edge in timetable maps.
+/// Edge indices are only unique within a public transport graph, the index of the graph is part of the key
+typedef std::pair<PublicTransportGraphIndex, uint32_t> PublicTransportEdgeKey;
+
+inline PublicTransportEdgeKey public_transport_edge_key( PublicTransportGraphIndex graph_idx, const PublicTransport::Edge& e )
+{
+    return PublicTransportEdgeKey( graph_idx, uint32_t( e.idx ) );
+}
+
+// transport_mode -> (public transport graph, edge) -> departure_time -> Timetable
+typedef std::map<int, std::map<PublicTransportEdgeKey, std::map<double, TimetableData> > > TimetableMap; 
+typedef std::map<int, std::map<PublicTransportEdgeKey, std::map<double, FrequencyData> > > FrequencyMap;
 
 //
 // Functor used by travel_time() for public transport edges, using internal timetables attached to the multimodal graph
@@ -123,6 +120,19 @@ struct pt2pt_time_internal_timetable_t
     const Graph& graph_;
     const Date& start_day_;
     double min_transfer_time_;
+    // public transport graph index -> services available on the start day, computed on first use
+    mutable std::vector<boost::optional<PublicTransport::ActiveServices>> active_services_;
+
+    const PublicTransport::ActiveServices& active_services( PublicTransportGraphIndex idx, const PublicTransport::Graph& pt_graph ) const
+    {
+        if ( idx >= active_services_.size() ) {
+            active_services_.resize( idx + 1 );
+        }
+        if ( ! active_services_[idx] ) {
+            active_services_[idx] = get_property( pt_graph ).service_map().active_services( start_day_ );
+        }
+        return *active_services_[idx];
+    }
 
     double operator()( const Multimodal::Edge& e,
                        const PublicTransport::Edge& pt_e,
@@ -136,8 +146,9 @@ struct pt2pt_time_internal_timetable_t
     {
         if ( ! is_graph_reversed<Graph>::value ) {
             // Timetable travel time calculation
-            const PublicTransport::Graph& pt_graph = *( e.source().pt_graph() );
-            auto trip_time = next_departure( pt_graph, pt_e, start_day_, initial_time );
+            const PublicTransport::Graph& pt_graph = *( e.source().pt_graph( underlying_graph( graph_ ) ) );
+            const PublicTransport::ActiveServices& services = active_services( e.source().pt_graph_idx(), pt_graph );
+            auto trip_time = next_departure( pt_graph, pt_e, services, initial_time );
             if ( ! trip_time ) {
                 return std::numeric_limits<double>::max();
             }
@@ -149,7 +160,7 @@ struct pt2pt_time_internal_timetable_t
             }
             // Else, no connection without transfer found, or first step
             // Look for a service after transfer_time
-            auto trip_time2 = next_departure( pt_graph, pt_e, start_day_, initial_time + min_transfer_time_ );
+            auto trip_time2 = next_departure( pt_graph, pt_e, services, initial_time + min_transfer_time_ );
             if ( trip_time2 ) {
                 final_trip_id = trip_time2->trip_id();
                 wait_time = trip_time2->departure_time() - initial_time;
@@ -186,7 +197,7 @@ struct pt2pt_time_external_timetable_t
     const FrequencyMap& frequency_; 
     const FrequencyMap& rfrequency_; 
 
-    double operator()( const Multimodal::Edge& /*e*/,
+    double operator()( const Multimodal::Edge& e,
                        const PublicTransport::Edge& pt_e,
                        db_id_t mode_id,
                        double initial_time,
@@ -196,12 +207,13 @@ struct pt2pt_time_external_timetable_t
                        db_id_t& final_trip_id,
                        double& wait_time ) const
     {
+        const PublicTransportEdgeKey pt_key = public_transport_edge_key( e.source().pt_graph_idx(), pt_e );
         if ( ! is_graph_reversed<Graph>::value ) {
             // Timetable travel time calculation
             auto pt_e_it = timetable_.find( mode_id );
             if ( pt_e_it != timetable_.end() ) {
                 // look for timetable of the given edge
-                auto mit = pt_e_it->second.find( pt_e );
+                auto mit = pt_e_it->second.find( pt_key );
                 if ( mit == pt_e_it->second.end() ) { // no timetable for this mode
                     return std::numeric_limits<double>::max(); 
                 }
@@ -229,7 +241,7 @@ struct pt2pt_time_external_timetable_t
             }
             else if (frequency_.find( mode_id ) != frequency_.end() ) {
                 auto pt_re_it = frequency_.find( mode_id );
-                auto mit = pt_re_it->second.find( pt_e );
+                auto mit = pt_re_it->second.find( pt_key );
                 if ( mit == pt_re_it->second.end() ) { // no timetable for this mode and edge
                     return std::numeric_limits<double>::max(); 
                 }
@@ -265,7 +277,7 @@ struct pt2pt_time_external_timetable_t
             auto pt_e_it = rtimetable_.find( mode_id );
             if ( pt_e_it != rtimetable_.end() ) {
                 // look for timetable of the given edge
-                auto mit = pt_e_it->second.find( pt_e );
+                auto mit = pt_e_it->second.find( pt_key );
                 if ( mit == pt_e_it->second.end() ) { // no timetable for this mode and edge
                     return std::numeric_limits<double>::max(); 
                 }
@@ -285,7 +297,7 @@ struct pt2pt_time_external_timetable_t
             else if ( rfrequency_.find( mode_id ) != rfrequency_.end() ) {
                 double rinitial_time = -initial_time - initial_shift_time;
                 auto pt_re_it = rfrequency_.find( mode_id );
-                auto mit = pt_re_it->second.find( pt_e );
+                auto mit = pt_re_it->second.find( pt_key );
                 if ( mit == pt_re_it->second.end() ) { // no timetable for this mode
                     return std::numeric_limits<double>::max(); 
                 }
@@ -341,6 +353,19 @@ public:
 		
     // Multimodal travel time function
     double travel_time( const Multimodal::Edge& e, db_id_t mode_id, double initial_time, double initial_shift_time, double& final_shift_time, db_id_t initial_trip_id, db_id_t& final_trip_id, double& wait_time ) const
+    {
+        if ( std::find(allowed_transport_modes_.begin(), allowed_transport_modes_.end(), mode_id) == allowed_transport_modes_.end() ) {
+            final_trip_id = 0;
+            final_shift_time = initial_shift_time;
+            wait_time = 0.0;
+            return std::numeric_limits<double>::max();
+        }
+        const TransportMode mode = graph_.transport_mode( mode_id ).get();
+        return travel_time( e, mode, initial_time, initial_shift_time, final_shift_time, initial_trip_id, final_trip_id, wait_time );
+    }
+
+    // Multimodal travel time function, for a mode known to be allowed
+    double travel_time( const Multimodal::Edge& e, const TransportMode& mode, double initial_time, double initial_shift_time, double& final_shift_time, db_id_t initial_trip_id, db_id_t& final_trip_id, double& wait_time ) const
     {
         // default (for non-PT edges)
         final_trip_id = 0;
@@ -348,110 +373,109 @@ public:
         final_shift_time = initial_shift_time;
         wait_time = 0.0;
 
-        const TransportMode& mode = graph_.transport_modes().find( mode_id )->second;
-        if ( std::find(allowed_transport_modes_.begin(), allowed_transport_modes_.end(), mode_id) != allowed_transport_modes_.end() ) 
-        {
-            switch ( e.connection_type() ) {  
-            case Multimodal::Edge::Road2Road: {
-                double c = road_travel_time( graph_.road(), e.road_edge(), graph_.road()[ e.road_edge() ].length(), initial_time, mode,
-                                             walking_speed_, cycling_speed_, speed_profile_ ); 
-                return c;
-            }
-                break;
+        const db_id_t mode_id = mode.db_id();
+        switch ( e.connection_type() ) {  
+        case Multimodal::Edge::Road2Road: {
+            double c = road_travel_time( graph_.road(), e.road_edge(), graph_.road()[ e.road_edge() ].length(), initial_time, mode,
+                                         walking_speed_, cycling_speed_, speed_profile_ ); 
+            return c;
+        }
+            break;
 		
-            case Multimodal::Edge::Road2Transport: {
-                double add_cost = 0.0;
-                if ( is_graph_reversed<Graph>::value ) {
-                    if ( initial_trip_id != 0 ) {
-                        // we are "coming" from a Transport2Transport
-                        wait_time = min_transfer_time_;
-                        add_cost = min_transfer_time_;
-                    }
+        case Multimodal::Edge::Road2Transport: {
+            double add_cost = 0.0;
+            if ( is_graph_reversed<Graph>::value ) {
+                if ( initial_trip_id != 0 ) {
+                    // we are "coming" from a Transport2Transport
+                    wait_time = min_transfer_time_;
+                    add_cost = min_transfer_time_;
                 }
+            }
 
-                // find the road section where the stop is attached to
-                const PublicTransport::Graph& pt_graph = *( e.target().pt_graph() );
-                double abscissa = pt_graph[ e.target().pt_vertex() ].abscissa_road_section();
-                Road::Edge road_e = pt_graph[ e.target().pt_vertex() ].road_edge();
+            // find the road section where the stop is attached to
+            const PublicTransport::Graph& pt_graph = *( e.target().pt_graph( underlying_graph( graph_ ) ) );
+            double abscissa = pt_graph[ e.target().pt_vertex() ].abscissa_road_section();
+            Road::Edge road_e = pt_graph[ e.target().pt_vertex() ].road_edge();
 						
-                // if we are coming from the start point of the road
-                if ( source( road_e, graph_.road() ) == e.source().road_vertex() ) {
-                    return road_travel_time( graph_.road(), road_e, graph_.road()[ road_e ].length() * abscissa, initial_time, mode,
-                                             walking_speed_, cycling_speed_, speed_profile_ ) + PT_STATION_PENALTY + add_cost;
-                }
-                // otherwise, that is the opposite direction
-                else {
-                    return road_travel_time( graph_.road(), road_e, graph_.road()[ road_e ].length() * (1 - abscissa), initial_time, mode,
-                                             walking_speed_, cycling_speed_, speed_profile_ ) + PT_STATION_PENALTY + add_cost;
-                }
+            // if we are coming from the start point of the road
+            if ( source( road_e, graph_.road() ) == e.source().road_vertex() ) {
+                return road_travel_time( graph_.road(), road_e, graph_.road()[ road_e ].length() * abscissa, initial_time, mode,
+                                         walking_speed_, cycling_speed_, speed_profile_ ) + PT_STATION_PENALTY + add_cost;
             }
-                break; 
+            // otherwise, that is the opposite direction
+            else {
+                return road_travel_time( graph_.road(), road_e, graph_.road()[ road_e ].length() * (1 - abscissa), initial_time, mode,
+                                         walking_speed_, cycling_speed_, speed_profile_ ) + PT_STATION_PENALTY + add_cost;
+            }
+        }
+            break; 
 					
-            case Multimodal::Edge::Transport2Road: {
-                // find the road section where the stop is attached to
-                const PublicTransport::Graph& pt_graph = *( e.source().pt_graph() );
-                double abscissa = pt_graph[ e.source().pt_vertex() ].abscissa_road_section();
-                Road::Edge road_e = pt_graph[ e.source().pt_vertex() ].road_edge();
+        case Multimodal::Edge::Transport2Road: {
+            // find the road section where the stop is attached to
+            const PublicTransport::Graph& pt_graph = *( e.source().pt_graph( underlying_graph( graph_ ) ) );
+            double abscissa = pt_graph[ e.source().pt_vertex() ].abscissa_road_section();
+            Road::Edge road_e = pt_graph[ e.source().pt_vertex() ].road_edge();
 						
-                // if we are coming from the start point of the road
-                if ( target( road_e, graph_.road() ) == e.target().road_vertex() ) {
-                    return road_travel_time( graph_.road(), road_e, graph_.road()[ road_e ].length() * (1 - abscissa), initial_time, mode,
-                                             walking_speed_, cycling_speed_, speed_profile_ ) + PT_STATION_PENALTY;
-                }
-                // otherwise, that is the opposite direction
-                else {
-                    return road_travel_time( graph_.road(), road_e, graph_.road()[ road_e ].length() * abscissa, initial_time, mode,
-                                             walking_speed_, cycling_speed_, speed_profile_ ) + PT_STATION_PENALTY;
-                }
-            } 
-                break;
+            // if we are coming from the start point of the road
+            if ( target( road_e, graph_.road() ) == e.target().road_vertex() ) {
+                return road_travel_time( graph_.road(), road_e, graph_.road()[ road_e ].length() * (1 - abscissa), initial_time, mode,
+                                         walking_speed_, cycling_speed_, speed_profile_ ) + PT_STATION_PENALTY;
+            }
+            // otherwise, that is the opposite direction
+            else {
+                return road_travel_time( graph_.road(), road_e, graph_.road()[ road_e ].length() * abscissa, initial_time, mode,
+                                         walking_speed_, cycling_speed_, speed_profile_ ) + PT_STATION_PENALTY;
+            }
+        } 
+            break;
 					
-            case Multimodal::Edge::Transport2Transport: { 
-                PublicTransport::Edge pt_e;
-                bool found = false;
-                boost::tie( pt_e, found ) = public_transport_edge( e );
-                BOOST_ASSERT(found);
+        case Multimodal::Edge::Transport2Transport: { 
+            PublicTransport::Edge pt_e;
+            bool found = false;
+            boost::tie( pt_e, found ) = public_transport_edge( e, underlying_graph( graph_ ) );
+            BOOST_ASSERT(found);
 
-                return pt2pt_foo_( e, pt_e, mode_id, initial_time, initial_shift_time, final_shift_time, initial_trip_id, final_trip_id, wait_time );
-            }
-                break; 
+            return pt2pt_foo_( e, pt_e, mode_id, initial_time, initial_shift_time, final_shift_time, initial_trip_id, final_trip_id, wait_time );
+        }
+            break; 
 					
-            case Multimodal::Edge::Road2Poi: {
-                Road::Edge road_e = e.target().poi()->road_edge();
-                double abscissa = e.target().poi()->abscissa_road_section();
-
-                // if we are coming from the start point of the road
-                if ( source( road_e, graph_.road() ) == e.source().road_vertex() ) {
-                    return road_travel_time( graph_.road(), road_e, graph_.road()[ road_e ].length() * abscissa, initial_time, mode,
-                                             walking_speed_, cycling_speed_, speed_profile_ ) + POI_STATION_PENALTY;
-                }
-                // otherwise, that is the opposite direction
-                else {
-                    return road_travel_time( graph_.road(), road_e, graph_.road()[ road_e ].length() * (1 - abscissa), initial_time, mode,
-                                             walking_speed_, cycling_speed_, speed_profile_ ) + POI_STATION_PENALTY;
-                }
+        case Multimodal::Edge::Road2Poi: {
+            const POI& poi = *e.target().poi( underlying_graph( graph_ ) );
+            Road::Edge road_e = poi.road_edge();
+            double abscissa = poi.abscissa_road_section();
+
+            // if we are coming from the start point of the road
+            if ( source( road_e, graph_.road() ) == e.source().road_vertex() ) {
+                return road_travel_time( graph_.road(), road_e, graph_.road()[ road_e ].length() * abscissa, initial_time, mode,
+                                         walking_speed_, cycling_speed_, speed_profile_ ) + POI_STATION_PENALTY;
             }
-                break;
-            case Multimodal::Edge::Poi2Road: {
-                Road::Edge road_e = e.source().poi()->road_edge();
-                double abscissa = e.source().poi()->abscissa_road_section();
-
-                // if we are coming from the start point of the road
-                if ( source( road_e, graph_.road() ) == e.source().road_vertex() ) {
-                    return road_travel_time( graph_.road(), road_e, graph_.road()[ road_e ].length() * abscissa, initial_time, mode,
-                                             walking_speed_, cycling_speed_, speed_profile_ ) + POI_STATION_PENALTY;
-                }
-                // otherwise, that is the opposite direction
-                else {
-                    return road_travel_time( graph_.road(), road_e, graph_.road()[ road_e ].length() * (1 - abscissa), initial_time, mode,
-                                             walking_speed_, cycling_speed_, speed_profile_ ) + POI_STATION_PENALTY;
-                }
+            // otherwise, that is the opposite direction
+            else {
+                return road_travel_time( graph_.road(), road_e, graph_.road()[ road_e ].length() * (1 - abscissa), initial_time, mode,
+                                         walking_speed_, cycling_speed_, speed_profile_ ) + POI_STATION_PENALTY;
             }
-                break;
-            default: {
-						
+        }
+            break;
+        case Multimodal::Edge::Poi2Road: {
+            const POI& poi = *e.source().poi( underlying_graph( graph_ ) );
+            Road::Edge road_e = poi.road_edge();
+            double abscissa = poi.abscissa_road_section();
+
+            // if we are coming from the start point of the road
+            if ( source( road_e, graph_.road() ) == e.source().road_vertex() ) {
+                return road_travel_time( graph_.road(), road_e, graph_.road()[ road_e ].length() * abscissa, initial_time, mode,
+                                         walking_speed_, cycling_speed_, speed_profile_ ) + POI_STATION_PENALTY;
             }
+            // otherwise, that is the opposite direction
+            else {
+                return road_travel_time( graph_.road(), road_e, graph_.road()[ road_e ].length() * (1 - abscissa), initial_time, mode,
+                                         walking_speed_, cycling_speed_, speed_profile_ ) + POI_STATION_PENALTY;
             }
+        }
+            break;
+        default: {
+						
+        }
         }
         return std::numeric_limits<double>::max(); 
     }
@@ -473,7 +497,7 @@ public:
 
         // park shared vehicle
         if ( ( transf_t < std::numeric_limits<double>::max() ) && initial_mode.must_be_returned() ) {
-            if (( tgt.type() == Multimodal::Vertex::Poi ) && ( tgt.poi()->has_parking_transport_mode( initial_mode.db_id() ) )) {
+            if (( tgt.type() == Multimodal::Vertex::Poi ) && ( tgt.poi( underlying_graph( graph_ ) )->has_parking_transport_mode( initial_mode.db_id() ) )) {
                 // FIXME replace 1 by time to park a shared vehicle
                 transf_t += 1;
             }
@@ -483,7 +507,7 @@ public:
         }
         // Parking search time for initial mode
         else if ( ( transf_t < std::numeric_limits<double>::max() ) && initial_mode.need_parking() ) {
-            if ( (tgt.type() == Multimodal::Vertex::Poi ) && ( tgt.poi()->has_parking_transport_mode( initial_mode.db_id() ) ) ) {
+            if ( (tgt.type() == Multimodal::Vertex::Poi ) && ( tgt.poi( underlying_graph( graph_ ) )->has_parking_transport_mode( initial_mode.db_id() ) ) ) {
                 // FIXME more complex than that
                 if (initial_mode.traffic_rules() & TrafficRuleCar ) 
                     transf_t += car_parking_search_time_ ; // Personal car
@@ -508,7 +532,7 @@ public:
 
         // take a shared vehicle from a POI
         if ( ( transf_t < std::numeric_limits<double>::max() ) && final_mode.is_shared() ) {
-            if (( src.type() == Multimodal::Vertex::Poi ) && ( src.poi()->has_parking_transport_mode( final_mode.db_id() ) )) {
+            if (( src.type() == Multimodal::Vertex::Poi ) && ( src.poi( underlying_graph( graph_ ) )->has_parking_transport_mode( final_mode.db_id() ) )) {
                 // FIXME replace 1 by time to take a shared vehicle
                 transf_t += 1;
             }
@@ -518,7 +542,7 @@ public:
         }
         // Taking vehicle time for final mode 
         else if ( ( transf_t < std::numeric_limits<double>::max() ) && ( final_mode.need_parking() ) ) {
-            if (( src.type() == Multimodal::Vertex::Poi ) && final_mode.is_shared() && ( src.poi()->has_parking_transport_mode( final_mode.db_id() ) )) {
+            if (( src.type() == Multimodal::Vertex::Poi ) && final_mode.is_shared() && ( src.poi( underlying_graph( graph_ ) )->has_parking_transport_mode( final_mode.db_id() ) )) {
                 // shared vehicles parked on a POI
                 transf_t += 1;
             }
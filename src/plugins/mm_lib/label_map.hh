@@ -0,0 +1,177 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef TEMPUS_MM_LABEL_MAP_HH
+#define TEMPUS_MM_LABEL_MAP_HH
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+#include "multimodal_graph.hh"
+
+namespace Tempus {
+
+///
+/// Labels of a multimodal search, stored in flat arrays.
+///
+/// Keys are objects with a Multimodal::Vertex "vertex" member and a transport mode "mode" member,
+/// and possibly other members, like the automaton state of dynamic_multi_plugin. A dense index over
+/// (vertex index, mode slot) gives the first label of a vertex and a mode. Labels of the same vertex
+/// and mode that differ by other members are chained, there are only a few of them.
+///
+/// It can be used like a std::map in an associative property map: labels are iterated as (key, value)
+/// pairs, in insertion order. Inserting a label may invalidate references to the other ones.
+///
+/// reset() only increments a stamp, the index is kept from one search to another. It is sized
+/// for the largest number of transport modes seen so far, so that requests with fewer modes reuse it.
+template <class Key, class Value>
+class MultimodalLabelMap
+{
+public:
+    typedef Key key_type;
+    typedef std::pair<Key, Value> value_type;
+    typedef typename std::vector<value_type>::iterator iterator;
+    typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+    MultimodalLabelMap() : graph_( nullptr ), n_mode_slots_( 0 ), current_stamp_( 0 ) {}
+
+    ///
+    /// Start a new search on a graph, where labels may only have the given transport modes.
+    /// The frozen adjacency of the graph has to be built
+    void reset( const Multimodal::Graph& graph, const std::vector<db_id_t>& modes )
+    {
+        graph_ = &graph;
+        std::fill( mode_slot_.begin(), mode_slot_.end(), NONE );
+        for ( size_t i = 0; i < modes.size(); i++ ) {
+            if ( size_t( modes[i] ) >= mode_slot_.size() ) {
+                mode_slot_.resize( size_t( modes[i] ) + 1, NONE );
+            }
+            mode_slot_[modes[i]] = uint32_t( i );
+        }
+
+        const size_t n_slots = std::max( n_mode_slots_, modes.size() );
+        const size_t n = graph.adjacency_size() * n_slots;
+        if ( heads_.size() != n ) {
+            n_mode_slots_ = n_slots;
+            heads_.assign( n, Head() );
+            current_stamp_ = 0;
+        }
+        current_stamp_++;
+        if ( current_stamp_ == 0 ) {
+            // stamp overflow, every head must be invalidated
+            std::fill( heads_.begin(), heads_.end(), Head() );
+            current_stamp_ = 1;
+        }
+        labels_.clear();
+        next_.clear();
+    }
+
+    iterator find( const Key& k )
+    {
+        const uint32_t i = find_index( k );
+        return i == NONE ? labels_.end() : labels_.begin() + i;
+    }
+
+    const_iterator find( const Key& k ) const
+    {
+        const uint32_t i = find_index( k );
+        return i == NONE ? labels_.end() : labels_.begin() + i;
+    }
+
+    ///
+    /// Label of a key, a default one is inserted if it does not exist
+    Value& operator[]( const Key& k )
+    {
+        Head& h = heads_[head_index( k )];
+        if ( h.stamp != current_stamp_ ) {
+            h.stamp = current_stamp_;
+            h.first = NONE;
+        }
+        for ( uint32_t i = h.first; i != NONE; i = next_[i] ) {
+            if ( labels_[i].first == k ) {
+                return labels_[i].second;
+            }
+        }
+        next_.push_back( h.first );
+        h.first = uint32_t( labels_.size() );
+        labels_.push_back( value_type( k, Value() ) );
+        return labels_.back().second;
+    }
+
+    iterator begin() { return labels_.begin(); }
+    iterator end() { return labels_.end(); }
+    const_iterator begin() const { return labels_.begin(); }
+    const_iterator end() const { return labels_.end(); }
+    const_iterator cbegin() const { return labels_.begin(); }
+    const_iterator cend() const { return labels_.end(); }
+
+    size_t size() const { return labels_.size(); }
+    bool empty() const { return labels_.empty(); }
+
+private:
+    static const uint32_t NONE = uint32_t(-1);
+
+    size_t head_index( const Key& k ) const
+    {
+        BOOST_ASSERT( size_t( k.mode ) < mode_slot_.size() && mode_slot_[k.mode] != NONE );
+        return graph_->adjacency_index( k.vertex ) * n_mode_slots_ + mode_slot_[k.mode];
+    }
+
+    uint32_t find_index( const Key& k ) const
+    {
+        const Head& h = heads_[head_index( k )];
+        if ( h.stamp != current_stamp_ ) {
+            return NONE;
+        }
+        for ( uint32_t i = h.first; i != NONE; i = next_[i] ) {
+            if ( labels_[i].first == k ) {
+                return i;
+            }
+        }
+        return NONE;
+    }
+
+    struct Head
+    {
+        Head() : stamp( 0 ), first( NONE ) {}
+        uint32_t stamp;
+        // first label of the chain
+        uint32_t first;
+    };
+
+    const Multimodal::Graph* graph_;
+    // transport mode id -> slot
+    std::vector<uint32_t> mode_slot_;
+    // number of slots per vertex in the index
+    size_t n_mode_slots_;
+
+    std::vector<Head> heads_;
+    uint32_t current_stamp_;
+
+    std::vector<value_type> labels_;
+    // next label of the same chain
+    std::vector<uint32_t> next_;
+};
+
+template <class Key, class Value>
+const uint32_t MultimodalLabelMap<Key, Value>::NONE;
+
+} // namespace Tempus
+
+#endif
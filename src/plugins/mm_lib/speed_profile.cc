@@ -17,42 +17,138 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <algorithm>
+#include <unordered_map>
+
 #include "speed_profile.hh"
 
 namespace Tempus {
 
 void RoadEdgeSpeedProfile::add_period( db_id_t section_id, TransportModeSpeedRule speed_rule, double begin_time, double length, double speed )
 {
-    bool found = false;
-    RoadEdgeSpeedProfileMap::iterator it;
-    boost::tie(it, found) = speed_profile_.insert( std::make_pair(section_id, SpeedProfile()) );
-    SpeedProfile::iterator sit;
-    boost::tie(sit, found) = it->second.insert( std::make_pair(speed_rule, std::map<double, SpeedTimePeriod>()) );
-    std::map<double, SpeedTimePeriod>::iterator tit;
-    boost::tie(tit, found) = sit->second.insert( std::make_pair(begin_time, SpeedTimePeriod()) );
-    tit->second.length = length;
-    tit->second.speed = speed;
+    pending_.push_back( PendingPeriod{ section_id, speed_rule, begin_time, length, speed } );
 }
 
-std::pair<RoadEdgeSpeedProfile::PeriodIterator, RoadEdgeSpeedProfile::PeriodIterator> RoadEdgeSpeedProfile::periods_after( db_id_t section_id, TransportModeSpeedRule speed_rule, double begin_time, bool& found ) const
+void RoadEdgeSpeedProfile::compile( const Road::Graph& road_graph )
 {
-    RoadEdgeSpeedProfileMap::const_iterator sit = speed_profile_.find( section_id );
-    if ( sit != speed_profile_.end() ) {
-        SpeedProfile::const_iterator it = sit->second.find( speed_rule );
-        if ( it != sit->second.end() ) {
-            std::map<double, SpeedTimePeriod>::const_iterator mit = it->second.upper_bound( begin_time );
-            // we suppose we cover 24h of speed profile
-            if ( mit != it->second.begin() ) {
-                mit--;
-                found = true;
-                return std::make_pair( mit, it->second.end() );
+    std::sort( pending_.begin(), pending_.end(), []( const PendingPeriod& a, const PendingPeriod& b ) {
+            if ( a.speed_rule != b.speed_rule ) {
+                return a.speed_rule < b.speed_rule;
+            }
+            if ( a.section_id != b.section_id ) {
+                return a.section_id < b.section_id;
             }
+            return a.begin_time < b.begin_time;
+        } );
+
+    first_breakpoint_.clear();
+    breakpoints_.clear();
+    const size_t n_edges = num_edges( road_graph );
+    size_t i = 0;
+    while ( i < pending_.size() ) {
+        const TransportModeSpeedRule rule = pending_[i].speed_rule;
+
+        // section id -> range of its periods
+        std::unordered_map<db_id_t, std::pair<size_t, size_t>> sections;
+        for ( ; i < pending_.size() && pending_[i].speed_rule == rule; i++ ) {
+            auto it = sections.insert( std::make_pair( pending_[i].section_id, std::make_pair( i, i ) ) ).first;
+            it->second.second = i + 1;
+        }
+
+        if ( size_t( rule ) >= first_breakpoint_.size() ) {
+            first_breakpoint_.resize( size_t( rule ) + 1 );
+        }
+        std::vector<uint32_t>& first = first_breakpoint_[rule];
+        first.resize( n_edges + 1 );
+        // edges are iterated in index order
+        Road::EdgeIterator eit, eit_end;
+        size_t e_idx = 0;
+        for ( boost::tie( eit, eit_end ) = edges( road_graph ); eit != eit_end; eit++, e_idx++ ) {
+            first[e_idx] = uint32_t( breakpoints_.size() );
+            auto sit = sections.find( road_graph[*eit].db_id() );
+            if ( sit == sections.end() ) {
+                continue;
+            }
+            // the speed of a period applies from the end of the previous one, a gap between
+            // two periods is covered at the speed of the next one
+            double distance = 0.0;
+            double time = pending_[sit->second.first].begin_time;
+            for ( size_t j = sit->second.first; j < sit->second.second; j++ ) {
+                const PendingPeriod& p = pending_[j];
+                if ( j > sit->second.first ) {
+                    const Breakpoint& prev = breakpoints_.back();
+                    const PendingPeriod& prev_period = pending_[j - 1];
+                    time = std::max( prev.time, prev_period.begin_time + prev_period.length );
+                    distance += prev.speed * ( time - prev.time );
+                }
+                breakpoints_.push_back( Breakpoint{ time, p.speed * 1000.0 / 60.0, distance } ); // km/h -> m/min
+            }
+        }
+        first[n_edges] = uint32_t( breakpoints_.size() );
+    }
+    pending_.clear();
+    pending_.shrink_to_fit();
+}
+
+bool RoadEdgeSpeedProfile::travel_time( const Road::Edge& e, TransportModeSpeedRule speed_rule, double length, double time, double& travel_time ) const
+{
+    if ( size_t( speed_rule ) >= first_breakpoint_.size() || first_breakpoint_[speed_rule].empty() ) {
+        return false;
+    }
+    const std::vector<uint32_t>& first = first_breakpoint_[speed_rule];
+    const Breakpoint* begin = breakpoints_.data() + first[e.idx];
+    const Breakpoint* end = breakpoints_.data() + first[e.idx + 1];
+
+    // period at the start time
+    const Breakpoint* it = std::upper_bound( begin, end, time, []( double t, const Breakpoint& b ) { return t < b.time; } );
+    if ( it == begin ) {
+        return false;
+    }
+    it--;
+    const double target = it->distance + it->speed * ( time - it->time ) + length;
+
+    // period at the arrival
+    const Breakpoint* jt = std::upper_bound( it, end, target, []( double d, const Breakpoint& b ) { return d < b.distance; } );
+    jt--;
+    travel_time = jt->time + ( target - jt->distance ) / jt->speed - time;
+    return true;
+}
+
+bool RoadEdgeSpeedProfile::travel_time_function( const Road::Edge& e, TransportModeSpeedRule speed_rule, double length, TravelTimeFunction& f ) const
+{
+    if ( size_t( speed_rule ) >= first_breakpoint_.size() || first_breakpoint_[speed_rule].empty() ) {
+        return false;
+    }
+    const std::vector<uint32_t>& first = first_breakpoint_[speed_rule];
+    const Breakpoint* begin = breakpoints_.data() + first[e.idx];
+    const Breakpoint* end = breakpoints_.data() + first[e.idx + 1];
+    if ( begin == end ) {
+        return false;
+    }
+
+    // the travel time is linear between departures at the beginning of a period
+    // and departures that arrive at the beginning of a period
+    std::vector<double> times;
+    for ( const Breakpoint* it = begin; it != end; it++ ) {
+        times.push_back( it->time );
+        const double target = it->distance - length;
+        if ( target < 0.0 ) {
+            continue;
         }
+        const Breakpoint* jt = std::upper_bound( begin, it + 1, target, []( double d, const Breakpoint& b ) { return d < b.distance; } );
+        jt--;
+        times.push_back( jt->time + ( target - jt->distance ) / jt->speed );
+    }
+    std::sort( times.begin(), times.end() );
+
+    std::vector<TravelTimeFunction::Point> points;
+    for ( double t : times ) {
+        double tt;
+        travel_time( e, speed_rule, length, t, tt );
+        points.push_back( TravelTimeFunction::Point{ t, tt } );
     }
-    
-    found = false;
-    // inconsistent return value
-    return std::make_pair( PeriodIterator(), PeriodIterator() );
+    f = TravelTimeFunction( std::move( points ) );
+    return true;
 }
 
 }
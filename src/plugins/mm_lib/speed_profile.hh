@@ -20,36 +20,76 @@
 #ifndef TEMPUS_SPEED_PROFILE_HH
 #define TEMPUS_SPEED_PROFILE_HH
 
+#include <vector>
+
 #include "road_graph.hh"
 #include "transport_modes.hh"
+#include "travel_time_function.hh"
 
 namespace Tempus {
 
-struct SpeedTimePeriod
-{
-    // length of the period (minutes)
-    double length;
-    // average speed (km/h)
-    double speed;
-};
-
+///
+/// Daily speed profiles of road edges, for each speed rule.
+///
+/// Periods are first added by section database id, then compile() lays them out
+/// in flat arrays indexed by road edge index and speed rule. Periods of an edge
+/// are stored with the distance covered since the beginning of its first period,
+/// so that a travel time is given by two binary searches on a few periods.
 class RoadEdgeSpeedProfile
 {
 public:
     RoadEdgeSpeedProfile() {}
 
-    // speed rule -> time of the day (in minutes) -> SpeedTimePeriod
-    typedef std::map< TransportModeSpeedRule, std::map< double, SpeedTimePeriod > > SpeedProfile;
-    // road edge -> speed profile
-    typedef std::map< db_id_t, SpeedProfile > RoadEdgeSpeedProfileMap;
+    ///
+    /// Add a period to the profile of a road section, must be called before compile()
+    /// @param begin_time beginning of the period, in minutes since midnight
+    /// @param length length of the period, in minutes
+    /// @param speed average speed during the period, in km/h
+    void add_period( db_id_t section_id, TransportModeSpeedRule speed_rule, double begin_time, double length, double speed );
 
-    typedef std::map<double, SpeedTimePeriod>::const_iterator PeriodIterator;
+    ///
+    /// Lay out the added periods by road edge index of the given graph.
+    /// The speed of a period applies from the end of the previous one to its own end, so that a gap
+    /// between two periods is covered at the speed of the next one. The last one extends after its end
+    void compile( const Road::Graph& road_graph );
 
-    std::pair<PeriodIterator, PeriodIterator> periods_after( db_id_t section_id, TransportModeSpeedRule speed_rule, double begin_time, bool& found ) const;
+    ///
+    /// Travel time (in minutes) to cover a length on a road edge, starting at the given time
+    /// @returns false if there is no profile for this edge and speed rule at this time
+    bool travel_time( const Road::Edge& e, TransportModeSpeedRule speed_rule, double length, double time, double& travel_time ) const;
+
+    ///
+    /// Travel time (in minutes) to cover a length on a road edge, as a function of the departure time.
+    /// It equals travel_time() from the beginning of the first period on, and keeps its first value before
+    /// @returns false if there is no profile for this edge and speed rule
+    bool travel_time_function( const Road::Edge& e, TransportModeSpeedRule speed_rule, double length, TravelTimeFunction& f ) const;
 
-    void add_period( db_id_t section_id, TransportModeSpeedRule speed_rule, double begin_time, double length, double speed );
 private:
-    RoadEdgeSpeedProfileMap speed_profile_;
+    struct PendingPeriod
+    {
+        db_id_t section_id;
+        TransportModeSpeedRule speed_rule;
+        double begin_time;
+        double length;
+        double speed;
+    };
+    // periods added, before compile()
+    std::vector<PendingPeriod> pending_;
+
+    struct Breakpoint
+    {
+        // time the speed applies from, in minutes since midnight: the beginning of the first period,
+        // then the end of the previous period
+        double time;
+        // speed, in m/min
+        double speed;
+        // distance covered since the beginning of the first period of the edge, at time
+        double distance;
+    };
+    // speed rule -> first breakpoint of each road edge, by edge index, plus the end
+    // empty when no edge has a profile for this speed rule
+    std::vector<std::vector<uint32_t>> first_breakpoint_;
+    std::vector<Breakpoint> breakpoints_;
 };
 
 } // namespace Tempus
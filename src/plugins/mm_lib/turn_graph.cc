@@ -0,0 +1,116 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "turn_graph.hh"
+#include "cost_calculator.hh"
+#include "automaton_lib/automaton.hh"
+
+#include <algorithm>
+#include <unordered_map>
+#include <map>
+#include <limits>
+#include <stdexcept>
+
+namespace Tempus
+{
+
+namespace
+{
+
+uint64_t pair_key( uint32_t a, uint32_t b )
+{
+    return ( uint64_t( a ) << 32 ) | b;
+}
+
+}
+
+TurnGraph::TurnGraph( const Road::Graph& graph, const Road::Restrictions& restrictions, unsigned traffic_rules ) :
+    penalty_values_( 1, 0.0 )
+{
+    // the automaton of dynamic_multi_plugin, restricted to the sequences that apply to the traffic rules
+    // so that other ones do not split nodes
+    Road::Restrictions applying( graph );
+    for ( const Road::Restriction& r : restrictions.restrictions() ) {
+        for ( const auto& c : r.cost_per_transport() ) {
+            if ( c.first & traffic_rules ) {
+                applying.add_restriction( r );
+                break;
+            }
+        }
+    }
+    typedef Automaton<Road::Edge> RoadAutomaton;
+    RoadAutomaton automaton;
+    automaton.build_graph( applying );
+    const RoadAutomaton::State initial = automaton.initial_state_;
+
+    // a node is a road edge and the automaton state after it
+    node_edge_.resize( num_edges( graph ) );
+    std::vector<RoadAutomaton::State> node_state( num_edges( graph ) );
+    Road::EdgeIterator ei, ei_end;
+    for ( boost::tie( ei, ei_end ) = edges( graph ); ei != ei_end; ei++ ) {
+        node_edge_[ei->idx] = *ei;
+        node_state[ei->idx] = automaton.find_transition( initial, *ei ).first;
+    }
+
+    // (edge index, state) -> copy of the node of the edge
+    std::unordered_map<uint64_t, Node> copies;
+    std::map<double, uint16_t> penalty_index;
+    penalty_index[0.0] = 0;
+
+    first_turn_.push_back( 0 );
+    // copies are appended while nodes are scanned
+    for ( Node n = 0; n < node_edge_.size(); n++ ) {
+        const Road::Edge e = node_edge_[n];
+        const RoadAutomaton::State s = node_state[n];
+        if ( graph[e].traffic_rules() & traffic_rules ) {
+            Road::OutEdgeIterator oi, oi_end;
+            for ( boost::tie( oi, oi_end ) = out_edges( target( e, graph ), graph ); oi != oi_end; oi++ ) {
+                if ( ( graph[*oi].traffic_rules() & traffic_rules ) == 0 ) {
+                    continue;
+                }
+                const RoadAutomaton::State ns = automaton.find_transition( s, *oi ).first;
+                // penalties are counted when the state changes, as in combined_ls_algorithm_no_init
+                const double p = ns != s ? penalty( automaton.automaton_graph_, ns, traffic_rules ) : 0.0;
+                if ( p == std::numeric_limits<double>::infinity() ) {
+                    continue;
+                }
+                Node t = oi->idx;
+                if ( ns != node_state[t] ) {
+                    auto it = copies.find( pair_key( oi->idx, uint32_t( ns ) ) );
+                    if ( it == copies.end() ) {
+                        it = copies.insert( std::make_pair( pair_key( oi->idx, uint32_t( ns ) ), Node( node_edge_.size() ) ) ).first;
+                        node_edge_.push_back( *oi );
+                        node_state.push_back( ns );
+                    }
+                    t = it->second;
+                }
+                auto pit = penalty_index.find( p );
+                if ( pit == penalty_index.end() ) {
+                    if ( penalty_values_.size() > std::numeric_limits<uint16_t>::max() ) {
+                        throw std::runtime_error( "Too many different turn penalties" );
+                    }
+                    pit = penalty_index.insert( std::make_pair( p, uint16_t( penalty_values_.size() ) ) ).first;
+                    penalty_values_.push_back( p );
+                }
+                turn_target_.push_back( t );
+                turn_penalty_.push_back( pit->second );
+            }
+        }
+        first_turn_.push_back( uint32_t( turn_target_.size() ) );
+    }
+}
+
+} // namespace Tempus
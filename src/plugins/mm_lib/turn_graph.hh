@@ -0,0 +1,90 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_TURN_GRAPH_HH
+#define TEMPUS_TURN_GRAPH_HH
+
+#include <vector>
+#include <cstdint>
+
+#include "road_graph.hh"
+
+/**
+ * Edge-based (turn-aware) road graph.
+ *
+ * Nodes of the graph are road sections and arcs are turns, from a section to a section leaving
+ * its target. Turn restrictions and time penalties of road_restriction_time_penalty are then
+ * costs of arcs, and any shortest path algorithm honours them without tracking an automaton state.
+ * Penalties are the ones of the restriction automaton (see automaton_lib) used by dynamic_multi_plugin.
+ *
+ * A restriction of more than two sections depends on the sections followed before the turn.
+ * While such a restriction is in progress, road sections are represented by copies of their
+ * node, whose turns are the ones allowed in this situation.
+ */
+
+namespace Tempus
+{
+
+///
+/// Edge-based graph of a road graph, for a set of traffic rules
+class TurnGraph
+{
+public:
+    typedef uint32_t Node;
+
+    ///
+    /// Build the graph of sections allowed to the traffic rules.
+    /// Forbidden turns (infinite penalties) are left out
+    /// \param graph The road graph
+    /// \param restrictions Turn restrictions of the road graph
+    /// \param traffic_rules Combination of TransportTrafficRule
+    TurnGraph( const Road::Graph& graph, const Road::Restrictions& restrictions, unsigned traffic_rules );
+
+    ///
+    /// Number of nodes. The node n < num_edges( road graph ) is the road edge of index n,
+    /// entered while no restriction is in progress. Paths start on these nodes
+    size_t num_nodes() const { return node_edge_.size(); }
+
+    size_t num_turns() const { return turn_target_.size(); }
+
+    ///
+    /// Road edge of a node
+    Road::Edge road_edge( Node n ) const { return node_edge_[n]; }
+
+    ///
+    /// Turns from a node are [first_turn(n), first_turn(n+1))
+    uint32_t first_turn( Node n ) const { return first_turn_[n]; }
+
+    ///
+    /// Node a turn goes to
+    Node turn_target( uint32_t t ) const { return turn_target_[t]; }
+
+    ///
+    /// Time penalty of a turn, in minutes
+    double turn_penalty( uint32_t t ) const { return penalty_values_[turn_penalty_[t]]; }
+
+private:
+    std::vector<Road::Edge> node_edge_;
+    std::vector<uint32_t> first_turn_;
+    std::vector<Node> turn_target_;
+    // penalties of turns, as indices in penalty_values_. Most turns have none, index 0
+    std::vector<uint16_t> turn_penalty_;
+    std::vector<double> penalty_values_;
+};
+
+} // namespace Tempus
+
+#endif
@@ -0,0 +1,393 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   Public transport plugin based on RAPTOR.
+
+   The timetables of the public transport graphs are flattened into routes when the plugin
+   is loaded, with footpaths between stops closer than "raptor/footpath_distance" meters.
+   A request walks from the origin road node to the stops around it, takes at most
+   "Raptor/max_transfers" + 1 trips and walks from a stop to the destination road node.
+
+   One result is returned for each number of trips that gives an earlier arrival, together
+   with a walk-only result when the destination is close enough.
+
+   With the "Raptor/algorithm" option set to "csa", the earliest arrival journey is computed
+   by the Connection Scan Algorithm instead, without any bound on the number of transfers.
+
+   With the "mcraptor" algorithm, or when the request optimizes the price, McRAPTOR returns
+   every Pareto-optimal journey over the arrival time, the number of trips and the number of
+   fare zones crossed. Public transport steps carry the number of fare zones they enter as
+   their price, and the number of changes they start, so that both sum up over a roadmap.
+
+   With "Raptor/departure_window" set to a positive number of minutes, the raptor algorithm
+   runs a range query (rRAPTOR) instead: every journey leaving the origin within the window
+   that is not dominated by a journey leaving later, arriving earlier and taking fewer trips
+   is returned, by departure time. Each result starts at its own departure time.
+ */
+
+#ifdef _WIN32
+#pragma warning(push, 0)
+#endif
+#include <boost/format.hpp>
+#ifdef _WIN32
+#pragma warning(pop)
+#endif
+
+#include <atomic>
+
+#include "plugin.hh"
+#include "plugin_factory.hh"
+#include "utils/timer.hh"
+#include "raptor.hh"
+#include "csa.hh"
+#include "mcraptor.hh"
+
+namespace Tempus {
+
+class RaptorPlugin : public Plugin {
+public:
+    static const OptionDescriptionList option_descriptions() {
+        OptionDescriptionList odl;
+        declare_option( odl, "prepare_result", "Prepare result", Variant::from_bool( true ) );
+        declare_option( odl, "Raptor/algorithm", "Algorithm: raptor, mcraptor, or csa for the earliest arrival only", Variant::from_string( "raptor" ) );
+        declare_option( odl, "Raptor/max_transfers", "Maximum number of transfers (raptor and mcraptor only)", Variant::from_int( 4 ) );
+        declare_option( odl, "Raptor/departure_window", "Departure window (min) after the requested time, raptor only. 0 for a single departure", Variant::from_int( 0 ) );
+        declare_option( odl, "Raptor/max_walking_distance", "Maximum walking distance (m) to the first stop and from the last stop", Variant::from_float( 1000.0 ) );
+        declare_option( odl, "Time/walking_speed", "Average walking speed (km/h)", Variant::from_float( 3.6 ) );
+        declare_option( odl, "Time/min_transfer_time", "Minimum time needed to transfer at a stop (min)", Variant::from_float( 2.0 ) );
+        return odl;
+    }
+
+    static const Capabilities plugin_capabilities() {
+        Capabilities params;
+        params.optimization_criteria().push_back( CostId::CostDuration );
+        params.optimization_criteria().push_back( CostId::CostNumberOfChanges );
+        params.optimization_criteria().push_back( CostId::CostPrice );
+        params.set_depart_after( true );
+        return params;
+    }
+
+    RaptorPlugin( ProgressionCallback& progression, const VariantMap& options ) : Plugin( "raptor_plugin", options ) {
+        // load graph
+        const RoutingData* rd = load_routing_data( "multimodal_graph", progression, options );
+        graph_ = dynamic_cast<const Multimodal::Graph*>( rd );
+        if ( graph_ == nullptr ) {
+            throw std::runtime_error( "Problem loading the multimodal graph" );
+        }
+
+        // transport modes of trips
+        std::map<db_id_t, db_id_t> trip_modes;
+        {
+            Db::Connection connection( db_options() );
+            Db::Result res( connection.exec( ( boost::format( "SELECT pt_trip.id, pt_route.transport_mode FROM %1%.pt_trip "
+                                                              "JOIN %1%.pt_route ON pt_route.id = pt_trip.route_id" ) % schema_name() ).str() ) );
+            for ( size_t i = 0; i < res.size(); i++ ) {
+                trip_modes[res[i][0].as<db_id_t>()] = res[i][1].as<db_id_t>();
+            }
+        }
+
+        float footpath_distance = 300.0;
+        auto it = options.find( "raptor/footpath_distance" );
+        if ( it != options.end() ) {
+            footpath_distance = float( it->second.as<double>() );
+        }
+        timetable_ = build_pt_timetable( *graph_, trip_modes, footpath_distance );
+        connections_.reset( new PTConnectionTable( *timetable_ ) );
+
+        static std::atomic<uint64_t> n_instances( 0 );
+        instance_id_ = ++n_instances;
+    }
+
+    virtual std::unique_ptr<PluginRequest> request( const VariantMap& options = VariantMap() ) const;
+
+    const RoutingData* routing_data() const { return graph_; }
+
+    const Multimodal::Graph& graph() const { return *graph_; }
+    const PTTimetable& timetable() const { return *timetable_; }
+
+    ///
+    /// RAPTOR labels of the calling thread
+    Raptor& thread_raptor() const
+    {
+        return thread_engine<Raptor>( *timetable_ );
+    }
+
+    ///
+    /// McRAPTOR bags of the calling thread
+    McRaptor& thread_mcraptor() const
+    {
+        return thread_engine<McRaptor>( *timetable_ );
+    }
+
+    ///
+    /// Connection scan labels of the calling thread
+    ConnectionScan& thread_connection_scan() const
+    {
+        return thread_engine<ConnectionScan>( *timetable_, *connections_ );
+    }
+
+private:
+    ///
+    /// Engine of the calling thread, kept from one request to another as the CH query workspaces.
+    /// It is built again when the thread runs a request of another instance of the plugin
+    template <typename Engine, typename... Args>
+    Engine& thread_engine( Args&&... args ) const
+    {
+        // instances are numbered, a new one may be allocated where a deleted one was
+        static thread_local uint64_t engine_instance = 0;
+        static thread_local std::unique_ptr<Engine> engine;
+        if ( !engine || engine_instance != instance_id_ ) {
+            engine.reset( new Engine( std::forward<Args>( args )... ) );
+            engine_instance = instance_id_;
+        }
+        return *engine;
+    }
+
+    const Multimodal::Graph* graph_;
+    std::unique_ptr<PTTimetable> timetable_;
+    std::unique_ptr<PTConnectionTable> connections_;
+
+    uint64_t instance_id_;
+};
+
+class RaptorPluginRequest : public PluginRequest
+{
+public:
+    RaptorPluginRequest( const RaptorPlugin* parent, const VariantMap& options )
+        : PluginRequest( parent, options ), raptor_plugin_( *parent ), graph_( parent->graph() ), timetable_( parent->timetable() )
+    {
+    }
+
+    virtual std::unique_ptr<Result> process( const Request& request ) {
+        REQUIRE( graph_.road_vertex_from_id( request.origin() ) );
+        REQUIRE( graph_.road_vertex_from_id( request.destination() ) );
+        if ( request.steps().size() > 2 ) {
+            throw std::invalid_argument( "Intermediate steps are not supported" );
+        }
+        if ( request.steps()[1].constraint().type() == Request::TimeConstraint::ConstraintBefore ) {
+            throw std::invalid_argument( "'Arrive before' constraints are not supported" );
+        }
+
+        const bool prepare_result = get_bool_option( "prepare_result" );
+        std::string algorithm = get_string_option( "Raptor/algorithm" );
+        if ( algorithm != "raptor" && algorithm != "mcraptor" && algorithm != "csa" ) {
+            throw std::invalid_argument( "Unknown public transport algorithm " + algorithm );
+        }
+        const std::vector<CostId>& criteria = request.optimizing_criteria();
+        if ( algorithm == "raptor" && std::find( criteria.begin(), criteria.end(), CostId::CostPrice ) != criteria.end() ) {
+            algorithm = "mcraptor";
+        }
+        const uint32_t max_transfers = uint32_t( get_int_option( "Raptor/max_transfers" ) );
+        const float departure_window = float( get_int_option( "Raptor/departure_window" ) );
+        if ( departure_window < 0.0 ) {
+            throw std::invalid_argument( "The departure window must not be negative" );
+        }
+        if ( departure_window > 0.0 && algorithm != "raptor" ) {
+            throw std::invalid_argument( "Departure windows are only supported by the raptor algorithm" );
+        }
+        const float max_walking_distance = float( get_float_option( "Raptor/max_walking_distance" ) );
+        // m/min
+        const float walking_speed = float( get_float_option( "Time/walking_speed" ) * 1000.0 / 60.0 );
+        const float min_transfer_time = float( get_float_option( "Time/min_transfer_time" ) );
+
+        Timer timer;
+
+        const Road::Graph& road_graph = graph_.road();
+        const Road::Vertex origin = graph_.road_vertex_from_id( request.origin() ).get();
+        const Road::Vertex destination = graph_.road_vertex_from_id( request.destination() ).get();
+        const DateTime& date_time = request.steps()[1].constraint().date_time();
+        const float departure_time = float( date_time.time_of_day().total_seconds() / 60.0 );
+
+        // trips running this day, with an allowed transport mode
+        std::vector<bool> active_trips = timetable_.active_trips( graph_, date_time.date() );
+        std::set<db_id_t> allowed_modes( request.allowed_modes().begin(), request.allowed_modes().end() );
+        for ( size_t t = 0; t < active_trips.size(); t++ ) {
+            const db_id_t mode = timetable_.trip( uint32_t(t) ).transport_mode;
+            if ( mode != 0 && allowed_modes.find( mode ) == allowed_modes.end() ) {
+                active_trips[t] = false;
+            }
+        }
+
+        std::vector<PTAccess> access, egress;
+        for ( const PTFootpath& f : pt_stops_around( timetable_, road_graph, origin, max_walking_distance ) ) {
+            access.push_back( PTAccess{ f.stop, f.distance / walking_speed } );
+        }
+        for ( const PTFootpath& f : pt_stops_around( timetable_, road_graph, destination, max_walking_distance ) ) {
+            egress.push_back( PTAccess{ f.stop, f.distance / walking_speed } );
+        }
+
+        // walk only
+        float walking_distance = PTTimetable::infinity();
+        pt_walking_search( road_graph, { std::make_pair( origin, 0.0f ) }, max_walking_distance, [&]( Road::Vertex v, float d ) {
+                if ( v == destination ) {
+                    walking_distance = d;
+                }
+            });
+        const float walking_duration = walking_distance / walking_speed;
+
+        std::vector<PTJourney> journeys;
+        if ( algorithm == "csa" ) {
+            ConnectionScan& csa = raptor_plugin_.thread_connection_scan();
+            PTJourney journey;
+            if ( csa.query( active_trips, access, egress, departure_time, walking_speed, min_transfer_time, journey ) ) {
+                journeys.push_back( journey );
+            }
+            metrics_["scanned_connections"] = Variant::from_int( csa.num_scanned_connections() );
+        }
+        else if ( algorithm == "raptor" && departure_window > 0.0 ) {
+            Raptor& raptor = raptor_plugin_.thread_raptor();
+            journeys = raptor.range_query( active_trips, access, egress, departure_time, departure_time + departure_window,
+                                           max_transfers, walking_speed, min_transfer_time );
+            metrics_["scanned_routes"] = Variant::from_int( raptor.num_scanned_routes() );
+        }
+        else if ( algorithm == "raptor" ) {
+            Raptor& raptor = raptor_plugin_.thread_raptor();
+            journeys = raptor.query( active_trips, access, egress, departure_time, max_transfers, walking_speed, min_transfer_time );
+            metrics_["scanned_routes"] = Variant::from_int( raptor.num_scanned_routes() );
+        }
+        else if ( algorithm == "mcraptor" ) {
+            McRaptor& mcraptor = raptor_plugin_.thread_mcraptor();
+            journeys = mcraptor.query( active_trips, access, egress, departure_time, max_transfers, walking_speed, min_transfer_time );
+            metrics_["labels"] = Variant::from_int( mcraptor.num_labels() );
+        }
+        metrics_["time_s"] = Variant::from_float( timer.elapsed() );
+
+        std::unique_ptr<Result> result( new Result() );
+        if ( walking_distance != PTTimetable::infinity() ) {
+            result->push_back( Roadmap() );
+            Roadmap& roadmap = result->back().roadmap();
+            roadmap.set_starting_date_time( date_time );
+            std::auto_ptr<Roadmap::Step> step( new Roadmap::TransferStep( MMVertex( MMVertex::Road, request.origin() ), MMVertex( MMVertex::Road, request.destination() ) ) );
+            static_cast<Roadmap::TransferStep*>( step.get() )->set_transport_mode( TransportModeWalking );
+            static_cast<Roadmap::TransferStep*>( step.get() )->set_final_mode( TransportModeWalking );
+            step->set_cost( CostId::CostDuration, walking_duration );
+            step->set_cost( CostId::CostDistance, walking_distance );
+            roadmap.add_step( step );
+        }
+        for ( const PTJourney& journey : journeys ) {
+            // walking is faster, whenever the journey starts
+            if ( journey.arrival_time - journey.departure_time >= walking_duration ) {
+                continue;
+            }
+            result->push_back( Roadmap() );
+            Roadmap& roadmap = result->back().roadmap();
+            if ( departure_window > 0.0 ) {
+                const int mins = int( journey.departure_time );
+                const int secs = int( ( journey.departure_time - mins ) * 60.0 );
+                roadmap.set_starting_date_time( DateTime( date_time.date(), boost::posix_time::minutes( mins ) + boost::posix_time::seconds( secs ) ) );
+            }
+            else {
+                roadmap.set_starting_date_time( date_time );
+            }
+            add_journey( roadmap, journey, request.origin(), request.destination() );
+        }
+        metrics_["results"] = Variant::from_int( result->size() );
+
+        if ( result->empty() ) {
+            throw std::runtime_error( "No path found !" );
+        }
+
+        if ( prepare_result ) {
+            Db::Connection connection( plugin_->db_options() );
+            simple_multimodal_roadmap( *result, connection, graph_ );
+        }
+
+        return result;
+    }
+
+private:
+    MMVertex stop_vertex( uint32_t s ) const
+    {
+        return MMVertex( timetable_.stop( s ).db_id, timetable_.stop( s ).network_id );
+    }
+
+    ///
+    /// Steps of a journey, one public transport step per pair of consecutive stops of a ride
+    void add_journey( Roadmap& roadmap, const PTJourney& journey, db_id_t origin, db_id_t destination ) const
+    {
+        float last_arrival = journey.departure_time;
+        bool on_board = false;
+        uint16_t last_zone = 0;
+        for ( size_t i = 0; i < journey.legs.size(); i++ ) {
+            const PTJourneyLeg& leg = journey.legs[i];
+            if ( leg.type == PTJourneyLeg::LegWalk ) {
+                const MMVertex from = leg.from_stop == PTJourneyLeg::NO_STOP ? MMVertex( MMVertex::Road, origin ) : stop_vertex( leg.from_stop );
+                const MMVertex to = leg.to_stop == PTJourneyLeg::NO_STOP ? MMVertex( MMVertex::Road, destination ) : stop_vertex( leg.to_stop );
+                std::auto_ptr<Roadmap::Step> step( new Roadmap::TransferStep( from, to ) );
+                Roadmap::TransferStep* tstep = static_cast<Roadmap::TransferStep*>( step.get() );
+                tstep->set_transport_mode( TransportModeWalking );
+                db_id_t final_mode = TransportModeWalking;
+                if ( i + 1 < journey.legs.size() && journey.legs[i + 1].type == PTJourneyLeg::LegRide ) {
+                    final_mode = timetable_.trip( journey.legs[i + 1].trip ).transport_mode;
+                }
+                tstep->set_final_mode( final_mode );
+                step->set_cost( CostId::CostDuration, leg.arrival_time - leg.departure_time );
+                roadmap.add_step( step );
+                last_arrival = leg.arrival_time;
+                continue;
+            }
+
+            const PTTrip& trip = timetable_.trip( leg.trip );
+            uint32_t route_trip = 0;
+            while ( timetable_.route_trip( leg.route, route_trip ) != leg.trip ) {
+                route_trip++;
+            }
+            const PTStopTime* times = timetable_.stop_times( leg.route, route_trip );
+            const bool change = on_board;
+            for ( uint32_t p = leg.board_position; p < leg.alight_position; p++ ) {
+                // fare zones entered by this step, see pt_journey_fare_zones()
+                int zones = 0;
+                for ( uint32_t q = ( p == leg.board_position ? p : p + 1 ); q <= p + 1; q++ ) {
+                    const uint16_t zone = timetable_.stop( timetable_.route_stop( leg.route, q ) ).zone_id;
+                    if ( !on_board || zone != last_zone ) {
+                        zones++;
+                        last_zone = zone;
+                        on_board = true;
+                    }
+                }
+                std::auto_ptr<Roadmap::Step> step( new Roadmap::PublicTransportStep() );
+                Roadmap::PublicTransportStep* pstep = static_cast<Roadmap::PublicTransportStep*>( step.get() );
+                pstep->set_transport_mode( trip.transport_mode );
+                pstep->set_network_id( trip.network_id );
+                pstep->set_departure_stop( timetable_.stop( timetable_.route_stop( leg.route, p ) ).db_id );
+                pstep->set_arrival_stop( timetable_.stop( timetable_.route_stop( leg.route, p + 1 ) ).db_id );
+                pstep->set_departure_time( times[p].departure_time );
+                pstep->set_arrival_time( times[p + 1].arrival_time );
+                pstep->set_trip_id( trip.db_id );
+                pstep->set_wait( p == leg.board_position ? times[p].departure_time - last_arrival : 0.0 );
+                pstep->set_cost( CostId::CostDuration, times[p + 1].arrival_time - times[p].departure_time );
+                pstep->set_cost( CostId::CostPrice, zones );
+                pstep->set_cost( CostId::CostNumberOfChanges, p == leg.board_position && change ? 1 : 0 );
+                roadmap.add_step( step );
+            }
+            last_arrival = leg.arrival_time;
+        }
+    }
+
+    const RaptorPlugin& raptor_plugin_;
+    const Multimodal::Graph& graph_;
+    const PTTimetable& timetable_;
+};
+
+std::unique_ptr<PluginRequest> RaptorPlugin::request( const VariantMap& options ) const
+{
+    return std::unique_ptr<PluginRequest>( new RaptorPluginRequest( this, options ) );
+}
+
+}
+
+DECLARE_TEMPUS_PLUGIN( "raptor_plugin", Tempus::RaptorPlugin )
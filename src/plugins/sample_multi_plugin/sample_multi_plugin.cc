@@ -119,9 +119,9 @@ public:
 
             case Multimodal::Edge::Transport2Transport: {
                 PublicTransport::Edge e;
-                const PublicTransport::Graph& pt_graph = *( ei->source().pt_graph() );
+                const PublicTransport::Graph& pt_graph = *( ei->source().pt_graph( *graph_ ) );
                 bool found;
-                boost::tie( e, found ) = public_transport_edge( *ei );
+                boost::tie( e, found ) = public_transport_edge( *ei, *graph_ );
 
                 if ( !found ) {
                     CERR << "Can't find pt edge" << *ei << std::endl;
@@ -135,7 +135,7 @@ public:
 
             case Multimodal::Edge::Road2Transport: {
                 // find the road section where the stop is attached to
-                const PublicTransport::Graph& pt_graph = *( ei->target().pt_graph() );
+                const PublicTransport::Graph& pt_graph = *( ei->target().pt_graph( *graph_ ) );
                 double abscissa = pt_graph[ei->target().pt_vertex()].abscissa_road_section();
                 Road::Edge e = pt_graph[ ei->target().pt_vertex() ].road_edge();
 
@@ -155,7 +155,7 @@ public:
 
             case Multimodal::Edge::Transport2Road: {
                 // find the road section where the stop is attached to
-                const PublicTransport::Graph& pt_graph = *( ei->source().pt_graph() );
+                const PublicTransport::Graph& pt_graph = *( ei->source().pt_graph( *graph_ ) );
                 double abscissa = pt_graph[ei->source().pt_vertex()].abscissa_road_section();
                 Road::Edge e = pt_graph[ ei->source().pt_vertex() ].road_edge();
 
@@ -228,7 +228,7 @@ public:
                 Roadmap::RoadStep* step = static_cast<Roadmap::RoadStep*>( mstep );
                 Road::Edge e;
                 bool found = false;
-                boost::tie( e, found ) = edge( previous->road_vertex(), it->road_vertex(), *it->road_graph() );
+                boost::tie( e, found ) = edge( previous->road_vertex(), it->road_vertex(), graph_->road() );
 
                 if ( !found ) {
                     throw std::runtime_error( "Can't find the road edge !" );
@@ -240,22 +240,16 @@ public:
             else if ( previous->type() == Multimodal::Vertex::PublicTransport && it->type() == Multimodal::Vertex::PublicTransport ) {
                 mstep = new Roadmap::PublicTransportStep();
                 Roadmap::PublicTransportStep* step = static_cast<Roadmap::PublicTransportStep*>( mstep );
-                step->set_departure_stop( get_mm_vertex(*previous).id() );
-                step->set_arrival_stop( get_mm_vertex(*it).id() );
+                step->set_departure_stop( get_mm_vertex( *previous, *graph_ ).id() );
+                step->set_arrival_stop( get_mm_vertex( *it, *graph_ ).id() );
                 // Set the trip ID
                 step->set_trip_id( 1 );
 
-                // find the network_id
-                for ( auto p : graph_->public_transports() ) {
-                    if ( it->pt_graph() == p.second ) {
-                        step->set_network_id( p.first );
-                        break;
-                    }
-                }
+                step->set_network_id( graph_->public_transport_rindex( it->pt_graph_idx() ) );
             }
             else {
                 // Make a multimodal edge and copy it into the roadmap as a 'generic' step
-                mstep = new Roadmap::TransferStep( get_mm_vertex( *previous ), get_mm_vertex( *it ) );
+                mstep = new Roadmap::TransferStep( get_mm_vertex( *previous, *graph_ ), get_mm_vertex( *it, *graph_ ) );
             }
 
             // build the multimodal edge to find corresponding costs
@@ -379,7 +373,7 @@ public:
             // Run for each intermiadry steps
 
             Multimodal::Vertex vorigin, vdestination;
-            vorigin = Multimodal::Vertex( graph, graph.road_vertex_from_id(request.origin()).get(), Multimodal::Vertex::road_t() );
+            vorigin = Multimodal::Vertex( graph.road_vertex_from_id(request.origin()).get(), Multimodal::Vertex::road_t() );
 
             Timer timer;
 
@@ -389,8 +383,8 @@ public:
                 // path of this step
                 Path lpath;
 
-                vorigin = Multimodal::Vertex( graph, graph.road_vertex_from_id(request.steps()[j - 1].location()).get(), Multimodal::Vertex::road_t() );
-                vdestination = Multimodal::Vertex( graph, graph.road_vertex_from_id(request.steps()[j].location()).get(), Multimodal::Vertex::road_t() );
+                vorigin = Multimodal::Vertex( graph.road_vertex_from_id(request.steps()[j - 1].location()).get(), Multimodal::Vertex::road_t() );
+                vdestination = Multimodal::Vertex( graph.road_vertex_from_id(request.steps()[j].location()).get(), Multimodal::Vertex::road_t() );
 
                 bool found;
                 found = find_path( vorigin, vdestination, request.optimizing_criteria()[i], lpath );
@@ -407,7 +401,7 @@ public:
                 std::copy( lpath.begin(), lpath.end(), std::back_inserter(path) );
             }
             // add origin back
-            path.push_front( Multimodal::Vertex( graph, graph.road_vertex_from_id(request.origin()).get(), Multimodal::Vertex::road_t() ) );
+            path.push_front( Multimodal::Vertex( graph.road_vertex_from_id(request.origin()).get(), Multimodal::Vertex::road_t() ) );
 
             metrics_[ "time_s" ] = Variant::from_float(timer.elapsed());
             metrics_["iterations"] = Variant::from_int(iterations_);
@@ -358,6 +358,7 @@ int main( int argc, char* argv[] )
     WPS::PluginListService plugin_list_service;
     WPS::SelectService select_service;
     WPS::ConstantListService constant_list_service;
+    WPS::DistanceTableService distance_table_service;
 
     if ( chdir_str != "" ) {
         if( chdir( chdir_str.c_str() ) ) {
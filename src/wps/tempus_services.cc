@@ -28,6 +28,8 @@
 #include <boost/timer/timer.hpp>
 #include "plugin_factory.hh"
 #include "tempus_services.hh"
+#include "ch_distance_table.hh"
+#include "cch_routing_data.hh"
 
 using namespace Tempus;
 
@@ -557,6 +559,19 @@ xmlNode* get_isochrone_node( const Isochrone& isochrone, const RoutingData* /*rd
     return result_node;
 }
 
+xmlNode* get_travel_time_profile_node( const TravelTimeProfile& profile )
+{
+    xmlNode* result_node = XML::new_node( "travel_time_profile" );
+
+    for ( const auto& v: profile ) {
+        xmlNode* node = XML::new_node("p");
+        XML::set_prop(node, "departure_time", to_string(v.departure_time()));
+        XML::set_prop(node, "travel_time", to_string(v.travel_time()));
+        XML::add_child(result_node, node);
+    }
+    return result_node;
+}
+
 Service::ParameterMap SelectService::execute( const ParameterMap& input_parameter_map ) const
 {
     ParameterMap output_parameters;
@@ -737,6 +752,9 @@ Service::ParameterMap SelectService::execute( const ParameterMap& input_paramete
         else if ( rit->is_isochrone() ) {
             result_node = get_isochrone_node( rit->isochrone(), rd );
         }
+        else if ( rit->is_travel_time_profile() ) {
+            result_node = get_travel_time_profile_node( rit->travel_time_profile() );
+        }
         XML::add_child( root_node, result_node );
     } // for each result
 
@@ -750,4 +768,88 @@ Service::ParameterMap SelectService::execute( const ParameterMap& input_paramete
     return output_parameters;
 }
 
+///
+/// "distance_table" service, costs between each origin and each destination.
+/// The plugin must be based on a CH graph or on a customizable CH graph (ch_plugin),
+/// whose walking metric is then used.
+///
+/// Input var: plugin, the name of the plugin
+/// Input var: origins, list of points
+/// Input var: destinations, list of points
+/// Output var: table, one row per origin and one cell per destination
+///
+DistanceTableService::DistanceTableService() : Service( "distance_table" ) {
+    add_input_parameter( "plugin" );
+    add_input_parameter( "origins" );
+    add_input_parameter( "destinations" );
+    add_output_parameter( "table" );
+}
+
+Service::ParameterMap DistanceTableService::execute( const ParameterMap& input_parameter_map ) const
+{
+    ParameterMap output_parameters;
+
+    Service::check_parameters( input_parameter_map, input_parameter_schema_ );
+    const xmlNode* plugin_node = input_parameter_map.find( "plugin" )->second;
+    const std::string plugin_str = XML::get_prop( plugin_node, "name" );
+    Plugin* plugin = PluginFactory::instance()->plugin( plugin_str );
+
+    if ( plugin == nullptr ) {
+        throw std::invalid_argument( "Cannot find plugin " + plugin_str );
+    }
+
+    // the CH the table is computed on, depending on the routing data of the plugin
+    const RoutingData* plugin_rd = plugin->routing_data();
+    const CHRoutingData* rd = nullptr;
+    if ( const CHRoutingData* ch = dynamic_cast<const CHRoutingData*>( plugin_rd ) ) {
+        rd = ch;
+    }
+    else if ( const CCHRoutingData* cch = dynamic_cast<const CCHRoutingData*>( plugin_rd ) ) {
+        // points are resolved for pedestrians
+        rd = &cch->metric( TransportModeWalking );
+    }
+    else {
+        // time-dependent and turn-aware CHs only answer one to one queries
+        throw std::invalid_argument( "Plugin " + plugin_str + " is based on " + ( plugin_rd ? "a " + plugin_rd->name() : std::string( "no routing data" ) ) +
+                                     ", distance tables need a ch_graph or a cch_graph" );
+    }
+
+    std::vector<db_id_t> origins, destinations;
+    {
+        Db::Connection db( plugin->db_options() );
+
+        auto parse_points = [&]( const std::string& name, std::vector<db_id_t>& ids ) {
+            const xmlNode* points_node = input_parameter_map.find( name )->second;
+            const xmlNode* field = XML::get_next_nontext( points_node->children );
+            while ( field && !xmlStrcmp( field->name, ( const xmlChar* )"point" ) ) {
+                ids.push_back( get_vertex_id_from_point_and_mode( field, db, TransportModeWalking ) );
+                field = XML::get_next_nontext( field->next );
+            }
+        };
+        parse_points( "origins", origins );
+        parse_points( "destinations", destinations );
+    }
+
+    CHDistanceTable table = ch_distance_table_from_ids( *rd, origins, destinations );
+
+    xmlNode* root_node = XML::new_node( "table" );
+    for ( size_t i = 0; i < table.n_origins(); i++ ) {
+        xmlNode* row_node = XML::new_node( "row" );
+        XML::new_prop( row_node, "origin", origins[i] );
+        for ( size_t j = 0; j < table.n_destinations(); j++ ) {
+            xmlNode* cell_node = XML::new_node( "c" );
+            XML::new_prop( cell_node, "destination", destinations[j] );
+            // no cost if the destination cannot be reached
+            if ( table.cost( i, j ) != CHDistanceTable::infinity() ) {
+                XML::new_prop( cell_node, "cost", table.cost( i, j ) );
+            }
+            XML::add_child( row_node, cell_node );
+        }
+        XML::add_child( root_node, row_node );
+    }
+
+    output_parameters[ "table" ] = root_node;
+    return output_parameters;
+}
+
 } // WPS namespace
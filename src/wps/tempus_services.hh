@@ -38,6 +38,12 @@ public:
     Service::ParameterMap execute( const ParameterMap& input_parameter_map ) const;
 };
 
+class DistanceTableService : public Service {
+public:
+    DistanceTableService();
+    Service::ParameterMap execute( const ParameterMap& input_parameter_map ) const;
+};
+
 } // WPS namespace
 
 #endif
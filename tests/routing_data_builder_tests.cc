@@ -20,6 +20,10 @@
 #include "routing_data.hh"
 #include "routing_data_builder.hh"
 #include "multimodal_graph.hh"
+#include "multimodal_graph_builder.hh"
+
+#include <boost/filesystem.hpp>
+#include <fstream>
 
 using namespace boost::unit_test ;
 using namespace Tempus;
@@ -57,5 +61,73 @@ BOOST_AUTO_TEST_CASE( test_routing_data_loading )
     std::cout << num_vertices( *mm_graph ) << std::endl;
 }
 
+BOOST_AUTO_TEST_CASE( test_multimodal_graph_dump )
+{
+    std::vector<std::pair<Road::Vertex, Road::Vertex>> road_ends;
+    road_ends.push_back( std::make_pair( 0, 1 ) );
+    road_ends.push_back( std::make_pair( 2, 1 ) );
+    std::vector<Road::Section> road_sections( 2 );
+    std::unique_ptr<Road::Graph> road( new Road::Graph( boost::edges_are_unsorted_multi_pass, road_ends.begin(), road_ends.end(), road_sections.begin(), 3 ) );
+
+    // a public transport network of two sections, with their timetables
+    std::vector<std::pair<PublicTransport::Vertex, PublicTransport::Vertex>> ends;
+    ends.push_back( std::make_pair( 1, 2 ) );
+    ends.push_back( std::make_pair( 0, 1 ) );
+    std::vector<PublicTransport::Section> sections( 2 );
+    std::unique_ptr<PublicTransport::Graph> pt( new PublicTransport::Graph( boost::edges_are_unsorted_multi_pass, ends.begin(), ends.end(), sections.begin(), 3 ) );
+    std::vector<std::vector<PublicTransport::Timetable::TripTime>> tables( 2 );
+    tables[0].emplace_back( 12.0, 13.0, 1, 1 );
+    tables[1].emplace_back( 13.0, 14.0, 1, 1 );
+    tables[1].emplace_back( 15.0, 16.0, 2, 2 );
+    get_property( *pt ).assign_time_tables( tables );
+    get_property( *pt ).service_map().add( 1, Date( 2026, 1, 5 ) );
+    get_property( *pt ).service_map().add( 2, Date( 2026, 3, 20 ) );
+    for ( PublicTransport::Vertex v = 0; v < 3; v++ ) {
+        (*pt)[v].set_road_edge( *edges( *road ).first );
+    }
+
+    Multimodal::Graph graph( std::move( road ) );
+    std::map<db_id_t, std::unique_ptr<PublicTransport::Graph>> networks;
+    networks[1] = std::move( pt );
+    graph.set_public_transports( std::move( networks ) );
+
+    const std::string dump_file = ( boost::filesystem::temp_directory_path() / boost::filesystem::unique_path( "multimodal_dump-%%%%-%%%%.bin" ) ).string();
+    MultimodalGraphBuilder builder;
+    TextProgression progression;
+    builder.file_export( &graph, dump_file, progression );
+    {
+        std::unique_ptr<RoutingData> rd = builder.file_import( dump_file, progression );
+        const Multimodal::Graph& imported = dynamic_cast<const Multimodal::Graph&>( *rd );
+        BOOST_CHECK_EQUAL( num_edges( imported.road() ), 2 );
+        // the adjacency built on import needs both directions
+        BOOST_CHECK_EQUAL( in_degree( Road::Vertex( 1 ), imported.road() ), 2 );
+        BOOST_CHECK_EQUAL( out_degree( Road::Vertex( 1 ), imported.road() ), 0 );
+
+        BOOST_REQUIRE_EQUAL( imported.public_transports().size(), 1 );
+        const PublicTransport::Graph& ipt = imported.public_transport( 0 );
+        BOOST_CHECK_EQUAL( num_edges( ipt ), 2 );
+        BOOST_CHECK_EQUAL( in_degree( PublicTransport::Vertex( 1 ), ipt ), 1 );
+        const PublicTransport::ServiceMap& services = get_property( ipt ).service_map();
+        BOOST_CHECK_EQUAL( services.size(), 2 );
+        BOOST_CHECK( services.is_available_on( 1, Date( 2026, 1, 5 ) ) );
+        BOOST_CHECK( !services.is_available_on( 1, Date( 2026, 3, 20 ) ) );
+        BOOST_CHECK( services.is_available_on( 2, Date( 2026, 3, 20 ) ) );
+        PublicTransport::EdgeIterator ei, ei_end;
+        for ( boost::tie( ei, ei_end ) = edges( ipt ); ei != ei_end; ei++ ) {
+            BOOST_CHECK_EQUAL( PublicTransport::time_table( ipt, *ei ).table().size(), ei->idx + 1 );
+        }
+    }
+
+    // dumps of older versions are rejected
+    {
+        std::fstream f( dump_file, std::ios::in | std::ios::out | std::ios::binary );
+        f.seekp( 4 + 256 );
+        const uint32_t old_version = builder.version() - 1;
+        f.write( reinterpret_cast<const char*>( &old_version ), sizeof( uint32_t ) );
+    }
+    BOOST_CHECK_THROW( builder.file_import( dump_file, progression ), std::runtime_error );
+    boost::filesystem::remove( dump_file );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
@@ -22,6 +22,7 @@
 #include <boost/graph/dijkstra_shortest_paths.hpp>
 #include <boost/test/unit_test.hpp>
 #include <boost/format.hpp>
+#include <boost/filesystem.hpp>
 #ifdef _WIN32
 #pragma warning(pop)
 #endif
@@ -32,10 +33,32 @@
 #include "utils/graph_db_link.hh"
 #include "multimodal_graph_builder.hh"
 #include "ch_routing_data.hh"
+#include "ch_distance_table.hh"
+#include "ch_query_workspace.hh"
+#include "cch_routing_data.hh"
+#include "tch_routing_data.hh"
+#include "road_landmarks.hh"
+#include "raptor.hh"
+#include "csa.hh"
+#include "mcraptor.hh"
+#include "mm_lib/label_map.hh"
+#include "mm_lib/speed_profile.hh"
+#include "mm_lib/cost_calculator.hh"
+#include "mm_lib/algorithms.hh"
+#include "mm_lib/turn_graph.hh"
+#include "automaton_lib/automaton.hh"
+#include "ch_plugin/ch_preprocess.hh"
 
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <sstream>
+#include <random>
+#include <queue>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 static std::string g_db_options = getenv( "TEMPUS_DB_OPTIONS" ) ? getenv( "TEMPUS_DB_OPTIONS" ) : "";
 static std::string g_db_name = getenv( "TEMPUS_DB_NAME" ) ? getenv( "TEMPUS_DB_NAME" ) : "tempus_test_db";
@@ -56,6 +79,78 @@ Multimodal::Vertex vertex_from_road_node_id( db_id_t id, const Multimodal::Graph
     throw std::runtime_error( "bug: should not reach here" );
 }
 
+///
+/// Edges of a side x side grid, between neighbours of a row (v, v + 1) and of a column (v, v + side).
+/// Each pair of neighbours is given once
+std::vector<std::pair<uint32_t, uint32_t>> grid_edges( uint32_t side )
+{
+    std::vector<std::pair<uint32_t, uint32_t>> e;
+    for ( uint32_t v = 0; v < side * side; v++ ) {
+        if ( v % side + 1 < side ) {
+            e.push_back( std::make_pair( v, v + 1 ) );
+        }
+        if ( v + side < side * side ) {
+            e.push_back( std::make_pair( v, v + side ) );
+        }
+    }
+    return e;
+}
+
+///
+/// Road graph of a side x side grid with sections in both directions.
+/// make_section( v, w ) returns the section from v to w, it is called for (v, w) then (w, v)
+/// in the order of grid_edges()
+template <typename SectionFunction>
+Road::Graph grid_road_graph( uint32_t side, SectionFunction make_section )
+{
+    std::vector<std::pair<uint32_t, uint32_t>> road_edges;
+    std::vector<Road::Section> sections;
+    for ( const auto& e : grid_edges( side ) ) {
+        for ( auto p : { e, std::make_pair( e.second, e.first ) } ) {
+            road_edges.push_back( p );
+            sections.push_back( make_section( p.first, p.second ) );
+        }
+    }
+    return Road::Graph( boost::edges_are_unsorted_multi_pass, road_edges.begin(), road_edges.end(), sections.begin(), side * side );
+}
+
+///
+/// Reference Dijkstra on n vertices, from origins given with their initial cost.
+/// relax( u, c, next ) appends to next a (v, cv) pair for each arc from u to v, where cv is the cost at v
+/// when u is reached with the cost c. Costs may be arrival times, for time-dependent FIFO arcs.
+/// \returns the costs of the vertices, infinity for the unreachable ones
+typedef std::vector<std::pair<uint32_t, double>> ReferenceArcs;
+template <typename Relax>
+std::vector<double> reference_dijkstra( size_t n, const ReferenceArcs& origins, Relax relax )
+{
+    std::vector<double> cost( n, std::numeric_limits<double>::infinity() );
+    typedef std::pair<double, uint32_t> QueueItem;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> q;
+    auto update = [&]( uint32_t v, double c ) {
+        if ( c < cost[v] ) {
+            cost[v] = c;
+            q.push( QueueItem( c, v ) );
+        }
+    };
+    for ( const auto& o : origins ) {
+        update( o.first, o.second );
+    }
+    ReferenceArcs next;
+    while ( !q.empty() ) {
+        const QueueItem top = q.top();
+        q.pop();
+        if ( top.first > cost[top.second] ) {
+            continue;
+        }
+        next.clear();
+        relax( top.second, top.first, next );
+        for ( const auto& a : next ) {
+            update( a.first, a.second );
+        }
+    }
+    return cost;
+}
+
 BOOST_AUTO_TEST_SUITE( tempus_core_Db )
 
 BOOST_AUTO_TEST_CASE( testConnection )
@@ -383,6 +478,9 @@ BOOST_AUTO_TEST_CASE( testMultimodal )
 
             for ( ; oei != oei_end; oei++ ) {
                 out_deg++;
+                // the frozen adjacency must agree with the generic edge constructor
+                BOOST_CHECK( oei->source() == *vi );
+                BOOST_CHECK_EQUAL( oei->connection_type(), Multimodal::Edge( *graph, oei->source(), oei->target() ).connection_type() );
             }
 
             size_t out_deg2 = out_degree( *vi, *graph );
@@ -629,6 +727,36 @@ std::cout << "n_poi2road = " << n_poi2road << " pois.size = " << graph->pois().s
 #endif
 }
 
+BOOST_AUTO_TEST_CASE( testMultimodalVertex )
+{
+    using Multimodal::Vertex;
+    BOOST_CHECK_EQUAL( sizeof( Vertex ), 8 );
+
+    Vertex null;
+    Vertex r( Road::Vertex( 42 ), Vertex::road_t() );
+    Vertex pt( PublicTransportGraphIndex( 3 ), PublicTransport::Vertex( 7 ) );
+    Vertex poi( POIIndex( 1 ), Vertex::poi_t() );
+
+    BOOST_CHECK( null.is_null() );
+    BOOST_CHECK_EQUAL( r.type(), Vertex::Road );
+    BOOST_CHECK_EQUAL( r.road_vertex(), 42 );
+    BOOST_CHECK_EQUAL( pt.type(), Vertex::PublicTransport );
+    BOOST_CHECK_EQUAL( pt.pt_graph_idx(), 3 );
+    BOOST_CHECK_EQUAL( pt.pt_vertex(), 7 );
+    BOOST_CHECK_EQUAL( poi.type(), Vertex::Poi );
+    BOOST_CHECK_EQUAL( poi.poi_idx(), 1 );
+
+    // road vertices, then public transport vertices by graph, then POIs
+    BOOST_CHECK( null < r );
+    BOOST_CHECK( Vertex( Road::Vertex( 1000 ), Vertex::road_t() ) < pt );
+    BOOST_CHECK( Vertex( PublicTransportGraphIndex( 2 ), PublicTransport::Vertex( 1000 ) ) < pt );
+    BOOST_CHECK( pt < Vertex( PublicTransportGraphIndex( 3 ), PublicTransport::Vertex( 8 ) ) );
+    BOOST_CHECK( pt < poi );
+    BOOST_CHECK( r == Vertex( Road::Vertex( 42 ), Vertex::road_t() ) );
+    BOOST_CHECK( r != Vertex( POIIndex( 42 ), Vertex::poi_t() ) );
+    BOOST_CHECK( r.hash() != Vertex( POIIndex( 42 ), Vertex::poi_t() ).hash() );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_AUTO_TEST_SUITE( tempus_core_reverse_road )
@@ -816,6 +944,217 @@ BOOST_AUTO_TEST_CASE( testRestrictions )
     BOOST_CHECK_EQUAL(i, 4);
 }
 
+BOOST_AUTO_TEST_CASE( testAutomaton )
+{
+    // path 0 -> 1 -> 2 -> 3 -> 4, e[i] goes from i to i+1
+    std::vector<std::pair<uint32_t, uint32_t>> path_edges;
+    for ( uint32_t v = 0; v < 4; v++ ) {
+        path_edges.push_back( std::make_pair( v, v + 1 ) );
+    }
+    std::vector<Road::Section> sections( path_edges.size() );
+    Road::Graph graph( boost::edges_are_unsorted_multi_pass, path_edges.begin(), path_edges.end(), sections.begin(), 5 );
+    std::vector<Road::Edge> e( num_edges( graph ) );
+    Road::EdgeIterator ei, ei_end;
+    for ( boost::tie( ei, ei_end ) = edges( graph ); ei != ei_end; ei++ ) {
+        e[source( *ei, graph )] = *ei;
+    }
+
+    const double inf = std::numeric_limits<double>::infinity();
+    Road::Restrictions restrictions( graph );
+    auto add = [&]( db_id_t id, const Road::Restriction::EdgeSequence& seq, const Road::Restriction::CostPerTransport& costs ) {
+        restrictions.add_restriction( Road::Restriction( id, seq, costs ) );
+    };
+    Road::Restriction::CostPerTransport c012, c12, c01, c23, c23_bis;
+    c012[TrafficRuleCar] = 100.0;
+    c12[TrafficRuleCar] = inf;
+    c12[TrafficRulePedestrian] = 30.0;
+    c01[TrafficRulePedestrian] = 20.0;
+    c23[TrafficRuleCar] = 10.0;
+    c23_bis[TrafficRuleCar] = 40.0;
+    add( 1, { e[0], e[1], e[2] }, c012 );
+    // suffix of the first sequence, with a higher car penalty
+    add( 2, { e[1], e[2] }, c12 );
+    // prefix of the first sequence
+    add( 3, { e[0], e[1] }, c01 );
+    // overlaps the end of the first sequence
+    add( 4, { e[2], e[3] }, c23 );
+    // the same sequence, with a higher penalty
+    add( 5, { e[2], e[3] }, c23_bis );
+
+    typedef Automaton<Road::Edge> RoadAutomaton;
+    RoadAutomaton automaton;
+    automaton.build_graph( restrictions );
+    const RoadAutomaton::Graph& agraph = automaton.automaton_graph_;
+    const RoadAutomaton::State initial = automaton.initial_state_;
+    // 0, 01, 012, 1, 12, 2, 23 and the initial state
+    BOOST_CHECK_EQUAL( num_vertices( agraph ), 8 );
+
+    auto next = [&]( RoadAutomaton::State q, uint32_t i ) {
+        std::pair<RoadAutomaton::State, bool> t = automaton.find_transition( q, e[i] );
+        BOOST_CHECK( t.second == ( t.first != initial ) );
+        return t.first;
+    };
+
+    const RoadAutomaton::State s0 = next( initial, 0 );
+    BOOST_CHECK( s0 != initial );
+    BOOST_CHECK( agraph[s0].penalty_per_mode.empty() );
+
+    const RoadAutomaton::State s01 = next( s0, 1 );
+    BOOST_CHECK( s01 != initial );
+    BOOST_CHECK_EQUAL( penalty( agraph, s01, TrafficRulePedestrian ), 20.0 );
+    BOOST_CHECK_EQUAL( penalty( agraph, s01, TrafficRuleCar ), 0.0 );
+
+    // the suffix 12 adds its pedestrian penalty and its higher car penalty
+    const RoadAutomaton::State s012 = next( s01, 2 );
+    BOOST_CHECK( s012 != initial );
+    BOOST_CHECK_EQUAL( agraph[s012].penalty_per_mode.size(), 2 );
+    BOOST_CHECK_EQUAL( penalty( agraph, s012, TrafficRuleCar ), inf );
+    BOOST_CHECK_EQUAL( penalty( agraph, s012, TrafficRulePedestrian ), 30.0 );
+
+    // the sequence 12 alone, without the prefix
+    const RoadAutomaton::State s1 = next( initial, 1 );
+    BOOST_CHECK( s1 != initial && s1 != s01 );
+    const RoadAutomaton::State s12 = next( s1, 2 );
+    BOOST_CHECK( s12 != s012 );
+    BOOST_CHECK_EQUAL( penalty( agraph, s12, TrafficRuleCar ), inf );
+    BOOST_CHECK_EQUAL( penalty( agraph, s12, TrafficRulePedestrian ), 30.0 );
+
+    // 0123 goes on with the overlapping sequence 23, through the failure function
+    const RoadAutomaton::State s23 = next( s012, 3 );
+    BOOST_CHECK( s23 != initial );
+    BOOST_CHECK_EQUAL( next( next( initial, 2 ), 3 ), s23 );
+    BOOST_CHECK_EQUAL( penalty( agraph, s23, TrafficRuleCar ), 40.0 );
+    BOOST_CHECK_EQUAL( penalty( agraph, s23, TrafficRulePedestrian ), 0.0 );
+    BOOST_CHECK_EQUAL( penalty( agraph, s23, TrafficRuleCar | TrafficRulePedestrian ), 40.0 );
+
+    // a miss falls back on the transitions of the initial state
+    BOOST_CHECK_EQUAL( next( s23, 0 ), s0 );
+    BOOST_CHECK_EQUAL( next( s0, 2 ), next( initial, 2 ) );
+    BOOST_CHECK_EQUAL( next( s0, 3 ), initial );
+    BOOST_CHECK_EQUAL( next( initial, 3 ), initial );
+}
+
+BOOST_AUTO_TEST_CASE( testTurnGraph )
+{
+    // 6x6 grid of two-way sections, some of them closed to cars
+    const uint32_t side = 6;
+    const uint32_t n = side * side;
+    std::mt19937 rng( 7 );
+    Road::Graph graph = grid_road_graph( side, [&]( uint32_t, uint32_t ) {
+        Road::Section s;
+        s.set_length( 100.0f + rng() % 400 );
+        s.set_traffic_rules( TrafficRulePedestrian | ( rng() % 8 ? TrafficRuleCar : 0 ) );
+        return s;
+    } );
+    std::vector<Road::Edge> road_edges( num_edges( graph ) );
+    Road::EdgeIterator ei, ei_end;
+    for ( boost::tie( ei, ei_end ) = edges( graph ); ei != ei_end; ei++ ) {
+        road_edges[ei->idx] = *ei;
+    }
+
+    // forbidden or penalized sequences of two or three sections, some of them for pedestrians only
+    const double inf = std::numeric_limits<double>::infinity();
+    Road::Restrictions restrictions( graph );
+    std::vector<std::pair<std::vector<uint32_t>, double>> car_restrictions;
+    for ( int k = 0; k < 40; k++ ) {
+        std::vector<uint32_t> seq( 1, rng() % road_edges.size() );
+        const size_t length = 2 + rng() % 2;
+        while ( seq.size() < length ) {
+            Road::OutEdgeIterator oi, oi_end;
+            boost::tie( oi, oi_end ) = out_edges( target( road_edges[seq.back()], graph ), graph );
+            std::advance( oi, rng() % std::distance( oi, oi_end ) );
+            seq.push_back( oi->idx );
+        }
+        const double cost = rng() % 3 ? inf : 50.0 + rng() % 100;
+        const unsigned rules = rng() % 5 ? TrafficRuleCar : TrafficRulePedestrian;
+        Road::Restriction::EdgeSequence edge_seq;
+        for ( uint32_t e : seq ) {
+            edge_seq.push_back( road_edges[e] );
+        }
+        Road::Restriction::CostPerTransport costs;
+        costs[rules] = cost;
+        restrictions.add_restriction( Road::Restriction( k, edge_seq, costs ) );
+        if ( rules == TrafficRuleCar ) {
+            car_restrictions.push_back( std::make_pair( seq, cost ) );
+        }
+    }
+
+    auto length = [&]( uint32_t e ) { return double( graph[road_edges[e]].length() ); };
+    auto car_allowed = [&]( uint32_t e ) { return ( graph[road_edges[e]].traffic_rules() & TrafficRuleCar ) != 0; };
+    // penalty of the turn from b to f, after a (or none)
+    const uint32_t none = std::numeric_limits<uint32_t>::max();
+    auto penalty = [&]( uint32_t a, uint32_t b, uint32_t f ) {
+        std::vector<uint32_t> h;
+        if ( a != none ) {
+            h.push_back( a );
+        }
+        h.push_back( b );
+        h.push_back( f );
+        double p = 0.0;
+        for ( const auto& r : car_restrictions ) {
+            if ( r.first.size() <= h.size() && std::equal( r.first.begin(), r.first.end(), h.end() - r.first.size() ) ) {
+                p = std::max( p, r.second );
+            }
+        }
+        return p;
+    };
+
+    TurnGraph turns( graph, restrictions, TrafficRuleCar );
+    BOOST_CHECK_GE( turns.num_nodes(), num_edges( graph ) );
+
+    // reference: Dijkstra on (previous section, section) pairs, numbered section * (m + 1) + previous, previous = m if none
+    const uint32_t m = uint32_t( num_edges( graph ) );
+    auto pair_node = [&]( uint32_t a, uint32_t b ) { return b * ( m + 1 ) + ( a == none ? m : a ); };
+    for ( uint32_t origin = 0; origin < n; origin++ ) {
+        ReferenceArcs pair_origins, turn_origins;
+        Road::OutEdgeIterator oi, oi_end;
+        for ( boost::tie( oi, oi_end ) = out_edges( origin, graph ); oi != oi_end; oi++ ) {
+            if ( car_allowed( oi->idx ) ) {
+                pair_origins.push_back( std::make_pair( pair_node( none, oi->idx ), length( oi->idx ) ) );
+                // a path on the turn graph starts on the node of the section itself
+                turn_origins.push_back( std::make_pair( uint32_t( oi->idx ), length( oi->idx ) ) );
+            }
+        }
+        std::vector<double> pair_cost = reference_dijkstra( size_t( m ) * ( m + 1 ), pair_origins, [&]( uint32_t x, double c, ReferenceArcs& next ) {
+            const uint32_t a = x % ( m + 1 ) == m ? none : x % ( m + 1 );
+            const uint32_t b = x / ( m + 1 );
+            Road::OutEdgeIterator fi, fi_end;
+            for ( boost::tie( fi, fi_end ) = out_edges( target( road_edges[b], graph ), graph ); fi != fi_end; fi++ ) {
+                const double p = penalty( a, b, fi->idx );
+                if ( car_allowed( fi->idx ) && p != inf ) {
+                    next.push_back( std::make_pair( pair_node( b, fi->idx ), c + p + length( fi->idx ) ) );
+                }
+            }
+        } );
+        std::vector<double> expected( n, inf );
+        for ( uint32_t x = 0; x < pair_cost.size(); x++ ) {
+            const Road::Vertex v = target( road_edges[x / ( m + 1 )], graph );
+            expected[v] = std::min( expected[v], pair_cost[x] );
+        }
+
+        std::vector<double> turn_cost = reference_dijkstra( turns.num_nodes(), turn_origins, [&]( uint32_t x, double c, ReferenceArcs& next ) {
+            for ( uint32_t t = turns.first_turn( x ); t < turns.first_turn( x + 1 ); t++ ) {
+                const TurnGraph::Node y = turns.turn_target( t );
+                next.push_back( std::make_pair( y, c + turns.turn_penalty( t ) + length( turns.road_edge( y ).idx ) ) );
+            }
+        } );
+        std::vector<double> found( n, inf );
+        for ( TurnGraph::Node x = 0; x < turns.num_nodes(); x++ ) {
+            const Road::Vertex v = target( turns.road_edge( x ), graph );
+            found[v] = std::min( found[v], turn_cost[x] );
+        }
+
+        for ( uint32_t v = 0; v < n; v++ ) {
+            if ( expected[v] == inf ) {
+                BOOST_CHECK_EQUAL( found[v], inf );
+            }
+            else {
+                BOOST_CHECK_SMALL( found[v] - expected[v], 1e-6 );
+            }
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_AUTO_TEST_SUITE( tempus_ch_query )
@@ -917,5 +1256,1318 @@ BOOST_AUTO_TEST_CASE( testCHQuery )
     }
 }
 
+// 0 -(1)- 1 -(2)- 3 -(1)- 2 -(5)- 0, with vertices given in CH order
+std::unique_ptr<CHRoutingData> build_test_ch_routing_data()
+{
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    edges.push_back( std::make_pair( (uint32_t)0, (uint32_t)(1) ) );
+    edges.push_back( std::make_pair( (uint32_t)0, (uint32_t)(2) ) );
+    edges.push_back( std::make_pair( (uint32_t)0, (uint32_t)(1) ) );
+    edges.push_back( std::make_pair( (uint32_t)0, (uint32_t)(2) ) );
+    edges.push_back( std::make_pair( (uint32_t)1, (uint32_t)(3) ) );
+    edges.push_back( std::make_pair( (uint32_t)1, (uint32_t)(3) ) );
+    edges.push_back( std::make_pair( (uint32_t)2, (uint32_t)(3) ) );
+    edges.push_back( std::make_pair( (uint32_t)2, (uint32_t)(3) ) );
+
+    int degrees[] = { 2, 1, 1, 0 };
+    int costs[] = { 100, 500, 100, 500, 200, 200, 100, 100 };
+
+    std::vector<CHEdgeProperty> props;
+    for ( size_t i = 0; i < edges.size(); i++ ) {
+        CHEdgeProperty p;
+        p.b.cost = costs[i];
+        p.b.is_shortcut = 0;
+        p.middle_node = 0;
+        p.db_id = i + 1;
+        props.push_back( p );
+    }
+    std::unique_ptr<CHQuery> graph( new CHQuery( edges.begin(), edges.end(), 4, (uint*)degrees, &props[0] ) );
+    std::vector<db_id_t> node_id = { 10, 11, 12, 13 };
+    return std::unique_ptr<CHRoutingData>( new CHRoutingData( std::move( graph ), std::move( node_id ) ) );
+}
+
+BOOST_AUTO_TEST_CASE( testCHDistanceTable )
+{
+    std::unique_ptr<CHRoutingData> prd( build_test_ch_routing_data() );
+    const CHRoutingData& rd = *prd;
+
+    CHDistanceTable table = ch_distance_table_from_ids( rd, { 10, 12, 13 }, { 10, 11, 12, 13 } );
+    BOOST_CHECK_EQUAL( table.n_origins(), 3 );
+    BOOST_CHECK_EQUAL( table.n_destinations(), 4 );
+
+    float expected[3][4] = { { 0.0, 1.0, 4.0, 3.0 },
+                             { 4.0, 3.0, 0.0, 1.0 },
+                             { 3.0, 2.0, 1.0, 0.0 } };
+    for ( size_t i = 0; i < 3; i++ ) {
+        for ( size_t j = 0; j < 4; j++ ) {
+            BOOST_CHECK_CLOSE( table.cost( i, j ), expected[i][j], 1e-4 );
+        }
+    }
+
+    BOOST_CHECK_THROW( ch_distance_table_from_ids( rd, { 10 }, { 42 } ), std::invalid_argument );
+}
+
+BOOST_AUTO_TEST_CASE( testCHOneToAll )
+{
+    std::unique_ptr<CHRoutingData> prd( build_test_ch_routing_data() );
+    const CHRoutingData& rd = *prd;
+
+    float expected[4][4] = { { 0.0, 1.0, 4.0, 3.0 },
+                             { 1.0, 0.0, 3.0, 2.0 },
+                             { 4.0, 3.0, 0.0, 1.0 },
+                             { 3.0, 2.0, 1.0, 0.0 } };
+
+    for ( CHVertex o = 0; o < 4; o++ ) {
+        std::vector<float> costs = ch_one_to_all( rd, o );
+        BOOST_REQUIRE_EQUAL( costs.size(), 4 );
+        for ( size_t v = 0; v < 4; v++ ) {
+            BOOST_CHECK_CLOSE( costs[v], expected[o][v], 1e-4 );
+        }
+    }
+
+    // more origins than lanes
+    std::vector<CHVertex> origins;
+    for ( size_t i = 0; i < CH_ONE_TO_ALL_LANES + 2; i++ ) {
+        origins.push_back( i % 4 );
+    }
+    std::vector<std::vector<float>> all_costs = ch_many_to_all( rd, origins );
+    BOOST_REQUIRE_EQUAL( all_costs.size(), origins.size() );
+    for ( size_t i = 0; i < origins.size(); i++ ) {
+        for ( size_t v = 0; v < 4; v++ ) {
+            BOOST_CHECK_CLOSE( all_costs[i][v], expected[origins[i]][v], 1e-4 );
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( testCHUnpackEdge )
+{
+    // 1 -(1)- 0 -(1)- 2, 0 is contracted first and a shortcut 1 - 2 is created
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    edges.push_back( std::make_pair( (uint32_t)0, (uint32_t)(1) ) );
+    edges.push_back( std::make_pair( (uint32_t)0, (uint32_t)(2) ) );
+    edges.push_back( std::make_pair( (uint32_t)0, (uint32_t)(1) ) );
+    edges.push_back( std::make_pair( (uint32_t)0, (uint32_t)(2) ) );
+    edges.push_back( std::make_pair( (uint32_t)1, (uint32_t)(2) ) );
+    edges.push_back( std::make_pair( (uint32_t)1, (uint32_t)(2) ) );
+
+    int degrees[] = { 2, 1, 0 };
+    int costs[] = { 100, 100, 100, 100, 200, 200 };
+    // original edges 0 -> 1, 0 -> 2, 1 -> 0, 2 -> 0
+    db_id_t ids[] = { 1, 2, 3, 4, 0, 0 };
+
+    std::vector<CHEdgeProperty> props;
+    for ( size_t i = 0; i < edges.size(); i++ ) {
+        CHEdgeProperty p;
+        p.b.cost = costs[i];
+        p.b.is_shortcut = i >= 4 ? 1 : 0;
+        p.middle_node = 0;
+        p.db_id = ids[i];
+        props.push_back( p );
+    }
+    std::unique_ptr<CHQuery> graph( new CHQuery( edges.begin(), edges.end(), 3, (uint*)degrees, &props[0] ) );
+    std::vector<db_id_t> node_id = { 10, 11, 12 };
+    CHRoutingData rd( std::move( graph ), std::move( node_id ) );
+
+    for ( size_t top = 0; top < 4; top += 3 ) {
+        rd.precompute_unpacked_shortcuts( top );
+        std::vector<CHEdge> path;
+        CHEdge e;
+        bool found = false;
+        boost::tie( e, found ) = edge( (CHVertex)1, (CHVertex)2, rd.ch_query() );
+        BOOST_REQUIRE( found );
+        rd.unpack_edge( e, path );
+        BOOST_REQUIRE_EQUAL( path.size(), 2 );
+        BOOST_CHECK_EQUAL( path[0].property().db_id, 3 );
+        BOOST_CHECK_EQUAL( path[1].property().db_id, 2 );
+
+        path.clear();
+        boost::tie( e, found ) = edge( (CHVertex)2, (CHVertex)1, rd.ch_query() );
+        BOOST_REQUIRE( found );
+        rd.unpack_edge( e, path );
+        BOOST_REQUIRE_EQUAL( path.size(), 2 );
+        BOOST_CHECK_EQUAL( path[0].property().db_id, 4 );
+        BOOST_CHECK_EQUAL( path[1].property().db_id, 1 );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( testCCHCustomization )
+{
+    // 5x5 grid of 100m sections, walkable everywhere
+    // cars can only use the rows and the first column, at 36 km/h
+    const uint32_t side = 5;
+    const uint32_t n = side * side;
+    std::vector<Point2D> coordinates;
+    for ( uint32_t v = 0; v < n; v++ ) {
+        coordinates.push_back( Point2D( float(v % side), float(v / side) ) );
+    }
+    const std::vector<std::pair<uint32_t, uint32_t>> grid = grid_edges( side );
+
+    std::vector<uint32_t> order = nested_dissection_order( coordinates, grid );
+    BOOST_REQUIRE_EQUAL( order.size(), n );
+    std::vector<uint32_t> rank( n, n );
+    for ( uint32_t i = 0; i < n; i++ ) {
+        BOOST_REQUIRE( order[i] < n && rank[order[i]] == n );
+        rank[order[i]] = i;
+    }
+
+    std::vector<CCHSection> sections;
+    for ( const auto& e : grid ) {
+        bool car = e.second == e.first + 1 || e.first % side == 0;
+        for ( int dir = 0; dir < 2; dir++ ) {
+            CCHSection s;
+            s.from = rank[dir ? e.second : e.first];
+            s.to = rank[dir ? e.first : e.second];
+            s.length = 100.0;
+            s.car_speed_limit = 36.0;
+            s.traffic_rules = TrafficRulePedestrian | ( car ? TrafficRuleCar : 0 );
+            s.db_id = sections.size() + 1;
+            sections.push_back( s );
+        }
+    }
+    std::vector<db_id_t> node_id;
+    for ( uint32_t i = 0; i < n; i++ ) {
+        node_id.push_back( order[i] + 100 );
+    }
+    CCHRoutingData cch( std::move( node_id ), std::vector<CCHSection>( sections ) );
+
+    // reference durations (s), by Dijkstra on the grid
+    auto reference = [&]( uint16_t traffic_rule, float speed ) {
+        std::vector<float> d;
+        for ( uint32_t o = 0; o < n; o++ ) {
+            std::vector<double> c = reference_dijkstra( n, ReferenceArcs( 1, std::make_pair( o, 0.0 ) ), [&]( uint32_t u, double cu, ReferenceArcs& next ) {
+                for ( const CCHSection& s : sections ) {
+                    if ( s.from == u && ( s.traffic_rules & traffic_rule ) ) {
+                        next.push_back( std::make_pair( s.to, cu + s.length / ( speed / 3.6 ) ) );
+                    }
+                }
+            } );
+            for ( double x : c ) {
+                d.push_back( x == std::numeric_limits<double>::infinity() ? CHDistanceTable::infinity() : float( x ) );
+            }
+        }
+        return d;
+    };
+
+    std::vector<CHVertex> all( n );
+    for ( uint32_t v = 0; v < n; v++ ) {
+        all[v] = v;
+    }
+    std::vector<float> walk = reference( TrafficRulePedestrian, 3.6f );
+    std::vector<float> car = reference( TrafficRuleCar, 36.0f );
+    CHDistanceTable walk_table = ch_distance_table( cch.metric( TransportModeWalking ), all, all );
+    CHDistanceTable car_table = ch_distance_table( cch.metric( TransportModePrivateCar ), all, all );
+    for ( uint32_t o = 0; o < n; o++ ) {
+        for ( uint32_t d = 0; d < n; d++ ) {
+            BOOST_CHECK_CLOSE( walk_table.cost( o, d ), walk[o * n + d], 1e-3 );
+            BOOST_CHECK_CLOSE( car_table.cost( o, d ), car[o * n + d], 1e-3 );
+        }
+    }
+    // no bicycle rule
+    BOOST_CHECK_EQUAL( ch_one_to_all( cch.metric( TransportModePrivateBicycle ), 0 )[1], CHDistanceTable::infinity() );
+
+    // re-customization with another walking speed
+    std::unique_ptr<CHRoutingData> faster = cch.customize( TransportModeWalking, [] { CCHSpeeds s; s.walking_speed = 7.2f; return s; }() );
+    CHDistanceTable faster_table = ch_distance_table( *faster, all, all );
+    for ( uint32_t o = 0; o < n; o++ ) {
+        for ( uint32_t d = 0; d < n; d++ ) {
+            BOOST_CHECK_CLOSE( faster_table.cost( o, d ), walk[o * n + d] / 2.0, 1e-3 );
+        }
+    }
+
+    BOOST_CHECK_THROW( cch.metric( TransportModeTaxi ), std::invalid_argument );
+}
+
+BOOST_AUTO_TEST_CASE( testTravelTimeFunction )
+{
+    typedef TravelTimeFunction::Point P;
+    // 10 minutes, up to 20 minutes at 8:00, back to 10 minutes at 10:00
+    TravelTimeFunction f( std::vector<P>{ P{ 420.0, 10.0 }, P{ 480.0, 20.0 }, P{ 600.0, 10.0 } } );
+    TravelTimeFunction g( std::vector<P>{ P{ 400.0, 15.0 }, P{ 500.0, 5.0 }, P{ 550.0, 5.0 }, P{ 700.0, 12.0 } } );
+
+    BOOST_CHECK_EQUAL( f( 0.0 ), 10.0 );
+    BOOST_CHECK_CLOSE( f( 450.0 ), 15.0, 1e-9 );
+    BOOST_CHECK_EQUAL( f( 2000.0 ), 10.0 );
+    BOOST_CHECK_EQUAL( f.min(), 10.0 );
+    BOOST_CHECK_EQUAL( f.max(), 20.0 );
+
+    // collinear breakpoints are removed
+    TravelTimeFunction c( std::vector<P>{ P{ 0.0, 1.0 }, P{ 10.0, 2.0 }, P{ 20.0, 3.0 }, P{ 30.0, 3.0 } } );
+    BOOST_CHECK_EQUAL( c.points().size(), 3 );
+
+    TravelTimeFunction fg = f.link( g );
+    TravelTimeFunction m = f.merge( g );
+    bool improves;
+    f.merge( TravelTimeFunction( 25.0 ), &improves );
+    BOOST_CHECK( !improves );
+    f.merge( g, &improves );
+    BOOST_CHECK( improves );
+    for ( double t = 300.0; t < 800.0; t += 0.25 ) {
+        BOOST_CHECK_SMALL( fg( t ) - ( f( t ) + g( t + f( t ) ) ), 1e-6 );
+        BOOST_CHECK_SMALL( m( t ) - std::min( f( t ), g( t ) ), 1e-6 );
+    }
+
+    std::stringstream ss;
+    fg.serialize( ss, binary_serialization_t() );
+    TravelTimeFunction fg2;
+    fg2.unserialize( ss, binary_serialization_t() );
+    BOOST_CHECK_EQUAL( fg2.points().size(), fg.points().size() );
+    BOOST_CHECK_EQUAL( fg2( 512.0 ), fg( 512.0 ) );
+}
+
+BOOST_AUTO_TEST_CASE( testTCHQuery )
+{
+    // 6x6 grid, with random travel time functions in both directions
+    // and a random contraction order
+    const uint32_t side = 6;
+    const uint32_t n = side * side;
+    std::mt19937 gen( 42 );
+    std::uniform_real_distribution<double> travel_time( 1.0, 10.0 );
+
+    std::vector<uint32_t> rank( n );
+    for ( uint32_t v = 0; v < n; v++ ) {
+        rank[v] = v;
+    }
+    std::shuffle( rank.begin(), rank.end(), gen );
+
+    std::vector<TCHSection> sections;
+    for ( const auto& e : grid_edges( side ) ) {
+        for ( int dir = 0; dir < 2; dir++ ) {
+            // one breakpoint per hour, slopes are greater than -1
+            std::vector<TravelTimeFunction::Point> points;
+            for ( int h = 0; h <= 24; h++ ) {
+                points.push_back( TravelTimeFunction::Point{ h * 60.0, travel_time( gen ) } );
+            }
+            TCHSection s;
+            s.from = rank[dir ? e.second : e.first];
+            s.to = rank[dir ? e.first : e.second];
+            s.db_id = sections.size() + 1;
+            s.travel_time = TravelTimeFunction( std::move( points ) );
+            sections.push_back( s );
+        }
+    }
+    std::vector<db_id_t> node_id;
+    for ( uint32_t i = 0; i < n; i++ ) {
+        node_id.push_back( i + 100 );
+    }
+    TCHRoutingData tch( std::move( node_id ), sections );
+
+    // reference earliest arrival times, by time-dependent Dijkstra
+    auto reference = [&]( uint32_t origin, double departure_time ) {
+        return reference_dijkstra( n, ReferenceArcs( 1, std::make_pair( origin, departure_time ) ), [&]( uint32_t u, double t, ReferenceArcs& next ) {
+            for ( const TCHSection& s : sections ) {
+                if ( s.from == u ) {
+                    next.push_back( std::make_pair( s.to, t + s.travel_time( t ) ) );
+                }
+            }
+        } );
+    };
+
+    std::stringstream ss;
+    tch.serialize( ss, binary_serialization_t() );
+    TCHRoutingData tch2;
+    tch2.unserialize( ss, binary_serialization_t() );
+    BOOST_CHECK_EQUAL( tch2.num_edges(), tch.num_edges() );
+    BOOST_CHECK_EQUAL( tch2.vertex_from_id( 107 ).get(), 7 );
+
+    for ( double departure_time : { 0.0, 437.5, 1000.0, 1500.0 } ) {
+        for ( uint32_t o = 0; o < n; o++ ) {
+            std::vector<double> arrival = reference( o, departure_time );
+            for ( uint32_t d = 0; d < n; d++ ) {
+                std::vector<TCHRoutingData::PathStep> path;
+                double tt = tch.query( o, d, departure_time, &path );
+                BOOST_CHECK_SMALL( tt - ( arrival[d] - departure_time ), 1e-6 );
+                BOOST_CHECK_EQUAL( tch2.query( o, d, departure_time ), tt );
+
+                // the path is made of consecutive sections
+                double t = departure_time;
+                uint32_t v = o;
+                for ( const TCHRoutingData::PathStep& step : path ) {
+                    const TCHSection& s = sections[step.section_id - 1];
+                    BOOST_CHECK_EQUAL( s.from, v );
+                    BOOST_CHECK_SMALL( step.departure_time - t, 1e-6 );
+                    BOOST_CHECK_SMALL( step.travel_time - s.travel_time( t ), 1e-6 );
+                    t += step.travel_time;
+                    v = s.to;
+                }
+                BOOST_CHECK_EQUAL( v, d );
+                BOOST_CHECK_SMALL( t - arrival[d], 1e-6 );
+            }
+        }
+    }
+}
+
+// CH query graph out of the original arcs of a contracted graph and its shortcuts, with vertices given in CH order
+std::unique_ptr<CHRoutingData> ch_routing_data_from_contraction( uint32_t n, const std::vector<Shortcut>& arcs, const std::vector<Shortcut>& shortcuts )
+{
+    // (lower vertex, dir, upper vertex, cost), the cheapest first
+    std::vector<std::tuple<uint32_t, int, uint32_t, TCost>> query_edges;
+    for ( const std::vector<Shortcut>* v : { &arcs, &shortcuts } ) {
+        for ( const Shortcut& s : *v ) {
+            query_edges.push_back( std::make_tuple( std::min( s.from, s.to ), s.from < s.to ? 0 : 1, std::max( s.from, s.to ), s.cost ) );
+        }
+    }
+    std::sort( query_edges.begin(), query_edges.end() );
+
+    std::vector<std::pair<uint32_t, uint32_t>> targets;
+    std::vector<CHEdgeProperty> properties;
+    std::vector<uint32_t> up_degrees( n, 0 );
+    for ( size_t i = 0; i < query_edges.size(); i++ ) {
+        uint32_t id1, id2;
+        int dir;
+        TCost cost;
+        std::tie( id1, dir, id2, cost ) = query_edges[i];
+        if ( i > 0 && std::get<0>( query_edges[i-1] ) == id1 && std::get<1>( query_edges[i-1] ) == dir && std::get<2>( query_edges[i-1] ) == id2 ) {
+            continue;
+        }
+        if ( dir == 0 ) {
+            up_degrees[id1]++;
+        }
+        CHEdgeProperty p;
+        p.b.cost = cost;
+        p.b.is_shortcut = 0;
+        p.middle_node = 0;
+        p.db_id = 0;
+        targets.push_back( std::make_pair( id1, id2 ) );
+        properties.push_back( p );
+    }
+    std::unique_ptr<CHQuery> ch_query( new CHQuery( targets.begin(), targets.end(), n, up_degrees.begin(), properties.begin() ) );
+    std::vector<db_id_t> node_id( n );
+    for ( uint32_t v = 0; v < n; v++ ) {
+        node_id[v] = v;
+    }
+    return std::unique_ptr<CHRoutingData>( new CHRoutingData( std::move( ch_query ), std::move( node_id ) ) );
+}
+
+BOOST_AUTO_TEST_CASE( testParallelContraction )
+{
+    const uint32_t side = 8;
+    const uint32_t n = side * side;
+
+    // grid with various costs, contracted in a shuffled order
+    std::vector<uint32_t> rank( n );
+    for ( uint32_t v = 0; v < n; v++ ) {
+        rank[v] = v;
+    }
+    std::mt19937 gen( 42 );
+    std::shuffle( rank.begin(), rank.end(), gen );
+    std::uniform_int_distribution<TCost> cost_dist( 100, 1000 );
+    std::vector<Shortcut> arcs;
+    for ( const auto& e : grid_edges( side ) ) {
+        arcs.push_back( Shortcut{ rank[e.first], rank[e.second], cost_dist( gen ), 0 } );
+        arcs.push_back( Shortcut{ rank[e.second], rank[e.first], cost_dist( gen ), 0 } );
+    }
+
+    std::vector<double> reference;
+    for ( uint32_t o = 0; o < n; o++ ) {
+        std::vector<double> c = reference_dijkstra( n, ReferenceArcs( 1, std::make_pair( o, 0.0 ) ), [&]( uint32_t u, double cu, ReferenceArcs& next ) {
+                for ( const Shortcut& a : arcs ) {
+                    if ( a.from == u ) {
+                        next.push_back( std::make_pair( a.to, cu + a.cost / 100.0 ) );
+                    }
+                }
+            } );
+        reference.insert( reference.end(), c.begin(), c.end() );
+    }
+
+    std::vector<CHVertex> all( n );
+    for ( uint32_t v = 0; v < n; v++ ) {
+        all[v] = v;
+    }
+
+#ifdef _OPENMP
+    const int max_threads = omp_get_max_threads();
+#endif
+    std::vector<Shortcut> first_shortcuts;
+    for ( int n_threads : { 1, 4 } ) {
+#ifdef _OPENMP
+        omp_set_num_threads( n_threads );
+#endif
+        CHGraph graph( n );
+        for ( const Shortcut& a : arcs ) {
+            graph.add_edge( a.from, a.to, a.cost );
+        }
+        std::vector<Shortcut> shortcuts = contract_graph( graph, /* parallel */ true );
+        BOOST_CHECK_EQUAL( graph.num_edges(), 0 );
+
+        // shortcuts do not depend on the number of threads
+        if ( n_threads == 1 ) {
+            first_shortcuts = shortcuts;
+        }
+        else {
+            BOOST_REQUIRE_EQUAL( shortcuts.size(), first_shortcuts.size() );
+            for ( size_t i = 0; i < shortcuts.size(); i++ ) {
+                BOOST_CHECK_EQUAL( shortcuts[i].from, first_shortcuts[i].from );
+                BOOST_CHECK_EQUAL( shortcuts[i].to, first_shortcuts[i].to );
+                BOOST_CHECK_EQUAL( shortcuts[i].cost, first_shortcuts[i].cost );
+                BOOST_CHECK_EQUAL( shortcuts[i].contracted, first_shortcuts[i].contracted );
+            }
+        }
+
+        std::unique_ptr<CHRoutingData> rd = ch_routing_data_from_contraction( n, arcs, shortcuts );
+        CHDistanceTable table = ch_distance_table( *rd, all, all );
+        for ( uint32_t o = 0; o < n; o++ ) {
+            for ( uint32_t d = 0; d < n; d++ ) {
+                BOOST_CHECK_CLOSE( table.cost( o, d ), reference[o * n + d], 1e-3 );
+            }
+        }
+    }
+#ifdef _OPENMP
+    omp_set_num_threads( max_threads );
+#endif
+}
+
+BOOST_AUTO_TEST_CASE( testCHGraph )
+{
+    CHGraph graph( 3 );
+    BOOST_CHECK( graph.add_edge( 0, 1, 10 ) );
+    // the lowest weight is kept
+    BOOST_CHECK( !graph.add_edge( 0, 1, 5 ) );
+    BOOST_CHECK( !graph.add_edge( 0, 1, 8 ) );
+    BOOST_CHECK_EQUAL( graph.edge_weight( 0, 1 ), 5 );
+    BOOST_CHECK_EQUAL( graph.in_arcs( 1 ).first->weight, 5 );
+    graph.set_edge( 0, 1, 8 );
+    BOOST_CHECK_EQUAL( graph.edge_weight( 0, 1 ), 8 );
+    BOOST_CHECK_EQUAL( graph.in_arcs( 1 ).first->weight, 8 );
+    BOOST_CHECK_EQUAL( graph.edge_weight( 1, 0 ), 0 );
+    BOOST_CHECK_EQUAL( graph.num_edges(), 1 );
+
+    // out arcs of 0 and in arcs of 2 outgrow their blocks several times
+    const CHVertex n = 40;
+    while ( graph.num_vertices() < n ) {
+        graph.add_vertex();
+    }
+    for ( CHVertex v = 2; v < n; v++ ) {
+        BOOST_CHECK( graph.add_edge( 0, v, TCost( v ) ) );
+        if ( v > 2 ) {
+            BOOST_CHECK( graph.add_edge( v, 2, TCost( 100 + v ) ) );
+        }
+    }
+    auto check_arcs = [&]() {
+        BOOST_CHECK_EQUAL( graph.num_edges(), 2 * n - 4 );
+        BOOST_CHECK_EQUAL( graph.out_degree( 0 ), n - 1 );
+        BOOST_CHECK_EQUAL( graph.in_degree( 2 ), n - 2 );
+        for ( CHVertex v = 2; v < n; v++ ) {
+            BOOST_CHECK_EQUAL( graph.edge_weight( 0, v ), TCost( v ) );
+            BOOST_CHECK_EQUAL( graph.in_degree( v ), ( v == 2 ? n - 2 : 1 ) );
+            if ( v > 2 ) {
+                BOOST_CHECK_EQUAL( graph.edge_weight( v, 2 ), TCost( 100 + v ) );
+                BOOST_CHECK_EQUAL( graph.out_degree( v ), 1 );
+            }
+        }
+        // in arcs mirror out arcs
+        for ( CHVertex v = 0; v < n; v++ ) {
+            for ( const CHGraph::Arc& a : pair_range( graph.in_arcs( v ) ) ) {
+                BOOST_CHECK_EQUAL( graph.edge_weight( a.vertex, v ), a.weight );
+            }
+        }
+    };
+    check_arcs();
+    graph.compact();
+    check_arcs();
+
+    // removal
+    graph.clear_vertex( 2 );
+    BOOST_CHECK_EQUAL( graph.num_edges(), n - 2 );
+    BOOST_CHECK_EQUAL( graph.out_degree( 2 ), 0 );
+    BOOST_CHECK_EQUAL( graph.in_degree( 2 ), 0 );
+    BOOST_CHECK_EQUAL( graph.out_degree( 0 ), n - 2 );
+    BOOST_CHECK_EQUAL( graph.edge_weight( 0, 2 ), 0 );
+    for ( CHVertex v = 3; v < n; v++ ) {
+        BOOST_CHECK_EQUAL( graph.out_degree( v ), 0 );
+        BOOST_CHECK_EQUAL( graph.edge_weight( 0, v ), TCost( v ) );
+    }
+    graph.compact();
+    BOOST_CHECK_EQUAL( graph.num_edges(), n - 2 );
+    BOOST_CHECK_EQUAL( graph.edge_weight( 0, n - 1 ), TCost( n - 1 ) );
+    BOOST_CHECK( graph.add_edge( 2, 1, 7 ) );
+    BOOST_CHECK_EQUAL( graph.edge_weight( 2, 1 ), 7 );
+
+    graph.clear();
+    BOOST_CHECK_EQUAL( graph.num_vertices(), 0 );
+    BOOST_CHECK_EQUAL( graph.num_edges(), 0 );
+}
+
+BOOST_AUTO_TEST_CASE( testCHGraphShortcuts )
+{
+    // 4x4 grid contracted in a shuffled order
+    const uint32_t side = 4;
+    const uint32_t n = side * side;
+    CHGraph graph( n );
+    for ( const auto& e : grid_edges( side ) ) {
+        for ( int dir = 0; dir < 2; dir++ ) {
+            uint32_t v = dir ? e.second : e.first;
+            uint32_t w = dir ? e.first : e.second;
+            graph.add_edge( ( v * 7 ) % n, ( w * 7 ) % n, TCost( 100 + ( 7 * v + 13 * w ) % 50 * 10 ) );
+        }
+    }
+
+    // shortcuts produced when the graph was a boost::adjacency_list
+    std::vector<std::tuple<CHVertex, CHVertex, TCost, CHVertex>> expected = {
+        { 7, 12, 290, 0 },
+        { 12, 7, 610, 0 },
+        { 5, 10, 590, 1 },
+        { 5, 13, 740, 1 },
+        { 13, 5, 760, 1 },
+        { 13, 10, 650, 1 },
+        { 6, 11, 390, 2 },
+        { 11, 9, 860, 2 },
+        { 9, 11, 740, 2 },
+        { 7, 10, 550, 3 },
+        { 7, 15, 440, 3 },
+        { 12, 10, 760, 3 },
+        { 12, 15, 650, 3 },
+        { 10, 12, 640, 3 },
+        { 10, 15, 290, 3 },
+        { 15, 7, 960, 3 },
+        { 15, 10, 610, 3 },
+        { 8, 11, 350, 4 },
+        { 14, 13, 870, 5 },
+        { 10, 13, 550, 6 },
+        { 15, 13, 760, 6 },
+        { 13, 15, 640, 6 },
+        { 13, 11, 560, 6 },
+        { 14, 12, 660, 7 },
+        { 12, 11, 770, 8 },
+        { 15, 12, 450, 8 },
+        { 14, 15, 810, 10 },
+        { 13, 14, 930, 10 },
+        { 12, 14, 1040, 10 },
+        { 12, 13, 1310, 10 },
+        { 15, 14, 890, 10 }
+    };
+
+    std::vector<std::tuple<CHVertex, CHVertex, TCost, CHVertex>> shortcuts;
+    for ( const Shortcut& s : contract_graph( graph ) ) {
+        shortcuts.push_back( std::make_tuple( s.from, s.to, s.cost, s.contracted ) );
+    }
+    std::sort( expected.begin(), expected.end() );
+    std::sort( shortcuts.begin(), shortcuts.end() );
+    BOOST_CHECK( shortcuts == expected );
+}
+
+// bidirectional CH query on a given workspace, costs in seconds
+template <typename Workspace>
+float ch_query_cost( const CHQuery& graph, CHVertex origin, CHVertex destination, Workspace& ws )
+{
+    const float infinity = std::numeric_limits<float>::max();
+    ws.reset( num_vertices( graph ) );
+    for ( int dir = 0; dir < 2; dir++ ) {
+        const CHVertex v = dir ? destination : origin;
+        ws.labels[dir].set( v, 0.0f, v );
+        ws.queue[dir].push( 0.0f, v );
+    }
+    float total_cost = infinity;
+    int dir = 1;
+    while ( !ws.queue[0].empty() || !ws.queue[1].empty() ) {
+        float min_pi[2];
+        for ( int d = 0; d < 2; d++ ) {
+            min_pi[d] = ws.queue[d].empty() ? infinity : ws.queue[d].top().first;
+        }
+        if ( std::min( min_pi[0], min_pi[1] ) > total_cost ) {
+            break;
+        }
+        dir = ws.queue[1 - dir].empty() ? dir : 1 - dir;
+
+        float pi;
+        CHVertex u;
+        std::tie( pi, u ) = ws.queue[dir].top();
+        ws.queue[dir].pop();
+        if ( pi > ws.labels[dir].potential( u ) ) {
+            continue;
+        }
+        if ( ws.labels[1 - dir].reached( u ) ) {
+            total_cost = std::min( total_cost, pi + ws.labels[1 - dir].potential( u ) );
+        }
+        auto relax = [&]( CHVertex v, const CHEdge& e ) {
+            const float c = pi + float( e.property().b.cost / 100.0 );
+            if ( c < ws.labels[dir].potential( v ) ) {
+                ws.labels[dir].set( v, c, u );
+                ws.queue[dir].push( c, v );
+            }
+        };
+        if ( dir == 0 ) {
+            for ( auto oei = out_edges( u, graph ).first; oei != out_edges( u, graph ).second; oei++ ) {
+                relax( target( *oei, graph ), *oei );
+            }
+        }
+        else {
+            for ( auto iei = in_edges( u, graph ).first; iei != in_edges( u, graph ).second; iei++ ) {
+                relax( source( *iei, graph ), *iei );
+            }
+        }
+    }
+    return total_cost;
+}
+
+BOOST_AUTO_TEST_CASE( testCHQueryWorkspace )
+{
+    // labels left by a query are not seen by the next ones, even once the stamp has wrapped around
+    TimestampedLabels<float, uint32_t, uint8_t> labels;
+    labels.reset( 4 );
+    labels.set( 2, 1.0f, 0 );
+    BOOST_CHECK( labels.reached( 2 ) );
+    BOOST_CHECK_EQUAL( labels.potential( 2 ), 1.0f );
+    for ( int i = 0; i < 600; i++ ) {
+        labels.reset( 4 );
+        BOOST_CHECK( !labels.reached( 2 ) );
+        BOOST_CHECK_EQUAL( labels.potential( 2 ), ( TimestampedLabels<float, uint32_t, uint8_t>::infinity() ) );
+    }
+
+    // 8x8 grid, contracted in a shuffled order
+    const uint32_t side = 8;
+    const uint32_t n = side * side;
+    std::vector<uint32_t> rank( n );
+    for ( uint32_t v = 0; v < n; v++ ) {
+        rank[v] = v;
+    }
+    std::mt19937 gen( 7 );
+    std::shuffle( rank.begin(), rank.end(), gen );
+    std::uniform_int_distribution<TCost> cost_dist( 100, 1000 );
+    std::vector<Shortcut> arcs;
+    for ( const auto& e : grid_edges( side ) ) {
+        arcs.push_back( Shortcut{ rank[e.first], rank[e.second], cost_dist( gen ), 0 } );
+        arcs.push_back( Shortcut{ rank[e.second], rank[e.first], cost_dist( gen ), 0 } );
+    }
+    CHGraph graph( n );
+    for ( const Shortcut& a : arcs ) {
+        graph.add_edge( a.from, a.to, a.cost );
+    }
+    std::unique_ptr<CHRoutingData> rd = ch_routing_data_from_contraction( n, arcs, contract_graph( graph ) );
+
+    std::vector<double> reference;
+    for ( uint32_t o = 0; o < n; o++ ) {
+        std::vector<double> c = reference_dijkstra( n, ReferenceArcs( 1, std::make_pair( o, 0.0 ) ), [&]( uint32_t u, double cu, ReferenceArcs& next ) {
+                for ( const Shortcut& a : arcs ) {
+                    if ( a.from == u ) {
+                        next.push_back( std::make_pair( a.to, cu + a.cost / 100.0 ) );
+                    }
+                }
+            } );
+        reference.insert( reference.end(), c.begin(), c.end() );
+    }
+
+    // consecutive queries on the same workspaces, the second one wraps around twice
+    CHQueryWorkspace<float> ws;
+    CHQueryWorkspace<float, uint32_t, uint8_t> small_ws;
+    std::uniform_int_distribution<CHVertex> vertex_dist( 0, n - 1 );
+    for ( int i = 0; i < 600; i++ ) {
+        const CHVertex o = vertex_dist( gen );
+        const CHVertex d = vertex_dist( gen );
+        BOOST_CHECK_CLOSE( ch_query_cost( rd->ch_query(), o, d, ws ), reference[o * n + d], 1e-3 );
+        BOOST_CHECK_CLOSE( ch_query_cost( rd->ch_query(), o, d, small_ws ), reference[o * n + d], 1e-3 );
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( tempus_road_landmarks )
+
+BOOST_AUTO_TEST_CASE( testALTHeuristic )
+{
+    // 8x8 grid of sections of various lengths, one-way rows for cars
+    const uint32_t side = 8;
+    const uint32_t n = side * side;
+    Road::Graph graph = grid_road_graph( side, []( uint32_t v, uint32_t w ) {
+        const uint32_t lo = std::min( v, w ), hi = std::max( v, w );
+        const bool row = hi == lo + 1;
+        Road::Section s;
+        s.set_length( 100.0f + ( lo * 37 + hi * 11 ) % 200 );
+        s.set_car_speed_limit( row ? 90.0f : 30.0f );
+        s.set_traffic_rules( TrafficRulePedestrian | ( v < w || !row ? TrafficRuleCar : 0 ) );
+        return s;
+    } );
+
+    // reference distances, by Dijkstra
+    auto reference = [&]( LandmarkMetric metric ) {
+        std::vector<float> d;
+        for ( uint32_t o = 0; o < n; o++ ) {
+            std::vector<double> c = reference_dijkstra( n, ReferenceArcs( 1, std::make_pair( o, 0.0 ) ), [&]( uint32_t u, double cu, ReferenceArcs& next ) {
+                Road::OutEdgeIterator oi, oi_end;
+                for ( boost::tie( oi, oi_end ) = out_edges( u, graph ); oi != oi_end; oi++ ) {
+                    next.push_back( std::make_pair( uint32_t( target( *oi, graph ) ), cu + landmark_metric_weight( graph, *oi, metric ) ) );
+                }
+            } );
+            d.insert( d.end(), c.begin(), c.end() );
+        }
+        return d;
+    };
+
+    // the dump is mapped in memory, it is written to a temporary file
+    const std::string dump_file = ( boost::filesystem::temp_directory_path() / boost::filesystem::unique_path( "landmarks_dump-%%%%-%%%%.bin" ) ).string();
+    for ( LandmarkSelection selection : { LandmarkSelectionFarthest, LandmarkSelectionAvoid } ) {
+        RoadLandmarks landmarks( graph, 4, selection );
+        BOOST_CHECK_EQUAL( landmarks.num_vertices(), n );
+
+        RoadLandmarksBuilder builder;
+        TextProgression progression;
+        builder.file_export( &landmarks, dump_file, progression );
+        std::unique_ptr<RoutingData> rd = builder.file_import( dump_file, progression );
+        const RoadLandmarks& mapped = dynamic_cast<const RoadLandmarks&>( *rd );
+        BOOST_REQUIRE_EQUAL( mapped.num_landmarks(), 4 );
+
+        for ( LandmarkMetric metric : { LandmarkMetricCarTravelTime, LandmarkMetricWalkingCyclingLength } ) {
+            std::vector<float> d = reference( metric );
+            for ( uint32_t k = 0; k < 4; k++ ) {
+                BOOST_CHECK_EQUAL( mapped.landmark( metric, k ), landmarks.landmark( metric, k ) );
+                for ( uint32_t v = 0; v < n; v++ ) {
+                    float expected = d[landmarks.landmark( metric, k ) * n + v];
+                    if ( expected == RoadLandmarks::infinity() ) {
+                        BOOST_CHECK_EQUAL( landmarks.from_landmarks( metric, v )[k], expected );
+                    }
+                    else {
+                        BOOST_CHECK_CLOSE( landmarks.from_landmarks( metric, v )[k], expected, 1e-3 );
+                    }
+                    BOOST_CHECK_EQUAL( mapped.to_landmarks( metric, v )[k], landmarks.to_landmarks( metric, v )[k] );
+                }
+            }
+
+            // admissible and consistent
+            for ( uint32_t o = 0; o < n; o += 5 ) {
+                for ( uint32_t t = 0; t < n; t++ ) {
+                    ALTHeuristic h( mapped, metric, o, t, 1.0, 2 );
+                    BOOST_CHECK( h.active_landmarks().size() <= 2 );
+                    Road::EdgeIterator ei, ei_end;
+                    for ( boost::tie( ei, ei_end ) = edges( graph ); ei != ei_end; ei++ ) {
+                        float w = landmark_metric_weight( graph, *ei, metric );
+                        BOOST_CHECK( h( source( *ei, graph ) ) <= w + h( target( *ei, graph ) ) + 1e-3 );
+                    }
+                    for ( uint32_t v = 0; v < n; v++ ) {
+                        BOOST_CHECK( h( v ) <= d[v * n + t] + 1e-3 );
+                    }
+                    BOOST_CHECK_EQUAL( h( t ), 0.0 );
+                }
+            }
+        }
+    }
+    boost::filesystem::remove( dump_file );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( tempus_raptor )
+
+std::unique_ptr<PTTimetable> test_timetable()
+{
+    // stops 0 to 4, all attached to a single road vertex
+    std::vector<PTStop> stops( 5 );
+    for ( uint32_t s = 0; s < stops.size(); s++ ) {
+        stops[s].db_id = s + 1;
+    }
+    std::vector<PTTrip> trips( 4 );
+    for ( uint32_t t = 0; t < trips.size(); t++ ) {
+        trips[t].db_id = t + 1;
+    }
+    std::vector<PTTripLeg> legs = {
+        // line A, two trips 0 -> 1 -> 2, given out of order
+        { 1, 1, 2, 31.0, 40.0 },
+        { 0, 0, 1, 10.0, 20.0 },
+        { 1, 0, 1, 20.0, 30.0 },
+        { 0, 1, 2, 21.0, 30.0 },
+        // line B, 1 -> 3
+        { 2, 1, 3, 25.0, 35.0 },
+        // line C, 0 -> 3, direct but slow
+        { 3, 0, 3, 15.0, 50.0 }
+    };
+    std::unique_ptr<PTTimetable> timetable( new PTTimetable( std::move( stops ), std::move( trips ), std::move( legs ), 1 ) );
+    // 120m footpath between 3 and 4
+    std::vector<std::vector<PTFootpath>> footpaths( 5 );
+    footpaths[3].push_back( PTFootpath{ 4, 120.0 } );
+    footpaths[4].push_back( PTFootpath{ 3, 120.0 } );
+    timetable->set_footpaths( footpaths );
+    return timetable;
+}
+
+std::unique_ptr<PTTimetable> transfer_timetable()
+{
+    // stop 1 is reached at 20 by a trip from 0, too late to board the trip of 21 to 3
+    // after the minimum transfer time, and at 20.5 by a trip to 2 and a 150m footpath
+    std::vector<PTStop> stops( 4 );
+    for ( uint32_t s = 0; s < stops.size(); s++ ) {
+        stops[s].db_id = s + 1;
+    }
+    std::vector<PTTrip> trips( 4 );
+    for ( uint32_t t = 0; t < trips.size(); t++ ) {
+        trips[t].db_id = t + 1;
+    }
+    std::vector<PTTripLeg> legs = {
+        { 0, 0, 1, 9.0, 20.0 },
+        { 1, 0, 2, 10.0, 18.0 },
+        { 2, 1, 3, 21.0, 30.0 },
+        { 3, 1, 3, 25.0, 40.0 }
+    };
+    std::unique_ptr<PTTimetable> timetable( new PTTimetable( std::move( stops ), std::move( trips ), std::move( legs ), 1 ) );
+    std::vector<std::vector<PTFootpath>> footpaths( 4 );
+    footpaths[2].push_back( PTFootpath{ 1, 150.0 } );
+    timetable->set_footpaths( footpaths );
+    return timetable;
+}
+
+BOOST_AUTO_TEST_CASE( testRaptor )
+{
+    std::unique_ptr<PTTimetable> tt( test_timetable() );
+    const PTTimetable& timetable = *tt;
+    BOOST_CHECK_EQUAL( timetable.num_routes(), 3 );
+
+    Raptor raptor( timetable );
+    std::vector<bool> active( 4, true );
+    const std::vector<PTAccess> access = { { 0, 0.0 } };
+    const float walking_speed = 60.0;
+    const float min_transfer_time = 2.0;
+
+    // one direct trip, or two faster trips with a transfer at 1
+    std::vector<PTJourney> journeys = raptor.query( active, access, { { 3, 0.0 } }, 5.0, 4, walking_speed, min_transfer_time );
+    BOOST_REQUIRE_EQUAL( journeys.size(), 2 );
+    BOOST_CHECK_EQUAL( journeys[0].n_trips, 1 );
+    BOOST_CHECK_EQUAL( journeys[0].arrival_time, 50.0 );
+    BOOST_CHECK_EQUAL( journeys[1].n_trips, 2 );
+    BOOST_CHECK_EQUAL( journeys[1].arrival_time, 35.0 );
+
+    // with the footpath to 4
+    journeys = raptor.query( active, access, { { 4, 1.0 } }, 5.0, 4, walking_speed, min_transfer_time );
+    BOOST_REQUIRE_EQUAL( journeys.size(), 2 );
+    BOOST_CHECK_EQUAL( journeys[1].arrival_time, 38.0 );
+    const std::vector<PTJourneyLeg>& j = journeys[1].legs;
+    BOOST_REQUIRE_EQUAL( j.size(), 5 );
+    BOOST_CHECK( j[0].type == PTJourneyLeg::LegWalk && j[0].from_stop == PTJourneyLeg::NO_STOP && j[0].to_stop == 0 );
+    BOOST_CHECK( j[1].type == PTJourneyLeg::LegRide && j[1].trip == 0 && j[1].from_stop == 0 && j[1].to_stop == 1 );
+    BOOST_CHECK_EQUAL( j[1].departure_time, 10.0 );
+    BOOST_CHECK( j[2].type == PTJourneyLeg::LegRide && j[2].trip == 2 && j[2].from_stop == 1 && j[2].to_stop == 3 );
+    BOOST_CHECK( j[3].type == PTJourneyLeg::LegWalk && j[3].from_stop == 3 && j[3].to_stop == 4 );
+    BOOST_CHECK( j[4].type == PTJourneyLeg::LegWalk && j[4].from_stop == 4 && j[4].to_stop == PTJourneyLeg::NO_STOP );
+
+    // no transfer
+    journeys = raptor.query( active, access, { { 3, 0.0 } }, 5.0, 0, walking_speed, min_transfer_time );
+    BOOST_REQUIRE_EQUAL( journeys.size(), 1 );
+    BOOST_CHECK_EQUAL( journeys[0].arrival_time, 50.0 );
+
+    // the transfer is too short when the first trip is missed
+    journeys = raptor.query( active, access, { { 3, 0.0 } }, 12.0, 4, walking_speed, min_transfer_time );
+    BOOST_REQUIRE_EQUAL( journeys.size(), 1 );
+    BOOST_CHECK_EQUAL( journeys[0].n_trips, 1 );
+
+    // line B does not run
+    active[2] = false;
+    journeys = raptor.query( active, access, { { 3, 0.0 } }, 5.0, 4, walking_speed, min_transfer_time );
+    BOOST_REQUIRE_EQUAL( journeys.size(), 1 );
+    BOOST_CHECK_EQUAL( journeys[0].arrival_time, 50.0 );
+
+    // a walk arrival later than a trip arrival still allows to board earlier
+    std::unique_ptr<PTTimetable> transfer_tt( transfer_timetable() );
+    Raptor transfer_raptor( *transfer_tt );
+    journeys = transfer_raptor.query( std::vector<bool>( 4, true ), access, { { 3, 0.0 } }, 5.0, 4, walking_speed, min_transfer_time );
+    BOOST_REQUIRE_EQUAL( journeys.size(), 1 );
+    BOOST_CHECK_EQUAL( journeys[0].arrival_time, 30.0 );
+    BOOST_CHECK_EQUAL( journeys[0].n_trips, 2 );
+    BOOST_REQUIRE_EQUAL( journeys[0].legs.size(), 5 );
+    BOOST_CHECK( journeys[0].legs[1].type == PTJourneyLeg::LegRide && journeys[0].legs[1].trip == 1 );
+    BOOST_CHECK( journeys[0].legs[2].type == PTJourneyLeg::LegWalk && journeys[0].legs[2].from_stop == 2 && journeys[0].legs[2].to_stop == 1 );
+    BOOST_CHECK( journeys[0].legs[3].type == PTJourneyLeg::LegRide && journeys[0].legs[3].trip == 2 );
+}
+
+BOOST_AUTO_TEST_CASE( testRaptorRange )
+{
+    std::unique_ptr<PTTimetable> tt( test_timetable() );
+    Raptor raptor( *tt );
+    std::vector<bool> active( 4, true );
+    const std::vector<PTAccess> access = { { 0, 0.0 } };
+
+    // leaving at 20 reaches 1 after line B, leaving at 10 through C is dominated by leaving at 15
+    std::vector<PTJourney> journeys = raptor.range_query( active, access, { { 3, 0.0 } }, 0.0, 30.0, 4, 60.0, 2.0 );
+    BOOST_REQUIRE_EQUAL( journeys.size(), 2 );
+    BOOST_CHECK_EQUAL( journeys[0].departure_time, 10.0 );
+    BOOST_CHECK_EQUAL( journeys[0].arrival_time, 35.0 );
+    BOOST_CHECK_EQUAL( journeys[0].n_trips, 2 );
+    BOOST_CHECK_EQUAL( journeys[1].departure_time, 15.0 );
+    BOOST_CHECK_EQUAL( journeys[1].arrival_time, 50.0 );
+    BOOST_CHECK_EQUAL( journeys[1].n_trips, 1 );
+
+    // labels of the range query are reset for the next one
+    journeys = raptor.query( active, access, { { 3, 0.0 } }, 12.0, 4, 60.0, 2.0 );
+    BOOST_REQUIRE_EQUAL( journeys.size(), 1 );
+    BOOST_CHECK_EQUAL( journeys[0].arrival_time, 50.0 );
+
+    // the window ends before the first trip
+    BOOST_CHECK( raptor.range_query( active, access, { { 3, 0.0 } }, 0.0, 5.0, 4, 60.0, 2.0 ).empty() );
+}
+
+BOOST_AUTO_TEST_CASE( testConnectionScan )
+{
+    std::unique_ptr<PTTimetable> tt( test_timetable() );
+    PTConnectionTable connections( *tt );
+    BOOST_CHECK_EQUAL( connections.num_connections(), 6 );
+    for ( size_t i = 1; i < connections.num_connections(); i++ ) {
+        BOOST_CHECK( connections.connection( i - 1 ).departure_time <= connections.connection( i ).departure_time );
+    }
+
+    ConnectionScan csa( *tt, connections );
+    std::vector<bool> active( 4, true );
+    const std::vector<PTAccess> access = { { 0, 0.0 } };
+
+    PTJourney j;
+    BOOST_REQUIRE( csa.query( active, access, { { 4, 1.0 } }, 5.0, 60.0, 2.0, j ) );
+    BOOST_CHECK_EQUAL( j.arrival_time, 38.0 );
+    BOOST_CHECK_EQUAL( j.n_trips, 2 );
+    BOOST_REQUIRE_EQUAL( j.legs.size(), 5 );
+    BOOST_CHECK( j.legs[1].type == PTJourneyLeg::LegRide && j.legs[1].trip == 0 && j.legs[1].board_position == 0 && j.legs[1].alight_position == 1 );
+    BOOST_CHECK( j.legs[2].type == PTJourneyLeg::LegRide && j.legs[2].trip == 2 && j.legs[2].from_stop == 1 && j.legs[2].to_stop == 3 );
+    BOOST_CHECK( j.legs[3].type == PTJourneyLeg::LegWalk && j.legs[3].from_stop == 3 && j.legs[3].to_stop == 4 );
+
+    // the transfer at 1 is missed
+    BOOST_REQUIRE( csa.query( active, access, { { 3, 0.0 } }, 12.0, 60.0, 2.0, j ) );
+    BOOST_CHECK_EQUAL( j.arrival_time, 50.0 );
+    BOOST_CHECK_EQUAL( j.n_trips, 1 );
+
+    // nothing leaves after the last departure
+    BOOST_CHECK( !csa.query( active, access, { { 3, 0.0 } }, 60.0, 60.0, 2.0, j ) );
+
+    // arrivals at every stop, before 35
+    const std::vector<float>& arrivals = csa.earliest_arrivals( active, access, 5.0, 60.0, 2.0, 35.0 );
+    BOOST_CHECK_EQUAL( arrivals[0], 5.0 );
+    BOOST_CHECK_EQUAL( arrivals[1], 20.0 );
+    BOOST_CHECK_EQUAL( arrivals[2], 30.0 );
+    BOOST_CHECK_EQUAL( arrivals[3], 35.0 );
+    BOOST_CHECK_EQUAL( arrivals[4], PTTimetable::infinity() );
+
+    // a walk arrival later than a trip arrival still allows to board earlier
+    std::unique_ptr<PTTimetable> transfer_tt( transfer_timetable() );
+    PTConnectionTable transfer_connections( *transfer_tt );
+    ConnectionScan transfer_csa( *transfer_tt, transfer_connections );
+    BOOST_REQUIRE( transfer_csa.query( active, access, { { 3, 0.0 } }, 5.0, 60.0, 2.0, j ) );
+    BOOST_CHECK_EQUAL( j.arrival_time, 30.0 );
+    BOOST_CHECK_EQUAL( j.n_trips, 2 );
+    BOOST_REQUIRE_EQUAL( j.legs.size(), 5 );
+    BOOST_CHECK( j.legs[2].type == PTJourneyLeg::LegWalk && j.legs[2].from_stop == 2 && j.legs[2].to_stop == 1 );
+    BOOST_CHECK( j.legs[3].type == PTJourneyLeg::LegRide && j.legs[3].trip == 2 );
+}
+
+BOOST_AUTO_TEST_CASE( testMcRaptor )
+{
+    // stop 2 is in another fare zone
+    std::vector<PTStop> stops( 4 );
+    for ( uint32_t s = 0; s < stops.size(); s++ ) {
+        stops[s].db_id = s + 1;
+    }
+    stops[2].zone_id = 1;
+    std::vector<PTTrip> trips( 5 );
+    for ( uint32_t t = 0; t < trips.size(); t++ ) {
+        trips[t].db_id = t + 1;
+    }
+    std::vector<PTTripLeg> legs = {
+        // 0 -> 1 -> 3, in a single zone
+        { 0, 0, 1, 10.0, 20.0 },
+        { 1, 1, 3, 25.0, 40.0 },
+        // 0 -> 2 -> 3, faster through zone 1
+        { 2, 0, 2, 10.0, 15.0 },
+        { 3, 2, 3, 20.0, 30.0 },
+        // 0 -> 3, direct
+        { 4, 0, 3, 5.0, 60.0 }
+    };
+    PTTimetable timetable( std::move( stops ), std::move( trips ), std::move( legs ), 1 );
+
+    McRaptor mcraptor( timetable );
+    std::vector<bool> active( 5, true );
+    std::vector<PTJourney> journeys = mcraptor.query( active, { { 0, 0.0 } }, { { 3, 0.0 } }, 0.0, 4, 60.0, 2.0 );
+    BOOST_REQUIRE_EQUAL( journeys.size(), 3 );
+    BOOST_CHECK_EQUAL( journeys[0].n_trips, 1 );
+    BOOST_CHECK_EQUAL( journeys[0].arrival_time, 60.0 );
+    BOOST_CHECK_EQUAL( pt_journey_fare_zones( timetable, journeys[0] ), 1 );
+    BOOST_CHECK_EQUAL( journeys[1].n_trips, 2 );
+    BOOST_CHECK_EQUAL( journeys[1].arrival_time, 30.0 );
+    BOOST_CHECK_EQUAL( pt_journey_fare_zones( timetable, journeys[1] ), 3 );
+    BOOST_CHECK_EQUAL( journeys[2].n_trips, 2 );
+    BOOST_CHECK_EQUAL( journeys[2].arrival_time, 40.0 );
+    BOOST_CHECK_EQUAL( pt_journey_fare_zones( timetable, journeys[2] ), 1 );
+
+    // RAPTOR only keeps the fastest journey with two trips
+    Raptor raptor( timetable );
+    BOOST_CHECK_EQUAL( raptor.query( active, { { 0, 0.0 } }, { { 3, 0.0 } }, 0.0, 4, 60.0, 2.0 ).size(), 2 );
+
+    // no transfer
+    journeys = mcraptor.query( active, { { 0, 0.0 } }, { { 3, 0.0 } }, 0.0, 0, 60.0, 2.0 );
+    BOOST_REQUIRE_EQUAL( journeys.size(), 1 );
+    BOOST_CHECK_EQUAL( journeys[0].arrival_time, 60.0 );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
+BOOST_AUTO_TEST_SUITE( tempus_mm_lib )
+
+// label key of a multimodal search, with an automaton state as dynamic_multi_plugin
+struct TestLabelKey
+{
+    Multimodal::Vertex vertex;
+    db_id_t mode;
+    int state;
+
+    bool operator==( const TestLabelKey& other ) const
+    {
+        return vertex == other.vertex && mode == other.mode && state == other.state;
+    }
+};
+
+BOOST_AUTO_TEST_CASE( testLabelMap )
+{
+    std::vector<std::pair<uint32_t, uint32_t>> road_edges = { { 0, 1 }, { 1, 2 }, { 2, 3 } };
+    std::vector<Road::Section> sections( road_edges.size() );
+    std::unique_ptr<Road::Graph> road( new Road::Graph( boost::edges_are_unsorted_multi_pass, road_edges.begin(), road_edges.end(), sections.begin(), 4 ) );
+    Multimodal::Graph graph( std::move( road ) );
+    graph.build_adjacency();
+    auto v = []( uint32_t i ) { return Multimodal::Vertex( Road::Vertex( i ), Multimodal::Vertex::road_t() ); };
+
+    MultimodalLabelMap<TestLabelKey, float> labels;
+    auto find = [&labels]( const Multimodal::Vertex& vertex, db_id_t mode, int state ) { return labels.find( TestLabelKey{ vertex, mode, state } ); };
+    labels.reset( graph, { TransportModeWalking, TransportModePrivateCar } );
+    BOOST_CHECK( labels.empty() );
+    labels[TestLabelKey{ v( 1 ), TransportModeWalking, 0 }] = 1.0;
+    labels[TestLabelKey{ v( 1 ), TransportModePrivateCar, 0 }] = 2.0;
+    // same vertex and mode, another state
+    labels[TestLabelKey{ v( 1 ), TransportModeWalking, 3 }] = 3.0;
+    labels[TestLabelKey{ v( 3 ), TransportModeWalking, 0 }] = 4.0;
+    labels[TestLabelKey{ v( 1 ), TransportModeWalking, 0 }] += 10.0;
+    BOOST_CHECK_EQUAL( labels.size(), 4 );
+    BOOST_CHECK_EQUAL( find( v( 1 ), TransportModeWalking, 0 )->second, 11.0 );
+    BOOST_CHECK_EQUAL( find( v( 1 ), TransportModePrivateCar, 0 )->second, 2.0 );
+    BOOST_CHECK_EQUAL( find( v( 1 ), TransportModeWalking, 3 )->second, 3.0 );
+    BOOST_CHECK( find( v( 1 ), TransportModeWalking, 1 ) == labels.end() );
+    BOOST_CHECK( find( v( 2 ), TransportModeWalking, 0 ) == labels.end() );
+    // insertion order
+    std::vector<float> values;
+    for ( const auto& l : labels ) {
+        values.push_back( l.second );
+    }
+    BOOST_CHECK( values == std::vector<float>( { 11.0, 2.0, 3.0, 4.0 } ) );
+
+    // labels of the previous searches are forgotten, with more or fewer modes
+    labels.reset( graph, { TransportModeWalking, TransportModePrivateBicycle, TransportModePrivateCar } );
+    BOOST_CHECK( labels.empty() );
+    BOOST_CHECK( find( v( 1 ), TransportModeWalking, 0 ) == labels.end() );
+    labels[TestLabelKey{ v( 2 ), TransportModePrivateBicycle, 0 }] = 5.0;
+    labels[TestLabelKey{ v( 2 ), TransportModePrivateCar, 0 }] = 6.0;
+
+    labels.reset( graph, { TransportModePrivateCar } );
+    BOOST_CHECK( find( v( 2 ), TransportModePrivateCar, 0 ) == labels.end() );
+    const TestLabelKey car_key{ v( 2 ), TransportModePrivateCar, 0 };
+    BOOST_CHECK_EQUAL( labels[car_key], 0.0 );
+    labels[TestLabelKey{ v( 0 ), TransportModePrivateCar, 0 }] = 7.0;
+    BOOST_CHECK_EQUAL( labels.size(), 2 );
+    BOOST_CHECK_EQUAL( find( v( 0 ), TransportModePrivateCar, 0 )->second, 7.0 );
+}
+
+
+BOOST_AUTO_TEST_CASE( testSpeedProfile )
+{
+    // (begin, length, speed) periods of three sections: contiguous, with a gap, and a single one
+    struct Period
+    {
+        double begin;
+        double length;
+        double speed;
+    };
+    const std::vector<std::vector<Period>> profiles = {
+        { { 0.0, 60.0, 60.0 }, { 60.0, 60.0, 30.0 } },
+        { { 0.0, 60.0, 60.0 }, { 90.0, 60.0, 30.0 }, { 150.0, 30.0, 90.0 } },
+        { { 30.0, 60.0, 60.0 } }
+    };
+    std::vector<std::pair<uint32_t, uint32_t>> road_edges = { { 0, 1 }, { 1, 2 }, { 2, 3 }, { 3, 0 } };
+    std::vector<Road::Section> sections( road_edges.size() );
+    for ( size_t i = 0; i < sections.size(); i++ ) {
+        sections[i].set_db_id( i + 1 );
+    }
+    Road::Graph graph( boost::edges_are_unsorted_multi_pass, road_edges.begin(), road_edges.end(), sections.begin(), 4 );
+
+    RoadEdgeSpeedProfile profile;
+    for ( size_t i = 0; i < profiles.size(); i++ ) {
+        // added out of order
+        for ( auto it = profiles[i].rbegin(); it != profiles[i].rend(); it++ ) {
+            profile.add_period( i + 1, SpeedRuleCar, it->begin, it->length, it->speed );
+        }
+    }
+    profile.compile( graph );
+
+    // walk through the periods: the speed of a period applies until its end,
+    // a gap is covered at the speed of the next period, the last one extends after its end
+    auto walk = []( const std::vector<Period>& periods, double length, double time ) {
+        double t = time;
+        for ( size_t k = 0; k < periods.size(); k++ ) {
+            const double end = periods[k].begin + periods[k].length;
+            const double speed = periods[k].speed * 1000.0 / 60.0;
+            if ( k + 1 < periods.size() && end <= t ) {
+                continue;
+            }
+            if ( k + 1 == periods.size() || length <= speed * ( end - t ) ) {
+                return t + length / speed - time;
+            }
+            length -= speed * ( end - t );
+            t = end;
+        }
+        return 0.0;
+    };
+
+    Road::EdgeIterator ei, ei_end;
+    for ( boost::tie( ei, ei_end ) = edges( graph ); ei != ei_end; ei++ ) {
+        const size_t i = graph[*ei].db_id() - 1;
+        double tt;
+        if ( i >= profiles.size() ) {
+            BOOST_CHECK( !profile.travel_time( *ei, SpeedRuleCar, 100.0, 10.0, tt ) );
+            continue;
+        }
+        BOOST_CHECK( !profile.travel_time( *ei, SpeedRuleCar, 100.0, profiles[i].front().begin - 1.0, tt ) );
+        BOOST_CHECK( !profile.travel_time( *ei, SpeedRuleTruck, 100.0, 40.0, tt ) );
+        // departures in every period and gap, and arrivals after the last period
+        for ( double time : { 0.0, 30.0, 59.0, 60.0, 75.0, 89.5, 100.0, 119.0, 130.0, 160.0, 200.0 } ) {
+            if ( time < profiles[i].front().begin ) {
+                continue;
+            }
+            for ( double length : { 500.0, 20000.0, 60000.0, 200000.0 } ) {
+                BOOST_REQUIRE( profile.travel_time( *ei, SpeedRuleCar, length, time, tt ) );
+                BOOST_CHECK_CLOSE( tt, walk( profiles[i], length, time ), 1e-6 );
+            }
+        }
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE( testRoadTravelTimeProfile )
+{
+    // 5x5 grid of two-way sections, with speed profiles of cars on two thirds of them
+    const uint32_t side = 5;
+    const uint32_t n = side * side;
+    std::mt19937 rng( 11 );
+    std::vector<Road::Section> sections;
+    Road::Graph graph = grid_road_graph( side, [&]( uint32_t, uint32_t ) {
+        Road::Section s;
+        s.set_db_id( sections.size() + 1 );
+        s.set_length( 500.0f + rng() % 2000 );
+        s.set_car_speed_limit( 30.0f + rng() % 60 );
+        s.set_traffic_rules( TrafficRuleCar );
+        sections.push_back( s );
+        return s;
+    } );
+
+    RoadEdgeSpeedProfile profile;
+    for ( const Road::Section& s : sections ) {
+        if ( rng() % 3 == 0 ) {
+            continue;
+        }
+        // periods from midnight, with a gap after the first one
+        double begin = 0.0;
+        for ( int k = 0; k < 3; k++ ) {
+            const double length = 2.0 + rng() % 10;
+            profile.add_period( s.db_id(), SpeedRuleCar, begin, length, 10.0 + rng() % 80 );
+            begin += length + ( k == 0 ? 3.0 : 0.0 );
+        }
+    }
+    profile.compile( graph );
+
+    TransportMode car;
+    car.set_speed_rule( SpeedRuleCar );
+    car.set_traffic_rules( TrafficRuleCar );
+    auto edge_function = [&]( const Road::Edge& e, TravelTimeFunction& f ) {
+        const double length = graph[e].length();
+        if ( !profile.travel_time_function( e, SpeedRuleCar, length, f ) ) {
+            f = TravelTimeFunction( avg_road_travel_time( graph, e, length, car ) );
+        }
+        return true;
+    };
+
+    // scalar time-dependent Dijkstra
+    auto earliest_arrival = [&]( Road::Vertex origin, Road::Vertex destination, double departure ) {
+        std::vector<double> arrival = reference_dijkstra( n, ReferenceArcs( 1, std::make_pair( uint32_t( origin ), departure ) ), [&]( uint32_t u, double t, ReferenceArcs& next ) {
+            Road::OutEdgeIterator oi, oi_end;
+            for ( boost::tie( oi, oi_end ) = out_edges( u, graph ); oi != oi_end; oi++ ) {
+                const double at = t + road_travel_time( graph, *oi, graph[*oi].length(), t, car, DEFAULT_WALKING_SPEED, DEFAULT_CYCLING_SPEED, &profile );
+                next.push_back( std::make_pair( uint32_t( target( *oi, graph ) ), at ) );
+            }
+        } );
+        return arrival[destination] - departure;
+    };
+
+    size_t n_breakpoints = 0;
+    for ( auto od : { std::make_pair( 0u, n - 1 ), std::make_pair( side - 1, n - side ), std::make_pair( 7u, 17u ), std::make_pair( 10u, 14u ) } ) {
+        TravelTimeFunction f = road_travel_time_profile( graph, od.first, od.second, edge_function );
+        BOOST_REQUIRE( !f.empty() );
+        n_breakpoints += f.points().size();
+
+        // same breakpoints as a result element, for the car mode
+        Result result;
+        result.push_back( road_travel_time_profile( graph, od.first, od.second, car, &profile, DEFAULT_WALKING_SPEED, DEFAULT_CYCLING_SPEED ) );
+        BOOST_REQUIRE( result.back().is_travel_time_profile() );
+        BOOST_CHECK( !result.back().is_roadmap() && !result.back().is_isochrone() );
+        const TravelTimeProfile& tp = result.back().travel_time_profile();
+        BOOST_REQUIRE_EQUAL( tp.size(), f.points().size() );
+        for ( size_t i = 0; i < tp.size(); i++ ) {
+            BOOST_CHECK_EQUAL( tp[i].departure_time(), f.points()[i].time );
+            BOOST_CHECK_EQUAL( tp[i].travel_time(), f.points()[i].travel_time );
+        }
+        // exact at breakpoints, from midnight on: before, road_travel_time() does not use the profiles
+        for ( const TravelTimeFunction::Point& p : f.points() ) {
+            if ( p.time < 0.0 ) {
+                continue;
+            }
+            BOOST_CHECK_CLOSE( p.travel_time, earliest_arrival( od.first, od.second, p.time ), 1e-6 );
+        }
+        // linear between breakpoints
+        for ( size_t i = 1; i < f.points().size(); i++ ) {
+            const double t = ( f.points()[i - 1].time + f.points()[i].time ) / 2.0;
+            if ( t >= 0.0 ) {
+                BOOST_CHECK_CLOSE( f( t ), earliest_arrival( od.first, od.second, t ), 1e-6 );
+            }
+        }
+    }
+    BOOST_CHECK( n_breakpoints > 20 );
+
+    // no section allowed to pedestrians
+    TransportMode walking;
+    walking.set_speed_rule( SpeedRulePedestrian );
+    walking.set_traffic_rules( TrafficRulePedestrian );
+    BOOST_CHECK( road_travel_time_profile( graph, 0, n - 1, walking, &profile, DEFAULT_WALKING_SPEED, DEFAULT_CYCLING_SPEED ).empty() );
+}
+
+BOOST_AUTO_TEST_CASE( testExternalTimetableNetworks )
+{
+    // two networks of one section, whose edges have the same index
+    std::map<db_id_t, std::unique_ptr<PublicTransport::Graph>> networks;
+    for ( db_id_t id : { 1, 2 } ) {
+        std::vector<std::pair<PublicTransport::Vertex, PublicTransport::Vertex>> ends( 1, std::make_pair( 0, 1 ) );
+        std::vector<PublicTransport::Section> sections( 1 );
+        networks[id].reset( new PublicTransport::Graph( boost::edges_are_unsorted_multi_pass, ends.begin(), ends.end(), sections.begin(), 2 ) );
+    }
+    Multimodal::Graph graph( std::unique_ptr<Road::Graph>( new Road::Graph() ) );
+    graph.set_public_transports( std::move( networks ) );
+
+    // a timetable mode and a frequency mode shared by both networks, slower on the second one
+    TimetableMap timetable, rtimetable;
+    FrequencyMap frequency, rfrequency;
+    for ( PublicTransportGraphIndex k = 0; k < 2; k++ ) {
+        const PublicTransportEdgeKey key = public_transport_edge_key( k, *edges( graph.public_transport( k ) ).first );
+        TimetableData td;
+        td.trip_id = k + 1;
+        td.arrival_time = 20.0 + 20.0 * k;
+        timetable[1][key].emplace( 10.0, td );
+        FrequencyData fd;
+        fd.trip_id = k + 1;
+        fd.end_time = 100.0;
+        fd.headway = 10.0;
+        fd.travel_time = 5.0 + 3.0 * k;
+        frequency[2][key].emplace( 0.0, fd );
+    }
+
+    const Date day( 2016, 1, 1 );
+    pt2pt_time_external_timetable_t<Multimodal::Graph> pt_time( graph, day, 0.0, timetable, rtimetable, frequency, rfrequency );
+    for ( PublicTransportGraphIndex k = 0; k < 2; k++ ) {
+        const Multimodal::Edge e( Multimodal::Vertex( k, PublicTransport::Vertex( 0 ) ), Multimodal::Vertex( k, PublicTransport::Vertex( 1 ) ), Road::Edge() );
+        PublicTransport::Edge pt_e;
+        bool found = false;
+        boost::tie( pt_e, found ) = public_transport_edge( e, graph );
+        BOOST_REQUIRE( found );
+
+        double shift_time = 0.0, wait_time = 0.0;
+        db_id_t trip_id = 0;
+        BOOST_CHECK_EQUAL( pt_time( e, pt_e, 1, 5.0, 0.0, shift_time, 0, trip_id, wait_time ), 15.0 + 20.0 * k );
+        BOOST_CHECK_EQUAL( trip_id, k + 1 );
+        BOOST_CHECK_EQUAL( pt_time( e, pt_e, 2, 50.0, 0.0, shift_time, 0, trip_id, wait_time ), 10.0 + 3.0 * k );
+        BOOST_CHECK_EQUAL( trip_id, k + 1 );
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
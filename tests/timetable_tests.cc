@@ -25,13 +25,12 @@ BOOST_AUTO_TEST_SUITE( timetable )
 
 BOOST_AUTO_TEST_CASE( test_timetable )
 {
-    PublicTransport::Timetable tt;
     std::vector<PublicTransport::Timetable::TripTime> v;
     v.emplace_back( 12.0, 13.0, 1, 1 );
     v.emplace_back( 12.0, 13.0, 1, 2 );
     v.emplace_back( 13.5, 14.0, 3, 2 );
     v.emplace_back( 14.5, 15.0, 3, 2 );
-    tt.assign_sorted_table( v );
+    PublicTransport::Timetable tt( v );
 
     {
         auto p = tt.next_departures( 10.0 );
@@ -138,5 +137,70 @@ BOOST_AUTO_TEST_CASE( test_timetable )
     }
 }
 
+BOOST_AUTO_TEST_CASE( test_graph_timetables )
+{
+    std::vector<std::pair<PublicTransport::Vertex, PublicTransport::Vertex>> ends;
+    ends.push_back( std::make_pair( 1, 2 ) );
+    ends.push_back( std::make_pair( 0, 1 ) );
+    std::vector<PublicTransport::Section> sections( 2 );
+    PublicTransport::Graph g( boost::edges_are_unsorted_multi_pass, ends.begin(), ends.end(), sections.begin(), 3 );
+
+    PublicTransport::Edge e01, e12;
+    bool found = false;
+    boost::tie( e01, found ) = edge( PublicTransport::Vertex( 0 ), PublicTransport::Vertex( 1 ), g );
+    BOOST_CHECK( found );
+    boost::tie( e12, found ) = edge( PublicTransport::Vertex( 1 ), PublicTransport::Vertex( 2 ), g );
+    BOOST_CHECK( found );
+
+    std::vector<std::vector<PublicTransport::Timetable::TripTime>> tables( num_edges( g ) );
+    tables[get( boost::edge_index, g, e01 )].emplace_back( 12.0, 13.0, 1, 1 );
+    tables[get( boost::edge_index, g, e12 )].emplace_back( 13.0, 14.0, 1, 1 );
+    tables[get( boost::edge_index, g, e12 )].emplace_back( 15.0, 16.0, 2, 2 );
+    get_property( g ).assign_time_tables( tables );
+
+    BOOST_CHECK_EQUAL( PublicTransport::time_table( g, e01 ).table().size(), 1 );
+    BOOST_CHECK_EQUAL( PublicTransport::time_table( g, e12 ).table().size(), 2 );
+    BOOST_CHECK_EQUAL( PublicTransport::time_table( g, e12 ).table().begin()->trip_id(), 1 );
+
+    Date day( 2016, 1, 1 );
+    get_property( g ).service_map().add( 2, day );
+    boost::optional<PublicTransport::Timetable::TripTime> tt = PublicTransport::next_departure( g, e12, day, 14.0 );
+    BOOST_CHECK( tt );
+    BOOST_CHECK_EQUAL( tt->trip_id(), 2 );
+    BOOST_CHECK( !PublicTransport::next_departure( g, e01, day, 12.0 ) );
+
+    PublicTransport::ActiveServices active = get_property( g ).service_map().active_services( day );
+    tt = PublicTransport::next_departure( g, e12, active, 14.0 );
+    BOOST_CHECK( tt );
+    BOOST_CHECK_EQUAL( tt->trip_id(), 2 );
+    BOOST_CHECK( !PublicTransport::next_departure( g, e01, active, 12.0 ) );
+}
+
+BOOST_AUTO_TEST_CASE( test_service_map )
+{
+    PublicTransport::ServiceMap services;
+    Date day( 2016, 6, 1 );
+    services.add( 10, day );
+    // extend the range after and before the first day
+    services.add( 10, day + boost::gregorian::days( 200 ) );
+    services.add( 20, day - boost::gregorian::days( 100 ) );
+    services.add( 20, day + boost::gregorian::days( 1 ) );
+
+    BOOST_CHECK_EQUAL( services.size(), 2 );
+    BOOST_CHECK( services.is_available_on( 10, day ) );
+    BOOST_CHECK( services.is_available_on( 10, day + boost::gregorian::days( 200 ) ) );
+    BOOST_CHECK( !services.is_available_on( 10, day + boost::gregorian::days( 1 ) ) );
+    BOOST_CHECK( services.is_available_on( 20, day - boost::gregorian::days( 100 ) ) );
+    BOOST_CHECK( services.is_available_on( 20, day + boost::gregorian::days( 1 ) ) );
+    BOOST_CHECK( !services.is_available_on( 20, day ) );
+    BOOST_CHECK( !services.is_available_on( 30, day ) );
+    BOOST_CHECK( !services.is_available_on( 10, day + boost::gregorian::days( 1000 ) ) );
+
+    PublicTransport::ActiveServices active = services.active_services( day + boost::gregorian::days( 1 ) );
+    BOOST_CHECK_EQUAL( active.size(), 2 );
+    BOOST_CHECK( !active[services.service_index( 10 )] );
+    BOOST_CHECK( active[services.service_index( 20 )] );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 